@@ -0,0 +1,471 @@
+// Offline codec sweep, reference WAV files run through the project's encode/decode path across Opus settings,
+// frame durations and simulated loss. Quality is measured as SNR and segmental SNR against the reference,
+// next to the encode/decode CPU time as a percentage of realtime and the bitrate actually produced.
+// SNR is a waveform metric, so it understates the perceived quality Opus reaches at low bitrates.
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "lib/clock.h"
+#include "lib/codec.h"
+#include "lib/config.h"
+#include "lib/string.h"
+#include "lib/wav.h"
+
+#define MAX_SWEEP_VALUES     32
+#define MAX_ENCODED_SIZE     4000
+#define SEGMENT_MS           20
+#define SEGMENT_SNR_MIN_DB   -10.0
+#define SEGMENT_SNR_MAX_DB   35.0
+#define SILENT_SEGMENT_POWER 1e-8
+#define READ_CHUNK_FRAMES    4096
+
+#define DEFAULT_BITRATES     "16000,32000,64000,128000"
+#define DEFAULT_COMPLEXITIES "0,5,10"
+#define DEFAULT_FRAME_MS     "10,20"
+#define DEFAULT_LOSS         "0,5,5:3"
+
+#define MODE_PLC "plc"
+#define MODE_FEC "fec"
+
+typedef struct {
+    const char *path;
+    float *samples;
+    size_t frames;
+    int channel_count;
+    int sample_rate;
+} reference_t;
+
+// Gilbert-Elliott loss, average loss percentage with bursts of the given mean length in packets
+typedef struct {
+    double percent;
+    double burst;
+} loss_pattern_t;
+
+typedef struct {
+    int bitrate;
+    int complexity;
+    double frame_ms;
+    loss_pattern_t loss;
+    bool fec;
+} sweep_case_t;
+
+typedef struct {
+    double bitrate;
+    double snr_db;
+    double segsnr_db;
+    double encode_cpu_pct;
+    double decode_cpu_pct;
+    double lost_pct;
+    size_t recovered;
+} sweep_result_t;
+
+typedef struct {
+    unsigned char data[MAX_ENCODED_SIZE];
+    opus_int32 len;
+    bool lost;
+} sweep_packet_t;
+
+static ra_logger_t *g_logger;
+
+static float sample_to_float(const unsigned char *p, const ra_wav_format_t *fmt) {
+    if (fmt->format == RA_WAV_FORMAT_FLOAT) {
+        float value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    switch (fmt->bits_per_sample) {
+    case 16:
+        return (int16_t)(p[0] | p[1] << 8) / 32768.0f;
+    case 24:
+        return (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) / 2147483648.0f;
+    default:
+        return (int32_t)((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24) /
+               2147483648.0f;
+    }
+}
+
+static bool supported_format(const ra_wav_format_t *fmt) {
+    if (fmt->format == RA_WAV_FORMAT_FLOAT) return fmt->bits_per_sample == 32;
+    if (fmt->format != RA_WAV_FORMAT_PCM) return false;
+    return fmt->bits_per_sample == 16 || fmt->bits_per_sample == 24 || fmt->bits_per_sample == 32;
+}
+
+static bool supported_rate(int rate) {
+    return rate == 8000 || rate == 12000 || rate == 16000 || rate == 24000 || rate == 48000;
+}
+
+// Reads the whole file into interleaved float samples
+static int load_reference(reference_t *ref, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        ra_logger_error(g_logger, "Failed to open %s", path);
+        return -1;
+    }
+
+    int rc = -1;
+    ra_wav_format_t fmt;
+    ra_wav_reader_t *reader = ra_wav_reader_create(file, &fmt);
+    if (!reader) {
+        ra_logger_error(g_logger, "%s is not a WAV file", path);
+        goto done;
+    }
+    if (!supported_format(&fmt) || !supported_rate(fmt.sample_rate) || fmt.channel_count < 1 ||
+        fmt.channel_count > 8) {
+        ra_logger_error(g_logger,
+                        "%s: unsupported format, %d-bit %s at %d Hz with %d channels",
+                        path,
+                        fmt.bits_per_sample,
+                        fmt.format == RA_WAV_FORMAT_FLOAT ? "float" : "PCM",
+                        fmt.sample_rate,
+                        fmt.channel_count);
+        goto done;
+    }
+
+    size_t sample_size = fmt.bits_per_sample / 8;
+    size_t frame_size = sample_size * fmt.channel_count;
+    unsigned char *chunk = malloc(READ_CHUNK_FRAMES * frame_size);
+    size_t cap = 0;
+    *ref = (reference_t){.path = path, .channel_count = fmt.channel_count, .sample_rate = fmt.sample_rate};
+    for (;;) {
+        size_t read = ra_wav_reader_read(reader, chunk, READ_CHUNK_FRAMES);
+        if (read == 0) break;
+        if (ref->frames + read > cap) {
+            cap = (ref->frames + read) * 2;
+            ref->samples = realloc(ref->samples, cap * fmt.channel_count * sizeof(float));
+        }
+        float *out = ref->samples + ref->frames * fmt.channel_count;
+        for (size_t i = 0; i < read * fmt.channel_count; i++) out[i] = sample_to_float(chunk + i * sample_size, &fmt);
+        ref->frames += read;
+    }
+    free(chunk);
+    if (ref->frames == 0) {
+        ra_logger_error(g_logger, "%s has no audio data", path);
+        goto done;
+    }
+    rc = 0;
+
+done:
+    if (reader) ra_wav_reader_close(reader);
+    fclose(file);
+    return rc;
+}
+
+static int parse_int_list(int *values, const char *list) {
+    int count = 0;
+    const char *rptr = list;
+    while (*rptr && count < MAX_SWEEP_VALUES) {
+        char *endptr;
+        values[count++] = strtol(rptr, &endptr, 10);
+        if (endptr == rptr || (*endptr && *endptr != ',')) return -1;
+        rptr = *endptr ? endptr + 1 : endptr;
+    }
+    return count;
+}
+
+static int parse_double_list(double *values, const char *list) {
+    int count = 0;
+    const char *rptr = list;
+    while (*rptr && count < MAX_SWEEP_VALUES) {
+        char *endptr;
+        values[count++] = strtod(rptr, &endptr);
+        if (endptr == rptr || (*endptr && *endptr != ',')) return -1;
+        rptr = *endptr ? endptr + 1 : endptr;
+    }
+    return count;
+}
+
+// Comma separated <percent>[:<mean burst length>] entries, bursts default to a single packet
+static int parse_loss_list(loss_pattern_t *patterns, const char *list) {
+    int count = 0;
+    const char *rptr = list;
+    while (*rptr && count < MAX_SWEEP_VALUES) {
+        char *endptr;
+        loss_pattern_t *pattern = &patterns[count++];
+        pattern->percent = strtod(rptr, &endptr);
+        pattern->burst = 1;
+        if (endptr == rptr || pattern->percent < 0 || pattern->percent >= 100) return -1;
+        if (*endptr == ':') {
+            rptr = endptr + 1;
+            pattern->burst = strtod(rptr, &endptr);
+            if (endptr == rptr || pattern->burst < 1) return -1;
+        }
+        if (*endptr && *endptr != ',') return -1;
+        rptr = *endptr ? endptr + 1 : endptr;
+    }
+    return count;
+}
+
+static const char *option_or(ra_config_section_t *options, const char *key, const char *fallback) {
+    const char *value = ra_config_get_value(options, key);
+    return value ? value : fallback;
+}
+
+static double next_uniform(uint32_t *seed) {
+    *seed = *seed * 1664525 + 1013904223;
+    return (*seed >> 8) / 16777216.0;
+}
+
+// Same seed for every case, so settings are compared against the same losses
+static void simulate_loss(sweep_packet_t *packets, size_t count, const loss_pattern_t *loss) {
+    double average = loss->percent / 100;
+    double recover = 1 / loss->burst;
+    double enter = average < 1 ? average * recover / (1 - average) : 1;
+    uint32_t seed = 0x2545f491;
+    bool bad = false;
+    for (size_t i = 0; i < count; i++) {
+        bad = next_uniform(&seed) < (bad ? 1 - recover : enter);
+        packets[i].lost = bad;
+    }
+}
+
+static int lookahead_samples(const reference_t *ref) {
+    int err, lookahead = 0;
+    OpusEncoder *enc = opus_encoder_create(ref->sample_rate, 1, OPUS_APPLICATION, &err);
+    if (err != OPUS_OK) return 0;
+    opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
+    opus_encoder_destroy(enc);
+    return lookahead;
+}
+
+static double power_db(double signal, double noise) {
+    if (noise <= 0) return SEGMENT_SNR_MAX_DB;
+    return 10 * log10(signal / noise);
+}
+
+// Decoded audio is delayed by the encoder's lookahead, compare against the reference shifted by it
+static void measure_quality(const reference_t *ref, const float *decoded, int lookahead, sweep_result_t *result) {
+    int channels = ref->channel_count;
+    size_t segment_frames = SEGMENT_MS * ref->sample_rate / 1000;
+    double signal = 0, noise = 0, segsnr_sum = 0;
+    size_t segments = 0;
+    for (size_t start = 0; start < ref->frames; start += segment_frames) {
+        size_t end = start + segment_frames < ref->frames ? start + segment_frames : ref->frames;
+        double seg_signal = 0, seg_noise = 0;
+        for (size_t i = start * channels; i < end * channels; i++) {
+            double r = ref->samples[i];
+            double e = r - decoded[i + lookahead * channels];
+            seg_signal += r * r;
+            seg_noise += e * e;
+        }
+        signal += seg_signal;
+        noise += seg_noise;
+        if (seg_signal / ((end - start) * channels) < SILENT_SEGMENT_POWER) continue;
+        double seg_db = power_db(seg_signal, seg_noise);
+        if (seg_db < SEGMENT_SNR_MIN_DB) seg_db = SEGMENT_SNR_MIN_DB;
+        if (seg_db > SEGMENT_SNR_MAX_DB) seg_db = SEGMENT_SNR_MAX_DB;
+        segsnr_sum += seg_db;
+        segments++;
+    }
+    result->snr_db = signal > 0 ? power_db(signal, noise) : 0;
+    result->segsnr_db = segments ? segsnr_sum / segments : 0;
+}
+
+static int run_case(const reference_t *ref, const sweep_case_t *sc, int lookahead, sweep_result_t *result) {
+    int err, rc = -1;
+    int channels = ref->channel_count;
+    int frame_size = sc->frame_ms * ref->sample_rate / 1000;
+    size_t packet_count = (ref->frames + lookahead + frame_size - 1) / frame_size;
+    size_t total_frames = packet_count * frame_size;
+
+    ra_channel_layout_t layout;
+    int family = channels <= 2 ? RA_MAPPING_FAMILY_MONO_STEREO : RA_MAPPING_FAMILY_SURROUND;
+    // A single group keeps all the coding on this thread, where its CPU time is measured
+    if (ra_channel_layout_init(&layout, channels, family, 1)) return -1;
+    ra_audio_config_t cfg = {
+        .sample_format = paFloat32,
+        .sample_size = sizeof(float),
+        .sample_rate = ref->sample_rate,
+        .channel_count = channels,
+        .frame_size = frame_size,
+    };
+
+    // The reference is padded with silence to flush the lookahead and complete the last frame
+    float *input = calloc(total_frames * channels, sizeof(float));
+    float *decoded = calloc(total_frames * channels, sizeof(float));
+    sweep_packet_t *packets = calloc(packet_count, sizeof(sweep_packet_t));
+    memcpy(input, ref->samples, ref->frames * channels * sizeof(float));
+
+    ra_encoder_t *enc = ra_encoder_create(&cfg, &layout, family, OPUS_APPLICATION, &err);
+    if (err) goto done;
+    ra_decoder_t *dec = ra_decoder_create(&cfg, &layout, NULL, &err);
+    if (err) {
+        ra_encoder_destroy(enc);
+        goto done;
+    }
+    ra_encoder_ctl(enc, OPUS_SET_BITRATE_REQUEST, sc->bitrate);
+    ra_encoder_ctl(enc, OPUS_SET_COMPLEXITY_REQUEST, sc->complexity);
+    ra_encoder_ctl(enc, OPUS_SET_INBAND_FEC_REQUEST, sc->fec);
+    ra_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC_REQUEST, sc->fec ? (opus_int32)ceil(sc->loss.percent) : 0);
+
+    size_t bytes = 0;
+    uint64_t cpu_start = ra_clock_thread_cpu_ns();
+    for (size_t i = 0; i < packet_count; i++) {
+        sweep_packet_t *packet = &packets[i];
+        packet->len = ra_encode(enc, input + i * frame_size * channels, frame_size, packet->data, MAX_ENCODED_SIZE);
+        if (packet->len <= 0) {
+            ra_logger_error(g_logger, "Encoding failed with error %d", packet->len);
+            goto cleanup;
+        }
+        bytes += packet->len;
+    }
+    uint64_t encode_ns = ra_clock_thread_cpu_ns() - cpu_start;
+
+    // Lost packets are concealed, or recovered from the next packet's redundancy when FEC is on
+    size_t lost = 0;
+    simulate_loss(packets, packet_count, &sc->loss);
+    cpu_start = ra_clock_thread_cpu_ns();
+    for (size_t i = 0; i < packet_count; i++) {
+        sweep_packet_t *packet = &packets[i];
+        float *out = decoded + i * frame_size * channels;
+        int frames;
+        if (!packet->lost) {
+            frames = ra_decode_float(dec, packet->data, packet->len, out, frame_size, 0);
+        } else if (sc->fec && i + 1 < packet_count && !packets[i + 1].lost) {
+            frames = ra_decode_float(dec, packets[i + 1].data, packets[i + 1].len, out, frame_size, 1);
+            result->recovered++;
+        } else {
+            frames = ra_decode_float(dec, NULL, 0, out, frame_size, 0);
+        }
+        if (packet->lost) lost++;
+        if (frames < 0) {
+            ra_logger_error(g_logger, "Decoding failed with error %d", frames);
+            goto cleanup;
+        }
+    }
+    uint64_t decode_ns = ra_clock_thread_cpu_ns() - cpu_start;
+
+    double audio_ns = (double)total_frames * RA_NSEC_PER_SEC / ref->sample_rate;
+    result->bitrate = bytes * 8.0 * ref->sample_rate / total_frames;
+    result->encode_cpu_pct = 100.0 * encode_ns / audio_ns;
+    result->decode_cpu_pct = 100.0 * decode_ns / audio_ns;
+    result->lost_pct = 100.0 * lost / packet_count;
+    measure_quality(ref, decoded, lookahead, result);
+    rc = 0;
+
+cleanup:
+    ra_decoder_destroy(dec);
+    ra_encoder_destroy(enc);
+done:
+    free(packets);
+    free(decoded);
+    free(input);
+    return rc;
+}
+
+static void print_result(const reference_t *ref, const sweep_case_t *sc, const sweep_result_t *result) {
+    printf("%s,%d,%d,%g,%g,%g,%s,%.0f,%.2f,%.2f,%.2f,%zu,%.3f,%.3f\n",
+           ref->path,
+           sc->bitrate,
+           sc->complexity,
+           sc->frame_ms,
+           sc->loss.percent,
+           sc->loss.burst,
+           sc->fec ? MODE_FEC : MODE_PLC,
+           result->bitrate,
+           result->lost_pct,
+           result->snr_db,
+           result->segsnr_db,
+           result->recovered,
+           result->encode_cpu_pct,
+           result->decode_cpu_pct);
+}
+
+static int sweep_reference(const reference_t *ref,
+                           const int *bitrates,
+                           int bitrate_count,
+                           const int *complexities,
+                           int complexity_count,
+                           const double *frame_ms,
+                           int frame_ms_count,
+                           const loss_pattern_t *losses,
+                           int loss_count) {
+    int lookahead = lookahead_samples(ref);
+    for (int b = 0; b < bitrate_count; b++) {
+        for (int c = 0; c < complexity_count; c++) {
+            for (int f = 0; f < frame_ms_count; f++) {
+                for (int l = 0; l < loss_count; l++) {
+                    // Without loss there's nothing for FEC to recover, so only the plain run is made
+                    for (int fec = 0; fec <= (losses[l].percent > 0); fec++) {
+                        sweep_case_t sc = {
+                            .bitrate = bitrates[b],
+                            .complexity = complexities[c],
+                            .frame_ms = frame_ms[f],
+                            .loss = losses[l],
+                            .fec = fec,
+                        };
+                        sweep_result_t result = {0};
+                        if (run_case(ref, &sc, lookahead, &result)) return -1;
+                        print_result(ref, &sc, &result);
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static bool valid_frame_ms(double ms) {
+    static const double durations[] = {2.5, 5, 10, 20, 40, 60};
+    for (size_t i = 0; i < sizeof(durations) / sizeof(durations[0]); i++)
+        if (ms == durations[i]) return true;
+    return false;
+}
+
+int main(int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    argc = ra_config_parse_args(opts, argc, argv);
+    ra_config_section_t *options = ra_config_get_default_section(opts);
+    ra_logger_stream_t *logger_stream = ra_logger_stream_create(stderr, stderr);
+    g_logger = ra_logger_create(logger_stream, NULL);
+
+    int bitrates[MAX_SWEEP_VALUES], complexities[MAX_SWEEP_VALUES];
+    double frame_ms[MAX_SWEEP_VALUES];
+    loss_pattern_t losses[MAX_SWEEP_VALUES];
+    int bitrate_count = parse_int_list(bitrates, option_or(options, "bitrates", DEFAULT_BITRATES));
+    int complexity_count = parse_int_list(complexities, option_or(options, "complexities", DEFAULT_COMPLEXITIES));
+    int frame_ms_count = parse_double_list(frame_ms, option_or(options, "frame-ms", DEFAULT_FRAME_MS));
+    int loss_count = parse_loss_list(losses, option_or(options, "loss", DEFAULT_LOSS));
+
+    bool valid = argc >= 2 && bitrate_count > 0 && complexity_count > 0 && frame_ms_count > 0 && loss_count > 0;
+    for (int i = 0; valid && i < complexity_count; i++) valid = complexities[i] >= 0 && complexities[i] <= 10;
+    for (int i = 0; valid && i < frame_ms_count; i++) valid = valid_frame_ms(frame_ms[i]);
+    for (int i = 0; valid && i < bitrate_count; i++) valid = bitrates[i] >= 500 && bitrates[i] <= 512000;
+
+    int rc = EXIT_FAILURE;
+    if (!valid) {
+        fprintf(stderr,
+                "Usage: %s <reference.wav>... [--bitrates=<bps,...>] [--complexities=<0-10,...>] "
+                "[--frame-ms=<2.5|5|10|20|40|60,...>] [--loss=<percent[:burst],...>]\n",
+                argv[0]);
+        goto done;
+    }
+
+    printf("file,bitrate,complexity,frame_ms,loss_pct,loss_burst,mode,actual_bitrate,actual_loss_pct,snr_db,segsnr_db,"
+           "fec_recovered,encode_cpu_pct,decode_cpu_pct\n");
+    rc = EXIT_SUCCESS;
+    for (int i = 1; i < argc; i++) {
+        reference_t ref;
+        if (load_reference(&ref, argv[i])) {
+            rc = EXIT_FAILURE;
+            continue;
+        }
+        if (sweep_reference(&ref,
+                            bitrates,
+                            bitrate_count,
+                            complexities,
+                            complexity_count,
+                            frame_ms,
+                            frame_ms_count,
+                            losses,
+                            loss_count))
+            rc = EXIT_FAILURE;
+        free(ref.samples);
+    }
+
+done:
+    ra_logger_destroy(g_logger);
+    ra_logger_stream_destroy(logger_stream);
+    ra_config_destroy(opts);
+    return rc;
+}
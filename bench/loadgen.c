@@ -0,0 +1,457 @@
+// Load generator, simulated sources speaking the real handshake and stream protocol to a running sink.
+// Every session has its own socket, key pair and stream, replaying pre-encoded Opus frames at realtime pacing.
+// Per session results are printed as CSV on stdout, the summary goes to stderr.
+#include <inttypes.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "lib/clock.h"
+#include "lib/codec.h"
+#include "lib/config.h"
+#include "lib/peer.h"
+#include "lib/proto.h"
+#include "lib/stream.h"
+#include "lib/string.h"
+#include "lib/thread.h"
+#include "lib/types.h"
+#include "lib/utils.h"
+
+#define MAX_LOAD_THREADS   64
+#define SAMPLE_RATE        48000
+#define MAX_ENCODED_SIZE   4000
+#define PREENCODED_MS      1000
+#define HANDSHAKE_RETRY_MS 1000
+#define PROBE_INTERVAL_MS  1000
+#define PROBE_PAYLOAD_SIZE 8
+#define TONE_FREQUENCY     440
+#define TONE_AMPLITUDE     0.25f
+#define TWO_PI             6.28318530717958647692f
+
+typedef struct {
+    opus_int32 len;
+    unsigned char data[MAX_ENCODED_SIZE];
+} encoded_frame_t;
+
+typedef struct {
+    ra_peer_t peer;
+    ra_keypair_t keypair;
+    uint32_t timestamp;
+    size_t frame_index;
+    uint64_t start_ns;
+    uint64_t handshake_sent_ns;
+    uint64_t next_probe_ns;
+
+    bool accepted;
+    double handshake_ms;
+    unsigned int handshakes;
+    unsigned int terminations;
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    uint64_t probes_sent;
+    uint64_t probes_received;
+    uint64_t rtt_sum_ns;
+    uint64_t rtt_max_ns;
+    bool has_report;
+    ra_stream_report_t report;
+} load_session_t;
+
+typedef struct {
+    const char *host;
+    unsigned int port;
+    int session_count;
+    int thread_count;
+    int duration;
+    int ramp_ms;
+    int frame_size;
+    int bitrate;
+    ra_audio_config_t cfg;
+    ra_channel_layout_t layout;
+
+    encoded_frame_t *frames;
+    size_t frame_count;
+    load_session_t *sessions;
+    atomic_bool running;
+    uint64_t start_ns;
+} load_t;
+
+typedef struct {
+    load_t *load;
+    int index;
+} load_worker_t;
+
+static ra_logger_t *g_logger;
+
+// Tone over a noise floor, encoded once and replayed by every session
+static int preencode_frames(load_t *load) {
+    int err;
+    ra_encoder_t *encoder = ra_encoder_create(&load->cfg, &load->layout, 0, OPUS_APPLICATION, &err);
+    if (err) return err;
+    if (load->bitrate > 0) ra_encoder_ctl(encoder, OPUS_SET_BITRATE_REQUEST, load->bitrate);
+
+    int channels = load->cfg.channel_count;
+    float *pcm = malloc(load->frame_size * channels * sizeof(float));
+    load->frame_count = PREENCODED_MS * SAMPLE_RATE / (1000 * load->frame_size);
+    if (load->frame_count < 1) load->frame_count = 1;
+    load->frames = calloc(load->frame_count, sizeof(encoded_frame_t));
+
+    uint32_t seed = 0x9e3779b9;
+    size_t sample_index = 0;
+    for (size_t f = 0; f < load->frame_count; f++) {
+        for (int i = 0; i < load->frame_size; i++, sample_index++) {
+            seed = seed * 1664525 + 1013904223;
+            float noise = ((int32_t)seed / 2147483648.0f) * 0.01f;
+            float sample = TONE_AMPLITUDE * sinf(TWO_PI * TONE_FREQUENCY * sample_index / SAMPLE_RATE) + noise;
+            for (int c = 0; c < channels; c++) pcm[i * channels + c] = sample;
+        }
+        encoded_frame_t *frame = &load->frames[f];
+        frame->len = ra_encode(encoder, pcm, load->frame_size, frame->data, MAX_ENCODED_SIZE);
+        if (frame->len <= 0) {
+            err = -1;
+            break;
+        }
+    }
+
+    free(pcm);
+    ra_encoder_destroy(encoder);
+    return err;
+}
+
+static void send_handshake(load_t *load, load_session_t *ls, uint64_t now) {
+    ls->handshake_sent_ns = now;
+    ls->handshakes++;
+    ra_peer_send_handshake(&ls->peer, &ls->keypair, &load->cfg, &load->layout);
+}
+
+static void send_data(load_t *load, load_session_t *ls) {
+    char rawbuf[STREAM_DATA_HEADER_SIZE + MAX_ENCODED_SIZE];
+    char msgbuf[BUFSIZE];
+
+    const encoded_frame_t *frame = &load->frames[ls->frame_index++ % load->frame_count];
+    uint16_to_bytes(rawbuf, load->frame_size);
+    uint32_to_bytes(rawbuf + 2, ls->timestamp);
+    rawbuf[6] = 0;
+    memcpy(rawbuf + STREAM_DATA_HEADER_SIZE, frame->data, frame->len);
+    ls->timestamp += load->frame_size;
+
+    ra_buf_t buf = {.base = msgbuf, .cap = sizeof(msgbuf)};
+    ra_rbuf_t data = {.base = rawbuf, .len = STREAM_DATA_HEADER_SIZE + frame->len};
+    create_stream_data_message(&buf, &data);
+    ssize_t sent = ra_peer_send(&ls->peer, (ra_rbuf_t *)&buf);
+    if (sent <= 0) return;
+    ls->packets_sent++;
+    ls->bytes_sent += sent;
+}
+
+// Heartbeat carrying the send time, which the sink echoes back unchanged
+static void send_probe(load_session_t *ls, uint64_t now) {
+    char rawbuf[1 + PROBE_PAYLOAD_SIZE];
+    rawbuf[0] = RA_STREAM_HEARTBEAT;
+    uint64_to_bytes(rawbuf + 1, now);
+    ra_rbuf_t rbuf = {.base = rawbuf, .len = sizeof(rawbuf)};
+    if (ra_peer_send(&ls->peer, &rbuf) > 0) ls->probes_sent++;
+}
+
+static void handle_probe(load_session_t *ls, const ra_rbuf_t *payload, uint64_t now) {
+    // Heartbeats the sink sends on its own have no payload
+    if (payload->len != PROBE_PAYLOAD_SIZE) return;
+    uint64_t sent_ns = bytes_to_uint64(payload->base);
+    if (sent_ns > now) return;
+    uint64_t rtt_ns = now - sent_ns;
+    ls->probes_received++;
+    ls->rtt_sum_ns += rtt_ns;
+    if (rtt_ns > ls->rtt_max_ns) ls->rtt_max_ns = rtt_ns;
+}
+
+static void handle_crypto(load_session_t *ls, const ra_rbuf_t *rbuf, uint64_t now) {
+    char rawbuf[BUFSIZE];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    if (ra_peer_read(&ls->peer, &buf, rbuf)) return;
+
+    ra_rbuf_t payload = {.base = buf.base + 1, .len = buf.len - 1};
+    switch ((ra_crypto_type)buf.base[0]) {
+    case RA_STREAM_HEARTBEAT:
+        handle_probe(ls, &payload, now);
+        break;
+    case RA_STREAM_REPORT:
+        if (read_stream_report_message(&ls->report, &payload) == 0) ls->has_report = true;
+        break;
+    case RA_STREAM_TERMINATE:
+        // Start over with a fresh handshake once the retry interval has passed
+        ls->terminations++;
+        ls->peer.state = 0;
+        ls->handshake_sent_ns = now;
+        break;
+    default:
+        break;
+    }
+}
+
+static void drain_socket(load_t *load, load_session_t *ls, uint64_t now) {
+    char rawbuf[BUFSIZE];
+    for (;;) {
+        ssize_t len = recv(ls->peer.conn.sock, rawbuf, sizeof(rawbuf), 0);
+        if (len <= 0) return;
+        ra_rbuf_t rbuf = {.base = rawbuf + 1, .len = len - 1};
+        switch ((ra_message_type)rawbuf[0]) {
+        case RA_HANDSHAKE_COOKIE:
+            // Answered right away, the handshake time includes the cookie round trip
+            if (ra_peer_handle_handshake_cookie(&ls->peer, &rbuf) == 0)
+                ra_peer_send_handshake(&ls->peer, &ls->keypair, &load->cfg, &load->layout);
+            break;
+        case RA_HANDSHAKE_RESPONSE:
+            if (ra_peer_handle_handshake_response(&ls->peer, &ls->keypair, &rbuf)) break;
+            if (!ls->accepted) ls->handshake_ms = (double)(now - ls->handshake_sent_ns) / RA_NSEC_PER_MSEC;
+            ls->accepted = true;
+            ls->next_probe_ns = now;
+            break;
+        case RA_MESSAGE_CRYPTO:
+            handle_crypto(ls, &rbuf, now);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void run_session(load_t *load, load_session_t *ls, uint64_t now) {
+    if (now < ls->start_ns) return;
+    drain_socket(load, ls, now);
+
+    uint64_t retry_ns = HANDSHAKE_RETRY_MS * RA_NSEC_PER_MSEC;
+    ra_peer_t *peer = &ls->peer;
+    if (peer->state == 0 && (ls->handshakes == 0 || now - ls->handshake_sent_ns >= retry_ns)) {
+        send_handshake(load, ls, now);
+    } else if (peer->state == 1 && now - ls->handshake_sent_ns >= retry_ns) {
+        send_handshake(load, ls, now);
+    }
+    if (!ra_peer_ready(peer)) return;
+
+    send_data(load, ls);
+    if (now >= ls->next_probe_ns) {
+        send_probe(ls, now);
+        ls->next_probe_ns = now + PROBE_INTERVAL_MS * RA_NSEC_PER_MSEC;
+    }
+}
+
+// Each worker drives every thread_count-th session, once per frame period
+static void worker_thread(void *arg) {
+    load_worker_t *worker = arg;
+    load_t *load = worker->load;
+    uint64_t period_ns = (uint64_t)load->frame_size * RA_NSEC_PER_SEC / SAMPLE_RATE;
+
+    for (uint64_t tick = 0; load->running; tick++) {
+        ra_clock_sleep_until_ns(load->start_ns + tick * period_ns);
+        uint64_t now = ra_clock_now_ns();
+        for (int i = worker->index; i < load->session_count; i += load->thread_count)
+            run_session(load, &load->sessions[i], now);
+    }
+}
+
+static int init_sessions(load_t *load) {
+    load->sessions = calloc(load->session_count, sizeof(load_session_t));
+    for (int i = 0; i < load->session_count; i++) {
+        load_session_t *ls = &load->sessions[i];
+        SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock < 0) {
+            ra_socket_perror("socket");
+            return -1;
+        }
+        if (ra_peer_init(&ls->peer, sock, load->host, load->port)) {
+            ra_socket_close(sock);
+            ls->peer.conn.addr = NULL;
+            return -1;
+        }
+        // The socket is owned by the peer from here on and closed along with the sessions
+        if (ra_socket_set_nonblocking(sock)) return -1;
+        ra_generate_keypair(&ls->keypair);
+        ls->start_ns = load->start_ns + (uint64_t)i * load->ramp_ms * RA_NSEC_PER_MSEC / load->session_count;
+    }
+    return 0;
+}
+
+static void destroy_sessions(load_t *load) {
+    if (!load->sessions) return;
+    for (int i = 0; i < load->session_count; i++) {
+        ra_peer_t *peer = &load->sessions[i].peer;
+        if (peer->conn.addr) ra_socket_close(peer->conn.sock);
+    }
+    free(load->sessions);
+}
+
+static void terminate_sessions(load_t *load) {
+    for (int i = 0; i < load->session_count; i++) {
+        ra_peer_t *peer = &load->sessions[i].peer;
+        if (ra_peer_ready(peer)) ra_peer_send(peer, ra_stream_terminate_message);
+    }
+}
+
+static void print_results(load_t *load, uint64_t elapsed_ns) {
+    double seconds = (double)elapsed_ns / RA_NSEC_PER_SEC;
+    int accepted = 0;
+    uint64_t packets = 0, bytes = 0, lost = 0, probes_sent = 0, probes_received = 0, rtt_sum_ns = 0, rtt_max_ns = 0;
+    double handshake_sum_ms = 0;
+
+    printf("session,accepted,handshake_ms,handshakes,terminations,rtt_avg_ms,rtt_max_ms,probes_sent,probes_received,"
+           "packets_sent,cumulative_lost,loss_pct,jitter_us,buffer_ms,underruns\n");
+    for (int i = 0; i < load->session_count; i++) {
+        load_session_t *ls = &load->sessions[i];
+        double rtt_avg_ms = ls->probes_received ? (double)ls->rtt_sum_ns / ls->probes_received / RA_NSEC_PER_MSEC : 0;
+        uint32_t cumulative_lost = ls->has_report ? ls->report.cumulative_lost : 0;
+        double loss_pct = ls->packets_sent ? 100.0 * cumulative_lost / ls->packets_sent : 0;
+        printf("%d,%d,%.2f,%u,%u,%.3f,%.3f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu32 ",%.2f,%" PRIu32 ",%" PRIu32
+               ",%" PRIu32 "\n",
+               i,
+               ls->accepted,
+               ls->handshake_ms,
+               ls->handshakes,
+               ls->terminations,
+               rtt_avg_ms,
+               (double)ls->rtt_max_ns / RA_NSEC_PER_MSEC,
+               ls->probes_sent,
+               ls->probes_received,
+               ls->packets_sent,
+               cumulative_lost,
+               loss_pct,
+               ls->report.jitter_us,
+               ls->report.buffer_ms,
+               ls->report.underruns);
+
+        if (ls->accepted) {
+            accepted++;
+            handshake_sum_ms += ls->handshake_ms;
+        }
+        packets += ls->packets_sent;
+        bytes += ls->bytes_sent;
+        lost += cumulative_lost;
+        probes_sent += ls->probes_sent;
+        probes_received += ls->probes_received;
+        rtt_sum_ns += ls->rtt_sum_ns;
+        if (ls->rtt_max_ns > rtt_max_ns) rtt_max_ns = ls->rtt_max_ns;
+    }
+
+    fprintf(stderr,
+            "sessions=%d accepted=%d threads=%d frame_size=%d duration=%.1f\n",
+            load->session_count,
+            accepted,
+            load->thread_count,
+            load->frame_size,
+            seconds);
+    fprintf(stderr,
+            "handshake_ms avg=%.2f rtt_ms avg=%.3f max=%.3f probes=%" PRIu64 "/%" PRIu64 "\n",
+            accepted ? handshake_sum_ms / accepted : 0,
+            probes_received ? (double)rtt_sum_ns / probes_received / RA_NSEC_PER_MSEC : 0,
+            (double)rtt_max_ns / RA_NSEC_PER_MSEC,
+            probes_received,
+            probes_sent);
+    fprintf(stderr,
+            "sent packets_per_sec=%.1f bytes_per_sec=%.1f lost=%" PRIu64 " loss_pct=%.2f\n",
+            packets / seconds,
+            bytes / seconds,
+            lost,
+            packets ? 100.0 * lost / packets : 0);
+}
+
+int main(int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    argc = ra_config_parse_args(opts, argc, argv);
+    ra_config_section_t *options = ra_config_get_default_section(opts);
+    ra_logger_stream_t *logger_stream = ra_logger_stream_create(stderr, stderr);
+    g_logger = ra_logger_create(logger_stream, NULL);
+
+    load_t load = {0};
+    load.session_count = ra_config_get_int(options, "sessions", 16);
+    load.thread_count = ra_config_get_int(options, "threads", 1);
+    load.duration = ra_config_get_int(options, "duration", 10);
+    load.ramp_ms = ra_config_get_int(options, "ramp-ms", 0);
+    load.frame_size = ra_config_get_int(options, "frame-size", FRAMES_PER_BUFFER);
+    load.bitrate = ra_config_get_int(options, "bitrate", 0);
+    load.cfg = (ra_audio_config_t){
+        .type = RA_AUDIO_DEVICE_INPUT,
+        .sample_format = paFloat32,
+        .sample_size = sizeof(float),
+        .sample_rate = SAMPLE_RATE,
+        .channel_count = ra_config_get_int(options, "channels", DEFAULT_CHANNELS),
+        .frame_size = load.frame_size,
+    };
+
+    int rc = EXIT_FAILURE;
+    char host[RA_PEER_HOST_SIZE];
+    if (argc < 2 || strlen(argv[1]) >= sizeof(host) || load.session_count < 1 || load.thread_count < 1 ||
+        load.thread_count > MAX_LOAD_THREADS || load.duration < 1 || load.ramp_ms < 0 || load.frame_size < 1 ||
+        load.frame_size > MAX_FRAME_SIZE) {
+        fprintf(stderr,
+                "Usage: %s <sink-host[:port]> [--sessions=<count>] [--threads=<1-%d>] [--duration=<seconds>] "
+                "[--ramp-ms=<ms>] [--frame-size=<samples>] [--bitrate=<bps>] [--channels=<count>]\n",
+                argv[0],
+                MAX_LOAD_THREADS);
+        goto done;
+    }
+    strcpy(host, argv[1]);
+    load.host = host;
+    load.port = LISTEN_PORT;
+    char *sep = strrchr(host, ':');
+    if (sep) {
+        *sep = '\0';
+        load.port = atoi(sep + 1);
+    }
+    if (load.thread_count > load.session_count) load.thread_count = load.session_count;
+    if (ra_channel_layout_init(&load.layout, load.cfg.channel_count, RA_MAPPING_FAMILY_MONO_STEREO, 1)) {
+        ra_logger_error(g_logger, "Unsupported channel count: %d", load.cfg.channel_count);
+        goto done;
+    }
+
+    ra_proto_init();
+    if (ra_crypto_init(g_logger) || ra_socket_init(g_logger)) goto cleanup;
+    if (preencode_frames(&load)) {
+        ra_logger_error(g_logger, "Failed to pre-encode audio frames");
+        goto cleanup;
+    }
+    load.start_ns = ra_clock_now_ns();
+    if (init_sessions(&load)) {
+        ra_logger_error(g_logger, "Failed to set up sessions towards %s:%u", load.host, load.port);
+        goto cleanup;
+    }
+    ra_logger_info(g_logger, "Simulating %d sources towards %s:%u", load.session_count, load.host, load.port);
+
+    int err;
+    ra_thread_t threads[MAX_LOAD_THREADS];
+    load_worker_t workers[MAX_LOAD_THREADS];
+    load.running = true;
+    for (int i = 0; i < load.thread_count; i++) {
+        workers[i] = (load_worker_t){.load = &load, .index = i};
+        threads[i] = ra_thread_start(worker_thread, &workers[i], &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to start load generator thread");
+            load.running = false;
+            for (int j = 0; j < i; j++) {
+                ra_thread_join(threads[j]);
+                ra_thread_destroy(threads[j]);
+            }
+            goto cleanup;
+        }
+    }
+    ra_clock_sleep_until_ns(load.start_ns + load.duration * RA_NSEC_PER_SEC);
+    load.running = false;
+    for (int i = 0; i < load.thread_count; i++) {
+        ra_thread_join(threads[i]);
+        ra_thread_destroy(threads[i]);
+    }
+
+    terminate_sessions(&load);
+    print_results(&load, ra_clock_now_ns() - load.start_ns);
+    rc = EXIT_SUCCESS;
+
+cleanup:
+    destroy_sessions(&load);
+    free(load.frames);
+    ra_socket_deinit();
+    ra_proto_deinit();
+
+done:
+    ra_logger_destroy(g_logger);
+    ra_logger_stream_destroy(logger_stream);
+    ra_config_destroy(opts);
+    return rc;
+}
@@ -0,0 +1,540 @@
+// End-to-end loopback benchmark, sources and a sink exchanging synthetic audio over localhost UDP.
+// Marker tones injected at capture are timed again at playout to measure glass-to-glass latency.
+#include <inttypes.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "lib/clock.h"
+#include "lib/codec.h"
+#include "lib/config.h"
+#include "lib/proto.h"
+#include "lib/stream.h"
+#include "lib/string.h"
+#include "lib/thread.h"
+#include "lib/types.h"
+#include "lib/utils.h"
+
+#define MAX_BENCH_STREAMS  256
+#define SAMPLE_RATE        48000
+#define MAX_ENCODED_SIZE   4000
+#define MARKER_INTERVAL_MS 500
+#define MARKER_DURATION_MS 10
+#define MARKER_FREQUENCY   1000
+#define MARKER_AMPLITUDE   0.5f
+#define MARKER_THRESHOLD   0.25f
+#define NOISE_AMPLITUDE    0.01f
+#define RECV_TIMEOUT_MS    100
+#define TWO_PI             6.28318530717958647692f
+
+#define CIPHER_XCHACHA20POLY1305 "xchacha20poly1305"
+#define CIPHER_NONE              "none"
+
+// Frame sizes Opus codes at 48 kHz, from 2.5 to 60 ms
+static const int frame_sizes[] = {120, 240, 480, 960, 1920, 2880, 0};
+
+typedef struct {
+    // Capture side, owned by the capture thread
+    ra_stream_t tx;
+    ra_encoder_t *encoder;
+    uint32_t timestamp;
+    uint32_t noise_seed;
+    // Capture time of every marker, published to the playout thread through the marker count
+    uint64_t *marker_capture_ns;
+    atomic_size_t markers_sent;
+
+    // Playout side, the receive thread writes the ring and the playout thread reads it
+    ra_stream_t rx;
+    ra_decoder_t *decoder;
+    ra_ringbuf_t *ringbuf;
+    size_t markers_matched;
+    bool in_marker;
+    bool primed;
+    size_t underruns;
+} bench_stream_t;
+
+typedef struct {
+    int stream_count;
+    int frame_size;
+    int bitrate;
+    int duration;
+    bool encrypt;
+    ra_audio_config_t cfg;
+    ra_channel_layout_t layout;
+    bench_stream_t *streams;
+    size_t max_markers;
+
+    SOCKET tx_sock;
+    SOCKET rx_sock;
+    ra_conn_t tx_conn;
+    struct sockaddr_in rx_addr;
+
+    atomic_bool running;
+    uint64_t start_ns;
+    uint64_t capture_cpu_ns;
+    uint64_t receive_cpu_ns;
+    uint64_t playout_cpu_ns;
+    uint64_t packets_sent;
+    uint64_t bytes_sent;
+    uint64_t packets_received;
+    uint64_t bytes_received;
+    uint64_t encode_errors;
+    uint64_t decode_errors;
+    uint64_t overflows;
+    uint64_t *latencies_ns;
+    size_t latency_count;
+} bench_t;
+
+static ra_logger_t *g_logger;
+
+static bool valid_frame_size(int frame_size) {
+    for (const int *size = frame_sizes; *size != 0; size++)
+        if (*size == frame_size) return true;
+    return false;
+}
+
+static uint64_t frame_period_ns(const bench_t *bench) {
+    return bench->frame_size * RA_NSEC_PER_SEC / SAMPLE_RATE;
+}
+
+static void sleep_until_tick(const bench_t *bench, uint64_t tick) {
+    ra_clock_sleep_until_ns(bench->start_ns + tick * bench->frame_size * RA_NSEC_PER_SEC / SAMPLE_RATE);
+}
+
+static float next_noise(bench_stream_t *bs) {
+    bs->noise_seed = bs->noise_seed * 1664525 + 1013904223;
+    return ((int32_t)bs->noise_seed / 2147483648.0f) * NOISE_AMPLITUDE;
+}
+
+// Low-level noise with a tone burst starting the first buffer of every marker interval
+static bool synthesize(bench_t *bench, bench_stream_t *bs, uint64_t tick, float *pcm) {
+    size_t ticks_per_marker = MARKER_INTERVAL_MS * SAMPLE_RATE / (1000 * bench->frame_size);
+    if (ticks_per_marker < 1) ticks_per_marker = 1;
+    size_t marker_samples = MARKER_DURATION_MS * SAMPLE_RATE / 1000;
+    bool marker = tick % ticks_per_marker == 0;
+
+    int channels = bench->cfg.channel_count;
+    for (int i = 0; i < bench->frame_size; i++) {
+        float sample = next_noise(bs);
+        if (marker && i < marker_samples) sample = MARKER_AMPLITUDE * sinf(TWO_PI * MARKER_FREQUENCY * i / SAMPLE_RATE);
+        for (int c = 0; c < channels; c++) pcm[i * channels + c] = sample;
+    }
+    return marker;
+}
+
+static void send_packet(bench_t *bench, bench_stream_t *bs, const ra_rbuf_t *data) {
+    char rawbuf[BUFSIZE];
+    ssize_t sent;
+    if (bench->encrypt) {
+        sent = ra_stream_send(&bs->tx, &bench->tx_conn, data);
+    } else {
+        // Without a cipher the data message goes out as is, prefixed with the stream id only
+        uint32_to_bytes(rawbuf, bs->tx.id);
+        ra_buf_t buf = {.base = rawbuf + RA_STREAM_ID_SIZE, .cap = sizeof(rawbuf) - RA_STREAM_ID_SIZE};
+        create_stream_data_message(&buf, data);
+        ra_rbuf_t rbuf = {.base = rawbuf, .len = buf.len + RA_STREAM_ID_SIZE};
+        sent = ra_buf_sendto(&bench->tx_conn, &rbuf);
+    }
+    if (sent <= 0) return;
+    bench->packets_sent++;
+    bench->bytes_sent += sent;
+}
+
+static void capture_thread(void *arg) {
+    bench_t *bench = arg;
+    float *pcm = malloc(bench->frame_size * bench->cfg.channel_count * sizeof(float));
+    char buf[STREAM_DATA_HEADER_SIZE + MAX_ENCODED_SIZE];
+    uint64_t cpu_start = ra_clock_thread_cpu_ns();
+
+    for (uint64_t tick = 0; bench->running; tick++) {
+        sleep_until_tick(bench, tick);
+        // The buffer delivered now started being captured a period ago
+        uint64_t capture_ns = ra_clock_now_ns() - frame_period_ns(bench);
+        for (int i = 0; i < bench->stream_count; i++) {
+            bench_stream_t *bs = &bench->streams[i];
+            bool marker = synthesize(bench, bs, tick, pcm);
+
+            unsigned char *data = (unsigned char *)buf + STREAM_DATA_HEADER_SIZE;
+            opus_int32 encsize = ra_encode(bs->encoder, pcm, bench->frame_size, data, MAX_ENCODED_SIZE);
+            if (encsize <= 0) {
+                bench->encode_errors++;
+                continue;
+            }
+            uint16_to_bytes(buf, bench->frame_size);
+            uint32_to_bytes(buf + 2, bs->timestamp);
+            buf[6] = 0;
+            bs->timestamp += bench->frame_size;
+
+            if (marker && bs->markers_sent < bench->max_markers) {
+                size_t index = bs->markers_sent;
+                bs->marker_capture_ns[index] = capture_ns;
+                bs->markers_sent = index + 1;
+            }
+            ra_rbuf_t rbuf = {.base = buf, .len = STREAM_DATA_HEADER_SIZE + encsize};
+            send_packet(bench, bs, &rbuf);
+        }
+    }
+
+    bench->capture_cpu_ns = ra_clock_thread_cpu_ns() - cpu_start;
+    free(pcm);
+}
+
+static void handle_data(bench_t *bench, bench_stream_t *bs, const ra_rbuf_t *rbuf, float *pcm) {
+    if (rbuf->len < 1 + STREAM_DATA_HEADER_SIZE || rbuf->base[0] != RA_STREAM_DATA) return;
+    const unsigned char *data = (const unsigned char *)rbuf->base + 1 + STREAM_DATA_HEADER_SIZE;
+    opus_int32 len = rbuf->len - 1 - STREAM_DATA_HEADER_SIZE;
+    int frames = ra_decode_float(bs->decoder, data, len, pcm, MAX_FRAME_SIZE, 0);
+    if (frames < 0) {
+        bench->decode_errors++;
+        return;
+    }
+
+    ra_ringbuf_t *rb = bs->ringbuf;
+    const char *rptr = (const char *)pcm;
+    const char *endptr = rptr + frames * bench->cfg.channel_count * sizeof(float);
+    while (rptr < endptr) {
+        size_t wbytes = ra_min(ra_ringbuf_free_count(rb), endptr - rptr);
+        if (wbytes <= 0) {
+            bench->overflows++;
+            return;
+        }
+        memcpy(ra_ringbuf_write_ptr(rb), rptr, wbytes);
+        ra_ringbuf_advance_write_ptr(rb, wbytes);
+        rptr += wbytes;
+    }
+}
+
+static void receive_thread(void *arg) {
+    bench_t *bench = arg;
+    char rawbuf[BUFSIZE], plainbuf[BUFSIZE];
+    float *pcm = malloc(MAX_FRAME_SIZE * bench->cfg.channel_count * sizeof(float));
+    uint64_t cpu_start = ra_clock_thread_cpu_ns();
+
+    struct sockaddr_in src_addr;
+    ra_conn_t conn = {
+        .sock = bench->rx_sock,
+        .addr = (struct sockaddr *)&src_addr,
+        .addrlen = sizeof(src_addr),
+    };
+    fd_set readfds;
+    while (bench->running) {
+        struct timeval timeout = {.tv_sec = 0, .tv_usec = RECV_TIMEOUT_MS * 1000};
+        FD_ZERO(&readfds);
+        FD_SET(bench->rx_sock, &readfds);
+        if (ra_socket_select(bench->rx_sock + 1, &readfds, &timeout) <= 0) continue;
+
+        ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+        conn.addrlen = sizeof(src_addr);
+        if (ra_buf_recvfrom(&conn, &buf) <= 0) continue;
+        bench->packets_received++;
+        bench->bytes_received += buf.len;
+
+        ra_rbuf_t data;
+        if (bench->encrypt) {
+            size_t sz_header = 1 + RA_STREAM_ID_SIZE;
+            if (buf.len < sz_header || buf.base[0] != RA_MESSAGE_CRYPTO) continue;
+            uint32_t id = bytes_to_uint32(buf.base + 1);
+            if (id >= bench->stream_count) continue;
+            bench_stream_t *bs = &bench->streams[id];
+            ra_buf_t plain = {.base = plainbuf, .cap = sizeof(plainbuf)};
+            if (ra_stream_read(&bs->rx, &plain, buf.base + sz_header, buf.len - sz_header)) continue;
+            data = (ra_rbuf_t){.base = plain.base, .len = plain.len};
+            handle_data(bench, bs, &data, pcm);
+        } else {
+            if (buf.len < RA_STREAM_ID_SIZE) continue;
+            uint32_t id = bytes_to_uint32(buf.base);
+            if (id >= bench->stream_count) continue;
+            data = (ra_rbuf_t){.base = buf.base + RA_STREAM_ID_SIZE, .len = buf.len - RA_STREAM_ID_SIZE};
+            handle_data(bench, &bench->streams[id], &data, pcm);
+        }
+    }
+
+    bench->receive_cpu_ns = ra_clock_thread_cpu_ns() - cpu_start;
+    free(pcm);
+}
+
+static void detect_marker(bench_t *bench, bench_stream_t *bs, const float *pcm, uint64_t playout_ns) {
+    int channels = bench->cfg.channel_count;
+    int onset = -1;
+    for (int i = 0; i < bench->frame_size; i++) {
+        if (fabsf(pcm[i * channels]) < MARKER_THRESHOLD) continue;
+        onset = i;
+        break;
+    }
+    if (onset < 0) {
+        bs->in_marker = false;
+        return;
+    } else if (bs->in_marker) {
+        return;
+    }
+    bs->in_marker = true;
+
+    // Skip the markers that never made it out, then pair the detection with the oldest one left
+    uint64_t detected_ns = playout_ns + (uint64_t)onset * RA_NSEC_PER_SEC / SAMPLE_RATE;
+    uint64_t max_latency_ns = MARKER_INTERVAL_MS * RA_NSEC_PER_MSEC;
+    size_t sent = bs->markers_sent;
+    while (bs->markers_matched < sent && detected_ns - bs->marker_capture_ns[bs->markers_matched] > max_latency_ns)
+        bs->markers_matched++;
+    if (bs->markers_matched >= sent) return;
+    uint64_t capture_ns = bs->marker_capture_ns[bs->markers_matched++];
+    if (detected_ns < capture_ns) return;
+    bench->latencies_ns[bench->latency_count++] = detected_ns - capture_ns;
+}
+
+// Pulls a buffer from every ring once a period the way the sink's audio callback does
+static void playout_thread(void *arg) {
+    bench_t *bench = arg;
+    size_t sz_buffer = bench->frame_size * bench->cfg.channel_count * sizeof(float);
+    float *pcm = malloc(sz_buffer);
+    uint64_t cpu_start = ra_clock_thread_cpu_ns();
+
+    for (uint64_t tick = 0; bench->running; tick++) {
+        sleep_until_tick(bench, tick);
+        uint64_t playout_ns = ra_clock_now_ns();
+        for (int i = 0; i < bench->stream_count; i++) {
+            bench_stream_t *bs = &bench->streams[i];
+            ra_ringbuf_t *rb = bs->ringbuf;
+            if (ra_ringbuf_fill_total(rb) < sz_buffer) {
+                if (bs->primed) bs->underruns++;
+                continue;
+            }
+            bs->primed = true;
+            char *wptr = (char *)pcm;
+            char *endptr = wptr + sz_buffer;
+            while (wptr < endptr) {
+                size_t rbytes = ra_min(ra_ringbuf_fill_count(rb), endptr - wptr);
+                memcpy(wptr, ra_ringbuf_read_ptr(rb), rbytes);
+                ra_ringbuf_advance_read_ptr(rb, rbytes);
+                wptr += rbytes;
+            }
+            detect_marker(bench, bs, pcm, playout_ns);
+        }
+    }
+
+    bench->playout_cpu_ns = ra_clock_thread_cpu_ns() - cpu_start;
+    free(pcm);
+}
+
+static int init_stream(bench_t *bench, bench_stream_t *bs, uint8_t id) {
+    int err;
+    ra_keypair_t source_keys, sink_keys;
+    ra_generate_keypair(&source_keys);
+    ra_generate_keypair(&sink_keys);
+    ra_stream_init(&bs->tx, id);
+    ra_stream_init(&bs->rx, id);
+    err = ra_compute_shared_secret(bs->tx.secret,
+                                   sizeof(bs->tx.secret),
+                                   sink_keys.public,
+                                   sizeof(sink_keys.public),
+                                   &source_keys,
+                                   RA_SHARED_SECRET_CLIENT);
+    if (err) return err;
+    err = ra_compute_shared_secret(bs->rx.secret,
+                                   sizeof(bs->rx.secret),
+                                   source_keys.public,
+                                   sizeof(source_keys.public),
+                                   &sink_keys,
+                                   RA_SHARED_SECRET_SERVER);
+    if (err) return err;
+
+    bs->encoder = ra_encoder_create(&bench->cfg, &bench->layout, 0, OPUS_APPLICATION, &err);
+    if (err) return err;
+    if (bench->bitrate > 0) ra_encoder_ctl(bs->encoder, OPUS_SET_BITRATE_REQUEST, bench->bitrate);
+    bs->decoder = ra_decoder_create(&bench->cfg, &bench->layout, NULL, &err);
+    if (err) return err;
+
+    bs->ringbuf = ra_ringbuf_create(RING_BUFFER_FRAMES * bench->cfg.channel_count * sizeof(float));
+    bs->marker_capture_ns = calloc(bench->max_markers, sizeof(uint64_t));
+    bs->noise_seed = 0x9e3779b9 + id;
+    return 0;
+}
+
+static void destroy_stream(bench_stream_t *bs) {
+    ra_encoder_destroy(bs->encoder);
+    ra_decoder_destroy(bs->decoder);
+    if (bs->ringbuf) ra_ringbuf_destroy(bs->ringbuf);
+    free(bs->marker_capture_ns);
+}
+
+static int open_sockets(bench_t *bench) {
+    bench->rx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    bench->tx_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (bench->rx_sock < 0 || bench->tx_sock < 0) {
+        ra_socket_perror("socket");
+        return -1;
+    }
+
+    // Let the system pick the sink's port
+    struct sockaddr_in *addr = &bench->rx_addr;
+    ra_sockaddr_init("127.0.0.1", 0, addr);
+    socklen_t addrlen = sizeof(struct sockaddr_in);
+    if (bind(bench->rx_sock, (struct sockaddr *)addr, addrlen)) {
+        ra_socket_perror("bind");
+        return -1;
+    }
+    if (getsockname(bench->rx_sock, (struct sockaddr *)addr, &addrlen)) {
+        ra_socket_perror("getsockname");
+        return -1;
+    }
+    bench->tx_conn.sock = bench->tx_sock;
+    bench->tx_conn.addr = (struct sockaddr *)addr;
+    bench->tx_conn.addrlen = addrlen;
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile_ms(const bench_t *bench, double p) {
+    if (bench->latency_count == 0) return 0;
+    size_t index = p * (bench->latency_count - 1) + 0.5;
+    return (double)bench->latencies_ns[index] / RA_NSEC_PER_MSEC;
+}
+
+static void print_results(bench_t *bench, uint64_t elapsed_ns) {
+    double seconds = (double)elapsed_ns / RA_NSEC_PER_SEC;
+    double streams = bench->stream_count;
+    size_t markers = 0, underruns = 0;
+    for (int i = 0; i < bench->stream_count; i++) {
+        markers += bench->streams[i].markers_sent;
+        underruns += bench->streams[i].underruns;
+    }
+    qsort(bench->latencies_ns, bench->latency_count, sizeof(uint64_t), compare_u64);
+
+    printf("streams=%d frame_size=%d bitrate=%d cipher=%s duration=%.1f\n",
+           bench->stream_count,
+           bench->frame_size,
+           bench->bitrate,
+           bench->encrypt ? CIPHER_XCHACHA20POLY1305 : CIPHER_NONE,
+           seconds);
+    printf("latency_ms p50=%.2f p90=%.2f p99=%.2f max=%.2f markers=%zu/%zu\n",
+           percentile_ms(bench, 0.5),
+           percentile_ms(bench, 0.9),
+           percentile_ms(bench, 0.99),
+           percentile_ms(bench, 1.0),
+           bench->latency_count,
+           markers);
+    printf("sent packets_per_sec=%.1f bytes_per_sec=%.1f\n",
+           bench->packets_sent / seconds,
+           bench->bytes_sent / seconds);
+    printf("received packets_per_sec=%.1f bytes_per_sec=%.1f\n",
+           bench->packets_received / seconds,
+           bench->bytes_received / seconds);
+    // CPU as a percentage of one core, per stream
+    printf("cpu_per_stream source=%.3f%% sink=%.3f%%\n",
+           100.0 * bench->capture_cpu_ns / elapsed_ns / streams,
+           100.0 * (bench->receive_cpu_ns + bench->playout_cpu_ns) / elapsed_ns / streams);
+    printf("errors encode=%" PRIu64 " decode=%" PRIu64 " overflows=%" PRIu64 " underruns=%zu\n",
+           bench->encode_errors,
+           bench->decode_errors,
+           bench->overflows,
+           underruns);
+}
+
+int main(int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    ra_config_parse_args(opts, argc, argv);
+    ra_config_section_t *options = ra_config_get_default_section(opts);
+    ra_logger_stream_t *logger_stream = ra_logger_stream_create(stderr, stderr);
+    g_logger = ra_logger_create(logger_stream, NULL);
+
+    bench_t bench = {0};
+    bench.stream_count = ra_config_get_int(options, "streams", 1);
+    bench.frame_size = ra_config_get_int(options, "frame-size", FRAMES_PER_BUFFER);
+    bench.bitrate = ra_config_get_int(options, "bitrate", 0);
+    bench.duration = ra_config_get_int(options, "duration", 10);
+    const char *cipher = ra_config_get_value(options, "cipher");
+    if (!cipher) cipher = CIPHER_XCHACHA20POLY1305;
+    bench.encrypt = strcasecmp(cipher, CIPHER_NONE) != 0;
+    bench.cfg = (ra_audio_config_t){
+        .type = RA_AUDIO_DEVICE_INPUT,
+        .sample_format = paFloat32,
+        .sample_size = sizeof(float),
+        .sample_rate = SAMPLE_RATE,
+        .channel_count = ra_config_get_int(options, "channels", DEFAULT_CHANNELS),
+        .frame_size = bench.frame_size,
+    };
+
+    int rc = EXIT_FAILURE;
+    bench.tx_sock = bench.rx_sock = -1;
+    if (bench.stream_count < 1 || bench.stream_count > MAX_BENCH_STREAMS || bench.duration < 1 ||
+        !valid_frame_size(bench.frame_size) ||
+        (bench.encrypt && strcasecmp(cipher, CIPHER_XCHACHA20POLY1305) != 0)) {
+        fprintf(stderr,
+                "Usage: %s [--streams=<1-%d>] [--frame-size=120|240|480|960|1920|2880] [--bitrate=<bps>] "
+                "[--cipher=" CIPHER_XCHACHA20POLY1305 "|" CIPHER_NONE "] [--channels=<count>] [--duration=<seconds>]\n",
+                argv[0],
+                MAX_BENCH_STREAMS);
+        goto done;
+    }
+    if (ra_channel_layout_init(&bench.layout, bench.cfg.channel_count, RA_MAPPING_FAMILY_MONO_STEREO, 1)) {
+        ra_logger_error(g_logger, "Unsupported channel count: %d", bench.cfg.channel_count);
+        goto done;
+    }
+
+    ra_proto_init();
+    if (ra_crypto_init(g_logger) || ra_socket_init(g_logger)) goto cleanup;
+    if (open_sockets(&bench)) goto cleanup;
+
+    bench.max_markers = (size_t)bench.duration * 1000 / MARKER_INTERVAL_MS + 1;
+    bench.latencies_ns = calloc(bench.max_markers * bench.stream_count, sizeof(uint64_t));
+    bench.streams = calloc(bench.stream_count, sizeof(bench_stream_t));
+    for (int i = 0; i < bench.stream_count; i++) {
+        int err = init_stream(&bench, &bench.streams[i], i);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to set up stream %d, error %d", i, err);
+            goto cleanup;
+        }
+    }
+
+    int err;
+    ra_thread_t threads[3];
+    ra_thread_func *routines[3] = {receive_thread, playout_thread, capture_thread};
+    bench.running = true;
+    bench.start_ns = ra_clock_now_ns();
+    for (int i = 0; i < 3; i++) {
+        threads[i] = ra_thread_start(routines[i], &bench, &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to start benchmark thread");
+            bench.running = false;
+            for (int j = 0; j < i; j++) {
+                ra_thread_join(threads[j]);
+                ra_thread_destroy(threads[j]);
+            }
+            goto cleanup;
+        }
+    }
+    ra_clock_sleep_until_ns(bench.start_ns + bench.duration * RA_NSEC_PER_SEC);
+    bench.running = false;
+    for (int i = 0; i < 3; i++) {
+        ra_thread_join(threads[i]);
+        ra_thread_destroy(threads[i]);
+    }
+
+    print_results(&bench, ra_clock_now_ns() - bench.start_ns);
+    // Latencies of a run that dropped frames at the encoder don't measure the path
+    if (bench.encode_errors) {
+        ra_logger_error(g_logger, "%" PRIu64 " frames failed to encode", bench.encode_errors);
+        goto cleanup;
+    }
+    rc = EXIT_SUCCESS;
+
+cleanup:
+    if (bench.streams)
+        for (int i = 0; i < bench.stream_count; i++) destroy_stream(&bench.streams[i]);
+    free(bench.streams);
+    free(bench.latencies_ns);
+    if (bench.tx_sock >= 0) ra_socket_close(bench.tx_sock);
+    if (bench.rx_sock >= 0) ra_socket_close(bench.rx_sock);
+    ra_socket_deinit();
+    ra_proto_deinit();
+
+done:
+    ra_logger_destroy(g_logger);
+    ra_logger_stream_destroy(logger_stream);
+    ra_config_destroy(opts);
+    return rc;
+}
@@ -0,0 +1,399 @@
+// Microbenchmarks of the hot-path primitives, printed as CSV so results can be compared between releases.
+// Each case is timed in batches grown until they run long enough, the median of the repeats is reported.
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "lib/clock.h"
+#include "lib/codec.h"
+#include "lib/config.h"
+#include "lib/proto.h"
+#include "lib/stream.h"
+#include "lib/string.h"
+#include "lib/thread.h"
+#include "lib/types.h"
+#include "lib/utils.h"
+
+#define REPEATS             5
+#define DEFAULT_MIN_TIME_MS 100
+#define MAX_ITERATIONS      1000000000
+#define MAX_ENCODED_SIZE    4000
+#define RINGBUF_CHUNK_SIZE  (FRAMES_PER_BUFFER * DEFAULT_CHANNELS * sizeof(float))
+#define SAMPLE_RATE         48000
+
+typedef void bench_func(void *ctx, size_t iterations);
+
+static const size_t payload_sizes[] = {64, 256, 1024, 4000, 0};
+static const int frame_sizes[] = {120, 240, 480, 960, 1920, 2880, 0};
+
+static const char *filter = NULL;
+static uint64_t min_time_ns = DEFAULT_MIN_TIME_MS * RA_NSEC_PER_MSEC;
+
+// Results are folded into this so the compiler can't drop the work being measured
+static volatile uint64_t sink;
+
+static uint64_t time_batch(bench_func *fn, void *ctx, size_t iterations) {
+    uint64_t start = ra_clock_now_ns();
+    fn(ctx, iterations);
+    return ra_clock_now_ns() - start;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run_bench(const char *name, bench_func *fn, void *ctx, size_t bytes_per_op) {
+    if (filter && !strstr(name, filter)) return;
+
+    // Warm up, then grow the batch until a single one takes a fair share of the minimum time
+    size_t iterations = 1;
+    uint64_t elapsed = time_batch(fn, ctx, iterations);
+    while (elapsed < min_time_ns / REPEATS && iterations < MAX_ITERATIONS) {
+        iterations = elapsed > 0 && min_time_ns / REPEATS / elapsed < 10
+                         ? iterations * min_time_ns / REPEATS / elapsed + 1
+                         : iterations * 10;
+        elapsed = time_batch(fn, ctx, iterations);
+    }
+
+    double samples[REPEATS];
+    for (int i = 0; i < REPEATS; i++) samples[i] = (double)time_batch(fn, ctx, iterations) / iterations;
+    qsort(samples, REPEATS, sizeof(double), compare_double);
+    double ns_per_op = samples[REPEATS / 2];
+    double bytes_per_sec = bytes_per_op > 0 ? bytes_per_op * (double)RA_NSEC_PER_SEC / ns_per_op : 0;
+    printf("%s,%zu,%.2f,%.0f\n", name, iterations, ns_per_op, bytes_per_sec);
+    fflush(stdout);
+}
+
+// Stream encryption
+
+typedef struct {
+    ra_stream_t stream;
+    char plain[BUFSIZE];
+    ra_rbuf_t payload;
+    char sealed[BUFSIZE];
+    size_t sealed_len;
+} stream_ctx_t;
+
+static void bench_stream_write(void *arg, size_t iterations) {
+    stream_ctx_t *ctx = arg;
+    for (size_t i = 0; i < iterations; i++) {
+        size_t outlen = sizeof(ctx->sealed);
+        ra_stream_write(&ctx->stream, ctx->sealed, &outlen, &ctx->payload);
+        sink += outlen;
+    }
+}
+
+static void bench_stream_read(void *arg, size_t iterations) {
+    stream_ctx_t *ctx = arg;
+    char rawbuf[BUFSIZE];
+    for (size_t i = 0; i < iterations; i++) {
+        ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+        // The same nonce stays inside the replay window, so every read decrypts in full
+        sink += ra_stream_read(&ctx->stream, &buf, ctx->sealed, ctx->sealed_len);
+        sink += buf.len;
+    }
+}
+
+static void run_stream_benches() {
+    char name[128];
+    stream_ctx_t *ctx = calloc(1, sizeof(stream_ctx_t));
+    ra_stream_init(&ctx->stream, 0);
+    randombytes_buf(ctx->stream.secret, sizeof(ctx->stream.secret));
+    randombytes_buf(ctx->plain, sizeof(ctx->plain));
+
+    // The protocol has the one cipher, XChaCha20-Poly1305
+    for (const size_t *size = payload_sizes; *size != 0; size++) {
+        ctx->payload = (ra_rbuf_t){.base = ctx->plain, .len = *size};
+        snprintf(name, sizeof(name), "stream_write/xchacha20poly1305/%zu", *size);
+        run_bench(name, bench_stream_write, ctx, *size);
+
+        ctx->sealed_len = sizeof(ctx->sealed);
+        ra_stream_write(&ctx->stream, ctx->sealed, &ctx->sealed_len, &ctx->payload);
+        snprintf(name, sizeof(name), "stream_read/xchacha20poly1305/%zu", *size);
+        run_bench(name, bench_stream_read, ctx, *size);
+    }
+    free(ctx);
+}
+
+// Ring buffer
+
+typedef struct {
+    ra_ringbuf_t *rb;
+    char chunk[RINGBUF_CHUNK_SIZE];
+    atomic_size_t produce;
+    atomic_bool running;
+} ringbuf_ctx_t;
+
+static void ringbuf_write_chunk(ra_ringbuf_t *rb, const char *chunk) {
+    const char *rptr = chunk;
+    const char *endptr = chunk + RINGBUF_CHUNK_SIZE;
+    while (rptr < endptr) {
+        size_t wbytes = ra_min(ra_ringbuf_free_count(rb), endptr - rptr);
+        memcpy(ra_ringbuf_write_ptr(rb), rptr, wbytes);
+        ra_ringbuf_advance_write_ptr(rb, wbytes);
+        rptr += wbytes;
+    }
+}
+
+static void ringbuf_read_chunk(ra_ringbuf_t *rb, char *chunk) {
+    char *wptr = chunk;
+    char *endptr = chunk + RINGBUF_CHUNK_SIZE;
+    while (wptr < endptr) {
+        size_t rbytes = ra_min(ra_ringbuf_fill_count(rb), endptr - wptr);
+        memcpy(wptr, ra_ringbuf_read_ptr(rb), rbytes);
+        ra_ringbuf_advance_read_ptr(rb, rbytes);
+        wptr += rbytes;
+    }
+}
+
+static void bench_ringbuf_single(void *arg, size_t iterations) {
+    ringbuf_ctx_t *ctx = arg;
+    for (size_t i = 0; i < iterations; i++) {
+        ringbuf_write_chunk(ctx->rb, ctx->chunk);
+        ringbuf_read_chunk(ctx->rb, ctx->chunk);
+    }
+}
+
+// Writes the chunks asked for by the consumer, spinning while the ring is full
+static void ringbuf_producer(void *arg) {
+    ringbuf_ctx_t *ctx = arg;
+    char chunk[RINGBUF_CHUNK_SIZE] = {0};
+    while (ctx->running) {
+        if (ctx->produce == 0 || ra_ringbuf_size(ctx->rb) - ra_ringbuf_fill_total(ctx->rb) < RINGBUF_CHUNK_SIZE)
+            continue;
+        ringbuf_write_chunk(ctx->rb, chunk);
+        ctx->produce--;
+    }
+}
+
+static void bench_ringbuf_cross(void *arg, size_t iterations) {
+    ringbuf_ctx_t *ctx = arg;
+    ctx->produce += iterations;
+    for (size_t i = 0; i < iterations; i++) {
+        while (ra_ringbuf_fill_total(ctx->rb) < RINGBUF_CHUNK_SIZE) continue;
+        ringbuf_read_chunk(ctx->rb, ctx->chunk);
+    }
+}
+
+static void run_ringbuf_benches() {
+    ringbuf_ctx_t *ctx = calloc(1, sizeof(ringbuf_ctx_t));
+    // Sized like the sink's rings, which don't hold a whole number of chunks
+    ctx->rb = ra_ringbuf_create(RING_BUFFER_FRAMES * DEFAULT_CHANNELS * sizeof(float));
+    run_bench("ringbuf/single_thread", bench_ringbuf_single, ctx, RINGBUF_CHUNK_SIZE);
+
+    int err;
+    ra_ringbuf_reset(ctx->rb);
+    ctx->running = true;
+    ra_thread_t thread = ra_thread_start(ringbuf_producer, ctx, &err);
+    if (!err) {
+        run_bench("ringbuf/cross_thread", bench_ringbuf_cross, ctx, RINGBUF_CHUNK_SIZE);
+        ctx->running = false;
+        ra_thread_join(thread);
+        ra_thread_destroy(thread);
+    }
+    ra_ringbuf_destroy(ctx->rb);
+    free(ctx);
+}
+
+// Byte order helpers
+
+typedef struct {
+    char buf[64 * sizeof(uint64_t)];
+} bytes_ctx_t;
+
+static void bench_uint16_to_bytes(void *arg, size_t iterations) {
+    bytes_ctx_t *ctx = arg;
+    for (size_t i = 0; i < iterations; i++) uint16_to_bytes(ctx->buf + (i & 63) * 2, i);
+    sink += ctx->buf[0];
+}
+
+static void bench_uint32_to_bytes(void *arg, size_t iterations) {
+    bytes_ctx_t *ctx = arg;
+    for (size_t i = 0; i < iterations; i++) uint32_to_bytes(ctx->buf + (i & 63) * 4, i);
+    sink += ctx->buf[0];
+}
+
+static void bench_uint64_to_bytes(void *arg, size_t iterations) {
+    bytes_ctx_t *ctx = arg;
+    for (size_t i = 0; i < iterations; i++) uint64_to_bytes(ctx->buf + (i & 63) * 8, i);
+    sink += ctx->buf[0];
+}
+
+static void bench_bytes_to_uint16(void *arg, size_t iterations) {
+    bytes_ctx_t *ctx = arg;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < iterations; i++) sum += bytes_to_uint16(ctx->buf + (i & 63) * 2);
+    sink += sum;
+}
+
+static void bench_bytes_to_uint32(void *arg, size_t iterations) {
+    bytes_ctx_t *ctx = arg;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < iterations; i++) sum += bytes_to_uint32(ctx->buf + (i & 63) * 4);
+    sink += sum;
+}
+
+static void bench_bytes_to_uint64(void *arg, size_t iterations) {
+    bytes_ctx_t *ctx = arg;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < iterations; i++) sum += bytes_to_uint64(ctx->buf + (i & 63) * 8);
+    sink += sum;
+}
+
+static void run_bytes_benches() {
+    bytes_ctx_t ctx;
+    randombytes_buf(ctx.buf, sizeof(ctx.buf));
+    run_bench("bytes/uint16_to_bytes", bench_uint16_to_bytes, &ctx, 2);
+    run_bench("bytes/uint32_to_bytes", bench_uint32_to_bytes, &ctx, 4);
+    run_bench("bytes/uint64_to_bytes", bench_uint64_to_bytes, &ctx, 8);
+    run_bench("bytes/bytes_to_uint16", bench_bytes_to_uint16, &ctx, 2);
+    run_bench("bytes/bytes_to_uint32", bench_bytes_to_uint32, &ctx, 4);
+    run_bench("bytes/bytes_to_uint64", bench_bytes_to_uint64, &ctx, 8);
+}
+
+// Protocol messages
+
+typedef struct {
+    char payload[BUFSIZE];
+    char out[BUFSIZE];
+    size_t size;
+} message_ctx_t;
+
+static void bench_stream_data_message(void *arg, size_t iterations) {
+    message_ctx_t *ctx = arg;
+    ra_rbuf_t rbuf = {.base = ctx->payload, .len = ctx->size};
+    for (size_t i = 0; i < iterations; i++) {
+        ra_buf_t buf = {.base = ctx->out, .cap = sizeof(ctx->out)};
+        create_stream_data_message(&buf, &rbuf);
+        sink += buf.len;
+    }
+}
+
+static void run_message_benches() {
+    char name[128];
+    message_ctx_t *ctx = calloc(1, sizeof(message_ctx_t));
+    for (const size_t *size = payload_sizes; *size != 0; size++) {
+        ctx->size = *size;
+        snprintf(name, sizeof(name), "create_stream_data_message/%zu", *size);
+        run_bench(name, bench_stream_data_message, ctx, *size);
+    }
+    free(ctx);
+}
+
+// Opus
+
+typedef struct {
+    ra_encoder_t *encoder;
+    ra_decoder_t *decoder;
+    int frame_size;
+    float pcm[MAX_FRAME_SIZE * DEFAULT_CHANNELS];
+    unsigned char packet[MAX_ENCODED_SIZE];
+    opus_int32 packet_len;
+} codec_ctx_t;
+
+static void bench_encode(void *arg, size_t iterations) {
+    codec_ctx_t *ctx = arg;
+    for (size_t i = 0; i < iterations; i++)
+        sink += ra_encode(ctx->encoder, ctx->pcm, ctx->frame_size, ctx->packet, sizeof(ctx->packet));
+}
+
+static void bench_decode(void *arg, size_t iterations) {
+    codec_ctx_t *ctx = arg;
+    for (size_t i = 0; i < iterations; i++)
+        sink += ra_decode_float(ctx->decoder, ctx->packet, ctx->packet_len, ctx->pcm, MAX_FRAME_SIZE, 0);
+}
+
+static void run_codec_benches() {
+    char name[128];
+    ra_audio_config_t cfg = {
+        .type = RA_AUDIO_DEVICE_INPUT,
+        .sample_format = paFloat32,
+        .sample_size = sizeof(float),
+        .sample_rate = SAMPLE_RATE,
+        .channel_count = DEFAULT_CHANNELS,
+    };
+    ra_channel_layout_t layout;
+    ra_channel_layout_init(&layout, cfg.channel_count, RA_MAPPING_FAMILY_MONO_STEREO, 1);
+
+    codec_ctx_t *ctx = calloc(1, sizeof(codec_ctx_t));
+    uint32_t seed = 1;
+    for (int i = 0; i < MAX_FRAME_SIZE * DEFAULT_CHANNELS; i++) {
+        seed = seed * 1664525 + 1013904223;
+        ctx->pcm[i] = (int32_t)seed / 4294967296.0f;
+    }
+
+    for (const int *frame_size = frame_sizes; *frame_size != 0; frame_size++) {
+        int err;
+        cfg.frame_size = *frame_size;
+        ctx->frame_size = *frame_size;
+        ctx->encoder = ra_encoder_create(&cfg, &layout, RA_MAPPING_FAMILY_MONO_STEREO, OPUS_APPLICATION, &err);
+        if (err) continue;
+        ctx->decoder = ra_decoder_create(&cfg, &layout, NULL, &err);
+        if (err) {
+            ra_encoder_destroy(ctx->encoder);
+            continue;
+        }
+
+        // Bytes per op count the PCM going through the codec
+        size_t pcm_size = *frame_size * cfg.channel_count * sizeof(float);
+        snprintf(name, sizeof(name), "opus_encode/%d", *frame_size);
+        run_bench(name, bench_encode, ctx, pcm_size);
+
+        ctx->packet_len = ra_encode(ctx->encoder, ctx->pcm, ctx->frame_size, ctx->packet, sizeof(ctx->packet));
+        if (ctx->packet_len > 0) {
+            snprintf(name, sizeof(name), "opus_decode/%d", *frame_size);
+            run_bench(name, bench_decode, ctx, pcm_size);
+        }
+        ra_encoder_destroy(ctx->encoder);
+        ra_decoder_destroy(ctx->decoder);
+    }
+    free(ctx);
+}
+
+// Logger, what the logging thread pays, past the rate limit that is mostly the drop path
+
+static void bench_logger(void *arg, size_t iterations) {
+    ra_logger_t *logger = arg;
+    for (size_t i = 0; i < iterations; i++) ra_logger_info(logger, "Stream %d: Ring buffer overflow! %zu", 42, i);
+}
+
+static void run_logger_benches() {
+    FILE *file = tmpfile();
+    if (!file) return;
+    ra_logger_stream_t *stream = ra_logger_stream_create(file, file);
+    ra_logger_t *logger = ra_logger_create(stream, "bench");
+    run_bench("logger/info", bench_logger, logger, 0);
+    ra_logger_destroy(logger);
+    ra_logger_stream_destroy(stream);
+}
+
+int main(int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    ra_config_parse_args(opts, argc, argv);
+    ra_config_section_t *options = ra_config_get_default_section(opts);
+    filter = ra_config_get_value(options, "filter");
+    min_time_ns = ra_config_get_int(options, "min-time-ms", DEFAULT_MIN_TIME_MS) * RA_NSEC_PER_MSEC;
+
+    ra_logger_stream_t *logger_stream = ra_logger_stream_create(stderr, stderr);
+    ra_logger_t *logger = ra_logger_create(logger_stream, NULL);
+    int rc = EXIT_FAILURE;
+    if (ra_crypto_init(logger)) goto cleanup;
+    ra_proto_init();
+
+    printf("name,iterations,ns_per_op,bytes_per_sec\n");
+    run_stream_benches();
+    run_ringbuf_benches();
+    run_bytes_benches();
+    run_message_benches();
+    run_codec_benches();
+    run_logger_benches();
+    ra_proto_deinit();
+    rc = EXIT_SUCCESS;
+
+cleanup:
+    ra_logger_destroy(logger);
+    ra_logger_stream_destroy(logger_stream);
+    ra_config_destroy(opts);
+    return rc;
+}
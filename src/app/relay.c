@@ -0,0 +1,389 @@
+#include "relay.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "lib/clock.h"
+#include "lib/peer.h"
+#include "lib/proto.h"
+#include "lib/stream.h"
+#include "lib/string.h"
+
+#define MAX_SINKS                  256
+#define LIVENESS_TIMEOUT_SECONDS   30
+#define HEARTBEAT_TIMEOUT_SECONDS  10
+#define HEARTBEAT_INTERVAL_SECONDS 3
+#define REPORT_INTERVAL_SECONDS    1
+
+typedef struct {
+    ra_keypair_t *keypair;
+    // Upstream session with the source, accepted the same way the sink does
+    ra_stream_t stream;
+    ra_conn_t conn;
+    struct sockaddr_in addr;
+    bool active;
+    ra_handshake_t handshake;
+    time_t last_update;
+    time_t last_heartbeat;
+    time_t last_report;
+    ra_receiver_stats_t stats;
+    bool group_warned;
+    // Downstream sessions, held the same way the source does
+    ra_peer_t peers[MAX_SINKS];
+    ra_stream_report_t reports[MAX_SINKS];
+    int peer_count;
+} ra_relay_t;
+
+typedef struct {
+    const ra_conn_t *conn;
+    const ra_rbuf_t *buf;
+} ra_handler_context_t;
+
+static SOCKET sock = -1;
+static atomic_bool is_running = false;
+static ra_relay_t *relay = NULL;
+static ra_logger_t *g_logger = NULL;
+static bool disable_signal_handlers = false;
+
+static void signal_handler(int signum) {
+    is_running = false;
+}
+
+static void send_handshake(ra_peer_t *peer) {
+    memset(&relay->reports[peer - relay->peers], 0, sizeof(ra_stream_report_t));
+    ra_peer_send_handshake(peer, relay->keypair, &relay->handshake.cfg, &relay->handshake.layout);
+}
+
+static void send_downstream(const ra_rbuf_t *buf) {
+    for (int i = 0; i < relay->peer_count; i++) ra_peer_send(&relay->peers[i], buf);
+}
+
+static void close_upstream(const char *reason) {
+    if (!relay->active) return;
+    relay->active = false;
+    send_downstream(ra_stream_terminate_message);
+    for (int i = 0; i < relay->peer_count; i++) relay->peers[i].state = 0;
+    ra_logger_info(g_logger, "Source session closed: %s", reason);
+}
+
+// Reports the worst of the relay's own reception and every sink's back to the source
+static void send_upstream_report() {
+    char rawbuf[64];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+
+    ra_stream_report_t report;
+    ra_receiver_stats_fill_report(&relay->stats, &report);
+    report.buffer_ms = 0;
+    report.underruns = 0;
+    bool buffered = false;
+    for (int i = 0; i < relay->peer_count; i++) {
+        if (!ra_peer_ready(&relay->peers[i])) continue;
+        const ra_stream_report_t *r = &relay->reports[i];
+        if (r->fraction_lost > report.fraction_lost) report.fraction_lost = r->fraction_lost;
+        if (r->jitter_us > report.jitter_us) report.jitter_us = r->jitter_us;
+        if (!buffered || r->buffer_ms < report.buffer_ms) report.buffer_ms = r->buffer_ms;
+        report.underruns += r->underruns;
+        buffered = true;
+    }
+    create_stream_report_message(&buf, &report);
+    ra_stream_send(&relay->stream, &relay->conn, (ra_rbuf_t *)&buf);
+}
+
+static void handle_handshake_init(ra_handler_context_t *ctx) {
+    ra_handshake_t hs = {
+        .cfg =
+            {
+                .type = RA_AUDIO_DEVICE_OUTPUT,
+                .channel_count = DEFAULT_CHANNELS,
+                .frame_size = FRAMES_PER_BUFFER,
+            },
+    };
+    if (read_handshake_message(&hs, ctx->buf)) {
+        ra_logger_error(g_logger, "Invalid handshake from source, unsupported audio config or channel layout");
+        return;
+    }
+
+    // The live source keeps the relay until it goes quiet, nobody else gets to take the stream over
+    const ra_conn_t *conn = ctx->conn;
+    const struct sockaddr_in *addr = (const struct sockaddr_in *)conn->addr;
+    if (relay->active &&
+        (addr->sin_addr.s_addr != relay->addr.sin_addr.s_addr || addr->sin_port != relay->addr.sin_port)) {
+        static char straddr[32];
+        ra_sockaddr_str(straddr, (struct sockaddr_in *)addr);
+        ra_logger_warn(g_logger, "Rejected handshake from %s, already relaying another source", straddr);
+        return;
+    }
+
+    // A fresh session ID for every handshake, packets of the previous session no longer match
+    ra_stream_t *stream = &relay->stream;
+    ra_stream_init(stream, randombytes_random());
+    int err = ra_compute_shared_secret(
+        stream->secret, sizeof(stream->secret), hs.key, hs.keylen, relay->keypair, RA_SHARED_SECRET_SERVER);
+    if (err) {
+        ra_logger_error(g_logger, "Key exchange with source failed");
+        return;
+    }
+
+    // A changed config means the sinks have to reopen their streams
+    if (relay->active && !ra_handshake_config_equal(&hs, &relay->handshake))
+        close_upstream("source reconnected with a different audio config");
+    relay->handshake = hs;
+    relay->handshake.key = NULL;
+    memcpy(&relay->addr, conn->addr, conn->addrlen);
+    relay->active = true;
+    relay->group_warned = false;
+    relay->last_update = relay->last_heartbeat = relay->last_report = time(NULL);
+    ra_receiver_stats_reset(&relay->stats, hs.cfg.sample_rate);
+
+    char rawbuf[BUFSIZE];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    create_handshake_response_message(&buf, stream->id, relay->keypair);
+    ra_buf_sendto(&relay->conn, (ra_rbuf_t *)&buf);
+
+    static char straddr[32];
+    ra_sockaddr_str(straddr, &relay->addr);
+    ra_logger_info(g_logger, "Relaying source from %s to %d sinks", straddr, relay->peer_count);
+    for (int i = 0; i < relay->peer_count; i++)
+        if (!ra_peer_ready(&relay->peers[i])) send_handshake(&relay->peers[i]);
+}
+
+// Stream data is only decrypted and re-encrypted for each sink, the Opus packets pass through untouched
+static void handle_upstream_crypto(ra_handler_context_t *ctx) {
+    static char rawbuf[BUFSIZE];
+
+    const ra_rbuf_t *rbuf = ctx->buf;
+    if (!relay->active || rbuf->len < RA_STREAM_ID_SIZE) return;
+    const char *rptr = rbuf->base;
+    const char *endptr = rptr + rbuf->len;
+
+    ra_stream_t *stream = &relay->stream;
+    if (bytes_to_uint32(rptr) != stream->id) return;
+    rptr += RA_STREAM_ID_SIZE;
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    if (ra_stream_read(stream, &buf, rptr, endptr - rptr) || buf.len < 1) return;
+    relay->last_update = time(NULL);
+    // Signals take their nonces from the same sequence as the data, loss is measured over all of them
+    ra_receiver_stats_update(&relay->stats, stream->last_nonce);
+
+    switch ((ra_crypto_type)rawbuf[0]) {
+    case RA_STREAM_DATA:
+        if (buf.len >= 1 + STREAM_DATA_HEADER_SIZE)
+            ra_receiver_stats_update_jitter(&relay->stats, bytes_to_uint32(rawbuf + 3), ra_clock_now_us());
+        send_downstream((ra_rbuf_t *)&buf);
+        break;
+    case RA_STREAM_TERMINATE:
+        close_upstream("terminated by the source");
+        break;
+    case RA_STREAM_GROUP:
+        // The relay doesn't join groups, a source sending its data to one leaves the sinks without audio
+        if (relay->group_warned) break;
+        relay->group_warned = true;
+        ra_logger_warn(g_logger, "Source streams to a multicast group, which the relay doesn't forward");
+        break;
+    default:
+        break;
+    }
+}
+
+static void handle_downstream_message(ra_handler_context_t *ctx, ra_peer_t *peer) {
+    static char rawbuf[BUFSIZE];
+
+    const ra_rbuf_t *rbuf = ctx->buf;
+    ra_message_type msg_type = (ra_message_type)rbuf->base[0];
+    ra_rbuf_t next_buf = {.base = rbuf->base + 1, .len = rbuf->len - 1};
+
+    switch (msg_type) {
+    case RA_HANDSHAKE_COOKIE:
+        if (ra_peer_handle_handshake_cookie(peer, &next_buf) == 0) send_handshake(peer);
+        break;
+    case RA_HANDSHAKE_RESPONSE:
+        if (ra_peer_handle_handshake_response(peer, relay->keypair, &next_buf)) return;
+        ra_logger_info(g_logger, "Handshake with sink %s succeed.", peer->host);
+        break;
+    case RA_MESSAGE_CRYPTO: {
+        ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+        if (ra_peer_read(peer, &buf, &next_buf)) return;
+        if ((ra_crypto_type)rawbuf[0] != RA_STREAM_REPORT) return;
+        ra_rbuf_t report_buf = {.base = rawbuf + 1, .len = buf.len - 1};
+        read_stream_report_message(&relay->reports[peer - relay->peers], &report_buf);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void handle_message(ra_handler_context_t *ctx) {
+    const ra_rbuf_t *rbuf = ctx->buf;
+    if (rbuf->len < 1) return;
+
+    ra_peer_t *peer = ra_peer_find(relay->peers, relay->peer_count, ctx->conn->addr);
+    if (peer) {
+        handle_downstream_message(ctx, peer);
+        return;
+    }
+
+    ra_message_type msg_type = (ra_message_type)rbuf->base[0];
+    ra_rbuf_t next_buf = {.base = rbuf->base + 1, .len = rbuf->len - 1};
+    ra_handler_context_t next_ctx = {.conn = ctx->conn, .buf = &next_buf};
+    switch (msg_type) {
+    case RA_HANDSHAKE_INIT:
+        handle_handshake_init(&next_ctx);
+        break;
+    case RA_MESSAGE_CRYPTO:
+        handle_upstream_crypto(&next_ctx);
+        break;
+    default:
+        break;
+    }
+}
+
+static void handle_timers() {
+    time_t now = time(NULL);
+    if (!relay->active) return;
+    if (relay->last_update + LIVENESS_TIMEOUT_SECONDS <= now) {
+        ra_stream_send(&relay->stream, &relay->conn, ra_stream_terminate_message);
+        close_upstream("liveness timeout");
+        return;
+    }
+    if (relay->last_heartbeat + HEARTBEAT_INTERVAL_SECONDS <= now) {
+        ra_stream_send(&relay->stream, &relay->conn, ra_stream_heartbeat_message);
+        relay->last_heartbeat = now;
+    }
+    if (relay->last_report + REPORT_INTERVAL_SECONDS <= now) {
+        send_upstream_report();
+        relay->last_report = now;
+    }
+    for (int i = 0; i < relay->peer_count; i++) {
+        ra_peer_t *peer = &relay->peers[i];
+        if (peer->last_heartbeat + HEARTBEAT_TIMEOUT_SECONDS > now) continue;
+        ra_logger_warn(g_logger, "Sink %s heartbeat timeout, re-attempting handshake.", peer->host);
+        send_handshake(peer);
+    }
+}
+
+void relay_disable_signal_handlers() {
+    disable_signal_handlers = true;
+}
+
+void relay_stop() {
+    is_running = false;
+}
+
+int relay_main(ra_logger_t *logger, int argc, const char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <sink-host[:port],...> [listen-port] [sink-port]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    g_logger = logger;
+    const char *hosts = argv[1];
+    int listen_port = argc >= 3 ? atoi(argv[2]) : LISTEN_PORT;
+    int sink_port = argc >= 4 ? atoi(argv[3]) : LISTEN_PORT;
+
+    int rc = EXIT_SUCCESS;
+    relay = calloc(1, sizeof(ra_relay_t));
+    ra_stream_init(&relay->stream, 0);
+
+    char rawbuf[BUFSIZE];
+    ra_buf_t buf = {
+        .base = rawbuf,
+        .len = 0,
+        .cap = sizeof(rawbuf),
+    };
+
+    ra_keypair_t keypair;
+    relay->keypair = &keypair;
+
+    struct sockaddr_in listen_addr;
+    listen_addr.sin_family = AF_INET;
+    listen_addr.sin_addr.s_addr = INADDR_ANY;
+    listen_addr.sin_port = htons(listen_port);
+    sockopt_t opt = 1;
+
+    struct sockaddr_in src_addr;
+    ra_conn_t conn = {
+        .sock = -1,
+        .addr = (struct sockaddr *)&src_addr,
+        .addrlen = sizeof(struct sockaddr_in),
+    };
+    ra_handler_context_t ctx = {
+        .conn = &conn,
+        .buf = (ra_rbuf_t *)&buf,
+    };
+
+    fd_set readfds;
+    struct timeval select_timeout;
+    select_timeout.tv_sec = 1;
+    select_timeout.tv_usec = 0;
+
+    ra_proto_init();
+
+    if (ra_crypto_init(logger)) goto error;
+    ra_generate_keypair(&keypair);
+
+    if (ra_socket_init(logger)) goto error;
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ra_socket_perror("socket");
+        goto error;
+    }
+    conn.sock = sock;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(sockopt_t))) {
+        ra_socket_perror("setsockopt");
+        goto error;
+    }
+    if (bind(sock, (struct sockaddr *)&listen_addr, sizeof(struct sockaddr_in))) {
+        ra_socket_perror("bind");
+        goto error;
+    }
+    relay->conn.sock = sock;
+    relay->conn.addr = (struct sockaddr *)&relay->addr;
+    relay->conn.addrlen = sizeof(relay->addr);
+
+    relay->peer_count = ra_peer_parse_list(relay->peers, MAX_SINKS, sock, hosts, sink_port);
+    if (relay->peer_count <= 0) {
+        ra_logger_error(g_logger, "Invalid sink list, expected up to %d sinks: %s", MAX_SINKS, hosts);
+        goto error;
+    }
+    ra_logger_info(logger, "Relay listening at port %d, forwarding to %d sinks.", listen_port, relay->peer_count);
+
+    is_running = true;
+    if (!disable_signal_handlers) {
+        signal(SIGINT, signal_handler);
+        signal(SIGTERM, signal_handler);
+    }
+
+    while (is_running) {
+        FD_ZERO(&readfds);
+        FD_SET(sock, &readfds);
+        int count = ra_socket_select(sock + 1, &readfds, &select_timeout);
+        if (count < 0) {
+            ra_socket_perror("select");
+            goto error;
+        }
+        if (count > 0 && FD_ISSET(sock, &readfds)) {
+            if (ra_buf_recvfrom(&conn, &buf) <= 0) goto error;
+            handle_message(&ctx);
+        }
+        handle_timers();
+    }
+    goto cleanup;
+
+error:
+    rc = EXIT_FAILURE;
+
+cleanup:
+    ra_logger_info(g_logger, "Relay shutting down...");
+    if (sock >= 0) {
+        if (relay->active) ra_stream_send(&relay->stream, &relay->conn, ra_stream_terminate_message);
+        close_upstream("relay shutting down");
+        ra_socket_close(sock);
+    }
+    ra_socket_deinit();
+    ra_proto_deinit();
+    free(relay);
+
+    ra_logger_info(logger, "Relay shutdown gracefully.");
+    return rc;
+}
@@ -0,0 +1,10 @@
+#ifndef _RA_RELAY_H
+#define _RA_RELAY_H
+
+#include "lib/logger.h"
+
+int relay_main(ra_logger_t *logger, int argc, const char **argv);
+void relay_disable_signal_handlers();
+void relay_stop();
+
+#endif
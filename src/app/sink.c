@@ -4,34 +4,112 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 
+#include "lib/alloc.h"
+#include "lib/clock.h"
+#include "lib/clocksync.h"
+#include "lib/codec.h"
+#include "lib/config.h"
+#include "lib/journal.h"
+#include "lib/metrics.h"
+#include "lib/probe.h"
 #include "lib/proto.h"
+#include "lib/realtime.h"
+#include "lib/recorder.h"
+#include "lib/sessions.h"
 #include "lib/stream.h"
 #include "lib/string.h"
 #include "lib/thread.h"
+#include "lib/trace.h"
 #include "lib/utils.h"
 
-#define MAX_STREAMS                16
+#define DEFAULT_MAX_STREAMS        4096
+#define PREALLOCATED_STREAMS       16  // Slots set up before the first source connects, the rest are set up on demand
 #define LIVENESS_TIMEOUT_SECONDS   30
 #define HEARTBEAT_INTERVAL_SECONDS 3
-
-#define STREAM_LOG_PREFIX "Stream %d: "
+#define REPORT_INTERVAL_SECONDS    1
+#define COMFORT_NOISE_LEVEL        0.0003f
+#define DEFAULT_CALLBACK_BUDGET    80  // Percent of the buffer period an audio callback may take
+#define DEADLINE_REPORT_SECONDS    10
+#define POOL_SAMPLE_RATE           48000  // The rate sources pick first, unless their device says otherwise
+#define COOKIE_EPOCH_SECONDS       30     // Cookies are honored for one to two epochs
+#define HANDSHAKE_QUEUE_SIZE       64     // Handshakes in the hands of the worker, sources retry the ones beyond
+#define HANDSHAKE_POLL_USEC        2000   // Receive loop's select timeout while handshakes are in flight
+#define PAYLOAD_POOL_SIZE          1      // Payloads decrypted at once, the receive loop handles one at a time
+
+// Multicast groups joined at once, select's set also holds our own socket
+#define MAX_GROUP_SOCKETS (FD_SETSIZE - 1)
+
+#define STREAM_LOG_PREFIX "Stream %u: "
+#define METRICS_PREFIX    "remote_audio_sink"
 
 typedef struct {
     ra_keypair_t *keypair;
     ra_audio_config_t *audio_cfg;
+    // Recording mode, streams are archived to files instead of played back
+    ra_recorder_t *recorder;
+    const char *record_dir;
+    bool record_wav;
+    int callback_budget;
+    ra_realtime_config_t realtime;
+    int background_cpu;
+    ra_packet_pool_t *payloads;    // Decrypted on the receive loop, taken instead of a static buffer per handler
+    ra_workers_t *decode_workers;  // Every stream decodes on the receive loop, so its decoders share one pool
 } ra_sink_t;
 
-typedef struct {
+typedef struct ra_audio_stream_t {
     ra_stream_t *stream;
     ra_ringbuf_t *ringbuf;
-    OpusDecoder *decoder;
-    PaStream *pa_stream;
+    ra_decoder_t *decoder;
+    ra_audio_handle_t *audio;
     atomic_uchar state;
     ra_audio_config_t audio_cfg;
     ra_conn_t conn;
     struct sockaddr_in _addr;
     _Atomic(time_t) last_update;
     _Atomic(time_t) last_heartbeat;
+    time_t last_report;
+    ra_receiver_stats_t stats;
+    atomic_bool primed;  // Set once decoded audio has been queued for playback
+    atomic_bool failed;  // Set by the audio callback, which leaves closing the stream to the main loop
+    // Links of the lists the main loop drains, a stream is on each at most once per session
+    struct ra_audio_stream_t *next_failed;
+    struct ra_audio_stream_t *next_closed;
+    atomic_uint underruns;
+    atomic_bool dtx;  // Source is suppressing silence, gaps are filled with comfort noise
+    uint32_t noise_seed;
+    // Multicast group the source sends the stream data to, only touched by the main thread
+    ra_stream_group_t group;
+    ra_stream_t group_stream;
+    SOCKET group_sock;
+    int group_index;  // Position among the joined groups, only meaningful while group_sock is open
+    ra_recording_t *recording;
+    // Kept across reopens so the counters only ever go up for the stream's slot
+    ra_metrics_t metrics;
+    uint64_t callback_budget_ns;
+    // Deadline misses and callbacks as of the last report, only touched by the background thread
+    uint64_t reported_misses;
+    uint64_t reported_callbacks;
+    // Maps the source's capture times onto our clock, only touched by the main thread
+    ra_clock_sync_t clock_sync;
+    uint64_t output_latency_ns;
+    atomic_ullong next_dac_ns;  // When the frame at the head of the ring will be played, set by the audio callback
+    // Accounting for the session's journal record, reset whenever the stream is opened
+    time_t session_started;
+    uint64_t session_started_ns;
+    uint64_t frames_received;
+    uint64_t data_packets;
+    uint64_t session_bytes;
+    uint64_t decode_ns;
+    uint64_t decodes;
+    atomic_ullong frames_concealed;
+    ra_jitter_histogram_t jitter;
+    // Set while the handshake worker opens the stream, its slot isn't handed back until the result is collected
+    bool handshaking;
+    // Who opened the session and with what, a repeat of the same handshake resumes it. Only touched by the main thread.
+    struct sockaddr_in source_addr;
+    unsigned char source_key[PUBLIC_KEY_SIZE];
+    ra_audio_config_t source_cfg;
+    ra_channel_layout_t source_layout;
 } ra_audio_stream_t;
 
 typedef struct {
@@ -39,19 +117,116 @@ typedef struct {
     const ra_rbuf_t *buf;
 } ra_handler_context_t;
 
+// Handshake that came back with a valid cookie, handed to the worker and back with its result
+typedef struct {
+    ra_audio_stream_t *astream;
+    uint32_t id;
+    unsigned char key[PUBLIC_KEY_SIZE];
+    ra_audio_config_t cfg;
+    ra_channel_layout_t layout;
+    struct sockaddr_in addr;
+    int err;
+} ra_handshake_job_t;
+
+// The key agreement and the device open run on their own thread, keeping them off the path every stream's audio
+// arrives on. Jobs only go through the queues, the stream isn't visible to the other threads until it's opened.
+typedef struct {
+    ra_mutex_t mutex;
+    ra_cond_t cond;
+    ra_thread_t thread;
+    bool running;
+    ra_handshake_job_t pending[HANDSHAKE_QUEUE_SIZE];
+    size_t pending_head;
+    size_t pending_count;
+    ra_handshake_job_t done[HANDSHAKE_QUEUE_SIZE];
+    size_t done_head;
+    size_t done_count;
+    size_t in_flight;  // Submitted and not collected yet, only touched by the main thread
+} ra_handshaker_t;
+
 static SOCKET sock = -1;
 static atomic_bool is_running = false;
-static ra_audio_stream_t *audio_streams[MAX_STREAMS] = {0};
+static ra_session_table_t *audio_streams = NULL;
 static ra_sink_t *sink = NULL;
 static ra_logger_t *g_logger = NULL;
 static bool disable_signal_handlers = false;
-
-static void audio_stream_close(ra_audio_stream_t *);
+static ra_metrics_t global_metrics;
+static ra_journal_t *journal = NULL;
+static ra_handshaker_t handshaker;
+static unsigned char cookie_key[COOKIE_KEY_SIZE];
+static unsigned char source_hash_key[crypto_shorthash_KEYBYTES];
+// Streams the audio callback gave up on and streams closed by any thread, waiting for the main loop
+static _Atomic(ra_audio_stream_t *) failed_streams = NULL;
+static _Atomic(ra_audio_stream_t *) closed_streams = NULL;
+// Streams with a group socket open, so the receive loop only walks those. Only touched by the main thread.
+static ra_audio_stream_t *joined_groups[MAX_GROUP_SOCKETS];
+static int joined_count = 0;
+
+static void audio_stream_close(ra_audio_stream_t *, const char *);
+
+// Lock free, so the audio callback can push too. The main loop takes the whole list at once.
+static void stream_list_push(_Atomic(ra_audio_stream_t *) *list, ra_audio_stream_t *astream, ra_audio_stream_t **next) {
+    ra_audio_stream_t *head = atomic_load_explicit(list, memory_order_relaxed);
+    do {
+        *next = head;
+    } while (!atomic_compare_exchange_weak_explicit(list, &head, astream, memory_order_release, memory_order_relaxed));
+}
 
 static void signal_handler(int signum) {
     is_running = false;
 }
 
+// Counts towards the stream's metrics and the global ones
+static void count_metric(ra_audio_stream_t *astream, ra_metric_id id, uint64_t value) {
+    ra_metrics_add(&global_metrics, id, value);
+    if (astream) ra_metrics_add(&astream->metrics, id, value);
+}
+
+static void count_sent(ra_audio_stream_t *astream, ssize_t sent) {
+    if (sent <= 0) return;
+    count_metric(astream, RA_METRIC_PACKETS_SENT, 1);
+    count_metric(astream, RA_METRIC_BYTES_SENT, sent);
+}
+
+static void count_read_error(ra_audio_stream_t *astream, int err) {
+    count_metric(astream, err == RA_STREAM_ERR_REPLAYED ? RA_METRIC_REPLAYS_DROPPED : RA_METRIC_DECRYPT_FAILURES, 1);
+}
+
+// Only counters are touched here, the background thread reports them so the audio thread never does I/O
+static void observe_callback(ra_audio_stream_t *astream, uint64_t started) {
+    uint64_t elapsed = ra_clock_now_ns() - started;
+    ra_metrics_observe_ns(&astream->metrics.callback_duration, elapsed);
+    ra_metrics_observe_ns(&global_metrics.callback_duration, elapsed);
+    if (elapsed > astream->callback_budget_ns) count_metric(astream, RA_METRIC_CALLBACK_DEADLINE_MISSES, 1);
+}
+
+// Playout time of the buffer on the monotonic clock, the stream's latency stands in when the host API gives no timing
+static uint64_t dac_time_ns(const ra_audio_stream_t *astream,
+                            const struct PaStreamCallbackTimeInfo *timeinfo,
+                            uint64_t now) {
+    if (timeinfo && timeinfo->outputBufferDacTime > 0 && timeinfo->outputBufferDacTime >= timeinfo->currentTime)
+        return now + (uint64_t)((timeinfo->outputBufferDacTime - timeinfo->currentTime) * RA_NSEC_PER_SEC);
+    return now + astream->output_latency_ns;
+}
+
+static void write_comfort_noise(ra_audio_stream_t *astream, char *wptr) {
+    const ra_audio_config_t *cfg = &astream->audio_cfg;
+    if (cfg->sample_format != paFloat32) {
+        memset(wptr, 0, cfg->channel_count * cfg->sample_size);
+        return;
+    }
+    float *samples = (float *)wptr;
+    uint32_t x = astream->noise_seed;
+    for (int i = 0; i < cfg->channel_count; i++) {
+        // xorshift32, cheap enough for the audio thread
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        samples[i] = (int32_t)x / 2147483648.0f * COMFORT_NOISE_LEVEL;
+    }
+    astream->noise_seed = x;
+}
+
 static int audio_callback(const void *input,
                           void *output,
                           unsigned long fpb,
@@ -59,87 +234,305 @@ static int audio_callback(const void *input,
                           PaStreamCallbackFlags flags,
                           void *userdata) {
     static char reason[256] = {0};
+    uint64_t started = ra_clock_now_ns();
+    uint64_t trace_start = RA_TRACE_BEGIN();
     ra_audio_stream_t *astream = userdata;
     ra_audio_config_t cfg = astream->audio_cfg;
     ra_ringbuf_t *rb = astream->ringbuf;
 
     if (cfg.frame_size != fpb) {
         ra_stream_t *stream = astream->stream;
-        ra_logger_error(g_logger, "Stream %d: Frame size mismatch, %d != %zu", stream->id, cfg.frame_size, fpb);
-        audio_stream_close(astream);
+        ra_logger_error(g_logger, STREAM_LOG_PREFIX "Frame size mismatch, %d != %zu", stream->id, cfg.frame_size, fpb);
+        if (!atomic_exchange(&astream->failed, true)) stream_list_push(&failed_streams, astream, &astream->next_failed);
         return paAbort;
     }
+    RA_NO_ALLOC_BEGIN();
 
     size_t sz_frame = cfg.channel_count * cfg.sample_size;
     size_t sz_buffer = sz_frame * fpb;
     char *wptr = (char *)output;
     char *endptr = wptr + (sz_frame * fpb);
-
-    while (wptr < endptr) {
-        const char *rptr = ra_ringbuf_read_ptr(rb);
-        size_t rbytes = ra_min(ra_ringbuf_fill_count(rb), endptr - wptr);
-        if (rbytes < sz_buffer) {
-            for (int i = 0; i < sz_frame; i++) *wptr++ = 0;
-            continue;
+    bool underrun = false;
+
+    if (ra_ringbuf_fill_total(rb) >= sz_buffer) {
+        uint64_t read_start = RA_TRACE_BEGIN();
+        // Frame sizes don't have to divide the ring size, so a buffer may wrap around the end of the ring
+        while (wptr < endptr) {
+            size_t rbytes = ra_min(ra_ringbuf_fill_count(rb), endptr - wptr);
+            memcpy(wptr, ra_ringbuf_read_ptr(rb), rbytes);
+            ra_ringbuf_advance_read_ptr(rb, rbytes);
+            wptr += rbytes;
+        }
+        RA_TRACE_END(RA_TRACE_RING_READ, read_start);
+    }
+    if (wptr < endptr && astream->primed) astream->frames_concealed += (endptr - wptr) / sz_frame;
+    for (; wptr < endptr; wptr += sz_frame) {
+        if (astream->dtx) {
+            write_comfort_noise(astream, wptr);
+        } else {
+            memset(wptr, 0, sz_frame);
+            underrun = true;
         }
-        memcpy(wptr, rptr, rbytes);
-        ra_ringbuf_advance_read_ptr(rb, rbytes);
-        wptr += rbytes;
     }
+    if (underrun && astream->primed) {
+        RA_PROBE3(ring_underrun, astream->stream->id, ra_ringbuf_fill_total(rb), sz_buffer);
+        astream->underruns++;
+        count_metric(astream, RA_METRIC_RING_UNDERRUNS, 1);
+    }
+    if (flags & paOutputUnderflow) count_metric(astream, RA_METRIC_AUDIO_UNDERFLOWS, 1);
+    if (flags & paOutputOverflow) count_metric(astream, RA_METRIC_AUDIO_OVERFLOWS, 1);
+
+    uint64_t next_dac = dac_time_ns(astream, timeinfo, started) + fpb * RA_NSEC_PER_SEC / cfg.sample_rate;
+    atomic_store_explicit(&astream->next_dac_ns, next_dac, memory_order_relaxed);
 
+    RA_TRACE_END(RA_TRACE_AUDIO_CALLBACK, trace_start);
+    observe_callback(astream, started);
+    RA_NO_ALLOC_END();
     return paContinue;
 }
 
-static ra_audio_stream_t *audio_stream_create(uint8_t id, size_t bufsize) {
+static ra_audio_stream_t *audio_stream_create(uint32_t id, size_t bufsize) {
     ra_audio_stream_t *astream = malloc(sizeof(ra_audio_stream_t));
-    astream->ringbuf = ra_ringbuf_create(RING_BUFFER_SIZE);
+    astream->ringbuf = NULL;
     astream->stream = ra_stream_create(id);
     astream->state = 0;
     astream->conn.sock = -1;
+    astream->group_sock = -1;
+    astream->recording = NULL;
+    astream->audio = NULL;
+    astream->decoder = NULL;
+    astream->handshaking = false;
+    astream->failed = false;
+    ra_metrics_init(&astream->metrics);
+    astream->reported_misses = 0;
+    astream->reported_callbacks = 0;
     astream->conn.addr = (struct sockaddr *)&astream->_addr;
     astream->conn.addrlen = sizeof(astream->_addr);
     return astream;
 }
 
-static int audio_stream_open(ra_audio_stream_t *astream, ra_audio_config_t *cfg, const ra_conn_t *conn) {
-    if (astream->state == 1) return 0;
+// The first slots get their stream state, ring and decoder up front, sized for what sources most likely send to the
+// output device. A source sending that format then gets served without any allocation, reopening included.
+static int audio_streams_preallocate(const ra_audio_config_t *device_cfg) {
+    ra_audio_config_t cfg = *device_cfg;
+    if (!cfg.sample_rate) cfg.sample_rate = POOL_SAMPLE_RATE;
+    if (!cfg.sample_format) cfg.sample_format = paFloat32;
+    cfg.sample_size = ra_audio_sample_format_size(cfg.sample_format);
+    ra_channel_layout_t layout;
+    int mapping_family = cfg.channel_count > 8 ? RA_MAPPING_FAMILY_DISCRETE : RA_MAPPING_FAMILY_SURROUND;
+    ra_channel_layout_init(&layout, cfg.channel_count, mapping_family, 0);
+
+    size_t count = ra_min(PREALLOCATED_STREAMS, ra_session_table_capacity(audio_streams));
+    if (ra_session_table_reserve(audio_streams, count)) return -1;
+    for (size_t i = 0; i < count; i++) {
+        ra_audio_stream_t *astream = audio_stream_create(RA_SESSION_ID_NONE, BUFSIZE);
+        ra_session_table_set(audio_streams, i, astream);
+        astream->ringbuf = ra_ringbuf_create(RING_BUFFER_FRAMES * cfg.channel_count * cfg.sample_size);
+        if (sink->recorder) continue;
+        int err;
+        astream->decoder = ra_decoder_create(&cfg, &layout, sink->decode_workers, &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to create Opus decoder, error %d: %s", err, opus_strerror(err));
+            return err;
+        }
+    }
+    return 0;
+}
 
-    PaStream *pa_stream = ra_audio_create_stream(cfg, audio_callback, astream);
-    if (!pa_stream) {
+static void audio_stream_leave_group(ra_audio_stream_t *astream) {
+    if (astream->group_sock < 0) return;
+    ra_audio_stream_t *last = joined_groups[--joined_count];
+    joined_groups[astream->group_index] = last;
+    last->group_index = astream->group_index;
+    ra_socket_close(astream->group_sock);
+    astream->group_sock = -1;
+}
+
+static int audio_stream_join_group(ra_audio_stream_t *astream, const struct sockaddr_in *addr) {
+    if (joined_count >= MAX_GROUP_SOCKETS) return -1;
+    SOCKET sock = ra_multicast_open(addr);
+    if (sock < 0) return -1;
+    if (!RA_SOCKET_SELECTABLE(sock)) {
+        ra_socket_close(sock);
         return -1;
     }
+    astream->group_sock = sock;
+    astream->group_index = joined_count;
+    joined_groups[joined_count++] = astream;
+    return 0;
+}
+
+// Releases what only the main thread touches, streams closed by the other threads are released from the main loop
+static void audio_stream_release(ra_audio_stream_t *astream) {
+    audio_stream_leave_group(astream);
+    if (astream->recording) {
+        ra_recording_close(astream->recording);
+        astream->recording = NULL;
+    }
+}
+
+static int audio_stream_open_recording(ra_audio_stream_t *astream,
+                                       ra_audio_config_t *cfg,
+                                       const ra_channel_layout_t *layout) {
+    char path[512];
+    char timestr[32];
+    struct tm now;
+    ra_clock_localtime(time(NULL), &now);
+    strftime(timestr, sizeof(timestr), "%Y%m%d-%H%M%S", &now);
+    snprintf(path, sizeof(path), "%s/stream-%u-%s", sink->record_dir, astream->stream->id, timestr);
 
     int err;
-    OpusDecoder *decoder = opus_decoder_create(cfg->sample_rate, cfg->channel_count, &err);
+    cfg->sample_size = ra_audio_sample_format_size(cfg->sample_format);
+    astream->recording = ra_recording_open(sink->recorder, path, cfg, layout, sink->record_wav, &err);
     if (err) {
-        ra_logger_error(g_logger, "Failed to create Opus decoder, error %d: %s", err, opus_strerror(err));
+        ra_logger_error(g_logger, "Failed to open recording %s, error %d", path, err);
         return err;
     }
+    ra_logger_info(g_logger, STREAM_LOG_PREFIX "Recording to %s.opus", astream->stream->id, path);
+    return 0;
+}
+
+// Runs on the handshake worker, on a slot the main loop already released. Leaving groups and closing recordings stay
+// with the main thread.
+static int audio_stream_open(ra_audio_stream_t *astream,
+                             ra_audio_config_t *cfg,
+                             const ra_channel_layout_t *layout,
+                             const ra_conn_t *conn) {
+    if (astream->state == 1) return 0;
+
+    int err;
+    ra_audio_handle_t *audio = NULL;
+    if (sink->recorder) {
+        if (audio_stream_open_recording(astream, cfg, layout)) return -1;
+    } else {
+        // The slot's decoder is started over when the source codes the same layout, only a new one allocates
+        if (astream->decoder && ra_decoder_reset(astream->decoder, cfg, layout)) {
+            ra_decoder_destroy(astream->decoder);
+            astream->decoder = NULL;
+        }
+        if (!astream->decoder) {
+            astream->decoder = ra_decoder_create(cfg, layout, sink->decode_workers, &err);
+            if (err) {
+                ra_logger_error(g_logger, "Failed to create Opus decoder, error %d: %s", err, opus_strerror(err));
+                return err;
+            }
+        }
+
+        audio = ra_audio_create_stream(cfg, audio_callback, astream);
+        if (!audio) return -1;
+    }
 
-    astream->state = 1;
-    astream->decoder = decoder;
-    astream->pa_stream = pa_stream;
+    // Size the ring for the stream's frame size, keeping the previous one when it matches
+    size_t rbsize = RING_BUFFER_FRAMES * cfg->channel_count * cfg->sample_size;
+    if (astream->ringbuf && ra_ringbuf_size(astream->ringbuf) != rbsize) {
+        ra_ringbuf_destroy(astream->ringbuf);
+        astream->ringbuf = NULL;
+    }
+    if (!astream->ringbuf) astream->ringbuf = ra_ringbuf_create(rbsize);
+
+    astream->audio = audio;
     astream->audio_cfg = *cfg;
     astream->conn.sock = conn->sock;
     memcpy(&astream->_addr, conn->addr, conn->addrlen);
     astream->last_update = time(NULL);
+    astream->last_report = astream->last_update;
+    astream->primed = false;
+    astream->failed = false;
+    astream->underruns = 0;
+    astream->dtx = false;
+    astream->noise_seed = 0x9e3779b9;
+    astream->output_latency_ns = ra_audio_stream_latency(audio) * RA_NSEC_PER_SEC;
+    astream->next_dac_ns = 0;
+    ra_clock_sync_reset(&astream->clock_sync);
+    astream->callback_budget_ns = cfg->frame_size * RA_NSEC_PER_SEC / cfg->sample_rate * sink->callback_budget / 100;
+    astream->session_started = astream->last_update;
+    astream->session_started_ns = ra_clock_now_ns();
+    astream->frames_received = 0;
+    astream->data_packets = 0;
+    astream->session_bytes = 0;
+    astream->decode_ns = 0;
+    astream->decodes = 0;
+    astream->frames_concealed = 0;
+    ra_jitter_histogram_reset(&astream->jitter);
 
     ra_ringbuf_reset(astream->ringbuf);
     ra_stream_reset(astream->stream);
+    ra_receiver_stats_reset(&astream->stats, cfg->sample_rate);
+    // Published last, the other threads only touch the stream once they see it open
+    atomic_store_explicit(&astream->state, 1, memory_order_release);
     return 0;
 }
 
-static void audio_stream_close(ra_audio_stream_t *astream) {
-    if (astream->state == 0) return;
+// Sequence numbers missing from the ones received, counted in frames at the session's average packet size
+static uint64_t session_frames_lost(const ra_audio_stream_t *astream) {
+    const ra_receiver_stats_t *stats = &astream->stats;
+    if (!stats->received || !astream->data_packets) return 0;
+    uint64_t expected = stats->highest_nonce - stats->base_nonce + 1;
+    if (expected <= stats->received) return 0;
+    return (expected - stats->received) * astream->frames_received / astream->data_packets;
+}
 
-    astream->state = 0;
-    opus_decoder_destroy(astream->decoder);
-    Pa_StopStream(astream->pa_stream);
-    Pa_CloseStream(astream->pa_stream);
+static void journal_session(ra_audio_stream_t *astream, const char *reason) {
+    if (!journal) return;
+    ra_session_record_t record = {
+        .start_time = astream->session_started,
+        .stream_id = astream->stream->id,
+        .reason = reason,
+        .duration_ms = (ra_clock_now_ns() - astream->session_started_ns) / RA_NSEC_PER_MSEC,
+        .frames_received = astream->frames_received,
+        .frames_lost = session_frames_lost(astream),
+        .frames_concealed = astream->frames_concealed,
+        .bytes_received = astream->session_bytes,
+        .jitter_mean_us = ra_jitter_histogram_mean(&astream->jitter),
+        .jitter_p99_us = ra_jitter_histogram_quantile(&astream->jitter, 0.99),
+        .underruns = astream->underruns,
+        .decode_avg_us = astream->decodes ? astream->decode_ns / astream->decodes / RA_NSEC_PER_USEC : 0,
+    };
+    ra_sockaddr_str(record.source, &astream->_addr);
+    if (ra_journal_append(journal, &record))
+        ra_logger_warn(g_logger, STREAM_LOG_PREFIX "Journal queue full, session record dropped", record.stream_id);
+}
+
+// Streams get closed from the main and background threads, only the first close ends the session. Closing takes the
+// journal's lock, so the audio thread flags its stream for the main loop instead. The slot is queued for the main loop
+// to release once the audio stream is gone, the callback can't flag it any more by then.
+static void audio_stream_close(ra_audio_stream_t *astream, const char *reason) {
+    if (atomic_exchange(&astream->state, 0) == 0) return;
+
+    journal_session(astream, reason);
+    ra_audio_close_stream(astream->audio);
+    astream->audio = NULL;
+    stream_list_push(&closed_streams, astream, &astream->next_closed);
+}
+
+// Closed slots are handed back here, no other thread acquires or releases them. The failed streams are taken after the
+// closed ones, so every flag raised before a stream was closed is dealt with before its slot gets reused.
+static void release_closed_streams() {
+    ra_audio_stream_t *closed = atomic_exchange_explicit(&closed_streams, NULL, memory_order_acquire);
+    ra_audio_stream_t *failed = atomic_exchange_explicit(&failed_streams, NULL, memory_order_acquire);
+    while (failed) {
+        ra_audio_stream_t *next = failed->next_failed;
+        if (failed->state > 0) audio_stream_close(failed, "error");
+        failed = next;
+    }
+    while (closed) {
+        ra_audio_stream_t *next = closed->next_closed;
+        // Its slot stays taken until the handshake's result is collected
+        if (closed->handshaking) {
+            stream_list_push(&closed_streams, closed, &closed->next_closed);
+        } else {
+            audio_stream_release(closed);
+            ra_session_table_release(audio_streams, closed->stream->id);
+        }
+        closed = next;
+    }
 }
 
 static void audio_stream_destroy(ra_audio_stream_t *astream) {
-    audio_stream_close(astream);
+    audio_stream_close(astream, "shutdown");
+    audio_stream_release(astream);
+    ra_decoder_destroy(astream->decoder);
+    if (astream->ringbuf) ra_ringbuf_destroy(astream->ringbuf);
     ra_stream_destroy(astream->stream);
     free(astream);
 }
@@ -151,40 +544,112 @@ static void send_handshake_response(ra_audio_stream_t *astream, const ra_keypair
         .cap = sizeof(rawbuf),
     };
     create_handshake_response_message(&buf, astream->stream->id, keypair);
-    ra_buf_sendto(&astream->conn, (ra_rbuf_t *)&buf);
+    count_sent(astream, ra_buf_sendto(&astream->conn, (ra_rbuf_t *)&buf));
 }
 
 static void send_stream_signal(ra_audio_stream_t *astream, const ra_rbuf_t *message) {
-    ra_stream_send(astream->stream, &astream->conn, message);
+    count_sent(astream, ra_stream_send(astream->stream, &astream->conn, message));
 }
 
 static void send_stream_heartbeat(ra_audio_stream_t *astream) {
     send_stream_signal(astream, ra_stream_heartbeat_message);
 }
 
+static void send_stream_clock(ra_audio_stream_t *astream) {
+    char rawbuf[32];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    ra_stream_clock_t clock = {.origin_ns = ra_clock_now_ns(), .remote_ns = 0};
+    create_stream_clock_message(&buf, &clock);
+    send_stream_signal(astream, (ra_rbuf_t *)&buf);
+}
+
 static void send_stream_terminate(ra_audio_stream_t *astream) {
     send_stream_signal(astream, ra_stream_terminate_message);
 }
 
-static void handle_stream_data(ra_handler_context_t *ctx, ra_audio_stream_t *astream) {
+static void send_stream_report(ra_audio_stream_t *astream) {
+    char rawbuf[64];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+
+    ra_audio_config_t cfg = astream->audio_cfg;
+    size_t sz_frame = cfg.channel_count * cfg.sample_size;
+    size_t buffered = sz_frame > 0 ? ra_ringbuf_fill_total(astream->ringbuf) / sz_frame : 0;
+
+    ra_stream_report_t report;
+    ra_receiver_stats_fill_report(&astream->stats, &report);
+    report.buffer_ms = cfg.sample_rate > 0 ? buffered * 1000 / cfg.sample_rate : 0;
+    report.underruns = astream->underruns;
+    ra_metrics_set(&astream->metrics, RA_METRIC_BUFFER_MS, report.buffer_ms);
+    create_stream_report_message(&buf, &report);
+    send_stream_signal(astream, (ra_rbuf_t *)&buf);
+}
+
+// When a frame written to the ring now gets played, 0 until the audio callback has run
+static uint64_t playout_time_ns(ra_audio_stream_t *astream) {
+    const ra_audio_config_t *cfg = &astream->audio_cfg;
+    size_t sz_frame = cfg->channel_count * cfg->sample_size;
+    uint64_t next_dac;
+    size_t queued;
+    // Both change with every callback, so read them again should one have run in between
+    do {
+        next_dac = atomic_load(&astream->next_dac_ns);
+        queued = ra_ringbuf_fill_total(astream->ringbuf);
+    } while (next_dac != atomic_load(&astream->next_dac_ns));
+    if (!next_dac) return 0;
+    return next_dac + queued / sz_frame * RA_NSEC_PER_SEC / cfg->sample_rate;
+}
+
+static void update_latency(ra_audio_stream_t *astream, const ra_rbuf_t *rbuf, uint64_t playout_ns) {
+    ra_clock_sample_t clock;
+    if (!(rbuf->base[6] & STREAM_DATA_FLAG_CAPTURE_TIME) || !playout_ns) return;
+    if (ra_clock_sync_get(&astream->clock_sync, &clock)) return;
+    uint64_t capture_ns = bytes_to_uint64(rbuf->base + STREAM_DATA_HEADER_SIZE) + clock.offset_ns;
+    uint64_t latency_us = playout_ns > capture_ns ? (playout_ns - capture_ns) / RA_NSEC_PER_USEC : 0;
+    ra_metrics_set(&astream->metrics, RA_METRIC_LATENCY_US, latency_us);
+}
+
+static void handle_stream_data(ra_handler_context_t *ctx, ra_audio_stream_t *astream, const ra_stream_t *stream) {
     static float pcm[DECODE_BUFFER_SIZE];
 
     const ra_rbuf_t *rbuf = ctx->buf;
-    if (rbuf->len < 2) return;
+    size_t sz_header = stream_data_header_size(rbuf);
+    if (rbuf->len < sz_header) return;
     uint16_t fpb = bytes_to_uint16(rbuf->base);
+    uint32_t timestamp = bytes_to_uint32(rbuf->base + 2);
+    ra_receiver_stats_update_jitter(&astream->stats, timestamp, ra_clock_now_us());
+    ra_jitter_histogram_add(&astream->jitter, (uint32_t)astream->stats.jitter_us);
+    astream->frames_received += fpb;
+    astream->data_packets++;
+
+    uint32_t stream_id = astream->stream->id;
+    if (astream->recording) {
+        const unsigned char *packet = (unsigned char *)rbuf->base + sz_header;
+        if (ra_recording_write(astream->recording, packet, rbuf->len - sz_header, fpb))
+            ra_logger_error(g_logger, STREAM_LOG_PREFIX "Recording queue overflow!", stream_id);
+        return;
+    }
 
-    uint8_t stream_id = astream->stream->id;
-    OpusDecoder *dec = astream->decoder;
-    int samples = opus_decode_float(dec, (unsigned char *)rbuf->base + 2, rbuf->len - 2, pcm, fpb, 0);
+    ra_decoder_t *dec = astream->decoder;
+    const unsigned char *data = (unsigned char *)rbuf->base + sz_header;
+    if (fpb > MAX_FRAME_SIZE) return;
+    RA_PROBE4(decode_start, stream_id, stream->last_nonce, timestamp, rbuf->len - sz_header);
+    uint64_t decode_start = ra_clock_now_ns();
+    int samples = ra_decode_float(dec, data, rbuf->len - sz_header, pcm, fpb, 0);
+    astream->decode_ns += ra_clock_now_ns() - decode_start;
+    astream->decodes++;
+    RA_PROBE3(decode_done, stream_id, timestamp, samples);
     if (samples <= 0) {
-        if (samples < 0)
+        if (samples < 0) {
+            count_metric(astream, RA_METRIC_DECODE_ERRORS, 1);
             ra_logger_error(g_logger,
                             STREAM_LOG_PREFIX "Opus decode error %d: %s",
                             stream_id,
                             samples,
                             opus_strerror(samples));
+        }
         return;
     } else if (fpb != samples) {
+        count_metric(astream, RA_METRIC_DECODE_ERRORS, 1);
         ra_logger_error(g_logger, STREAM_LOG_PREFIX "Decoded sample count mismatch, %d != %d", stream_id, fpb, samples);
         return;
     }
@@ -193,10 +658,15 @@ static void handle_stream_data(ra_handler_context_t *ctx, ra_audio_stream_t *ast
     const char *rptr = (char *)pcm;
     const char *endptr = rptr + (cfg.channel_count * cfg.sample_size * samples);
     ra_ringbuf_t *rb = astream->ringbuf;
+    uint64_t playout_ns = playout_time_ns(astream);
+    uint64_t trace_start = RA_TRACE_BEGIN();
     while (rptr < endptr) {
         char *wptr = ra_ringbuf_write_ptr(rb);
         size_t wbytes = ra_min(ra_ringbuf_free_count(rb), endptr - rptr);
         if (wbytes <= 0) {
+            RA_PROBE3(ring_overflow, stream_id, timestamp, endptr - rptr);
+            RA_TRACE_END(RA_TRACE_RING_WRITE, trace_start);
+            count_metric(astream, RA_METRIC_RING_OVERFLOWS, 1);
             ra_logger_error(g_logger, STREAM_LOG_PREFIX "Ring buffer overflow!", stream_id);
             return;
         }
@@ -204,107 +674,406 @@ static void handle_stream_data(ra_handler_context_t *ctx, ra_audio_stream_t *ast
         ra_ringbuf_advance_write_ptr(rb, wbytes);
         rptr += wbytes;
     }
+    RA_TRACE_END(RA_TRACE_RING_WRITE, trace_start);
+    update_latency(astream, rbuf, playout_ns);
+    astream->primed = true;
+    astream->dtx = (rbuf->base[6] & STREAM_DATA_FLAG_DTX) != 0;
 }
 
 static void handle_stream_terminate(ra_handler_context_t *ctx, ra_audio_stream_t *astream) {
-    audio_stream_close(astream);
+    audio_stream_close(astream, "terminated");
     ra_logger_info(g_logger, STREAM_LOG_PREFIX "Terminated due to signal from source", astream->stream->id);
 }
 
-static void handle_handshake_init(ra_handler_context_t *ctx) {
-    const ra_rbuf_t *rbuf = ctx->buf;
-    if (rbuf->len < 1) return;
-
-    uint8_t id;
-    ra_audio_stream_t **astream_ptr = NULL;
-    for (id = 0; id < MAX_STREAMS; id++) {
-        astream_ptr = &audio_streams[id];
-        ra_audio_stream_t *astream = *astream_ptr;
-        if (astream == NULL || astream->state == 0) break;
-        astream_ptr = NULL;
+static void handle_stream_group(ra_handler_context_t *ctx, ra_audio_stream_t *astream) {
+    ra_stream_group_t group;
+    if (read_stream_group_message(&group, ctx->buf)) return;
+    uint32_t stream_id = astream->stream->id;
+    if (!IN_MULTICAST(ntohl(group.addr.sin_addr.s_addr))) {
+        ra_logger_error(g_logger, STREAM_LOG_PREFIX "Source sent an invalid multicast group", stream_id);
+        return;
     }
-    if (astream_ptr == NULL) {
-        ra_logger_error(g_logger, "Can't accept any more audio stream");
+
+    // The group is announced periodically, only rejoin when it changes
+    ra_stream_group_t *current = &astream->group;
+    if (astream->group_sock >= 0 && current->addr.sin_addr.s_addr == group.addr.sin_addr.s_addr &&
+        current->addr.sin_port == group.addr.sin_port && current->stream_id == group.stream_id &&
+        memcmp(current->secret, group.secret, sizeof(group.secret)) == 0)
+        return;
+
+    audio_stream_leave_group(astream);
+    *current = group;
+    ra_stream_init(&astream->group_stream, group.stream_id);
+    memcpy(astream->group_stream.secret, group.secret, sizeof(group.secret));
+
+    static char straddr[32];
+    ra_sockaddr_str(straddr, &group.addr);
+    if (audio_stream_join_group(astream, &group.addr)) {
+        ra_logger_error(g_logger, STREAM_LOG_PREFIX "Failed to join multicast group %s", stream_id, straddr);
         return;
-    } else if (*astream_ptr == NULL) {
-        *astream_ptr = audio_stream_create(id, BUFSIZE);
     }
-    ra_audio_stream_t *astream = *astream_ptr;
-    ra_stream_t *stream = astream->stream;
+    ra_logger_info(g_logger, STREAM_LOG_PREFIX "Joined multicast group %s", stream_id, straddr);
+    ra_receiver_stats_reset(&astream->stats, astream->audio_cfg.sample_rate);
+}
 
+// Decrypts into a packet from the pool, returning NULL once the error got counted
+static ra_packet_t *read_payload(ra_audio_stream_t *astream, ra_stream_t *stream, const char *src, size_t len) {
+    ra_packet_t *pkt = ra_packet_alloc(sink->payloads);
+    if (!pkt) {
+        ra_logger_error(g_logger, "Payload pool exhausted, dropping packet");
+        return NULL;
+    }
+    ra_buf_t readbuf = {
+        .base = pkt->data,
+        .len = 0,
+        .cap = ra_packet_tailroom(pkt),
+    };
+    RA_NO_ALLOC_BEGIN();
+    int err = ra_stream_read(stream, &readbuf, src, len);
+    RA_NO_ALLOC_END();
+    if (err) {
+        count_read_error(astream, err);
+        ra_packet_release(pkt);
+        return NULL;
+    }
+    ra_packet_put(pkt, readbuf.len);
+    return pkt;
+}
+
+// Stream data sent to the multicast group, encrypted with the group key instead of the stream's own
+static void handle_group_message(ra_handler_context_t *ctx, ra_audio_stream_t *astream) {
+    const ra_rbuf_t *rbuf = ctx->buf;
+    if (rbuf->len < 1 + RA_STREAM_ID_SIZE || astream->state <= 0) return;
     const char *rptr = rbuf->base;
     const char *endptr = rptr + rbuf->len;
+    if ((ra_message_type)*rptr++ != RA_MESSAGE_CRYPTO) return;
+
+    ra_stream_t *stream = &astream->group_stream;
+    if (bytes_to_uint32(rptr) != stream->id) return;
+    rptr += RA_STREAM_ID_SIZE;
+    ra_metrics_add(&astream->metrics, RA_METRIC_PACKETS_RECEIVED, 1);
+    ra_metrics_add(&astream->metrics, RA_METRIC_BYTES_RECEIVED, rbuf->len);
+    astream->session_bytes += rbuf->len;
+    ra_packet_t *pkt = read_payload(astream, stream, rptr, endptr - rptr);
+    if (!pkt) return;
+    ra_receiver_stats_update(&astream->stats, stream->last_nonce);
+    if (pkt->len < 1 || (ra_crypto_type)*pkt->data != RA_STREAM_DATA) {
+        ra_packet_release(pkt);
+        return;
+    }
+    astream->last_update = time(NULL);
 
-    // Compute shared secret
-    size_t keysize = *rptr++;
-    if (rptr + keysize > endptr) return;
-    const ra_keypair_t *keypair = sink->keypair;
-    int err = ra_compute_shared_secret(stream->secret,
-                                       sizeof(stream->secret),
-                                       (unsigned char *)rptr,
-                                       keysize,
-                                       keypair,
-                                       RA_SHARED_SECRET_SERVER);
+    ra_packet_pull(pkt, 1);
+    ra_rbuf_t data_buf = ra_packet_rbuf(pkt);
+    ra_handler_context_t data_ctx = {
+        .conn = ctx->conn,
+        .buf = &data_buf,
+    };
+    RA_NO_ALLOC_BEGIN();
+    handle_stream_data(&data_ctx, astream, stream);
+    RA_NO_ALLOC_END();
+    ra_packet_release(pkt);
+}
+
+// Cookies are bound to the address they were sent to, a spoofed source never gets to see its cookie
+static size_t cookie_peer(unsigned char *peer, const ra_conn_t *conn) {
+    const struct sockaddr_in *addr = (const struct sockaddr_in *)conn->addr;
+    memcpy(peer, &addr->sin_addr, 4);
+    memcpy(peer + 4, &addr->sin_port, 2);
+    return 6;
+}
+
+static bool handshake_cookie_valid(const ra_handshake_t *hs, const ra_conn_t *conn) {
+    unsigned char peer[6];
+    size_t peerlen = cookie_peer(peer, conn);
+    uint64_t epoch = time(NULL) / COOKIE_EPOCH_SECONDS;
+    return ra_verify_cookie(hs->cookie, hs->cookielen, cookie_key, peer, peerlen, epoch) == 0;
+}
+
+static void send_handshake_cookie(const ra_conn_t *conn) {
+    unsigned char peer[6], cookie[COOKIE_SIZE];
+    size_t peerlen = cookie_peer(peer, conn);
+    ra_compute_cookie(cookie, cookie_key, peer, peerlen, time(NULL) / COOKIE_EPOCH_SECONDS);
+
+    char rawbuf[64];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    create_handshake_cookie_message(&buf, cookie, sizeof(cookie));
+    count_sent(NULL, ra_buf_sendto(conn, (ra_rbuf_t *)&buf));
+}
+
+// Keyed so sources can't pick addresses and keys that pile up in one bucket of the session table
+static uint64_t source_hash(const ra_conn_t *conn, const unsigned char *key) {
+    unsigned char in[6 + PUBLIC_KEY_SIZE], out[crypto_shorthash_BYTES];
+    size_t peerlen = cookie_peer(in, conn);
+    memcpy(in + peerlen, key, PUBLIC_KEY_SIZE);
+    crypto_shorthash(out, in, peerlen + PUBLIC_KEY_SIZE, source_hash_key);
+    return bytes_to_uint64((const char *)out);
+}
+
+// The session a source already has from the same address and key, the hash alone doesn't make it the same source
+static ra_audio_stream_t *find_source_session(const ra_handshake_t *hs, const ra_conn_t *conn, uint64_t hash) {
+    uint32_t id = ra_session_table_find(audio_streams, hash);
+    ra_audio_stream_t *astream = id != RA_SESSION_ID_NONE ? ra_session_table_lookup(audio_streams, id) : NULL;
+    if (!astream) return NULL;
+    const struct sockaddr_in *addr = (const struct sockaddr_in *)conn->addr;
+    if (astream->source_addr.sin_addr.s_addr != addr->sin_addr.s_addr) return NULL;
+    if (astream->source_addr.sin_port != addr->sin_port) return NULL;
+    return memcmp(astream->source_key, hs->key, PUBLIC_KEY_SIZE) == 0 ? astream : NULL;
+}
+
+// A source that didn't hear back retries the same handshake, answering it from the open session keeps the slot,
+// decoder and device stream instead of opening them all over again. Returns false when it takes a new session.
+static bool resume_handshake(ra_audio_stream_t *astream, const ra_handshake_t *hs) {
+    // Still with the worker, which answers it once the stream is open
+    if (astream->handshaking) return true;
+
+    // Only the fields a handshake carries, the rest of the stored config is ours and padding may differ
+    ra_handshake_t opened = {.cfg = astream->source_cfg, .layout = astream->source_layout};
+    bool same = ra_handshake_config_equal(&opened, hs);
+    if (same && astream->state > 0) {
+        ra_metrics_add(&global_metrics, RA_METRIC_HANDSHAKES_RESUMED, 1);
+        ra_metrics_add(&astream->metrics, RA_METRIC_HANDSHAKES_RESUMED, 1);
+        ra_logger_info(g_logger, STREAM_LOG_PREFIX "Resumed for source", astream->stream->id);
+        astream->last_update = time(NULL);
+        send_handshake_response(astream, sink->keypair);
+        send_stream_clock(astream);
+        return true;
+    }
+
+    // Reconfigured or already closed, the old session goes the usual way and stops answering for the source
+    ra_session_table_unbind(audio_streams, astream->stream->id);
+    audio_stream_close(astream, "reconnected");
+    return false;
+}
+
+// Runs on the handshake worker, the stream only becomes visible to the other threads once it's opened
+static int accept_handshake(ra_handshake_job_t *job) {
+    ra_audio_stream_t *astream = job->astream;
+    ra_stream_t *stream = astream->stream;
+    int err = ra_compute_shared_secret(
+        stream->secret, sizeof(stream->secret), job->key, sizeof(job->key), sink->keypair, RA_SHARED_SECRET_SERVER);
     if (err) {
-        ra_logger_error(g_logger, STREAM_LOG_PREFIX "Key exchange failed", id);
+        ra_logger_error(g_logger, STREAM_LOG_PREFIX "Key exchange failed", job->id);
+        return err;
+    }
+
+    ra_conn_t conn = {.sock = sock, .addr = (struct sockaddr *)&job->addr, .addrlen = sizeof(job->addr)};
+    if (audio_stream_open(astream, &job->cfg, &job->layout, &conn)) {
+        ra_logger_error(g_logger, STREAM_LOG_PREFIX "Failed to initialize audio stream", job->id);
+        return -1;
+    }
+    if (astream->audio) ra_audio_start_stream(astream->audio);
+    return 0;
+}
+
+static void handshake_thread(void *arg) {
+    // Key agreement and device setup can wait on the receive loop, so it runs a notch below it like the background
+    ra_realtime_apply(g_logger, &sink->realtime, "sink-handshake", 1, sink->background_cpu);
+    ra_trace_set_thread_name("handshake");
+    ra_handshake_job_t job;
+    ra_mutex_lock(&handshaker.mutex);
+    for (;;) {
+        while (handshaker.running && handshaker.pending_count == 0) ra_cond_wait(&handshaker.cond, &handshaker.mutex);
+        if (!handshaker.running) break;
+        job = handshaker.pending[handshaker.pending_head];
+        handshaker.pending_head = (handshaker.pending_head + 1) % HANDSHAKE_QUEUE_SIZE;
+        handshaker.pending_count--;
+        ra_mutex_unlock(&handshaker.mutex);
+
+        job.err = accept_handshake(&job);
+        ra_mutex_lock(&handshaker.mutex);
+        handshaker.done[(handshaker.done_head + handshaker.done_count) % HANDSHAKE_QUEUE_SIZE] = job;
+        handshaker.done_count++;
+    }
+    ra_mutex_unlock(&handshaker.mutex);
+}
+
+static int handshaker_start() {
+    handshaker.running = true;
+    handshaker.pending_head = handshaker.pending_count = 0;
+    handshaker.done_head = handshaker.done_count = 0;
+    handshaker.in_flight = 0;
+    int err = ra_mutex_init(&handshaker.mutex);
+    if (!err) err = ra_cond_init(&handshaker.cond);
+    if (!err) handshaker.thread = ra_thread_start(&handshake_thread, NULL, &err);
+    if (err) handshaker.thread = 0;
+    return err;
+}
+
+// Jobs still queued are dropped, their streams get destroyed along with every other one
+static void handshaker_stop() {
+    if (!handshaker.thread) return;
+    ra_mutex_lock(&handshaker.mutex);
+    handshaker.running = false;
+    ra_cond_signal(&handshaker.cond);
+    ra_mutex_unlock(&handshaker.mutex);
+
+    ra_thread_join(handshaker.thread);
+    ra_thread_destroy(handshaker.thread);
+    handshaker.thread = 0;
+    ra_cond_destroy(&handshaker.cond);
+    ra_mutex_destroy(&handshaker.mutex);
+}
+
+static void handshaker_submit(const ra_handshake_job_t *job) {
+    ra_mutex_lock(&handshaker.mutex);
+    handshaker.pending[(handshaker.pending_head + handshaker.pending_count) % HANDSHAKE_QUEUE_SIZE] = *job;
+    handshaker.pending_count++;
+    ra_cond_signal(&handshaker.cond);
+    ra_mutex_unlock(&handshaker.mutex);
+    handshaker.in_flight++;
+}
+
+static void finish_handshake(const ra_handshake_job_t *job) {
+    ra_audio_stream_t *astream = job->astream;
+    astream->handshaking = false;
+    if (job->err) {
+        ra_metrics_add(&global_metrics, RA_METRIC_HANDSHAKES_REJECTED, 1);
+        ra_session_table_release(audio_streams, job->id);
         return;
     }
-    rptr += keysize;
+    ra_metrics_add(&astream->metrics, RA_METRIC_HANDSHAKES, 1);
+    RA_PROBE3(handshake_accepted, job->id, job->cfg.channel_count, job->cfg.sample_rate);
 
-    // Read audio config from handshake packet
-    ra_audio_config_t cfg = *sink->audio_cfg;
-    if (rptr + 8 <= endptr) {
-        cfg.channel_count = *rptr++;
-        cfg.sample_format = *rptr++;
-        cfg.frame_size = bytes_to_uint16(rptr);
-        cfg.sample_rate = bytes_to_uint32(rptr + 2);
+    static char straddr[32];
+    ra_sockaddr_str(straddr, (struct sockaddr_in *)&job->addr);
+    ra_logger_info(g_logger, STREAM_LOG_PREFIX "Opened for source from %s", job->id, straddr);
+    send_handshake_response(astream, sink->keypair);
+    send_stream_clock(astream);
+}
+
+// Publishes what the worker finished to the receive thread, which alone sends the responses and owns the slots
+static void collect_handshakes() {
+    ra_handshake_job_t job;
+    while (handshaker.in_flight > 0) {
+        ra_mutex_lock(&handshaker.mutex);
+        bool found = handshaker.done_count > 0;
+        if (found) {
+            job = handshaker.done[handshaker.done_head];
+            handshaker.done_head = (handshaker.done_head + 1) % HANDSHAKE_QUEUE_SIZE;
+            handshaker.done_count--;
+        }
+        ra_mutex_unlock(&handshaker.mutex);
+        if (!found) return;
+        handshaker.in_flight--;
+        finish_handshake(&job);
     }
+}
 
+static void handle_handshake_init(ra_handler_context_t *ctx) {
+    const ra_rbuf_t *rbuf = ctx->buf;
     const ra_conn_t *conn = ctx->conn;
-    if (audio_stream_open(astream, &cfg, conn)) {
-        ra_logger_error(g_logger, STREAM_LOG_PREFIX "Failed to initialize audio stream", id);
+    RA_PROBE1(handshake_init, rbuf->len);
+
+    static char straddr[32];
+    ra_handshake_t hs = {.cfg = *sink->audio_cfg};
+    if (read_handshake_message(&hs, rbuf) || hs.keylen != PUBLIC_KEY_SIZE) {
+        ra_metrics_add(&global_metrics, RA_METRIC_HANDSHAKES_REJECTED, 1);
+        ra_sockaddr_str(straddr, (struct sockaddr_in *)conn->addr);
+        ra_logger_error(g_logger, "Invalid handshake from %s, unsupported audio config or channel layout", straddr);
         return;
     }
 
-    static char straddr[32];
-    ra_sockaddr_str(straddr, (struct sockaddr_in *)conn->addr);
-    ra_logger_info(g_logger, STREAM_LOG_PREFIX "Opened for source from %s", id, straddr);
-    send_handshake_response(astream, keypair);
-    Pa_StartStream(astream->pa_stream);
+    // Nothing gets allocated or computed for a source before it comes back with a cookie sent to its address
+    if (!handshake_cookie_valid(&hs, conn)) {
+        ra_metrics_add(&global_metrics, RA_METRIC_HANDSHAKE_COOKIES, 1);
+        send_handshake_cookie(conn);
+        return;
+    }
+
+    ra_metrics_add(&global_metrics, RA_METRIC_HANDSHAKES, 1);
+    uint64_t hash = source_hash(conn, hs.key);
+    ra_audio_stream_t *existing = find_source_session(&hs, conn, hash);
+    if (existing && resume_handshake(existing, &hs)) return;
+
+    uint32_t id;
+    int index = handshaker.in_flight < HANDSHAKE_QUEUE_SIZE
+                    ? ra_session_table_acquire(audio_streams, randombytes_random(), &id)
+                    : -1;
+    if (index < 0) {
+        ra_metrics_add(&global_metrics, RA_METRIC_HANDSHAKES_REJECTED, 1);
+        ra_logger_error(g_logger, "Can't accept any more audio stream");
+        return;
+    }
+    ra_audio_stream_t *astream = ra_session_table_at(audio_streams, index);
+    if (!astream) {
+        astream = audio_stream_create(id, BUFSIZE);
+        ra_session_table_set(audio_streams, index, astream);
+    }
+    astream->stream->id = id;
+    astream->handshaking = true;
+    memcpy(&astream->source_addr, conn->addr, sizeof(astream->source_addr));
+    memcpy(astream->source_key, hs.key, sizeof(astream->source_key));
+    astream->source_cfg = hs.cfg;
+    astream->source_layout = hs.layout;
+    ra_session_table_bind(audio_streams, id, hash);
+
+    ra_handshake_job_t job = {
+        .astream = astream,
+        .id = id,
+        .cfg = hs.cfg,
+        .layout = hs.layout,
+        .err = 0,
+    };
+    memcpy(job.key, hs.key, sizeof(job.key));
+    memcpy(&job.addr, conn->addr, sizeof(job.addr));
+    handshaker_submit(&job);
 }
 
-static void handle_message_crypto(ra_handler_context_t *ctx) {
-    static char rawbuf[BUFSIZE];
+static void handle_stream_clock(ra_handler_context_t *ctx, ra_audio_stream_t *astream) {
+    ra_stream_clock_t clock;
+    if (read_stream_clock_message(&clock, ctx->buf) || !clock.remote_ns) return;
+    ra_clock_sync_update(&astream->clock_sync, clock.origin_ns, clock.remote_ns, ra_clock_now_ns());
 
+    ra_clock_sample_t sample;
+    if (ra_clock_sync_get(&astream->clock_sync, &sample) == 0)
+        ra_metrics_set(&astream->metrics, RA_METRIC_CLOCK_RTT_US, sample.rtt_ns / RA_NSEC_PER_USEC);
+}
+
+// Heartbeats carrying a payload are probes from the source, echoed back as is so it can time the round trip
+static void handle_stream_heartbeat(ra_handler_context_t *ctx, ra_audio_stream_t *astream) {
+    char rawbuf[64];
+    const ra_rbuf_t *rbuf = ctx->buf;
+    if (rbuf->len < 1 || rbuf->len >= sizeof(rawbuf)) return;
+    rawbuf[0] = RA_STREAM_HEARTBEAT;
+    memcpy(rawbuf + 1, rbuf->base, rbuf->len);
+    ra_rbuf_t echo = {.base = rawbuf, .len = rbuf->len + 1};
+    send_stream_signal(astream, &echo);
+}
+
+static void handle_message_crypto(ra_handler_context_t *ctx) {
     const ra_rbuf_t *rbuf = ctx->buf;
-    if (rbuf->len < 1) return;
+    if (rbuf->len < RA_STREAM_ID_SIZE) return;
 
-    // Get the stream by ID
+    // Get the stream by ID, its index bits point straight at the stream's slot
     const char *rptr = rbuf->base;
     const char *endptr = rptr + rbuf->len;
 
-    uint8_t stream_id = *rptr++;
-    if (stream_id >= MAX_STREAMS) return;
-    ra_audio_stream_t *astream = audio_streams[stream_id];
+    uint32_t stream_id = bytes_to_uint32(rptr);
+    rptr += RA_STREAM_ID_SIZE;
+    ra_audio_stream_t *astream = ra_session_table_lookup(audio_streams, stream_id);
     if (!astream || astream->state <= 0) return;
     ra_stream_t *stream = astream->stream;
+    ra_metrics_add(&astream->metrics, RA_METRIC_PACKETS_RECEIVED, 1);
+    ra_metrics_add(&astream->metrics, RA_METRIC_BYTES_RECEIVED, rbuf->len + 1);
+    astream->session_bytes += rbuf->len + 1;
 
     // Read the payload
-    ra_buf_t readbuf = {
-        .base = rawbuf,
-        .len = 0,
-        .cap = sizeof(rawbuf),
-    };
-    if (ra_stream_read(stream, &readbuf, rptr, endptr - rptr)) return;
+    ra_packet_t *pkt = read_payload(astream, stream, rptr, endptr - rptr);
+    if (!pkt) return;
     astream->last_update = time(NULL);
+    // Signals take their nonces from the same sequence as the data, loss is measured over all of them. Once the stream
+    // joined a group, its data comes in on the group's own sequence instead.
+    if (astream->group_sock < 0) ra_receiver_stats_update(&astream->stats, stream->last_nonce);
 
     // Prepare context data
-    const char *q = rawbuf;
-    ra_crypto_type crypto_type = *q++;
-    ra_rbuf_t crypto_buf = {
-        .base = q,
-        .len = readbuf.len - 1,
-    };
+    if (pkt->len < 1) {
+        ra_packet_release(pkt);
+        return;
+    }
+    ra_crypto_type crypto_type = *pkt->data;
+    ra_packet_pull(pkt, 1);
+    ra_rbuf_t crypto_buf = ra_packet_rbuf(pkt);
     ra_handler_context_t crypto_ctx = {
         .conn = ctx->conn,
         .buf = &crypto_buf,
@@ -313,20 +1082,33 @@ static void handle_message_crypto(ra_handler_context_t *ctx) {
     // Handle crypto message
     switch (crypto_type) {
     case RA_STREAM_DATA:
-        handle_stream_data(&crypto_ctx, astream);
+        RA_NO_ALLOC_BEGIN();
+        handle_stream_data(&crypto_ctx, astream, stream);
+        RA_NO_ALLOC_END();
+        break;
+    case RA_STREAM_HEARTBEAT:
+        handle_stream_heartbeat(&crypto_ctx, astream);
         break;
     case RA_STREAM_TERMINATE:
         handle_stream_terminate(&crypto_ctx, astream);
         break;
+    case RA_STREAM_GROUP:
+        handle_stream_group(&crypto_ctx, astream);
+        break;
+    case RA_STREAM_CLOCK:
+        handle_stream_clock(&crypto_ctx, astream);
+        break;
     default:
         break;
     }
+    ra_packet_release(pkt);
 }
 
 static void handle_message(ra_handler_context_t *ctx) {
     const ra_rbuf_t *rbuf = ctx->buf;
     const char *rptr = rbuf->base;
     ra_message_type msg_type = (ra_message_type)*rptr++;
+    RA_PROBE2(message, msg_type, rbuf->len);
 
     ra_rbuf_t next_buf = {
         .base = rptr,
@@ -350,27 +1132,97 @@ static void handle_message(ra_handler_context_t *ctx) {
 
 static void handle_liveness() {
     time_t now = time(NULL);
-    for (int i = 0; i < MAX_STREAMS; i++) {
-        ra_audio_stream_t *astream = audio_streams[i];
+    size_t slots = ra_session_table_size(audio_streams);
+    for (size_t i = 0; i < slots; i++) {
+        ra_audio_stream_t *astream = ra_session_table_at(audio_streams, i);
         if (!astream || astream->state <= 0) continue;
         ra_stream_t *stream = astream->stream;
         if (astream->last_update + LIVENESS_TIMEOUT_SECONDS <= now) {
-            audio_stream_close(astream);
+            audio_stream_close(astream, "timeout");
             send_stream_terminate(astream);
             ra_logger_info(g_logger, STREAM_LOG_PREFIX "Terminated due to liveness timeout", stream->id);
             continue;
         }
         if (astream->last_heartbeat + HEARTBEAT_INTERVAL_SECONDS <= now) {
             send_stream_heartbeat(astream);
+            send_stream_clock(astream);
             astream->last_heartbeat = now;
         }
     }
 }
 
+static void report_callback_deadlines() {
+    size_t slots = ra_session_table_size(audio_streams);
+    for (size_t i = 0; i < slots; i++) {
+        ra_audio_stream_t *astream = ra_session_table_at(audio_streams, i);
+        if (!astream || astream->state <= 0) continue;
+        uint64_t misses = ra_metrics_get(&astream->metrics, RA_METRIC_CALLBACK_DEADLINE_MISSES);
+        uint64_t callbacks = ra_metrics_histogram_count(&astream->metrics.callback_duration);
+        if (misses > astream->reported_misses) {
+            ra_logger_warn(g_logger,
+                           STREAM_LOG_PREFIX "%llu of %llu audio callbacks overran %d%% of the buffer period",
+                           astream->stream->id,
+                           (unsigned long long)(misses - astream->reported_misses),
+                           (unsigned long long)(callbacks - astream->reported_callbacks),
+                           sink->callback_budget);
+        }
+        astream->reported_misses = misses;
+        astream->reported_callbacks = callbacks;
+    }
+}
+
+static void handle_reports() {
+    time_t now = time(NULL);
+    size_t slots = ra_session_table_size(audio_streams);
+    for (size_t i = 0; i < slots; i++) {
+        ra_audio_stream_t *astream = ra_session_table_at(audio_streams, i);
+        if (!astream || astream->state <= 0) continue;
+        if (astream->last_report + REPORT_INTERVAL_SECONDS > now) continue;
+        send_stream_report(astream);
+        astream->last_report = now;
+    }
+}
+
+// Gauges that depend on the time of the scrape are filled in right before rendering
+static int render_metrics(char *buf, size_t cap, size_t *len, void *userdata) {
+    int count = 0, open = 0;
+    time_t now = time(NULL);
+    size_t slots = ra_session_table_size(audio_streams);
+    char(*labels)[16] = malloc(slots * sizeof(*labels));
+    ra_metrics_set_t *sets = malloc(slots * sizeof(ra_metrics_set_t));
+    for (size_t i = 0; i < slots; i++) {
+        ra_audio_stream_t *astream = ra_session_table_at(audio_streams, i);
+        if (!astream) continue;
+        bool is_open = astream->state > 0;
+        open += is_open;
+        ra_metrics_set(&astream->metrics, RA_METRIC_STREAMS_OPEN, is_open);
+        ra_metrics_set(&astream->metrics, RA_METRIC_LAST_UPDATE_AGE_SECONDS, now - astream->last_update);
+        snprintf(labels[count], sizeof(labels[count]), "stream=\"%zu\"", i);
+        sets[count] = (ra_metrics_set_t){.labels = labels[count], .metrics = &astream->metrics};
+        count++;
+    }
+    ra_metrics_set(&global_metrics, RA_METRIC_STREAMS_OPEN, open);
+
+    ra_metrics_set_t global_set = {.metrics = &global_metrics};
+    int err = ra_metrics_render(buf, cap, len, METRICS_PREFIX, RA_METRIC_SCOPE_GLOBAL, &global_set, 1);
+    if (!err) err = ra_metrics_render(buf, cap, len, METRICS_PREFIX "_stream", RA_METRIC_SCOPE_STREAM, sets, count);
+    free(labels);
+    free(sets);
+    return err;
+}
+
 static void background_thread(void *arg) {
+    // Liveness and heartbeats can wait on the receive loop, so it runs a notch below it
+    ra_realtime_apply(g_logger, &sink->realtime, "sink-background", 1, sink->background_cpu);
+    ra_trace_set_thread_name("background");
     ra_logger_info(g_logger, "Background thread started.");
+    time_t last_deadline_report = time(NULL);
     while (is_running) {
         handle_liveness();
+        if (last_deadline_report + DEADLINE_REPORT_SECONDS <= time(NULL)) {
+            report_callback_deadlines();
+            last_deadline_report = time(NULL);
+        }
         ra_sleep(1);
     }
     ra_logger_info(g_logger, "Background thread stopped.");
@@ -385,11 +1237,24 @@ void sink_stop() {
 }
 
 int sink_main(ra_logger_t *logger, int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    argc = ra_config_parse_args(opts, argc, argv);
+    ra_config_section_t *options = ra_config_get_default_section(opts);
     g_logger = logger;
     sink = (ra_sink_t *)malloc(sizeof(ra_sink_t));
+    sink->recorder = NULL;
+    sink->decode_workers = NULL;
+    sink->record_dir = ra_config_get_value(options, "record");
+    sink->record_wav = ra_config_get_bool(options, "record-wav", 0);
+    sink->callback_budget = ra_config_get_int(options, "callback-budget", DEFAULT_CALLBACK_BUDGET);
+    sink->background_cpu = ra_config_get_int(options, "background-cpu", -1);
+    sink->payloads = ra_packet_pool_create(PAYLOAD_POOL_SIZE);
+    int max_streams = ra_config_get_int(options, "max-streams", DEFAULT_MAX_STREAMS);
     int err = 0, rc = EXIT_SUCCESS;
     const char *dev = argc >= 2 ? argv[1] : NULL;
     int port = argc >= 3 ? atoi(argv[2]) : LISTEN_PORT;
+    const char *trace_file = ra_config_get_value(options, "trace-file");
+    const char *journal_path = ra_config_get_value(options, "journal");
 
     char rawbuf[BUFSIZE];
     ra_buf_t buf = {
@@ -403,7 +1268,7 @@ int sink_main(ra_logger_t *logger, int argc, const char **argv) {
 
     ra_audio_config_t audio_cfg = {
         .type = RA_AUDIO_DEVICE_OUTPUT,
-        .channel_count = MAX_CHANNELS,
+        .channel_count = DEFAULT_CHANNELS,
         .frame_size = FRAMES_PER_BUFFER,
         .sample_format = 0,
         .sample_rate = 0,
@@ -427,22 +1292,57 @@ int sink_main(ra_logger_t *logger, int argc, const char **argv) {
         .buf = (ra_rbuf_t *)&buf,
     };
     ra_thread_t thread = 0;
+    ra_metrics_server_t *metrics_server = NULL;
+    ra_metrics_init(&global_metrics);
 
     fd_set readfds;
     struct timeval select_timeout;
-    select_timeout.tv_sec = 1;
-    select_timeout.tv_usec = 0;
 
     ra_proto_init();
 
-    PaDeviceIndex device = paNoDevice;
-    if (ra_audio_init(logger)) goto error;
-    device = ra_audio_find_device(&audio_cfg, dev);
-    if (device == paNoDevice) goto error;
-    ra_logger_info(g_logger, "Output device: %s", ra_audio_device_name(device));
+    audio_streams = ra_session_table_create(max_streams > 0 ? max_streams : 0);
+    if (!audio_streams) {
+        ra_logger_error(g_logger, "Invalid stream limit, expected --max-streams=<1-%d>", RA_SESSION_MAX_SLOTS);
+        goto error;
+    }
+
+    if (ra_realtime_config_read(&sink->realtime, options)) {
+        ra_logger_error(g_logger, "Invalid scheduling options, expected --rt-priority=<1-99> and --rt-policy=fifo|rr");
+        goto error;
+    }
+    // The decoders get created here and on the handshake thread, their workers mustn't take after either
+    ra_realtime_set_audio_threads(&sink->realtime);
+
+    // Recording doesn't need an output device, the audio config comes from each source
+    if (sink->record_dir) {
+        sink->recorder = ra_recorder_create(logger, &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to start the recorder");
+            goto error;
+        }
+        ra_logger_info(g_logger, "Recording streams to %s", sink->record_dir);
+    } else {
+        const char *backend = ra_config_get_value(options, "audio-backend");
+        if (ra_audio_set_backend(backend, !ra_config_get_bool(options, "free-running", 0))) {
+            ra_logger_error(g_logger, "Unknown audio backend: %s", backend);
+            goto error;
+        }
+        if (ra_audio_init(logger)) goto error;
+        if (ra_audio_find_device(&audio_cfg, dev)) goto error;
+        ra_logger_info(
+            g_logger, "Output device: %s (%s)", ra_audio_device_name(&audio_cfg), ra_audio_backend_name());
+        sink->decode_workers = ra_codec_workers_create(MAX_CHANNELS, &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to start the decode workers");
+            goto error;
+        }
+    }
+    if (audio_streams_preallocate(&audio_cfg)) goto error;
 
     if (ra_crypto_init(logger)) goto error;
     ra_generate_keypair(&keypair);
+    ra_generate_cookie_key(cookie_key);
+    crypto_shorthash_keygen(source_hash_key);
 
     if (ra_socket_init(logger)) goto error;
     sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
@@ -461,29 +1361,93 @@ int sink_main(ra_logger_t *logger, int argc, const char **argv) {
     }
     ra_logger_info(logger, "Sink listening at port %d.", port);
 
+    // A bare --metrics serves on the default port, always on the loopback interface only
+    int metrics_port = ra_config_get_int(options, "metrics", 0);
+    if (metrics_port == 1) metrics_port = RA_METRICS_SINK_PORT;
+    if (metrics_port > 0) {
+        metrics_server = ra_metrics_server_start(logger, "127.0.0.1", metrics_port, render_metrics, NULL, &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to serve metrics at port %d", metrics_port);
+            goto error;
+        }
+    }
+
+    if (journal_path) {
+        journal = ra_journal_open(logger, journal_path, &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to open session journal %s", journal_path);
+            goto error;
+        }
+        ra_logger_info(g_logger, "Journaling sessions to %s", journal_path);
+    }
+
     is_running = true;
     if (!disable_signal_handlers) {
         signal(SIGINT, signal_handler);
         signal(SIGTERM, signal_handler);
+        ra_trace_install_signal_handlers(trace_file);
     }
+    ra_trace_set_thread_name("main");
+    if (ra_config_get_bool(options, "trace", 0)) ra_trace_set_enabled(true);
+
+    // Locked once the streams are preallocated, and applied before the background thread gets started
+    ra_realtime_lock_memory(logger, &sink->realtime);
+    ra_realtime_apply(logger, &sink->realtime, NULL, 0, ra_config_get_int(options, "cpu", -1));
 
     thread = ra_thread_start(&background_thread, NULL, &err);
     if (err) {
         perror("thread_start");
         goto error;
     }
+    if (handshaker_start()) {
+        ra_logger_error(g_logger, "Failed to start the handshake worker");
+        goto error;
+    }
 
+    time_t last_reports = 0;
     while (is_running) {
+        release_closed_streams();
         FD_ZERO(&readfds);
         FD_SET(sock, &readfds);
-        int count = ra_socket_select(sock + 1, &readfds, &select_timeout);
+        SOCKET maxfd = sock;
+        for (int i = 0; i < joined_count; i++) {
+            SOCKET group_sock = joined_groups[i]->group_sock;
+            FD_SET(group_sock, &readfds);
+            if (group_sock > maxfd) maxfd = group_sock;
+        }
+        // Handshakes finished by the worker get picked up between packets, or after a short wait on an idle socket
+        select_timeout.tv_sec = handshaker.in_flight > 0 ? 0 : 1;
+        select_timeout.tv_usec = handshaker.in_flight > 0 ? HANDSHAKE_POLL_USEC : 0;
+        int count = ra_socket_select(maxfd + 1, &readfds, &select_timeout);
         if (count < 0) {
             ra_socket_perror("select");
             goto error;
         }
-        if (count == 0 || !FD_ISSET(sock, &readfds)) continue;
-        if (ra_buf_recvfrom(&conn, &buf) <= 0) goto error;
-        handle_message(&ctx);
+        // Group sockets go first, the messages on our own socket may join or leave groups
+        for (int i = 0; count > 0 && i < joined_count; i++) {
+            ra_audio_stream_t *astream = joined_groups[i];
+            if (!FD_ISSET(astream->group_sock, &readfds)) continue;
+            conn.sock = astream->group_sock;
+            if (ra_buf_recvfrom(&conn, &buf) <= 0) continue;
+            count_metric(NULL, RA_METRIC_PACKETS_RECEIVED, 1);
+            count_metric(NULL, RA_METRIC_BYTES_RECEIVED, buf.len);
+            handle_group_message(&ctx, astream);
+        }
+        if (count > 0 && FD_ISSET(sock, &readfds)) {
+            conn.sock = sock;
+            if (ra_buf_recvfrom(&conn, &buf) <= 0) goto error;
+            count_metric(NULL, RA_METRIC_PACKETS_RECEIVED, 1);
+            count_metric(NULL, RA_METRIC_BYTES_RECEIVED, buf.len);
+            handle_message(&ctx);
+        }
+        collect_handshakes();
+        // Reports are due once a second at most, walking every slot for them on each packet would cost more
+        time_t now = time(NULL);
+        if (last_reports + REPORT_INTERVAL_SECONDS <= now) {
+            handle_reports();
+            last_reports = now;
+        }
+        ra_trace_handle_requests();
     }
     goto cleanup;
 
@@ -497,16 +1461,31 @@ cleanup:
             ra_logger_error(logger, "Timeout waiting for background thread to stop.");
         ra_thread_destroy(thread);
     }
-    for (int i = 0; i < MAX_STREAMS; i++) {
-        ra_audio_stream_t *astream = audio_streams[i];
+    handshaker_stop();
+    ra_metrics_server_stop(metrics_server);
+    if (trace_file || atomic_load(&ra_trace_enabled)) {
+        const char *path = trace_file ? trace_file : RA_TRACE_DEFAULT_FILE;
+        if (ra_trace_dump_file(path)) ra_logger_error(g_logger, "Failed to write the trace to %s", path);
+    }
+    size_t slots = audio_streams ? ra_session_table_size(audio_streams) : 0;
+    for (size_t i = 0; i < slots; i++) {
+        ra_audio_stream_t *astream = ra_session_table_at(audio_streams, i);
         if (!astream) continue;
         audio_stream_destroy(astream);
     }
+    ra_session_table_destroy(audio_streams);
+    audio_streams = NULL;
+    ra_journal_close(journal);
+    journal = NULL;
+    ra_recorder_destroy(sink->recorder);
+    ra_workers_destroy(sink->decode_workers);
+    ra_packet_pool_destroy(sink->payloads);
     if (sock >= 0) ra_socket_close(sock);
     ra_socket_deinit();
-    ra_audio_deinit();
+    if (!sink->record_dir) ra_audio_deinit();
     ra_proto_deinit();
     free(sink);
+    ra_config_destroy(opts);
 
     ra_logger_info(logger, "Sink shutdown gracefully.");
     return rc;
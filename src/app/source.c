@@ -1,24 +1,72 @@
 #include "source.h"
 
+#include <math.h>
 #include <signal.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
+#include "lib/clock.h"
+#include "lib/codec.h"
+#include "lib/config.h"
+#include "lib/congestion.h"
+#include "lib/level.h"
+#include "lib/metrics.h"
+#include "lib/peer.h"
+#include "lib/probe.h"
 #include "lib/proto.h"
+#include "lib/realtime.h"
 #include "lib/stream.h"
+#include "lib/string.h"
+#include "lib/trace.h"
+#include "lib/utils.h"
 
+#define MAX_SINKS                 16
 #define HEARTBEAT_TIMEOUT_SECONDS 10
+#define GROUP_ANNOUNCE_SECONDS    5
+#define DEFAULT_MULTICAST_TTL     1
+#define MAX_FRAME_DURATION_MS     60
+#define DTX_DEFAULT_THRESHOLD_DB  -60
+#define DTX_HANGOVER_MS           200
+#define DTX_REFRESH_MS            400
+#define DEFAULT_CALLBACK_BUDGET   80  // Percent of the buffer period the audio callback may take
+#define DEADLINE_REPORT_SECONDS   10
+
+// Keeps a packet and its stream framing within a single UDP datagram
+#define MAX_ENCODED_SIZE 60000
+// Packets in flight at once, the audio callback holds one while it's sent to every sink
+#define PACKET_POOL_SIZE 1
+
+#define METRICS_PREFIX "remote_audio_source"
 
 typedef struct {
-    ra_conn_t *conn;
     ra_keypair_t *keypair;
-    ra_stream_t *stream;
     ra_audio_config_t *audio_cfg;
-    PaStream *pa_stream;
-    OpusEncoder *encoder;
-    atomic_uchar state;  // 0 = uninitialized, 1 = handshake sent, 2 = handshake completed
-    _Atomic(time_t) last_heartbeat;
+    ra_audio_handle_t *audio;
+    ra_encoder_t *encoder;
+    ra_channel_layout_t layout;
+    ra_peer_t peers[MAX_SINKS];
+    ra_metrics_t peer_metrics[MAX_SINKS];
+    int peer_count;
+    bool capturing;
+    // Multicast delivery, the stream data is encrypted once with a group key handed to every sink
+    bool multicast;
+    ra_stream_group_t group;
+    ra_stream_t group_stream;
+    ra_conn_t group_conn;
+    // Encoder settings published by the congestion controllers, applied by the audio callback
+    atomic_int bitrate;
+    atomic_int loss_percent;
+    atomic_int frame_multiplier;
+    atomic_uint settings_generation;
+    bool dtx;
+    ra_silence_gate_t silence_gate;
+    size_t dtx_refresh_frames;
+    int callback_budget;
+    uint64_t callback_budget_ns;
+    uint64_t input_latency_ns;
+    ra_packet_pool_t *packets;
 } ra_source_t;
 
 typedef struct {
@@ -31,67 +79,180 @@ static atomic_bool is_running = false;
 static ra_source_t *source = NULL;
 static ra_logger_t *g_logger = NULL;
 static bool disable_signal_handlers = false;
+static ra_metrics_t global_metrics;
 
-static void configure_encoder(OpusEncoder *st) {
-    opus_encoder_ctl(st, OPUS_SET_SIGNAL(OPUS_SIGNAL_MUSIC));
+// Counts towards the sink's metrics and the global ones
+static void count_metric(const ra_peer_t *peer, ra_metric_id id, uint64_t value) {
+    ra_metrics_add(&global_metrics, id, value);
+    if (peer) ra_metrics_add(&source->peer_metrics[peer - source->peers], id, value);
+}
+
+static void count_sent(const ra_peer_t *peer, ssize_t sent) {
+    if (sent <= 0) return;
+    count_metric(peer, RA_METRIC_PACKETS_SENT, 1);
+    count_metric(peer, RA_METRIC_BYTES_SENT, sent);
+}
+
+static void configure_encoder(ra_encoder_t *enc) {
+    ra_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_MUSIC));
 
 #ifdef ENCODE_HIGH_BANDWIDTH
-    opus_encoder_ctl(st, OPUS_SET_BANDWIDTH(OPUS_BANDWIDTH_FULLBAND));
-    opus_encoder_ctl(st, OPUS_SET_BITRATE(OPUS_BITRATE_MAX));
-    opus_encoder_ctl(st, OPUS_SET_PREDICTION_DISABLED(1));
+    ra_encoder_ctl(enc, OPUS_SET_BANDWIDTH(OPUS_BANDWIDTH_FULLBAND));
+    ra_encoder_ctl(enc, OPUS_SET_BITRATE(OPUS_BITRATE_MAX));
+    ra_encoder_ctl(enc, OPUS_SET_PREDICTION_DISABLED(1));
 #endif
 }
 
-static void handle_handshake_response(ra_handler_context_t *ctx) {
-    if (source->state > 1) return;
-
-    static const size_t hdrlen = 2;
-    const ra_rbuf_t *rbuf = ctx->buf;
-    if (rbuf->len < hdrlen) return;
-
-    ra_stream_t *stream = source->stream;
-    const char *rptr = rbuf->base;
-    const char *endptr = rptr + rbuf->len;
-    stream->id = (uint8_t)*rptr++;
-
-    unsigned char keysize = (unsigned char)*rptr++;
-    if (rptr + keysize > endptr) return;
-    int err = ra_compute_shared_secret(stream->secret,
-                                       sizeof(stream->secret),
-                                       (unsigned char *)rptr,
-                                       keysize,
-                                       source->keypair,
-                                       RA_SHARED_SECRET_CLIENT);
-    if (err) {
-        ra_logger_error(g_logger, "Handshake error with the sink: key exchange failed.");
+static void apply_encoder_settings(ra_encoder_t *enc) {
+    int loss_percent = source->loss_percent;
+    ra_encoder_ctl(enc, OPUS_SET_BITRATE(source->bitrate));
+    ra_encoder_ctl(enc, OPUS_SET_INBAND_FEC(loss_percent > 0));
+    ra_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(loss_percent));
+}
+
+// The one encoder serves every sink, so it's tuned for the worst of them
+static void publish_encoder_settings() {
+    int bitrate = 0, loss_percent = 0, frame_multiplier = 1;
+    for (int i = 0; i < source->peer_count; i++) {
+        const ra_peer_t *peer = &source->peers[i];
+        if (!ra_peer_ready(peer)) continue;
+        const ra_congestion_t *cc = &peer->cc;
+        if (bitrate <= 0 || cc->bitrate < bitrate) bitrate = cc->bitrate;
+        if (cc->loss_percent > loss_percent) loss_percent = cc->loss_percent;
+        if (cc->frame_multiplier > frame_multiplier) frame_multiplier = cc->frame_multiplier;
+    }
+    if (bitrate <= 0) return;
+    source->bitrate = bitrate;
+    source->loss_percent = loss_percent;
+    source->frame_multiplier = frame_multiplier;
+    source->settings_generation++;
+}
+
+static void reset_congestion(ra_peer_t *peer) {
+    ra_audio_config_t *cfg = source->audio_cfg;
+    int max_frame_multiplier = MAX_FRAME_DURATION_MS * cfg->sample_rate / (1000 * cfg->frame_size);
+    if (max_frame_multiplier > RA_CC_MAX_FRAME_MULTIPLIER) max_frame_multiplier = RA_CC_MAX_FRAME_MULTIPLIER;
+    ra_congestion_init(&peer->cc, cfg->channel_count, max_frame_multiplier);
+}
+
+static void start_capture() {
+    if (source->capturing) return;
+    ra_audio_start_stream(source->audio);
+    source->capturing = true;
+}
+
+// Capturing and encoding carry on while any sink is still listening
+static void stop_capture_if_idle() {
+    if (!source->capturing) return;
+    for (int i = 0; i < source->peer_count; i++)
+        if (ra_peer_ready(&source->peers[i])) return;
+    ra_audio_stop_stream(source->audio);
+    source->capturing = false;
+}
+
+// Hands the group key over the sink's own stream, sinks can only decrypt the group's data once they have it
+static void send_group(ra_peer_t *peer) {
+    char rawbuf[64];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    create_stream_group_message(&buf, &source->group);
+    count_sent(peer, ra_peer_send(peer, (ra_rbuf_t *)&buf));
+}
+
+static int send_handshake(ra_peer_t *peer) {
+    count_metric(peer, RA_METRIC_HANDSHAKES, 1);
+    return ra_peer_send_handshake(peer, source->keypair, source->audio_cfg, &source->layout);
+}
+
+static void handle_handshake_response(ra_handler_context_t *ctx, ra_peer_t *peer) {
+    if (peer->state != 1) return;
+
+    reset_congestion(peer);
+    if (ra_peer_handle_handshake_response(peer, source->keypair, ctx->buf)) {
+        ra_logger_error(g_logger, "Handshake error with sink %s: key exchange failed.", peer->host);
         return;
     }
-    ra_logger_info(g_logger, "Handshake with the sink succeed. Proceeding to stream audio to sink.");
-    Pa_StartStream(source->pa_stream);
-    source->last_heartbeat = time(NULL);
-    source->state = 2;
+    ra_logger_info(g_logger, "Handshake with sink %s succeed. Proceeding to stream audio to sink.", peer->host);
+    publish_encoder_settings();
+    if (source->multicast) send_group(peer);
+    start_capture();
 }
 
-static void handle_message_crypto(ra_handler_context_t *ctx) {
-    static char rawbuf[BUFSIZE];
+static void handle_stream_report(ra_handler_context_t *ctx, ra_peer_t *peer) {
+    ra_stream_report_t report;
+    if (read_stream_report_message(&report, ctx->buf)) return;
+
+    ra_metrics_set(&source->peer_metrics[peer - source->peers], RA_METRIC_BUFFER_MS, report.buffer_ms);
+    ra_congestion_t *cc = &peer->cc;
+    if (!ra_congestion_update(cc, &report)) return;
+    publish_encoder_settings();
+    ra_logger_info(g_logger,
+                   "Sink %s reported %d%% loss, %u us jitter, %u ms buffered, %u underruns. "
+                   "Encoding at %d bps, %d%% FEC, %dx frame size.",
+                   peer->host,
+                   report.fraction_lost * 100 / 256,
+                   report.jitter_us,
+                   report.buffer_ms,
+                   report.underruns,
+                   (int)source->bitrate,
+                   (int)source->loss_percent,
+                   (int)source->frame_multiplier);
+}
 
-    const ra_rbuf_t *rbuf = ctx->buf;
-    const char *rptr = rbuf->base;
-    const char *endptr = rptr + rbuf->len;
+// Answers the sink's clock request with our own time, letting it map capture times onto its clock
+static void handle_stream_clock(ra_handler_context_t *ctx, ra_peer_t *peer) {
+    char rawbuf[32];
+    ra_stream_clock_t clock;
+    if (read_stream_clock_message(&clock, ctx->buf) || clock.remote_ns) return;
+    clock.remote_ns = ra_clock_now_ns();
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    create_stream_clock_message(&buf, &clock);
+    count_sent(peer, ra_peer_send(peer, (ra_rbuf_t *)&buf));
+}
 
-    const uint8_t stream_id = *rptr++;
-    if (stream_id != source->stream->id) return;
+static void handle_message_crypto(ra_handler_context_t *ctx, ra_peer_t *peer) {
+    static char rawbuf[BUFSIZE];
 
-    ra_stream_t *stream = source->stream;
     ra_buf_t buf = {.base = rawbuf, .cap = BUFSIZE};
-    if (ra_stream_read(stream, &buf, rptr, endptr - rptr)) return;
-    source->last_heartbeat = time(NULL);
+    int err = ra_peer_read(peer, &buf, ctx->buf);
+    if (err) {
+        count_metric(peer, err == RA_STREAM_ERR_REPLAYED ? RA_METRIC_REPLAYS_DROPPED : RA_METRIC_DECRYPT_FAILURES, 1);
+        return;
+    }
+
+    // Prepare context data
+    const char *q = rawbuf;
+    ra_crypto_type crypto_type = *q++;
+    ra_rbuf_t crypto_buf = {
+        .base = q,
+        .len = buf.len - 1,
+    };
+    ra_handler_context_t crypto_ctx = {
+        .conn = ctx->conn,
+        .buf = &crypto_buf,
+    };
+
+    switch (crypto_type) {
+    case RA_STREAM_REPORT:
+        handle_stream_report(&crypto_ctx, peer);
+        break;
+    case RA_STREAM_CLOCK:
+        handle_stream_clock(&crypto_ctx, peer);
+        break;
+    default:
+        break;
+    }
 }
 
 static void handle_message(ra_handler_context_t *ctx) {
     const ra_rbuf_t *buf = ctx->buf;
+    if (buf->len < 1) return;
+    ra_peer_t *peer = ra_peer_find(source->peers, source->peer_count, ctx->conn->addr);
+    if (!peer) return;
+    ra_metrics_add(&source->peer_metrics[peer - source->peers], RA_METRIC_PACKETS_RECEIVED, 1);
+    ra_metrics_add(&source->peer_metrics[peer - source->peers], RA_METRIC_BYTES_RECEIVED, buf->len);
     const char *rptr = buf->base;
     ra_message_type msg_type = (ra_message_type)*rptr++;
+    RA_PROBE2(message, msg_type, buf->len);
 
     ra_rbuf_t next_buf = {
         .base = rptr,
@@ -102,75 +263,195 @@ static void handle_message(ra_handler_context_t *ctx) {
         .buf = &next_buf,
     };
     switch (msg_type) {
+    case RA_HANDSHAKE_COOKIE:
+        if (ra_peer_handle_handshake_cookie(peer, &next_buf) == 0) send_handshake(peer);
+        break;
     case RA_HANDSHAKE_RESPONSE:
-        handle_handshake_response(&next_ctx);
+        handle_handshake_response(&next_ctx, peer);
         break;
     case RA_MESSAGE_CRYPTO:
-        handle_message_crypto(&next_ctx);
+        handle_message_crypto(&next_ctx, peer);
         break;
     default:
         break;
     }
 }
 
-static void send_crypto_data(const ra_conn_t *conn, ra_stream_t *stream, const char *src, size_t len) {
-    static char rawbuf[BUFSIZE];
-    static ra_buf_t buf = {.base = rawbuf, .cap = BUFSIZE};
-    ra_rbuf_t rbuf = {.base = src, .len = len};
-    create_stream_data_message(&buf, &rbuf);
-    ra_stream_send(stream, conn, (ra_rbuf_t *)&buf);
-}
-
-static int send_handshake() {
-    static char rawbuf[2048];
-    static ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
-    create_handshake_message(&buf, source->keypair, source->audio_cfg);
-    if (ra_buf_sendto(source->conn, (ra_rbuf_t *)&buf) <= 0) return -1;
-    source->last_heartbeat = time(NULL);
-    return 0;
+// The packet is encoded once, only the encryption is done per sink, and the message type goes in its headroom
+static void send_crypto_data(ra_packet_t *pkt) {
+    *ra_packet_push(pkt, 1) = (char)RA_STREAM_DATA;
+    ra_rbuf_t rbuf = ra_packet_rbuf(pkt);
+    if (source->multicast) {
+        count_sent(NULL, ra_stream_send(&source->group_stream, &source->group_conn, &rbuf));
+        return;
+    }
+    for (int i = 0; i < source->peer_count; i++) count_sent(&source->peers[i], ra_peer_send(&source->peers[i], &rbuf));
 }
 
 static void send_termination_signal() {
-    ra_logger_info(g_logger, "Sending stream termination signal to sink...");
-    if (ra_stream_send(source->stream, source->conn, ra_stream_terminate_message) > 0) {
-        ra_logger_info(g_logger, "Termination signal sent.");
-    } else {
-        ra_logger_error(g_logger, "Failed to send termination signal.");
+    for (int i = 0; i < source->peer_count; i++) {
+        ra_peer_t *peer = &source->peers[i];
+        if (!ra_peer_ready(peer)) continue;
+        ra_logger_info(g_logger, "Sending stream termination signal to sink %s...", peer->host);
+        ssize_t sent = ra_peer_send(peer, ra_stream_terminate_message);
+        count_sent(peer, sent);
+        if (sent > 0) {
+            ra_logger_info(g_logger, "Termination signal sent.");
+        } else {
+            ra_logger_error(g_logger, "Failed to send termination signal.");
+        }
     }
 }
 
-static int audio_callback(const void *input,
-                          void *output,
-                          unsigned long fpb,
-                          const struct PaStreamCallbackTimeInfo *timeinfo,
-                          PaStreamCallbackFlags flags,
-                          void *userdata) {
-    static char buf[ENCODE_BUFFER_SIZE];
-    static size_t buflen = sizeof(buf);
+static int capture(const void *input, unsigned long fpb, PaStreamCallbackFlags flags, uint64_t capture_ns) {
+    static char pending[ENCODE_BUFFER_SIZE];
+    static size_t pending_frames = 0;
+    static uint64_t pending_capture_ns = 0;
+    static uint32_t timestamp = 0;
+    static unsigned int settings_generation = 0;
+    static bool in_dtx = false;
+    static size_t dtx_suppressed = SIZE_MAX;
 
     ra_audio_config_t *cfg = source->audio_cfg;
     if (fpb != cfg->frame_size) {
         ra_logger_error(g_logger, "Number of frames mismatch, %d != %zu", cfg->frame_size, fpb);
         return paAbort;
     }
-    uint16_to_bytes(buf, fpb);
+    if (flags & paInputUnderflow) count_metric(NULL, RA_METRIC_AUDIO_UNDERFLOWS, 1);
+    if (flags & paInputOverflow) count_metric(NULL, RA_METRIC_AUDIO_OVERFLOWS, 1);
 
-    OpusEncoder *enc = source->encoder;
-    opus_int32 encsize = cfg->sample_format == paFloat32
-                             ? opus_encode_float(enc, (float *)input, fpb, (unsigned char *)buf + 2, buflen - 2)
-                             : opus_encode(enc, (opus_int16 *)input, fpb, (unsigned char *)buf + 2, buflen - 2);
+    ra_encoder_t *enc = source->encoder;
+    if (settings_generation != source->settings_generation) {
+        settings_generation = source->settings_generation;
+        apply_encoder_settings(enc);
+    }
+
+    // Silence suppression, switching the encoder's DTX on once the input level stays below the threshold
+    if (source->dtx) {
+        size_t count = fpb * cfg->channel_count;
+        float peak = cfg->sample_format == paFloat32 ? ra_level_peak_float((const float *)input, count)
+                                                     : ra_level_peak_int16((const int16_t *)input, count);
+        bool silent = ra_silence_gate_update(&source->silence_gate, peak, fpb);
+        if (silent != in_dtx) {
+            ra_encoder_ctl(enc, OPUS_SET_DTX(silent));
+            in_dtx = silent;
+        }
+    }
+
+    // Accumulate capture buffers until there's enough for the frame duration chosen by the congestion controller
+    size_t sz_frame = cfg->channel_count * cfg->sample_size;
+    if (pending_frames == 0) pending_capture_ns = capture_ns;
+    memcpy(pending + pending_frames * sz_frame, input, fpb * sz_frame);
+    pending_frames += fpb;
+    timestamp += fpb;
+    if (pending_frames < fpb * source->frame_multiplier) return paContinue;
+
+    size_t frames = pending_frames;
+    pending_frames = 0;
+    ra_packet_t *pkt = ra_packet_alloc(source->packets);
+    if (!pkt) {
+        ra_logger_error(g_logger, "Packet pool exhausted, dropping %zu frames", frames);
+        return paContinue;
+    }
+    char *header = ra_packet_put(pkt, STREAM_DATA_HEADER_SIZE + STREAM_DATA_CAPTURE_TIME_SIZE);
+    uint16_to_bytes(header, frames);
+    uint32_to_bytes(header + 2, timestamp - frames);
+    header[6] = (in_dtx ? STREAM_DATA_FLAG_DTX : 0) | STREAM_DATA_FLAG_CAPTURE_TIME;
+    uint64_to_bytes(header + STREAM_DATA_HEADER_SIZE, pending_capture_ns);
+
+    // Encoded straight into the packet's tail, nothing gets copied on the way out
+    unsigned char *data = (unsigned char *)pkt->data + pkt->len;
+    opus_int32 maxlen = ra_min(ra_packet_tailroom(pkt), MAX_ENCODED_SIZE);
+    opus_int32 encsize = ra_encode(enc, pending, frames, data, maxlen);
     if (encsize <= 0) {
         if (encsize < 0) ra_logger_error(g_logger, "Opus encode error %d: %s", encsize, opus_strerror(encsize));
+        ra_packet_release(pkt);
         return paAbort;
     }
+    ra_packet_put(pkt, encsize);
+
+    // While silent only refresh the sink's comfort noise every so often, the sink fills the gaps itself
+    if (in_dtx) {
+        if (dtx_suppressed < source->dtx_refresh_frames) {
+            dtx_suppressed += frames;
+            ra_packet_release(pkt);
+            return paContinue;
+        }
+        dtx_suppressed = 0;
+    } else {
+        dtx_suppressed = SIZE_MAX;
+    }
 
-    ra_stream_t *stream = source->stream;
-    ra_conn_t *conn = source->conn;
-    send_crypto_data(conn, stream, buf, 2 + encsize);
+    send_crypto_data(pkt);
+    ra_packet_release(pkt);
 
     return paContinue;
 }
 
+// Capture time of the buffer on the monotonic clock, the stream's latency stands in when the host API gives no timing
+static uint64_t adc_time_ns(const struct PaStreamCallbackTimeInfo *timeinfo, uint64_t now) {
+    if (timeinfo && timeinfo->inputBufferAdcTime > 0 && timeinfo->currentTime >= timeinfo->inputBufferAdcTime)
+        return now - (uint64_t)((timeinfo->currentTime - timeinfo->inputBufferAdcTime) * RA_NSEC_PER_SEC);
+    return now - source->input_latency_ns;
+}
+
+static int audio_callback(const void *input,
+                          void *output,
+                          unsigned long fpb,
+                          const struct PaStreamCallbackTimeInfo *timeinfo,
+                          PaStreamCallbackFlags flags,
+                          void *userdata) {
+    uint64_t started = ra_clock_now_ns();
+    uint64_t trace_start = RA_TRACE_BEGIN();
+    int res = capture(input, fpb, flags, adc_time_ns(timeinfo, started));
+    RA_TRACE_END(RA_TRACE_AUDIO_CALLBACK, trace_start);
+
+    // Only counters are touched here, the main loop reports them so the audio thread never does I/O
+    uint64_t elapsed = ra_clock_now_ns() - started;
+    ra_metrics_observe_ns(&global_metrics.callback_duration, elapsed);
+    if (elapsed > source->callback_budget_ns) count_metric(NULL, RA_METRIC_CALLBACK_DEADLINE_MISSES, 1);
+    return res;
+}
+
+static void report_callback_deadlines() {
+    static uint64_t reported_misses = 0, reported_callbacks = 0;
+    uint64_t misses = ra_metrics_get(&global_metrics, RA_METRIC_CALLBACK_DEADLINE_MISSES);
+    uint64_t callbacks = ra_metrics_histogram_count(&global_metrics.callback_duration);
+    if (misses > reported_misses) {
+        ra_logger_warn(g_logger,
+                       "%llu of %llu audio callbacks overran %d%% of the buffer period",
+                       (unsigned long long)(misses - reported_misses),
+                       (unsigned long long)(callbacks - reported_callbacks),
+                       source->callback_budget);
+    }
+    reported_misses = misses;
+    reported_callbacks = callbacks;
+}
+
+// Gauges that depend on the time of the scrape are filled in right before rendering
+static int render_metrics(char *buf, size_t cap, size_t *len, void *userdata) {
+    char labels[MAX_SINKS][RA_PEER_HOST_SIZE + 32];
+    ra_metrics_set_t sets[MAX_SINKS];
+    int open = 0;
+    time_t now = time(NULL);
+    for (int i = 0; i < source->peer_count; i++) {
+        ra_peer_t *peer = &source->peers[i];
+        ra_metrics_t *metrics = &source->peer_metrics[i];
+        bool ready = ra_peer_ready(peer);
+        open += ready;
+        ra_metrics_set(metrics, RA_METRIC_STREAMS_OPEN, ready);
+        ra_metrics_set(metrics, RA_METRIC_LAST_UPDATE_AGE_SECONDS, now - peer->last_heartbeat);
+        snprintf(labels[i], sizeof(labels[i]), "sink=\"%s:%u\"", peer->host, peer->port);
+        sets[i] = (ra_metrics_set_t){.labels = labels[i], .metrics = metrics};
+    }
+    ra_metrics_set(&global_metrics, RA_METRIC_STREAMS_OPEN, open);
+
+    ra_metrics_set_t global_set = {.metrics = &global_metrics};
+    if (ra_metrics_render(buf, cap, len, METRICS_PREFIX, RA_METRIC_SCOPE_GLOBAL, &global_set, 1)) return -1;
+    return ra_metrics_render(
+        buf, cap, len, METRICS_PREFIX "_stream", RA_METRIC_SCOPE_STREAM, sets, source->peer_count);
+}
+
 static void signal_handler(int signum) {
     if (sock >= 0) send_termination_signal();
     is_running = false;
@@ -185,28 +466,46 @@ void source_stop() {
 }
 
 int source_main(ra_logger_t *logger, int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    argc = ra_config_parse_args(opts, argc, argv);
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s <sink-host> [audio-input] [sink-port]\n", argv[0]);
+        fprintf(stderr,
+                "Usage: %s [--channels=<count>] [--channel-mapping=surround|discrete] [--codec-threads=<count>] "
+                "[--dtx] [--dtx-threshold=<dBFS>] [--multicast=<group>[:port]] [--multicast-ttl=<hops>] "
+                "[--audio-backend=portaudio|null|file|pipe] [--free-running] [--metrics[=<port>]] "
+                "[--trace] [--trace-file=<path>] [--callback-budget=<percent>] "
+                "[--rt-priority=<1-99>] [--rt-policy=fifo|rr] [--cpu=<index>] [--mlock] "
+                "<sink-host[:port],...> [audio-input] [sink-port]\n",
+                argv[0]);
+        ra_config_destroy(opts);
         return EXIT_FAILURE;
     }
+    ra_config_section_t *options = ra_config_get_default_section(opts);
     g_logger = logger;
 
-    const char *host = argv[1];
+    const char *hosts = argv[1];
     const char *dev = NULL;
     if (argc >= 3) dev = argv[2];
     int port = LISTEN_PORT;
     if (argc >= 4) port = atoi(argv[3]);
-    ra_logger_info(logger, "Sink address: %s:%d", host, port);
+    const char *trace_file = ra_config_get_value(options, "trace-file");
 
     source = malloc(sizeof(ra_source_t));
-    source->state = 0;
-    source->last_heartbeat = time(NULL);
+    source->peer_count = 0;
+    source->capturing = false;
+    source->multicast = false;
+    source->frame_multiplier = 1;
+    source->settings_generation = 0;
+    source->dtx = ra_config_get_bool(options, "dtx", 0);
+    source->callback_budget = ra_config_get_int(options, "callback-budget", DEFAULT_CALLBACK_BUDGET);
+    source->packets = ra_packet_pool_create(PACKET_POOL_SIZE);
+    ra_metrics_init(&global_metrics);
+    for (int i = 0; i < MAX_SINKS; i++) ra_metrics_init(&source->peer_metrics[i]);
 
     int rc = EXIT_SUCCESS, err;
-    PaStream *pa_stream = NULL;
-    OpusEncoder *encoder = NULL;
-    ra_stream_t *stream = ra_stream_create(0);
-    source->stream = stream;
+    ra_audio_handle_t *audio = NULL;
+    ra_encoder_t *encoder = NULL;
+    ra_metrics_server_t *metrics_server = NULL;
 
     char rawbuf[BUFSIZE];
     ra_buf_t buf = {
@@ -218,7 +517,7 @@ int source_main(ra_logger_t *logger, int argc, const char **argv) {
     ra_keypair_t keypair;
     ra_audio_config_t audio_cfg = {
         .type = RA_AUDIO_DEVICE_INPUT,
-        .channel_count = MAX_CHANNELS,
+        .channel_count = ra_config_get_int(options, "channels", DEFAULT_CHANNELS),
         .frame_size = FRAMES_PER_BUFFER,
         .sample_format = 0,
         .sample_rate = 0,
@@ -231,13 +530,6 @@ int source_main(ra_logger_t *logger, int argc, const char **argv) {
     client_addr.sin_addr.s_addr = INADDR_ANY;
     client_addr.sin_port = 0;
 
-    struct sockaddr_in server_addr;
-    ra_conn_t sink_conn = {
-        .addr = (struct sockaddr *)&server_addr,
-        .addrlen = sizeof(struct sockaddr_in),
-    };
-    source->conn = &sink_conn;
-
     struct sockaddr_in src_addr;
     ra_conn_t conn = {
         .addr = (struct sockaddr *)&src_addr,
@@ -256,23 +548,67 @@ int source_main(ra_logger_t *logger, int argc, const char **argv) {
     ra_proto_init();
 
     // Init audio
-    PaDeviceIndex device = paNoDevice;
+    const char *backend = ra_config_get_value(options, "audio-backend");
+    if (ra_audio_set_backend(backend, !ra_config_get_bool(options, "free-running", 0))) {
+        ra_logger_error(g_logger, "Unknown audio backend: %s", backend);
+        goto error;
+    }
     if (ra_audio_init(logger)) goto error;
-    device = ra_audio_find_device(&audio_cfg, dev);
-    if (device == paNoDevice) goto error;
-    ra_logger_info(g_logger, "Input device: %s", ra_audio_device_name(device));
-    pa_stream = ra_audio_create_stream(&audio_cfg, audio_callback, NULL);
-    if (!pa_stream) goto error;
-    source->pa_stream = pa_stream;
-
-    // Init encoder
-    encoder = opus_encoder_create(audio_cfg.sample_rate, audio_cfg.channel_count, OPUS_APPLICATION, &err);
+    if (ra_audio_find_device(&audio_cfg, dev)) goto error;
+    ra_logger_info(g_logger, "Input device: %s (%s)", ra_audio_device_name(&audio_cfg), ra_audio_backend_name());
+
+    // Set before the audio stream and the encoder get created, their threads start with it
+    ra_realtime_config_t realtime;
+    if (ra_realtime_config_read(&realtime, options)) {
+        ra_logger_error(g_logger, "Invalid scheduling options, expected --rt-priority=<1-99> and --rt-policy=fifo|rr");
+        goto error;
+    }
+    ra_realtime_set_audio_threads(&realtime);
+    ra_realtime_apply(logger, &realtime, NULL, 0, ra_config_get_int(options, "cpu", -1));
+
+    audio = ra_audio_create_stream(&audio_cfg, audio_callback, NULL);
+    if (!audio) goto error;
+    source->audio = audio;
+    source->input_latency_ns = ra_audio_stream_latency(audio) * RA_NSEC_PER_SEC;
+    // Only known once the stream settled on a sample rate, the device alone may not say
+    source->callback_budget_ns =
+        audio_cfg.frame_size * RA_NSEC_PER_SEC / audio_cfg.sample_rate * source->callback_budget / 100;
+
+    // Init encoder, surround layouts only go up to 7.1 so anything wider is coded as discrete channels
+    const char *mapping = ra_config_get_value(options, "channel-mapping");
+    int mapping_family = RA_MAPPING_FAMILY_SURROUND;
+    if ((mapping && strcmp(mapping, "discrete") == 0) || (!mapping && audio_cfg.channel_count > 8))
+        mapping_family = RA_MAPPING_FAMILY_DISCRETE;
+    ra_channel_layout_t *layout = &source->layout;
+    err = ra_channel_layout_init(
+        layout, audio_cfg.channel_count, mapping_family, ra_config_get_int(options, "codec-threads", 0));
+    if (err) {
+        ra_logger_error(g_logger, "Unsupported channel layout for %d channels", audio_cfg.channel_count);
+        goto error;
+    }
+    encoder = ra_encoder_create(&audio_cfg, layout, mapping_family, OPUS_APPLICATION, &err);
     if (err) {
         ra_logger_error(g_logger, "Failed to create Opus encoder, error %d: %s", err, opus_strerror(err));
         goto error;
     }
+    ra_logger_info(g_logger,
+                   "Encoding %d streams (%d coupled) in %d groups.",
+                   layout->streams,
+                   layout->coupled_streams,
+                   layout->groups);
     configure_encoder(encoder);
     source->encoder = encoder;
+    // Only what's mapped by now gets locked, the stream and the encoder are the buffers that matter
+    ra_realtime_lock_memory(logger, &realtime);
+
+    // Init silence suppression
+    if (source->dtx) {
+        int threshold_db = ra_config_get_int(options, "dtx-threshold", DTX_DEFAULT_THRESHOLD_DB);
+        size_t hangover_frames = audio_cfg.sample_rate * DTX_HANGOVER_MS / 1000;
+        ra_silence_gate_init(&source->silence_gate, powf(10.0f, threshold_db / 20.0f), hangover_frames);
+        source->dtx_refresh_frames = audio_cfg.sample_rate * DTX_REFRESH_MS / 1000;
+        ra_logger_info(g_logger, "Silence suppression enabled below %d dBFS.", threshold_db);
+    }
 
     // Init crypto
     if (ra_crypto_init(logger)) goto error;
@@ -286,7 +622,7 @@ int source_main(ra_logger_t *logger, int argc, const char **argv) {
         ra_socket_perror("socket");
         goto error;
     }
-    sink_conn.sock = conn.sock = sock;
+    conn.sock = sock;
     if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(sockopt_t))) {
         ra_socket_perror("setsockopt");
         goto error;
@@ -295,18 +631,68 @@ int source_main(ra_logger_t *logger, int argc, const char **argv) {
         ra_socket_perror("bind");
         goto error;
     }
-    ra_sockaddr_init(host, port, &server_addr);
 
-    if (send_handshake()) goto error;
-    ra_logger_info(g_logger, "Initiated handshake with sink.");
-    source->state = 1;
+    // Init multicast delivery
+    const char *multicast = ra_config_get_value(options, "multicast");
+    ra_stream_group_t *group = &source->group;
+    if (multicast) {
+        if (ra_sockaddr_parse(multicast, MULTICAST_PORT, &group->addr) ||
+            !IN_MULTICAST(ntohl(group->addr.sin_addr.s_addr))) {
+            ra_logger_error(g_logger, "Invalid multicast group: %s", multicast);
+            goto error;
+        }
+        if (ra_multicast_set_ttl(sock, ra_config_get_int(options, "multicast-ttl", DEFAULT_MULTICAST_TTL))) {
+            ra_socket_perror("setsockopt");
+            goto error;
+        }
+        randombytes_buf(&group->stream_id, sizeof(group->stream_id));
+        randombytes_buf(group->secret, sizeof(group->secret));
+        ra_stream_init(&source->group_stream, group->stream_id);
+        memcpy(source->group_stream.secret, group->secret, sizeof(group->secret));
+        source->group_conn.sock = sock;
+        source->group_conn.addr = (struct sockaddr *)&group->addr;
+        source->group_conn.addrlen = sizeof(group->addr);
+        source->multicast = true;
+
+        char straddr[32];
+        ra_sockaddr_str(straddr, &group->addr);
+        ra_logger_info(g_logger, "Streaming to multicast group %s.", straddr);
+    }
+
+    source->peer_count = ra_peer_parse_list(source->peers, MAX_SINKS, sock, hosts, port);
+    if (source->peer_count <= 0) {
+        ra_logger_error(g_logger, "Invalid sink list, expected up to %d sinks: %s", MAX_SINKS, hosts);
+        goto error;
+    }
+    for (int i = 0; i < source->peer_count; i++) {
+        ra_peer_t *peer = &source->peers[i];
+        ra_logger_info(logger, "Sink address: %s:%d", peer->host, peer->port);
+        if (send_handshake(peer)) goto error;
+        ra_logger_info(g_logger, "Initiated handshake with sink %s.", peer->host);
+    }
+
+    // A bare --metrics serves on the default port, always on the loopback interface only
+    int metrics_port = ra_config_get_int(options, "metrics", 0);
+    if (metrics_port == 1) metrics_port = RA_METRICS_SOURCE_PORT;
+    if (metrics_port > 0) {
+        metrics_server = ra_metrics_server_start(logger, "127.0.0.1", metrics_port, render_metrics, NULL, &err);
+        if (err) {
+            ra_logger_error(g_logger, "Failed to serve metrics at port %d", metrics_port);
+            goto error;
+        }
+    }
 
     is_running = true;
     if (!disable_signal_handlers) {
         signal(SIGINT, signal_handler);
         signal(SIGTERM, signal_handler);
+        ra_trace_install_signal_handlers(trace_file);
     }
+    ra_trace_set_thread_name("main");
+    if (ra_config_get_bool(options, "trace", 0)) ra_trace_set_enabled(true);
 
+    time_t last_group_announce = time(NULL);
+    time_t last_deadline_report = last_group_announce;
     while (is_running) {
         FD_ZERO(&readfds);
         FD_SET(sock, &readfds);
@@ -317,16 +703,30 @@ int source_main(ra_logger_t *logger, int argc, const char **argv) {
         }
         if (FD_ISSET(sock, &readfds)) {
             if (ra_buf_recvfrom(&conn, &buf) <= 0) goto error;
+            count_metric(NULL, RA_METRIC_PACKETS_RECEIVED, 1);
+            count_metric(NULL, RA_METRIC_BYTES_RECEIVED, buf.len);
             handle_message(&ctx);
         }
         time_t now = time(NULL);
-        if (source->last_heartbeat + HEARTBEAT_TIMEOUT_SECONDS <= now) {  // Heartbeat timeout
-            ra_logger_warn(g_logger, "Sink heartbeat timeout, re-attempting handshake.");
-            ra_stream_reset(stream);
-            if (source->state >= 2) Pa_StopStream(source->pa_stream);
-            if (send_handshake()) goto error;
-            source->state = 1;
+        for (int i = 0; i < source->peer_count; i++) {
+            ra_peer_t *peer = &source->peers[i];
+            if (peer->last_heartbeat + HEARTBEAT_TIMEOUT_SECONDS > now) continue;
+            ra_logger_warn(g_logger, "Sink %s heartbeat timeout, re-attempting handshake.", peer->host);
+            if (send_handshake(peer)) goto error;
+            publish_encoder_settings();
+        }
+        // Sinks that missed the group key get it again
+        if (source->multicast && last_group_announce + GROUP_ANNOUNCE_SECONDS <= now) {
+            for (int i = 0; i < source->peer_count; i++)
+                if (ra_peer_ready(&source->peers[i])) send_group(&source->peers[i]);
+            last_group_announce = now;
+        }
+        if (last_deadline_report + DEADLINE_REPORT_SECONDS <= now) {
+            report_callback_deadlines();
+            last_deadline_report = now;
         }
+        stop_capture_if_idle();
+        ra_trace_handle_requests();
     }
 
     goto cleanup;
@@ -336,16 +736,19 @@ error:
 
 cleanup:
     ra_logger_info(g_logger, "Shutting down source...");
-    ra_stream_destroy(stream);
-    if (encoder) opus_encoder_destroy(encoder);
-    if (pa_stream) {
-        Pa_StopStream(pa_stream);
-        Pa_CloseStream(pa_stream);
+    ra_metrics_server_stop(metrics_server);
+    if (trace_file || atomic_load(&ra_trace_enabled)) {
+        const char *path = trace_file ? trace_file : RA_TRACE_DEFAULT_FILE;
+        if (ra_trace_dump_file(path)) ra_logger_error(g_logger, "Failed to write the trace to %s", path);
     }
+    ra_encoder_destroy(encoder);
+    ra_audio_close_stream(audio);
+    ra_packet_pool_destroy(source->packets);
     if (sock >= 0) ra_socket_close(sock);
     ra_socket_deinit();
     ra_audio_deinit();
     ra_proto_deinit();
+    ra_config_destroy(opts);
     free(source);
 
     ra_logger_info(g_logger, "Source shutdown gracefully.");
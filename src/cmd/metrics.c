@@ -0,0 +1,104 @@
+// Queries the metrics endpoint of a running sink or source, printing the samples matching the filter
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "lib/config.h"
+#include "lib/logger.h"
+#include "lib/metrics.h"
+#include "lib/socket.h"
+#include "lib/string.h"
+
+#define RESPONSE_BUFFER_SIZE 65536
+
+// Reads the whole response, the server closes the connection once it's sent
+static char *fetch_metrics(SOCKET sock) {
+    static const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    if (send(sock, request, sizeof(request) - 1, 0) != sizeof(request) - 1) return NULL;
+
+    size_t len = 0, cap = RESPONSE_BUFFER_SIZE;
+    char *response = malloc(cap);
+    for (;;) {
+        if (len + 1 >= cap) {
+            cap *= 2;
+            response = realloc(response, cap);
+        }
+        int n = recv(sock, response + len, cap - len - 1, 0);
+        if (n < 0) {
+            free(response);
+            return NULL;
+        }
+        if (n == 0) break;
+        len += n;
+    }
+    response[len] = '\0';
+    return response;
+}
+
+// Without a filter everything is printed, with one only the samples containing it
+static int print_metrics(char *response, const char *filter) {
+    char *body = strstr(response, "\r\n\r\n");
+    if (strncmp(response, "HTTP/1.0 200", 12) != 0 || !body) {
+        char *endptr = strstr(response, "\r\n");
+        if (endptr) *endptr = '\0';
+        fprintf(stderr, "Unexpected response: %s\n", response);
+        return -1;
+    }
+    for (char *line = body + 4; *line;) {
+        char *endptr = strchr(line, '\n');
+        if (endptr) *endptr = '\0';
+        if (!filter || (line[0] != '#' && strstr(line, filter))) puts(line);
+        line = endptr ? endptr + 1 : line + strlen(line);
+    }
+    return 0;
+}
+
+int main(int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    argc = ra_config_parse_args(opts, argc, argv);
+    ra_config_section_t *options = ra_config_get_default_section(opts);
+    ra_logger_stream_t *stream = ra_logger_stream_create(stderr, stderr);
+    ra_logger_t *logger = ra_logger_create(stream, NULL);
+    const char *filter = ra_config_get_value(options, "filter");
+    const char *target = argc >= 2 ? argv[1] : "127.0.0.1";
+    int rc = EXIT_FAILURE;
+
+    SOCKET sock = -1;
+    char *response = NULL;
+    if (ra_socket_init(logger)) goto done;
+
+    struct sockaddr_in addr;
+    if (ra_sockaddr_parse(target, RA_METRICS_SINK_PORT, &addr)) {
+        fprintf(stderr,
+                "Usage: %s [host[:port]] [--filter=<substring>]\n"
+                "Sinks serve metrics on port %d and sources on port %d by default.\n",
+                argv[0],
+                RA_METRICS_SINK_PORT,
+                RA_METRICS_SOURCE_PORT);
+        goto cleanup;
+    }
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0) {
+        ra_socket_perror("socket");
+        goto cleanup;
+    }
+    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        ra_socket_perror("connect");
+        goto cleanup;
+    }
+    response = fetch_metrics(sock);
+    if (!response) {
+        ra_socket_perror("recv");
+        goto cleanup;
+    }
+    if (print_metrics(response, filter) == 0) rc = EXIT_SUCCESS;
+
+cleanup:
+    free(response);
+    if (sock >= 0) ra_socket_close(sock);
+    ra_socket_deinit();
+done:
+    ra_logger_destroy(logger);
+    ra_logger_stream_destroy(stream);
+    ra_config_destroy(opts);
+    return rc;
+}
@@ -1,9 +1,18 @@
 #include "app/sink.h"
 
+#include <string.h>
+
 #include "lib/logger.h"
 
+// The pipe backend plays out on the standard output, so the logs move over to the standard error
+static ra_logger_stream_t *create_logger_stream(int argc, const char **argv) {
+    for (int i = 1; i < argc; i++)
+        if (strcmp(argv[i], "--audio-backend=pipe") == 0) return ra_logger_stream_create(stderr, stderr);
+    return ra_logger_stream_create_default();
+}
+
 int main(int argc, const char **argv) {
-    ra_logger_stream_t *stream = ra_logger_stream_create_default();
+    ra_logger_stream_t *stream = create_logger_stream(argc, argv);
     ra_logger_t *logger = ra_logger_create(stream, NULL);
     int rc = sink_main(logger, argc, argv);
     ra_logger_destroy(logger);
@@ -0,0 +1,45 @@
+#include "alloc.h"
+
+#if defined(RA_ALLOC_GUARD) && defined(__GLIBC__)
+#include <string.h>
+#include <unistd.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static _Thread_local int guard_depth = 0;
+
+// Can't log from here, the logger may allocate too
+static void check_guard(const char *func) {
+    static const char msg[] = "Heap allocation inside a no-allocation section: ";
+    if (guard_depth == 0) return;
+    write(STDERR_FILENO, msg, sizeof(msg) - 1);
+    write(STDERR_FILENO, func, strlen(func));
+    write(STDERR_FILENO, "\n", 1);
+    abort();
+}
+
+void *malloc(size_t size) {
+    check_guard("malloc");
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    check_guard("calloc");
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    check_guard("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void ra_alloc_guard_enter() {
+    guard_depth++;
+}
+
+void ra_alloc_guard_leave() {
+    guard_depth--;
+}
+#endif
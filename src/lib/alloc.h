@@ -0,0 +1,18 @@
+#ifndef _RA_ALLOC_H
+#define _RA_ALLOC_H
+
+#include <stdlib.h>
+
+// Built with RA_ALLOC_GUARD, a heap allocation by a thread inside a no-allocation section aborts the process. The
+// allocator can only be interposed on glibc, elsewhere the sections compile to nothing.
+#if defined(RA_ALLOC_GUARD) && defined(__GLIBC__)
+void ra_alloc_guard_enter();
+void ra_alloc_guard_leave();
+#define RA_NO_ALLOC_BEGIN() ra_alloc_guard_enter()
+#define RA_NO_ALLOC_END()   ra_alloc_guard_leave()
+#else
+#define RA_NO_ALLOC_BEGIN() ((void)0)
+#define RA_NO_ALLOC_END()   ((void)0)
+#endif
+
+#endif
@@ -3,21 +3,29 @@
 
 #include <opus/opus.h>
 #include <portaudio.h>
+#include <stdbool.h>
 
 #include "logger.h"
 #include "types.h"
 
-#define MAX_CHANNELS      2
+#define MAX_CHANNELS      16
+#define DEFAULT_CHANNELS  2
 #define MAX_SAMPLE_SIZE   4
+#define MAX_FRAME_SIZE    5760
 #define FRAMES_PER_BUFFER 960
 #define OPUS_APPLICATION  OPUS_APPLICATION_AUDIO
 
-#define DECODE_BUFFER_SIZE 5760 * MAX_CHANNELS *MAX_SAMPLE_SIZE
+#define DECODE_BUFFER_SIZE MAX_FRAME_SIZE *MAX_CHANNELS *MAX_SAMPLE_SIZE
 #define ENCODE_BUFFER_SIZE DECODE_BUFFER_SIZE
-#define RING_BUFFER_SIZE   8 * DECODE_BUFFER_SIZE
+#define RING_BUFFER_FRAMES 8 * MAX_FRAME_SIZE
 
 #define ENCODE_HIGH_BANDWIDTH
 
+#define RA_AUDIO_BACKEND_PORTAUDIO "portaudio"
+#define RA_AUDIO_BACKEND_NULL      "null"
+#define RA_AUDIO_BACKEND_FILE      "file"
+#define RA_AUDIO_BACKEND_PIPE      "pipe"
+
 typedef enum {
     RA_AUDIO_DEVICE_OUTPUT,
     RA_AUDIO_DEVICE_INPUT,
@@ -26,6 +34,8 @@ typedef enum {
 typedef struct {
     ra_audio_device_type type;
     PaDeviceIndex device;
+    // Device as given by the user, the file and pipe backends take their path or format from it
+    const char *device_name;
     PaSampleFormat sample_format;
     int channel_count;
     int sample_rate;
@@ -33,14 +43,28 @@ typedef struct {
     size_t sample_size;
 } ra_audio_config_t;
 
+struct ra_audio_handle_t;
+typedef struct ra_audio_handle_t ra_audio_handle_t;
+
+// Picks the backend before ra_audio_init(), all but PortAudio run on their own clock either paced in realtime
+// or free-running as fast as the callback returns
+int ra_audio_set_backend(const char *name, bool realtime);
+const char *ra_audio_backend_name();
+
 int ra_audio_init(ra_logger_t *logger);
 void ra_audio_deinit();
 
 size_t ra_audio_sample_format_size(PaSampleFormat fmt);
 const char *ra_audio_sample_format_str(PaSampleFormat fmt);
 const char *ra_audio_device_type_str(ra_audio_device_type type);
-PaStream *ra_audio_create_stream(ra_audio_config_t *cfg, PaStreamCallback *callback, void *userdata);
-PaDeviceIndex ra_audio_find_device(ra_audio_config_t *cfg, const char *dev);
-const char *ra_audio_device_name(PaDeviceIndex device);
+int ra_audio_find_device(ra_audio_config_t *cfg, const char *dev);
+const char *ra_audio_device_name(const ra_audio_config_t *cfg);
+
+ra_audio_handle_t *ra_audio_create_stream(ra_audio_config_t *cfg, PaStreamCallback *callback, void *userdata);
+int ra_audio_start_stream(ra_audio_handle_t *handle);
+int ra_audio_stop_stream(ra_audio_handle_t *handle);
+void ra_audio_close_stream(ra_audio_handle_t *handle);
+// Device latency of an open stream in seconds, for host APIs that leave the callback timing at zero
+double ra_audio_stream_latency(ra_audio_handle_t *handle);
 
 #endif
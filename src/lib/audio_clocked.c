@@ -0,0 +1,445 @@
+#include "lib/private/audio.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "lib/clock.h"
+#include "lib/string.h"
+#include "lib/thread.h"
+#include "lib/wav.h"
+
+// Once the clock falls this far behind it starts over instead of calling back in a burst to catch up
+#define MAX_CLOCK_LAG_NS (100 * RA_NSEC_PER_MSEC)
+// How long a read from a quiet pipe waits before checking whether the stream was stopped
+#define PIPE_POLL_MSEC 50
+
+typedef struct clocked_handle_t clocked_handle_t;
+
+typedef struct {
+    // Reads return fewer frames than asked for at the end of the input
+    size_t (*read)(clocked_handle_t *handle, void *buf, size_t frames);
+    int (*write)(clocked_handle_t *handle, const void *buf, size_t frames);
+    void (*close)(clocked_handle_t *handle);
+} clocked_io_t;
+
+struct clocked_handle_t {
+    ra_audio_handle_t base;
+    const clocked_io_t *io;
+    ra_audio_config_t cfg;
+    PaStreamCallback *callback;
+    void *userdata;
+    ra_thread_t thread;
+    atomic_bool running;
+    char *buffer;
+    FILE *file;
+    ra_wav_reader_t *wav_reader;
+    ra_wav_writer_t *wav_writer;
+};
+
+static ra_logger_t *g_logger;
+static bool clock_realtime = true;
+
+void ra_audio_clock_set_realtime(bool realtime) {
+    clock_realtime = realtime;
+}
+
+static bool is_supported_format(PaSampleFormat fmt) {
+    for (const PaSampleFormat *ptr = ra_prioritized_sample_formats; *ptr != 0; ptr++)
+        if (*ptr == fmt) return true;
+    return false;
+}
+
+static bool is_supported_rate(int rate) {
+    for (const int *ptr = ra_prioritized_sample_rates; *ptr != 0; ptr++)
+        if (*ptr == rate) return true;
+    return false;
+}
+
+static void clock_thread(void *arg) {
+    clocked_handle_t *handle = arg;
+    const ra_audio_config_t *cfg = &handle->cfg;
+    const bool input = cfg->type == RA_AUDIO_DEVICE_INPUT;
+    const size_t frames = cfg->frame_size;
+    const size_t sz_frame = cfg->channel_count * cfg->sample_size;
+
+    // Deadlines are counted from the start so the rounding of a single period doesn't add up
+    uint64_t start = ra_clock_now_ns();
+    uint64_t ticks = 0;
+    PaStreamCallbackTimeInfo timeinfo = {0};
+    while (handle->running) {
+        if (clock_realtime) {
+            uint64_t deadline = start + ticks * frames * RA_NSEC_PER_SEC / cfg->sample_rate;
+            uint64_t now = ra_clock_now_ns();
+            if (now > deadline + MAX_CLOCK_LAG_NS) {
+                start = deadline = now;
+                ticks = 0;
+            }
+            ra_clock_sleep_until_ns(deadline);
+            ticks++;
+        }
+        PaTime now = (PaTime)ra_clock_now_ns() / RA_NSEC_PER_SEC;
+        timeinfo.currentTime = now;
+        timeinfo.inputBufferAdcTime = input ? now : 0;
+        timeinfo.outputBufferDacTime = input ? 0 : now;
+
+        int rc;
+        if (input) {
+            size_t read = handle->io->read(handle, handle->buffer, frames);
+            if (!handle->running) break;
+            if (read == 0) {
+                ra_logger_info(g_logger, "End of %s input", handle->base.backend->name);
+                break;
+            }
+            // The last buffer is padded with silence
+            memset(handle->buffer + read * sz_frame, 0, (frames - read) * sz_frame);
+            rc = handle->callback(handle->buffer, NULL, frames, &timeinfo, 0, handle->userdata);
+            if (read < frames) rc = paComplete;
+        } else {
+            rc = handle->callback(NULL, handle->buffer, frames, &timeinfo, 0, handle->userdata);
+            if (handle->io->write(handle, handle->buffer, frames)) {
+                ra_logger_error(g_logger, "Failed to write %s output", handle->base.backend->name);
+                break;
+            }
+        }
+        if (rc != paContinue) break;
+    }
+    handle->running = false;
+}
+
+static int clocked_init(ra_logger_t *logger) {
+    g_logger = logger;
+    return 0;
+}
+
+static void clocked_deinit() {}
+
+static const char *clocked_device_name(const ra_audio_config_t *cfg) {
+    return cfg->device_name ? cfg->device_name : "default";
+}
+
+// Fills in the format left unset, validating what the input or the remote end chose against what Opus takes
+static int clocked_config(ra_audio_config_t *cfg) {
+    if (!cfg->sample_format) cfg->sample_format = ra_prioritized_sample_formats[0];
+    if (!cfg->sample_rate) cfg->sample_rate = ra_prioritized_sample_rates[0];
+    if (!is_supported_format(cfg->sample_format)) {
+        ra_logger_error(g_logger, "Unsupported sample format: %s", ra_audio_sample_format_str(cfg->sample_format));
+        return -1;
+    }
+    if (!is_supported_rate(cfg->sample_rate)) {
+        ra_logger_error(g_logger, "Unsupported sample rate: %d", cfg->sample_rate);
+        return -1;
+    }
+    if (cfg->channel_count <= 0 || cfg->channel_count > MAX_CHANNELS) {
+        ra_logger_error(g_logger, "Unsupported channel count: %d", cfg->channel_count);
+        return -1;
+    }
+    cfg->sample_size = ra_audio_sample_format_size(cfg->sample_format);
+
+    ra_logger_info(g_logger, "Channel count: %d", cfg->channel_count);
+    ra_logger_info(g_logger, "Sample format: %s", ra_audio_sample_format_str(cfg->sample_format));
+    ra_logger_info(g_logger, "Sample rate: %d", cfg->sample_rate);
+    ra_logger_info(g_logger, "Clock: %s", clock_realtime ? "realtime" : "free-running");
+    return 0;
+}
+
+static ra_audio_handle_t *clocked_open(const ra_audio_backend_t *backend,
+                                       const clocked_io_t *io,
+                                       PaStreamCallback *callback,
+                                       void *userdata) {
+    clocked_handle_t *handle = calloc(1, sizeof(clocked_handle_t));
+    handle->base.backend = backend;
+    handle->io = io;
+    handle->callback = callback;
+    handle->userdata = userdata;
+    handle->running = false;
+    return &handle->base;
+}
+
+static int clocked_setup(clocked_handle_t *handle, ra_audio_config_t *cfg) {
+    if (clocked_config(cfg)) return -1;
+    handle->cfg = *cfg;
+    handle->buffer = malloc(cfg->frame_size * cfg->channel_count * cfg->sample_size);
+    return 0;
+}
+
+static int clocked_stop(ra_audio_handle_t *base) {
+    clocked_handle_t *handle = (clocked_handle_t *)base;
+    if (!handle->thread) return 0;
+    handle->running = false;
+    ra_thread_join(handle->thread);
+    ra_thread_destroy(handle->thread);
+    handle->thread = NULL;
+    return 0;
+}
+
+static int clocked_start(ra_audio_handle_t *base) {
+    clocked_handle_t *handle = (clocked_handle_t *)base;
+    if (handle->running) return 0;
+    // Reap the thread of a stream that ended on its own
+    clocked_stop(base);
+
+    int err;
+    handle->running = true;
+    handle->thread = ra_thread_start_sched(&clock_thread, handle, ra_thread_audio_sched(), &err);
+    if (err) {
+        ra_logger_error(g_logger, "Failed to start the %s clock thread", base->backend->name);
+        handle->running = false;
+        handle->thread = NULL;
+    }
+    return err;
+}
+
+static void clocked_close(ra_audio_handle_t *base) {
+    clocked_handle_t *handle = (clocked_handle_t *)base;
+    clocked_stop(base);
+    if (handle->io->close) handle->io->close(handle);
+    free(handle->buffer);
+    free(handle);
+}
+
+// Null backend, captures silence and discards playback
+
+static size_t null_read(clocked_handle_t *handle, void *buf, size_t frames) {
+    memset(buf, 0, frames * handle->cfg.channel_count * handle->cfg.sample_size);
+    return frames;
+}
+
+static int null_write(clocked_handle_t *handle, const void *buf, size_t frames) {
+    (void)handle;
+    (void)buf;
+    (void)frames;
+    return 0;
+}
+
+static const clocked_io_t null_io = {
+    .read = null_read,
+    .write = null_write,
+};
+
+static int null_find_device(ra_audio_config_t *cfg, const char *dev) {
+    (void)cfg;
+    (void)dev;
+    return 0;
+}
+
+static ra_audio_handle_t *null_open(ra_audio_config_t *cfg, PaStreamCallback *callback, void *userdata) {
+    ra_audio_handle_t *base = clocked_open(&ra_audio_backend_null, &null_io, callback, userdata);
+    if (clocked_setup((clocked_handle_t *)base, cfg)) {
+        clocked_close(base);
+        return NULL;
+    }
+    return base;
+}
+
+// File backend, plays a WAV file as the input and records the output into one
+
+static size_t file_read(clocked_handle_t *handle, void *buf, size_t frames) {
+    return ra_wav_reader_read(handle->wav_reader, buf, frames);
+}
+
+static int file_write(clocked_handle_t *handle, const void *buf, size_t frames) {
+    return ra_wav_writer_write(handle->wav_writer, buf, frames);
+}
+
+static void file_close(clocked_handle_t *handle) {
+    if (handle->wav_reader) ra_wav_reader_close(handle->wav_reader);
+    if (handle->wav_writer) ra_wav_writer_close(handle->wav_writer);
+    if (handle->file) fclose(handle->file);
+}
+
+static const clocked_io_t file_io = {
+    .read = file_read,
+    .write = file_write,
+    .close = file_close,
+};
+
+static int file_find_device(ra_audio_config_t *cfg, const char *dev) {
+    if (dev) return 0;
+    ra_logger_error(g_logger, "The file backend needs a WAV file path as the %s device",
+                    ra_audio_device_type_str(cfg->type));
+    return -1;
+}
+
+static PaSampleFormat wav_sample_format(const ra_wav_format_t *fmt) {
+    if (fmt->format == RA_WAV_FORMAT_FLOAT && fmt->bits_per_sample == 32) return paFloat32;
+    if (fmt->format != RA_WAV_FORMAT_PCM) return 0;
+    switch (fmt->bits_per_sample) {
+    case 32:
+        return paInt32;
+    case 24:
+        return paInt24;
+    case 16:
+        return paInt16;
+    default:
+        return 0;
+    }
+}
+
+static ra_audio_handle_t *file_open(ra_audio_config_t *cfg, PaStreamCallback *callback, void *userdata) {
+    ra_audio_handle_t *base = clocked_open(&ra_audio_backend_file, &file_io, callback, userdata);
+    clocked_handle_t *handle = (clocked_handle_t *)base;
+    const char *path = cfg->device_name;
+    bool input = cfg->type == RA_AUDIO_DEVICE_INPUT;
+
+    handle->file = fopen(path, input ? "rb" : "wb");
+    if (!handle->file) {
+        ra_logger_error(g_logger, "Failed to open %s", path);
+        goto error;
+    }
+
+    ra_wav_format_t fmt;
+    if (input) {
+        // The file decides the audio config, whatever was asked for
+        handle->wav_reader = ra_wav_reader_create(handle->file, &fmt);
+        if (!handle->wav_reader) {
+            ra_logger_error(g_logger, "Not a valid WAV file: %s", path);
+            goto error;
+        }
+        cfg->channel_count = fmt.channel_count;
+        cfg->sample_rate = fmt.sample_rate;
+        cfg->sample_format = wav_sample_format(&fmt);
+        if (clocked_setup(handle, cfg)) goto error;
+    } else {
+        if (clocked_setup(handle, cfg)) goto error;
+        fmt.format = cfg->sample_format == paFloat32 ? RA_WAV_FORMAT_FLOAT : RA_WAV_FORMAT_PCM;
+        fmt.channel_count = cfg->channel_count;
+        fmt.sample_rate = cfg->sample_rate;
+        fmt.bits_per_sample = cfg->sample_size * 8;
+        handle->wav_writer = ra_wav_writer_create(handle->file, &fmt);
+        if (!handle->wav_writer) {
+            ra_logger_error(g_logger, "Failed to write WAV header to %s", path);
+            goto error;
+        }
+    }
+    return base;
+
+error:
+    clocked_close(base);
+    return NULL;
+}
+
+// Pipe backend, raw interleaved PCM from the standard input or to the standard output
+
+// Waits for input in short slices so stopping the stream doesn't hang on a quiet pipe, false once stopped
+static bool pipe_wait_readable(clocked_handle_t *handle) {
+#ifdef _WIN32
+    HANDLE pipe = (HANDLE)_get_osfhandle(_fileno(handle->file));
+    while (handle->running) {
+        DWORD available = 0;
+        // Anything that isn't a pipe, or a pipe that was closed, is left for the read to tell
+        if (!PeekNamedPipe(pipe, NULL, 0, NULL, &available, NULL) || available > 0) return true;
+        Sleep(PIPE_POLL_MSEC);
+    }
+#else
+    struct pollfd pfd = {.fd = fileno(handle->file), .events = POLLIN};
+    while (handle->running) {
+        int rc = poll(&pfd, 1, PIPE_POLL_MSEC);
+        if (rc > 0 || (rc < 0 && errno != EINTR)) return true;
+    }
+#endif
+    return false;
+}
+
+// Reads the file descriptor directly, the stdio buffer would hide input from the wait above
+static size_t pipe_read(clocked_handle_t *handle, void *buf, size_t frames) {
+    size_t sz_frame = handle->cfg.channel_count * handle->cfg.sample_size;
+    size_t len = frames * sz_frame, filled = 0;
+    while (filled < len && pipe_wait_readable(handle)) {
+#ifdef _WIN32
+        int n = _read(_fileno(handle->file), (char *)buf + filled, (unsigned int)(len - filled));
+#else
+        ssize_t n = read(fileno(handle->file), (char *)buf + filled, len - filled);
+        if (n < 0 && errno == EINTR) continue;
+#endif
+        if (n <= 0) break;
+        filled += n;
+    }
+    return filled / sz_frame;
+}
+
+static int pipe_write(clocked_handle_t *handle, const void *buf, size_t frames) {
+    if (fwrite(buf, handle->cfg.channel_count * handle->cfg.sample_size, frames, handle->file) != frames) return -1;
+    return fflush(handle->file);
+}
+
+static const clocked_io_t pipe_io = {
+    .read = pipe_read,
+    .write = pipe_write,
+};
+
+// The device picks the raw format as <f32|s16>[:rate], output takes whatever the remote end sends
+static int pipe_find_device(ra_audio_config_t *cfg, const char *dev) {
+    if (!dev) return 0;
+    if (strncasecmp(dev, "f32", 3) == 0) {
+        cfg->sample_format = paFloat32;
+    } else if (strncasecmp(dev, "s16", 3) == 0) {
+        cfg->sample_format = paInt16;
+    } else {
+        ra_logger_error(g_logger, "Unknown raw sample format %s, expected f32 or s16", dev);
+        return -1;
+    }
+    const char *rate = strchr(dev, ':');
+    if (rate) cfg->sample_rate = atoi(rate + 1);
+    return 0;
+}
+
+static ra_audio_handle_t *pipe_open(ra_audio_config_t *cfg, PaStreamCallback *callback, void *userdata) {
+    ra_audio_handle_t *base = clocked_open(&ra_audio_backend_pipe, &pipe_io, callback, userdata);
+    clocked_handle_t *handle = (clocked_handle_t *)base;
+    if (clocked_setup(handle, cfg)) {
+        clocked_close(base);
+        return NULL;
+    }
+    handle->file = cfg->type == RA_AUDIO_DEVICE_INPUT ? stdin : stdout;
+#ifdef _WIN32
+    _setmode(_fileno(handle->file), _O_BINARY);
+#endif
+    return base;
+}
+
+const ra_audio_backend_t ra_audio_backend_null = {
+    .name = RA_AUDIO_BACKEND_NULL,
+    .init = clocked_init,
+    .deinit = clocked_deinit,
+    .find_device = null_find_device,
+    .device_name = clocked_device_name,
+    .open = null_open,
+    .start = clocked_start,
+    .stop = clocked_stop,
+    .close = clocked_close,
+};
+
+const ra_audio_backend_t ra_audio_backend_file = {
+    .name = RA_AUDIO_BACKEND_FILE,
+    .init = clocked_init,
+    .deinit = clocked_deinit,
+    .find_device = file_find_device,
+    .device_name = clocked_device_name,
+    .open = file_open,
+    .start = clocked_start,
+    .stop = clocked_stop,
+    .close = clocked_close,
+};
+
+const ra_audio_backend_t ra_audio_backend_pipe = {
+    .name = RA_AUDIO_BACKEND_PIPE,
+    .init = clocked_init,
+    .deinit = clocked_deinit,
+    .find_device = pipe_find_device,
+    .device_name = clocked_device_name,
+    .open = pipe_open,
+    .start = clocked_start,
+    .stop = clocked_stop,
+    .close = clocked_close,
+};
@@ -0,0 +1,209 @@
+#include "lib/private/audio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "lib/string.h"
+
+typedef struct {
+    ra_audio_handle_t base;
+    PaStream *stream;
+} pa_handle_t;
+
+static ra_logger_t *g_logger;
+
+static void print_pa_error(const char *cause, int err) {
+    ra_logger_error(g_logger, "%s: (%d) %s", cause, err, Pa_GetErrorText(err));
+}
+
+static void init_stream_params(ra_audio_config_t *cfg, const PaDeviceInfo *info, PaStreamParameters *params) {
+    memset(params, 0, sizeof(PaStreamParameters));
+    params->device = cfg->device;
+    params->channelCount = cfg->channel_count;
+    params->sampleFormat = cfg->sample_format;
+    params->suggestedLatency =
+        cfg->type == RA_AUDIO_DEVICE_INPUT ? info->defaultLowInputLatency : info->defaultLowOutputLatency;
+}
+
+static void copy_stream_params(PaStreamParameters *dst, const PaStreamParameters *src) {
+    memcpy(dst, src, sizeof(PaStreamParameters));
+}
+
+static void assign_stream_params(ra_audio_device_type type,
+                                 PaStreamParameters *params,
+                                 PaStreamParameters **inparams,
+                                 PaStreamParameters **outparams) {
+    if (type == RA_AUDIO_DEVICE_INPUT) {
+        *inparams = params;
+        *outparams = NULL;
+    } else {
+        *outparams = params;
+        *inparams = NULL;
+    }
+}
+
+static int find_sample_rate(ra_audio_device_type type, const PaStreamParameters *params, int *err) {
+    PaStreamParameters temp;
+    copy_stream_params(&temp, params);
+    PaStreamParameters *inparams, *outparams;
+    assign_stream_params(type, &temp, &inparams, &outparams);
+    for (const int *rate_ptr = ra_prioritized_sample_rates; *rate_ptr != 0; rate_ptr++) {
+        *err = Pa_IsFormatSupported(inparams, outparams, *rate_ptr);
+        if (*err == paFormatIsSupported) return *rate_ptr;
+    }
+    return 0;
+}
+
+static PaSampleFormat find_sample_format(ra_audio_device_type type,
+                                         const PaDeviceInfo *info,
+                                         const PaStreamParameters *params,
+                                         int *err) {
+    PaStreamParameters temp;
+    copy_stream_params(&temp, params);
+    PaStreamParameters *inparams, *outparams;
+    assign_stream_params(type, &temp, &inparams, &outparams);
+    for (const PaSampleFormat *fmt_ptr = ra_prioritized_sample_formats; *fmt_ptr != 0; fmt_ptr++) {
+        temp.sampleFormat = *fmt_ptr;
+        *err = Pa_IsFormatSupported(inparams, outparams, info->defaultSampleRate);
+        if (*err == paFormatIsSupported) return *fmt_ptr;
+    }
+    return 0;
+}
+
+static int pa_init(ra_logger_t *logger) {
+    g_logger = logger;
+    int err = Pa_Initialize();
+    if (err) print_pa_error("Failed to initialize audio library", err);
+    return err;
+}
+
+static void pa_deinit() {
+    Pa_Terminate();
+}
+
+static ra_audio_handle_t *pa_open(ra_audio_config_t *cfg, PaStreamCallback *callback, void *userdata) {
+    int err = paNoError;
+    const char *devtype = ra_audio_device_type_str(cfg->type);
+    const PaDeviceInfo *info = Pa_GetDeviceInfo(cfg->device);
+    if (!info) {
+        ra_logger_error(g_logger, "Couldn't get %s device info", devtype);
+        return NULL;
+    }
+
+    PaStream *stream;
+    PaStreamParameters params;
+    init_stream_params(cfg, info, &params);
+
+    if (!cfg->sample_format) {
+        cfg->sample_format = find_sample_format(cfg->type, info, &params, &err);
+        if (err != paFormatIsSupported) {
+            print_pa_error("No supported sample format found for the device", err);
+            return NULL;
+        }
+        params.sampleFormat = cfg->sample_format;
+    }
+    if (!cfg->sample_rate) {
+        cfg->sample_rate = find_sample_rate(cfg->type, &params, &err);
+        if (err != paFormatIsSupported) {
+            print_pa_error("No supported sample rate found for the device", err);
+            return NULL;
+        }
+    }
+    cfg->sample_size = ra_audio_sample_format_size(cfg->sample_format);
+
+    ra_logger_info(g_logger, "Channel count: %d", cfg->channel_count);
+    ra_logger_info(g_logger, "Sample format: %s", ra_audio_sample_format_str(cfg->sample_format));
+    ra_logger_info(g_logger, "Sample rate: %d", cfg->sample_rate);
+
+    PaStreamParameters *inparams, *outparams;
+    assign_stream_params(cfg->type, &params, &inparams, &outparams);
+    err = Pa_OpenStream(&stream, inparams, outparams, cfg->sample_rate, cfg->frame_size, 0, callback, userdata);
+    if (err != paNoError) {
+        print_pa_error("Failed to open stream", err);
+        return NULL;
+    }
+
+    pa_handle_t *handle = malloc(sizeof(pa_handle_t));
+    handle->base.backend = &ra_audio_backend_portaudio;
+    handle->stream = stream;
+    return &handle->base;
+}
+
+static int pa_start(ra_audio_handle_t *handle) {
+    int err = Pa_StartStream(((pa_handle_t *)handle)->stream);
+    if (err) print_pa_error("Failed to start stream", err);
+    return err;
+}
+
+static int pa_stop(ra_audio_handle_t *handle) {
+    return Pa_StopStream(((pa_handle_t *)handle)->stream);
+}
+
+static void pa_close(ra_audio_handle_t *handle) {
+    pa_handle_t *pa_handle = (pa_handle_t *)handle;
+    Pa_StopStream(pa_handle->stream);
+    Pa_CloseStream(pa_handle->stream);
+    free(pa_handle);
+}
+
+static int pa_find_device(ra_audio_config_t *cfg, const char *dev) {
+    const char *devtype = ra_audio_device_type_str(cfg->type);
+    PaDeviceIndex index = cfg->device = paNoDevice;
+    const PaDeviceInfo *info;
+
+    if (dev) {
+        int count = Pa_GetDeviceCount();
+        for (index = 0; index < count; index++) {
+            info = Pa_GetDeviceInfo(index);
+            if (strncasecmp(dev, info->name, strlen(dev)))
+                continue;
+            else if (cfg->type == RA_AUDIO_DEVICE_INPUT && info->maxInputChannels <= 0)
+                continue;
+            else if (cfg->type == RA_AUDIO_DEVICE_OUTPUT && info->maxOutputChannels <= 0)
+                continue;
+            break;
+        }
+        if (index >= count) {
+            ra_logger_error(g_logger, "No %s device found: %s", devtype, dev);
+            return -1;
+        }
+    } else {
+        index = cfg->type == RA_AUDIO_DEVICE_INPUT ? Pa_GetDefaultInputDevice() : Pa_GetDefaultOutputDevice();
+        if (index == paNoDevice) {
+            ra_logger_error(g_logger, "No default %s device found.", devtype);
+            return -1;
+        }
+        info = Pa_GetDeviceInfo(index);
+    }
+
+    cfg->device = index;
+    if (cfg->type == RA_AUDIO_DEVICE_INPUT && info->maxInputChannels < cfg->channel_count)
+        cfg->channel_count = info->maxInputChannels;
+    else if (cfg->type == RA_AUDIO_DEVICE_OUTPUT && info->maxOutputChannels < cfg->channel_count)
+        cfg->channel_count = info->maxOutputChannels;
+    return 0;
+}
+
+// Streams only go one way, so only one of the latencies is set
+static double pa_latency(ra_audio_handle_t *handle) {
+    const PaStreamInfo *info = Pa_GetStreamInfo(((pa_handle_t *)handle)->stream);
+    return info ? info->inputLatency + info->outputLatency : 0;
+}
+
+static const char *pa_device_name(const ra_audio_config_t *cfg) {
+    const PaDeviceInfo *info = Pa_GetDeviceInfo(cfg->device);
+    return info ? info->name : "Unknown";
+}
+
+const ra_audio_backend_t ra_audio_backend_portaudio = {
+    .name = RA_AUDIO_BACKEND_PORTAUDIO,
+    .init = pa_init,
+    .deinit = pa_deinit,
+    .find_device = pa_find_device,
+    .device_name = pa_device_name,
+    .open = pa_open,
+    .start = pa_start,
+    .stop = pa_stop,
+    .close = pa_close,
+    .latency = pa_latency,
+};
@@ -0,0 +1,24 @@
+#ifndef _RA_CLOCK_H
+#define _RA_CLOCK_H
+
+#include <stdint.h>
+#include <time.h>
+
+#define RA_NSEC_PER_USEC 1000ULL
+#define RA_NSEC_PER_MSEC 1000000ULL
+#define RA_NSEC_PER_SEC  1000000000ULL
+
+// Monotonic clock in nanoseconds, unaffected by wall clock adjustments
+uint64_t ra_clock_now_ns();
+uint64_t ra_clock_now_us();
+
+// CPU time spent by the calling thread, user and system
+uint64_t ra_clock_thread_cpu_ns();
+
+// Sleeps until the monotonic clock reaches the deadline, returning right away when it already passed
+void ra_clock_sleep_until_ns(uint64_t deadline);
+
+// Local calendar time into the caller's struct, safe to call from any thread unlike localtime()
+int ra_clock_localtime(time_t time, struct tm *tm);
+
+#endif
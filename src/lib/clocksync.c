@@ -0,0 +1,25 @@
+#include "clocksync.h"
+
+void ra_clock_sync_reset(ra_clock_sync_t *sync) {
+    sync->count = 0;
+    sync->next = 0;
+}
+
+void ra_clock_sync_update(ra_clock_sync_t *sync, uint64_t sent_ns, uint64_t remote_ns, uint64_t recv_ns) {
+    if (recv_ns < sent_ns) return;
+    ra_clock_sample_t *sample = &sync->samples[sync->next];
+    sample->rtt_ns = recv_ns - sent_ns;
+    // The peer is assumed to have answered halfway through the round trip
+    sample->offset_ns = (int64_t)(sent_ns + sample->rtt_ns / 2 - remote_ns);
+    sync->next = (sync->next + 1) % RA_CLOCK_SYNC_SAMPLES;
+    if (sync->count < RA_CLOCK_SYNC_SAMPLES) sync->count++;
+}
+
+int ra_clock_sync_get(const ra_clock_sync_t *sync, ra_clock_sample_t *sample) {
+    if (sync->count == 0) return -1;
+    const ra_clock_sample_t *best = &sync->samples[0];
+    for (int i = 1; i < sync->count; i++)
+        if (sync->samples[i].rtt_ns < best->rtt_ns) best = &sync->samples[i];
+    *sample = *best;
+    return 0;
+}
@@ -0,0 +1,28 @@
+#ifndef _RA_CLOCKSYNC_H
+#define _RA_CLOCKSYNC_H
+
+#include <stdint.h>
+
+// Round trips kept to pick the offset from, about half a minute at the sink's heartbeat interval
+#define RA_CLOCK_SYNC_SAMPLES 8
+
+typedef struct {
+    int64_t offset_ns;  // Added to a remote time to get the local time
+    uint64_t rtt_ns;
+} ra_clock_sample_t;
+
+// Estimates the offset between a peer's monotonic clock and ours from timestamped round trips, NTP style
+typedef struct {
+    ra_clock_sample_t samples[RA_CLOCK_SYNC_SAMPLES];
+    int count;
+    int next;
+} ra_clock_sync_t;
+
+void ra_clock_sync_reset(ra_clock_sync_t *sync);
+// Adds the exchange sent at local time sent_ns, answered at the peer's remote_ns and received back at recv_ns
+void ra_clock_sync_update(ra_clock_sync_t *sync, uint64_t sent_ns, uint64_t remote_ns, uint64_t recv_ns);
+// Picks the sample with the shortest round trip, the one with the least room for asymmetric delays.
+// Returns -1 until a round trip completed.
+int ra_clock_sync_get(const ra_clock_sync_t *sync, ra_clock_sample_t *sample);
+
+#endif
@@ -0,0 +1,452 @@
+#include "codec.h"
+
+#include <stdlib.h>
+
+#include "string.h"
+#include "thread.h"
+#include "trace.h"
+#include "types.h"
+#include "workers.h"
+
+// Worst case packet for one elementary stream, six 20 ms frames at the maximum frame size
+#define MAX_STREAM_PACKET_SIZE (1275 * 6 + 8)
+
+typedef struct {
+    int channel_count;
+    int streams;
+    int coupled_streams;
+    unsigned char channels[MAX_CHANNELS];  // Interleaved channel index of each of the group's channels
+    unsigned char mapping[MAX_CHANNELS];
+    char *pcm;
+    unsigned char *packet;
+    opus_int32 packet_len;
+    int result;
+} codec_group_t;
+
+struct ra_encoder_t {
+    ra_audio_config_t cfg;
+    ra_channel_layout_t layout;
+    codec_group_t *groups;
+    OpusMSEncoder **encoders;
+    ra_workers_t *workers;
+    const void *pcm;
+    int frames;
+    opus_int32 maxlen;
+};
+
+struct ra_decoder_t {
+    ra_audio_config_t cfg;
+    ra_channel_layout_t layout;
+    codec_group_t *groups;
+    OpusMSDecoder **decoders;
+    ra_workers_t *workers;  // Borrowed, not destroyed with the decoder
+    float *pcm;
+    int frames;
+    int fec;
+};
+
+// Vorbis channel order, matching what libopus uses for mapping family 1
+static const struct {
+    int streams;
+    int coupled_streams;
+    unsigned char mapping[8];
+} surround_layouts[8] = {
+    {1, 0, {0}},
+    {1, 1, {0, 1}},
+    {2, 1, {0, 2, 1}},
+    {2, 2, {0, 1, 2, 3}},
+    {3, 2, {0, 4, 1, 2, 3}},
+    {4, 2, {0, 4, 1, 2, 3, 5}},
+    {4, 3, {0, 4, 1, 2, 3, 5, 6}},
+    {5, 3, {0, 6, 1, 2, 3, 4, 5, 7}},
+};
+
+int ra_channel_layout_init(ra_channel_layout_t *layout, int channel_count, int mapping_family, int groups) {
+    if (channel_count < 1 || channel_count > MAX_CHANNELS) return OPUS_BAD_ARG;
+    layout->channel_count = channel_count;
+    switch (mapping_family) {
+    case RA_MAPPING_FAMILY_MONO_STEREO:
+    case RA_MAPPING_FAMILY_SURROUND:
+        if (channel_count > (mapping_family == RA_MAPPING_FAMILY_SURROUND ? 8 : 2)) return OPUS_BAD_ARG;
+        layout->streams = surround_layouts[channel_count - 1].streams;
+        layout->coupled_streams = surround_layouts[channel_count - 1].coupled_streams;
+        memcpy(layout->mapping, surround_layouts[channel_count - 1].mapping, channel_count);
+        break;
+    case RA_MAPPING_FAMILY_DISCRETE:
+        layout->streams = channel_count;
+        layout->coupled_streams = 0;
+        for (int i = 0; i < channel_count; i++) layout->mapping[i] = i;
+        break;
+    default:
+        return OPUS_BAD_ARG;
+    }
+    layout->groups = groups > 0 ? groups : ra_channel_layout_default_groups(layout);
+    if (layout->groups > layout->streams) layout->groups = layout->streams;
+    return OPUS_OK;
+}
+
+int ra_channel_layout_default_groups(const ra_channel_layout_t *layout) {
+    int groups = layout->streams / RA_CODEC_STREAMS_PER_GROUP;
+    int cpus = ra_cpu_count();
+    if (groups > cpus) groups = cpus;
+    return groups > 1 ? groups : 1;
+}
+
+int ra_channel_layout_validate(const ra_channel_layout_t *layout) {
+    if (layout->channel_count < 1 || layout->channel_count > MAX_CHANNELS) return -1;
+    if (layout->streams < 1 || layout->coupled_streams < 0 || layout->coupled_streams > layout->streams) return -1;
+    if (layout->streams + layout->coupled_streams > 255) return -1;
+    if (layout->groups < 1 || layout->groups > layout->streams) return -1;
+    for (int i = 0; i < layout->channel_count; i++) {
+        int m = layout->mapping[i];
+        if (m != 255 && m >= layout->streams + layout->coupled_streams) return -1;
+    }
+    return 0;
+}
+
+// Mapping family matching the layout, for containers that have to declare it
+int ra_channel_layout_mapping_family(const ra_channel_layout_t *layout) {
+    static const int families[] = {RA_MAPPING_FAMILY_MONO_STEREO, RA_MAPPING_FAMILY_SURROUND};
+    for (int i = 0; i < 2; i++) {
+        ra_channel_layout_t expected;
+        if (ra_channel_layout_init(&expected, layout->channel_count, families[i], 1)) continue;
+        if (expected.streams == layout->streams && expected.coupled_streams == layout->coupled_streams &&
+            memcmp(expected.mapping, layout->mapping, layout->channel_count) == 0)
+            return families[i];
+    }
+    return RA_MAPPING_FAMILY_DISCRETE;
+}
+
+// Picks the channels belonging to a contiguous range of elementary streams and remaps them for a group-local coder
+static void group_init(codec_group_t *group, const ra_channel_layout_t *layout, int index) {
+    int first = index * layout->streams / layout->groups;
+    int last = (index + 1) * layout->streams / layout->groups;
+    int coupled = layout->coupled_streams;
+
+    group->streams = last - first;
+    group->coupled_streams = coupled > first ? (coupled < last ? coupled : last) - first : 0;
+    group->channel_count = 0;
+    for (int i = 0; i < layout->channel_count; i++) {
+        int m = layout->mapping[i];
+        if (m == 255) continue;
+        int stream = m < 2 * coupled ? m / 2 : m - coupled;
+        if (stream < first || stream >= last) continue;
+
+        int local = stream - first;
+        int n = group->channel_count++;
+        group->channels[n] = i;
+        group->mapping[n] = local < group->coupled_streams ? 2 * local + m % 2 : group->coupled_streams + local;
+    }
+}
+
+static codec_group_t *groups_create(const ra_channel_layout_t *layout, size_t sample_size) {
+    codec_group_t *groups = calloc(layout->groups, sizeof(codec_group_t));
+    for (int i = 0; i < layout->groups; i++) {
+        codec_group_t *group = &groups[i];
+        group_init(group, layout, i);
+        if (layout->groups <= 1) continue;
+        group->pcm = malloc(MAX_FRAME_SIZE * group->channel_count * sample_size);
+        group->packet = malloc(MAX_STREAM_PACKET_SIZE * group->streams);
+    }
+    return groups;
+}
+
+static void groups_destroy(codec_group_t *groups, int count) {
+    if (!groups) return;
+    for (int i = 0; i < count; i++) {
+        free(groups[i].pcm);
+        free(groups[i].packet);
+    }
+    free(groups);
+}
+
+ra_workers_t *ra_codec_workers_create(int groups, int *err) {
+    *err = 0;
+    if (groups <= 1) return NULL;
+    int threads = ra_cpu_count();
+    if (threads > groups) threads = groups;
+    return ra_workers_create(threads - 1, err);
+}
+
+static void encode_group(void *data, int index) {
+    ra_encoder_t *enc = data;
+    codec_group_t *group = &enc->groups[index];
+    int channels = enc->cfg.channel_count, frames = enc->frames;
+    // Each group gets its share of the output buffer by stream count, less the framing
+    opus_int32 maxlen = (enc->maxlen - 2 * enc->layout.groups) * group->streams / enc->layout.streams;
+    if (maxlen > MAX_STREAM_PACKET_SIZE * group->streams) maxlen = MAX_STREAM_PACKET_SIZE * group->streams;
+
+    if (enc->cfg.sample_format == paFloat32) {
+        const float *in = enc->pcm;
+        float *out = (float *)group->pcm;
+        for (int f = 0; f < frames; f++, in += channels)
+            for (int c = 0; c < group->channel_count; c++) *out++ = in[group->channels[c]];
+        group->result = opus_multistream_encode_float(
+            enc->encoders[index], (float *)group->pcm, frames, group->packet, maxlen);
+    } else {
+        const opus_int16 *in = enc->pcm;
+        opus_int16 *out = (opus_int16 *)group->pcm;
+        for (int f = 0; f < frames; f++, in += channels)
+            for (int c = 0; c < group->channel_count; c++) *out++ = in[group->channels[c]];
+        group->result = opus_multistream_encode(
+            enc->encoders[index], (opus_int16 *)group->pcm, frames, group->packet, maxlen);
+    }
+    group->packet_len = group->result > 0 ? group->result : 0;
+}
+
+ra_encoder_t *ra_encoder_create(const ra_audio_config_t *cfg,
+                                const ra_channel_layout_t *layout,
+                                int mapping_family,
+                                int application,
+                                int *err) {
+    if (ra_channel_layout_validate(layout) || layout->channel_count != cfg->channel_count) {
+        *err = OPUS_BAD_ARG;
+        return NULL;
+    }
+
+    ra_encoder_t *enc = calloc(1, sizeof(ra_encoder_t));
+    enc->cfg = *cfg;
+    enc->layout = *layout;
+    enc->groups = groups_create(layout, cfg->sample_size);
+    enc->encoders = calloc(layout->groups, sizeof(OpusMSEncoder *));
+
+    if (layout->groups == 1 && mapping_family != RA_MAPPING_FAMILY_DISCRETE) {
+        // Surround encoder for the whole layout, so LFE and surround masking are handled by libopus
+        int streams, coupled_streams;
+        unsigned char mapping[MAX_CHANNELS];
+        enc->encoders[0] = opus_multistream_surround_encoder_create(cfg->sample_rate,
+                                                                    cfg->channel_count,
+                                                                    mapping_family,
+                                                                    &streams,
+                                                                    &coupled_streams,
+                                                                    mapping,
+                                                                    application,
+                                                                    err);
+        if (*err) goto error;
+    } else {
+        for (int i = 0; i < layout->groups; i++) {
+            codec_group_t *group = &enc->groups[i];
+            enc->encoders[i] = opus_multistream_encoder_create(cfg->sample_rate,
+                                                               group->channel_count,
+                                                               group->streams,
+                                                               group->coupled_streams,
+                                                               group->mapping,
+                                                               application,
+                                                               err);
+            if (*err) goto error;
+        }
+    }
+
+    enc->workers = ra_codec_workers_create(layout->groups, err);
+    if (*err) goto error;
+    return enc;
+
+error:
+    ra_encoder_destroy(enc);
+    return NULL;
+}
+
+int ra_encoder_ctl(ra_encoder_t *enc, int request, opus_int32 value) {
+    int err = OPUS_OK;
+    for (int i = 0; i < enc->layout.groups; i++) {
+        opus_int32 group_value = value;
+        // Bitrate is split across groups in proportion to their channels
+        if (request == OPUS_SET_BITRATE_REQUEST && value > 0 && enc->layout.groups > 1)
+            group_value = value * enc->groups[i].channel_count / enc->layout.channel_count;
+        int res = opus_multistream_encoder_ctl(enc->encoders[i], request, group_value);
+        if (res != OPUS_OK) err = res;
+    }
+    return err;
+}
+
+// Groups are framed as a 16-bit length for each group but the last, followed by the group packets
+static opus_int32 encode(ra_encoder_t *enc, const void *pcm, int frames, unsigned char *data, opus_int32 maxlen) {
+    if (enc->layout.groups == 1) {
+        return enc->cfg.sample_format == paFloat32
+                   ? opus_multistream_encode_float(enc->encoders[0], pcm, frames, data, maxlen)
+                   : opus_multistream_encode(enc->encoders[0], pcm, frames, data, maxlen);
+    }
+    if (frames > MAX_FRAME_SIZE) return OPUS_BAD_ARG;
+
+    enc->pcm = pcm;
+    enc->frames = frames;
+    enc->maxlen = maxlen;
+    ra_workers_run(enc->workers, &encode_group, enc, enc->layout.groups);
+
+    unsigned char *wptr = data;
+    unsigned char *endptr = data + maxlen;
+    for (int i = 0; i < enc->layout.groups; i++) {
+        codec_group_t *group = &enc->groups[i];
+        if (group->result < 0) return group->result;
+        int last = i == enc->layout.groups - 1;
+        if (wptr + (last ? 0 : 2) + group->packet_len > endptr) return OPUS_BUFFER_TOO_SMALL;
+        if (!last) {
+            uint16_to_bytes((char *)wptr, group->packet_len);
+            wptr += 2;
+        }
+        memcpy(wptr, group->packet, group->packet_len);
+        wptr += group->packet_len;
+    }
+    return wptr - data;
+}
+
+opus_int32 ra_encode(ra_encoder_t *enc, const void *pcm, int frames, unsigned char *data, opus_int32 maxlen) {
+    uint64_t trace_start = RA_TRACE_BEGIN();
+    opus_int32 res = encode(enc, pcm, frames, data, maxlen);
+    RA_TRACE_END(RA_TRACE_ENCODE, trace_start);
+    return res;
+}
+
+void ra_encoder_destroy(ra_encoder_t *enc) {
+    if (!enc) return;
+    ra_workers_destroy(enc->workers);
+    for (int i = 0; i < enc->layout.groups; i++)
+        if (enc->encoders[i]) opus_multistream_encoder_destroy(enc->encoders[i]);
+    free(enc->encoders);
+    groups_destroy(enc->groups, enc->layout.groups);
+    free(enc);
+}
+
+static void decode_group(void *data, int index) {
+    ra_decoder_t *dec = data;
+    codec_group_t *group = &dec->groups[index];
+    const unsigned char *packet = group->packet_len > 0 ? group->packet : NULL;
+    group->result = opus_multistream_decode_float(
+        dec->decoders[index], packet, group->packet_len, (float *)group->pcm, dec->frames, dec->fec);
+    if (group->result <= 0) return;
+
+    int channels = dec->cfg.channel_count;
+    const float *in = (float *)group->pcm;
+    float *out = dec->pcm;
+    for (int f = 0; f < group->result; f++, out += channels)
+        for (int c = 0; c < group->channel_count; c++) out[group->channels[c]] = *in++;
+}
+
+// Initializes the decoder states in the memory they already have, the same as creating them afresh
+static int decoders_init(ra_decoder_t *dec) {
+    const ra_channel_layout_t *layout = &dec->layout;
+    int single = layout->groups == 1;
+    for (int i = 0; i < layout->groups; i++) {
+        const codec_group_t *group = &dec->groups[i];
+        int err = opus_multistream_decoder_init(dec->decoders[i],
+                                                dec->cfg.sample_rate,
+                                                single ? layout->channel_count : group->channel_count,
+                                                single ? layout->streams : group->streams,
+                                                single ? layout->coupled_streams : group->coupled_streams,
+                                                single ? layout->mapping : group->mapping);
+        if (err) return err;
+    }
+    return OPUS_OK;
+}
+
+int ra_channel_layout_equal(const ra_channel_layout_t *a, const ra_channel_layout_t *b) {
+    return a->channel_count == b->channel_count && a->streams == b->streams &&
+           a->coupled_streams == b->coupled_streams && a->groups == b->groups &&
+           memcmp(a->mapping, b->mapping, a->channel_count) == 0;
+}
+
+ra_decoder_t *ra_decoder_create(const ra_audio_config_t *cfg,
+                                const ra_channel_layout_t *layout,
+                                ra_workers_t *workers,
+                                int *err) {
+    if (ra_channel_layout_validate(layout) || layout->channel_count != cfg->channel_count) {
+        *err = OPUS_BAD_ARG;
+        return NULL;
+    }
+
+    ra_decoder_t *dec = calloc(1, sizeof(ra_decoder_t));
+    dec->cfg = *cfg;
+    dec->layout = *layout;
+    dec->workers = workers;
+    dec->groups = groups_create(layout, sizeof(float));
+    dec->decoders = calloc(layout->groups, sizeof(OpusMSDecoder *));
+
+    // Sized up front so a reset can initialize the states again without allocating
+    for (int i = 0; i < layout->groups; i++) {
+        const codec_group_t *group = &dec->groups[i];
+        int single = layout->groups == 1;
+        opus_int32 size = opus_multistream_decoder_get_size(single ? layout->streams : group->streams,
+                                                            single ? layout->coupled_streams : group->coupled_streams);
+        dec->decoders[i] = size > 0 ? malloc(size) : NULL;
+        if (!dec->decoders[i]) {
+            *err = OPUS_ALLOC_FAIL;
+            goto error;
+        }
+    }
+    *err = decoders_init(dec);
+    if (*err) goto error;
+    return dec;
+
+error:
+    ra_decoder_destroy(dec);
+    return NULL;
+}
+
+static int decode(ra_decoder_t *dec, const unsigned char *data, opus_int32 len, float *pcm, int frames, int fec) {
+    if (dec->layout.groups == 1) return opus_multistream_decode_float(dec->decoders[0], data, len, pcm, frames, fec);
+    if (frames > MAX_FRAME_SIZE) return OPUS_BAD_ARG;
+
+    // Split the packet into the group packets, no data means concealing lost packets for every group
+    const unsigned char *rptr = data;
+    const unsigned char *endptr = data ? data + len : NULL;
+    for (int i = 0; i < dec->layout.groups; i++) {
+        codec_group_t *group = &dec->groups[i];
+        if (!data) {
+            group->packet_len = 0;
+            continue;
+        }
+        int last = i == dec->layout.groups - 1;
+        opus_int32 group_len = last ? endptr - rptr : 0;
+        if (!last) {
+            if (rptr + 2 > endptr) return OPUS_INVALID_PACKET;
+            group_len = bytes_to_uint16((const char *)rptr);
+            rptr += 2;
+        }
+        if (group_len > MAX_STREAM_PACKET_SIZE * group->streams || rptr + group_len > endptr)
+            return OPUS_INVALID_PACKET;
+        memcpy(group->packet, rptr, group_len);
+        group->packet_len = group_len;
+        rptr += group_len;
+    }
+
+    // Channels without a stream aren't written by any group
+    for (int c = 0; c < dec->layout.channel_count; c++) {
+        if (dec->layout.mapping[c] != 255) continue;
+        for (int f = 0; f < frames; f++) pcm[f * dec->layout.channel_count + c] = 0;
+    }
+
+    dec->pcm = pcm;
+    dec->frames = frames;
+    dec->fec = fec;
+    ra_workers_run(dec->workers, &decode_group, dec, dec->layout.groups);
+
+    int samples = dec->groups[0].result;
+    for (int i = 0; i < dec->layout.groups; i++) {
+        int result = dec->groups[i].result;
+        if (result < 0) return result;
+        if (result != samples) return OPUS_INVALID_PACKET;
+    }
+    return samples;
+}
+
+int ra_decoder_reset(ra_decoder_t *dec, const ra_audio_config_t *cfg, const ra_channel_layout_t *layout) {
+    if (dec->cfg.sample_rate != cfg->sample_rate || dec->cfg.channel_count != cfg->channel_count ||
+        !ra_channel_layout_equal(&dec->layout, layout))
+        return OPUS_BAD_ARG;
+    return decoders_init(dec);
+}
+
+int ra_decode_float(ra_decoder_t *dec, const unsigned char *data, opus_int32 len, float *pcm, int frames, int fec) {
+    uint64_t trace_start = RA_TRACE_BEGIN();
+    int res = decode(dec, data, len, pcm, frames, fec);
+    RA_TRACE_END(RA_TRACE_DECODE, trace_start);
+    return res;
+}
+
+void ra_decoder_destroy(ra_decoder_t *dec) {
+    if (!dec) return;
+    for (int i = 0; i < dec->layout.groups; i++) free(dec->decoders[i]);
+    free(dec->decoders);
+    groups_destroy(dec->groups, dec->layout.groups);
+    free(dec);
+}
@@ -0,0 +1,59 @@
+#ifndef _RA_CODEC_H
+#define _RA_CODEC_H
+
+#include <opus/opus_multistream.h>
+
+#include "audio.h"
+#include "workers.h"
+
+#define RA_MAPPING_FAMILY_MONO_STEREO 0
+#define RA_MAPPING_FAMILY_SURROUND    1
+#define RA_MAPPING_FAMILY_DISCRETE    255
+
+// Elementary streams per group before spreading the groups across threads
+#define RA_CODEC_STREAMS_PER_GROUP 4
+
+// Opus multistream channel layout, elementary streams are split into groups coded independently and in parallel
+typedef struct {
+    int channel_count;
+    int streams;
+    int coupled_streams;
+    int groups;
+    unsigned char mapping[MAX_CHANNELS];
+} ra_channel_layout_t;
+
+struct ra_encoder_t;
+typedef struct ra_encoder_t ra_encoder_t;
+
+struct ra_decoder_t;
+typedef struct ra_decoder_t ra_decoder_t;
+
+int ra_channel_layout_init(ra_channel_layout_t *layout, int channel_count, int mapping_family, int groups);
+int ra_channel_layout_default_groups(const ra_channel_layout_t *layout);
+int ra_channel_layout_validate(const ra_channel_layout_t *layout);
+int ra_channel_layout_mapping_family(const ra_channel_layout_t *layout);
+int ra_channel_layout_equal(const ra_channel_layout_t *a, const ra_channel_layout_t *b);
+
+ra_encoder_t *ra_encoder_create(const ra_audio_config_t *cfg,
+                                const ra_channel_layout_t *layout,
+                                int mapping_family,
+                                int application,
+                                int *err);
+int ra_encoder_ctl(ra_encoder_t *enc, int request, opus_int32 value);
+opus_int32 ra_encode(ra_encoder_t *enc, const void *pcm, int frames, unsigned char *data, opus_int32 maxlen);
+void ra_encoder_destroy(ra_encoder_t *enc);
+
+// Threads for coding that many groups in parallel, NULL and no error when the calling thread can do it alone
+ra_workers_t *ra_codec_workers_create(int groups, int *err);
+
+// Groups are decoded on the given workers, shared among decoders run from the same thread, or serially when NULL
+ra_decoder_t *ra_decoder_create(const ra_audio_config_t *cfg,
+                                const ra_channel_layout_t *layout,
+                                ra_workers_t *workers,
+                                int *err);
+// Starts the decoder over for a new stream without allocating, OPUS_BAD_ARG when the stream needs another decoder
+int ra_decoder_reset(ra_decoder_t *dec, const ra_audio_config_t *cfg, const ra_channel_layout_t *layout);
+int ra_decode_float(ra_decoder_t *dec, const unsigned char *data, opus_int32 len, float *pcm, int frames, int fec);
+void ra_decoder_destroy(ra_decoder_t *dec);
+
+#endif
@@ -199,6 +199,66 @@ const char *ra_config_get_value(ra_config_section_t *section, const char *key) {
     return NULL;
 }
 
+int ra_config_get_int(ra_config_section_t *section, const char *key, int defval) {
+    const char *value = ra_config_get_value(section, key);
+    return value ? atoi(value) : defval;
+}
+
+int ra_config_get_bool(ra_config_section_t *section, const char *key, int defval) {
+    const char *value = ra_config_get_value(section, key);
+    if (!value) return defval;
+    return !strequal(value, "0") && strcasecmp(value, "false") && strcasecmp(value, "no") && strcasecmp(value, "off");
+}
+
+void ra_config_set_value(ra_config_t *cfg, const char *section_name, const char *key, const char *value) {
+    ra_config_section_t *section = ra_config_get_section(cfg, section_name);
+    if (!section) {
+        section = section_create(section_name, strlen(section_name));
+        ra_config_section_t *tail = cfg->section_head;
+        while (tail && tail->next) tail = tail->next;
+        if (!tail)
+            cfg->section_head = section;
+        else
+            tail->next = section;
+        cfg->section_tail = section;
+    }
+
+    ra_config_entry_t *entry = section->entry_head;
+    while (entry && !strequal(entry->key, key)) entry = entry->next;
+    if (!entry) {
+        entry = entry_create(key, strlen(key));
+        if (!section->entry_tail)
+            section->entry_head = entry;
+        else
+            section->entry_tail->next = entry;
+        section->entry_tail = entry;
+    }
+    free(entry->value);
+    entry->value = string_create(value, strlen(value));
+}
+
+// Moves "--key=value" and "--flag" options into the default section and compacts the
+// remaining positional arguments to the front of argv, returning their count.
+int ra_config_parse_args(ra_config_t *cfg, int argc, const char **argv) {
+    int count = 0;
+    for (int i = 0; i < argc; i++) {
+        const char *arg = argv[i];
+        if (i == 0 || strncmp(arg, "--", 2) || !arg[2]) {
+            argv[count++] = arg;
+            continue;
+        }
+        char key[256];
+        const char *name = arg + 2;
+        const char *sep = strchr(name, '=');
+        size_t keylen = sep ? (size_t)(sep - name) : strlen(name);
+        if (keylen >= sizeof(key)) keylen = sizeof(key) - 1;
+        memcpy(key, name, keylen);
+        key[keylen] = '\0';
+        ra_config_set_value(cfg, DEFAULT_SECTION, key, sep ? sep + 1 : "1");
+    }
+    return count;
+}
+
 void ra_config_destroy(ra_config_t *cfg) {
     if (!cfg) return;
     ra_config_section_t *section = cfg->section_head;
@@ -17,5 +17,9 @@ void ra_config_parse(ra_config_t *cfg, const char *buf, size_t len);
 ra_config_section_t *ra_config_get_section(ra_config_t *cfg, const char *name);
 ra_config_section_t *ra_config_get_default_section(ra_config_t *cfg);
 const char *ra_config_get_value(ra_config_section_t *section, const char *key);
+int ra_config_get_int(ra_config_section_t *section, const char *key, int defval);
+int ra_config_get_bool(ra_config_section_t *section, const char *key, int defval);
+void ra_config_set_value(ra_config_t *cfg, const char *section_name, const char *key, const char *value);
+int ra_config_parse_args(ra_config_t *cfg, int argc, const char **argv);
 void ra_config_destroy(ra_config_t *cfg);
 #endif
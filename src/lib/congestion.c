@@ -0,0 +1,57 @@
+#include "congestion.h"
+
+#define CC_LOSS_CONGESTED_PERCENT  5
+#define CC_LOSS_SEVERE_PERCENT     10
+#define CC_LOSS_CLEAR_PERCENT      2
+#define CC_JITTER_CONGESTED_US     40000
+#define CC_MAX_LOSS_PERCENT        30
+#define CC_INCREASE_STEP           8000
+#define CC_CLEAN_REPORTS_TO_SHRINK 5
+
+void ra_congestion_init(ra_congestion_t *cc, int channel_count, int max_frame_multiplier) {
+    cc->min_bitrate = RA_CC_MIN_BITRATE_PER_CHANNEL * channel_count;
+    cc->max_bitrate = RA_CC_MAX_BITRATE_PER_CHANNEL * channel_count;
+    cc->bitrate = cc->max_bitrate;
+    cc->loss_percent = 0;
+    cc->frame_multiplier = 1;
+    cc->max_frame_multiplier = max_frame_multiplier < 1 ? 1 : max_frame_multiplier;
+    cc->clean_reports = 0;
+    cc->last_underruns = 0;
+}
+
+int ra_congestion_update(ra_congestion_t *cc, const ra_stream_report_t *report) {
+    int bitrate = cc->bitrate;
+    int loss_percent = cc->loss_percent;
+    int frame_multiplier = cc->frame_multiplier;
+
+    int loss = report->fraction_lost * 100 / 256;
+    int underran = report->underruns > cc->last_underruns;
+    cc->last_underruns = report->underruns;
+
+    // Smooth the loss estimate so FEC doesn't flap between reports, rounding up while loss persists
+    loss_percent = loss > 0 ? (loss_percent * 3 + loss + 3) / 4 : loss_percent * 3 / 4;
+    if (loss_percent > CC_MAX_LOSS_PERCENT) loss_percent = CC_MAX_LOSS_PERCENT;
+
+    if (loss >= CC_LOSS_CONGESTED_PERCENT || underran || report->jitter_us >= CC_JITTER_CONGESTED_US) {
+        // Multiplicative decrease, fewer and larger packets under heavy loss
+        bitrate = bitrate * 3 / 4;
+        if (loss >= CC_LOSS_SEVERE_PERCENT && frame_multiplier < cc->max_frame_multiplier) frame_multiplier++;
+        cc->clean_reports = 0;
+    } else if (loss < CC_LOSS_CLEAR_PERCENT) {
+        // Additive increase, going back to shorter frames once the link has been clean for a while
+        bitrate += CC_INCREASE_STEP;
+        if (++cc->clean_reports >= CC_CLEAN_REPORTS_TO_SHRINK && frame_multiplier > 1) {
+            frame_multiplier--;
+            cc->clean_reports = 0;
+        }
+    }
+    if (bitrate < cc->min_bitrate) bitrate = cc->min_bitrate;
+    if (bitrate > cc->max_bitrate) bitrate = cc->max_bitrate;
+
+    int changed =
+        bitrate != cc->bitrate || loss_percent != cc->loss_percent || frame_multiplier != cc->frame_multiplier;
+    cc->bitrate = bitrate;
+    cc->loss_percent = loss_percent;
+    cc->frame_multiplier = frame_multiplier;
+    return changed;
+}
@@ -0,0 +1,25 @@
+#ifndef _RA_CONGESTION_H
+#define _RA_CONGESTION_H
+
+#include "report.h"
+
+#define RA_CC_MIN_BITRATE_PER_CHANNEL 12000
+#define RA_CC_MAX_BITRATE_PER_CHANNEL 256000
+#define RA_CC_MAX_FRAME_MULTIPLIER    3
+
+// Loss-based AIMD controller driven by the sink's receiver reports
+typedef struct {
+    int bitrate;
+    int min_bitrate;
+    int max_bitrate;
+    int loss_percent;      // Expected packet loss to tune the encoder's in-band FEC for
+    int frame_multiplier;  // Encoded frame duration as a multiple of the capture buffer
+    int max_frame_multiplier;
+    int clean_reports;
+    uint32_t last_underruns;
+} ra_congestion_t;
+
+void ra_congestion_init(ra_congestion_t *cc, int channel_count, int max_frame_multiplier);
+int ra_congestion_update(ra_congestion_t *cc, const ra_stream_report_t *report);
+
+#endif
@@ -35,3 +35,34 @@ int ra_compute_shared_secret(unsigned char *outkey,
     }
     return crypto_generichash_blake2b_final(&state, outkey, outlen);
 }
+
+void ra_generate_cookie_key(unsigned char *key) {
+    randombytes_buf(key, COOKIE_KEY_SIZE);
+}
+
+void ra_compute_cookie(
+    unsigned char *cookie, const unsigned char *key, const unsigned char *peer, size_t peerlen, uint64_t epoch) {
+    unsigned char epoch_bytes[8];
+    for (int i = 0; i < 8; i++) epoch_bytes[i] = (unsigned char)(epoch >> (56 - i * 8));
+
+    crypto_generichash_blake2b_state state;
+    crypto_generichash_blake2b_init(&state, key, COOKIE_KEY_SIZE, COOKIE_SIZE);
+    crypto_generichash_blake2b_update(&state, epoch_bytes, sizeof(epoch_bytes));
+    crypto_generichash_blake2b_update(&state, peer, peerlen);
+    crypto_generichash_blake2b_final(&state, cookie, COOKIE_SIZE);
+}
+
+int ra_verify_cookie(const unsigned char *cookie,
+                     size_t len,
+                     const unsigned char *key,
+                     const unsigned char *peer,
+                     size_t peerlen,
+                     uint64_t epoch) {
+    unsigned char expected[COOKIE_SIZE];
+    if (len != COOKIE_SIZE) return -1;
+    ra_compute_cookie(expected, key, peer, peerlen, epoch);
+    if (crypto_verify_16(cookie, expected) == 0) return 0;
+    if (epoch == 0) return -1;
+    ra_compute_cookie(expected, key, peer, peerlen, epoch - 1);
+    return crypto_verify_16(cookie, expected);
+}
@@ -9,6 +9,8 @@
 #define PUBLIC_KEY_SIZE    crypto_scalarmult_curve25519_BYTES
 #define SHARED_SECRET_SIZE crypto_generichash_blake2b_BYTES
 #define NONCE_SIZE         crypto_aead_xchacha20poly1305_IETF_NPUBBYTES
+#define COOKIE_SIZE        16
+#define COOKIE_KEY_SIZE    crypto_generichash_blake2b_KEYBYTES
 
 typedef enum {
     RA_SHARED_SECRET_SERVER,
@@ -29,4 +31,16 @@ int ra_compute_shared_secret(unsigned char *outkey,
                              const ra_keypair_t *keypair,
                              ra_shared_secret_type type);
 
+// Cookies are a keyed hash of what the peer claims to be and the epoch, so handing them out keeps no state. A cookie
+// checks out for its own epoch and the one after.
+void ra_generate_cookie_key(unsigned char *key);
+void ra_compute_cookie(
+    unsigned char *cookie, const unsigned char *key, const unsigned char *peer, size_t peerlen, uint64_t epoch);
+int ra_verify_cookie(const unsigned char *cookie,
+                     size_t len,
+                     const unsigned char *key,
+                     const unsigned char *peer,
+                     size_t peerlen,
+                     uint64_t epoch);
+
 #endif
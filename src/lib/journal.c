@@ -0,0 +1,155 @@
+#include "journal.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread.h"
+
+struct ra_journal_t {
+    ra_logger_t *logger;
+    FILE *file;
+    ra_thread_t thread;
+    ra_mutex_t mutex;
+    ra_cond_t cond;
+    bool running;
+    // Ring of queued records, only ever locked long enough to copy a record in or out
+    ra_session_record_t queue[RA_JOURNAL_QUEUE_SIZE];
+    size_t head;
+    size_t count;
+    uint64_t dropped;
+};
+
+void ra_jitter_histogram_reset(ra_jitter_histogram_t *hist) {
+    memset(hist, 0, sizeof(*hist));
+}
+
+void ra_jitter_histogram_add(ra_jitter_histogram_t *hist, uint32_t jitter_us) {
+    uint32_t bucket = jitter_us / RA_JITTER_BUCKET_US;
+    hist->buckets[bucket < RA_JITTER_BUCKETS ? bucket : RA_JITTER_BUCKETS - 1]++;
+    hist->count++;
+    hist->sum_us += jitter_us;
+}
+
+uint32_t ra_jitter_histogram_mean(const ra_jitter_histogram_t *hist) {
+    return hist->count > 0 ? hist->sum_us / hist->count : 0;
+}
+
+uint32_t ra_jitter_histogram_quantile(const ra_jitter_histogram_t *hist, double q) {
+    if (hist->count == 0) return 0;
+    // Nearest rank, the smallest sample with at least the quantile of all samples at or below it
+    double pos = q * hist->count;
+    uint64_t rank = (uint64_t)pos;
+    if (rank > 0 && rank >= pos) rank--;
+    if (rank >= hist->count) rank = hist->count - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < RA_JITTER_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen > rank) return (i + 1) * RA_JITTER_BUCKET_US;
+    }
+    return RA_JITTER_BUCKETS * RA_JITTER_BUCKET_US;
+}
+
+int ra_session_record_format(const ra_session_record_t *record, char *buf, size_t cap) {
+    int n = snprintf(buf,
+                     cap,
+                     "%lld,%u,%s,%s,%llu,%llu,%llu,%llu,%llu,%u,%u,%u,%u\n",
+                     (long long)record->start_time,
+                     record->stream_id,
+                     record->source,
+                     record->reason ? record->reason : "",
+                     (unsigned long long)record->duration_ms,
+                     (unsigned long long)record->frames_received,
+                     (unsigned long long)record->frames_lost,
+                     (unsigned long long)record->frames_concealed,
+                     (unsigned long long)record->bytes_received,
+                     record->jitter_mean_us,
+                     record->jitter_p99_us,
+                     record->underruns,
+                     record->decode_avg_us);
+    return n < 0 || (size_t)n >= cap ? -1 : n;
+}
+
+static void write_record(ra_journal_t *journal, const ra_session_record_t *record) {
+    char line[512];
+    if (ra_session_record_format(record, line, sizeof(line)) < 0) return;
+    if (fputs(line, journal->file) == EOF || fflush(journal->file))
+        ra_logger_error(journal->logger, "Failed to write session record for stream %u", record->stream_id);
+}
+
+static void writer_thread(void *arg) {
+    ra_journal_t *journal = arg;
+    ra_session_record_t record;
+    ra_mutex_lock(&journal->mutex);
+    for (;;) {
+        while (journal->running && journal->count == 0) ra_cond_wait(&journal->cond, &journal->mutex);
+        if (journal->count == 0) break;
+        record = journal->queue[journal->head];
+        journal->head = (journal->head + 1) % RA_JOURNAL_QUEUE_SIZE;
+        journal->count--;
+        ra_mutex_unlock(&journal->mutex);
+
+        write_record(journal, &record);
+        ra_mutex_lock(&journal->mutex);
+    }
+    ra_mutex_unlock(&journal->mutex);
+}
+
+ra_journal_t *ra_journal_open(ra_logger_t *logger, const char *path, int *err) {
+    ra_journal_t *journal = calloc(1, sizeof(ra_journal_t));
+    journal->logger = logger;
+    journal->running = true;
+    journal->file = fopen(path, "a");
+    if (!journal->file) {
+        *err = -1;
+        free(journal);
+        return NULL;
+    }
+    if (ftell(journal->file) == 0) {
+        fputs(RA_JOURNAL_CSV_HEADER, journal->file);
+        fflush(journal->file);
+    }
+
+    *err = ra_mutex_init(&journal->mutex);
+    if (!*err) *err = ra_cond_init(&journal->cond);
+    if (!*err) journal->thread = ra_thread_start(&writer_thread, journal, err);
+    if (*err) {
+        fclose(journal->file);
+        free(journal);
+        return NULL;
+    }
+    return journal;
+}
+
+int ra_journal_append(ra_journal_t *journal, const ra_session_record_t *record) {
+    int rc = 0;
+    ra_mutex_lock(&journal->mutex);
+    if (journal->count < RA_JOURNAL_QUEUE_SIZE) {
+        journal->queue[(journal->head + journal->count) % RA_JOURNAL_QUEUE_SIZE] = *record;
+        journal->count++;
+        ra_cond_signal(&journal->cond);
+    } else {
+        journal->dropped++;
+        rc = -1;
+    }
+    ra_mutex_unlock(&journal->mutex);
+    return rc;
+}
+
+void ra_journal_close(ra_journal_t *journal) {
+    if (!journal) return;
+    ra_mutex_lock(&journal->mutex);
+    journal->running = false;
+    ra_cond_signal(&journal->cond);
+    ra_mutex_unlock(&journal->mutex);
+
+    ra_thread_join(journal->thread);
+    ra_thread_destroy(journal->thread);
+    ra_cond_destroy(&journal->cond);
+    ra_mutex_destroy(&journal->mutex);
+    if (journal->dropped > 0)
+        ra_logger_warn(journal->logger, "Dropped %llu session records", (unsigned long long)journal->dropped);
+    fclose(journal->file);
+    free(journal);
+}
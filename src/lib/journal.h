@@ -0,0 +1,63 @@
+#ifndef _RA_JOURNAL_H
+#define _RA_JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "logger.h"
+
+// Records queued for the writer thread before new ones get dropped
+#define RA_JOURNAL_QUEUE_SIZE 256
+
+// Jitter is bucketed in 100 us steps up to 100 ms, the last bucket catching everything above
+#define RA_JITTER_BUCKET_US 100
+#define RA_JITTER_BUCKETS   1000
+
+#define RA_JOURNAL_CSV_HEADER                                                                                  \
+    "start_time,stream,source,reason,duration_ms,frames_received,frames_lost,frames_concealed,bytes_received," \
+    "jitter_mean_us,jitter_p99_us,underruns,decode_avg_us\n"
+
+typedef struct {
+    uint32_t buckets[RA_JITTER_BUCKETS];
+    uint64_t count;
+    uint64_t sum_us;
+} ra_jitter_histogram_t;
+
+// Accounting for a single stream from its handshake until it was closed
+typedef struct {
+    time_t start_time;
+    uint32_t stream_id;
+    char source[32];
+    const char *reason;  // Why the session ended, must outlive the record
+    uint64_t duration_ms;
+    uint64_t frames_received;
+    uint64_t frames_lost;
+    uint64_t frames_concealed;  // Played out as silence or comfort noise for want of received audio
+    uint64_t bytes_received;
+    uint32_t jitter_mean_us;
+    uint32_t jitter_p99_us;
+    uint32_t underruns;
+    uint32_t decode_avg_us;
+} ra_session_record_t;
+
+struct ra_journal_t;
+typedef struct ra_journal_t ra_journal_t;
+
+void ra_jitter_histogram_reset(ra_jitter_histogram_t *hist);
+void ra_jitter_histogram_add(ra_jitter_histogram_t *hist, uint32_t jitter_us);
+uint32_t ra_jitter_histogram_mean(const ra_jitter_histogram_t *hist);
+// Upper bound of the bucket the quantile falls in, 0 without any samples
+uint32_t ra_jitter_histogram_quantile(const ra_jitter_histogram_t *hist, double q);
+
+// Formats the record as a CSV line matching RA_JOURNAL_CSV_HEADER, returns -1 when it doesn't fit
+int ra_session_record_format(const ra_session_record_t *record, char *buf, size_t cap);
+
+// Appends session records to a CSV file from a background thread, writing the header when the file is new
+ra_journal_t *ra_journal_open(ra_logger_t *logger, const char *path, int *err);
+// Queues the record without waiting on any I/O, returns -1 when the queue is full and the record got dropped
+int ra_journal_append(ra_journal_t *journal, const ra_session_record_t *record);
+// Writes out the records still queued before closing
+void ra_journal_close(ra_journal_t *journal);
+
+#endif
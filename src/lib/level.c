@@ -0,0 +1,87 @@
+#include "level.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LEVEL_USE_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define LEVEL_USE_NEON
+#endif
+
+float ra_level_peak_float(const float *samples, size_t count) {
+    size_t i = 0;
+    float peak = 0;
+#if defined(LEVEL_USE_SSE2)
+    const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 vpeak = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) vpeak = _mm_max_ps(vpeak, _mm_and_ps(_mm_loadu_ps(samples + i), mask));
+    float lanes[4];
+    _mm_storeu_ps(lanes, vpeak);
+    for (int j = 0; j < 4; j++)
+        if (lanes[j] > peak) peak = lanes[j];
+#elif defined(LEVEL_USE_NEON)
+    float32x4_t vpeak = vdupq_n_f32(0);
+    for (; i + 4 <= count; i += 4) vpeak = vmaxq_f32(vpeak, vabsq_f32(vld1q_f32(samples + i)));
+    float lanes[4];
+    vst1q_f32(lanes, vpeak);
+    for (int j = 0; j < 4; j++)
+        if (lanes[j] > peak) peak = lanes[j];
+#endif
+    for (; i < count; i++) {
+        float value = samples[i] < 0 ? -samples[i] : samples[i];
+        if (value > peak) peak = value;
+    }
+    return peak;
+}
+
+float ra_level_peak_int16(const int16_t *samples, size_t count) {
+    size_t i = 0;
+    int32_t max = 0, min = 0;
+#if defined(LEVEL_USE_SSE2)
+    __m128i vmax = _mm_setzero_si128(), vmin = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(samples + i));
+        vmax = _mm_max_epi16(vmax, v);
+        vmin = _mm_min_epi16(vmin, v);
+    }
+    int16_t maxlanes[8], minlanes[8];
+    _mm_storeu_si128((__m128i *)maxlanes, vmax);
+    _mm_storeu_si128((__m128i *)minlanes, vmin);
+    for (int j = 0; j < 8; j++) {
+        if (maxlanes[j] > max) max = maxlanes[j];
+        if (minlanes[j] < min) min = minlanes[j];
+    }
+#elif defined(LEVEL_USE_NEON)
+    int16x8_t vmax = vdupq_n_s16(0), vmin = vdupq_n_s16(0);
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(samples + i);
+        vmax = vmaxq_s16(vmax, v);
+        vmin = vminq_s16(vmin, v);
+    }
+    max = vmaxvq_s16(vmax);
+    min = vminvq_s16(vmin);
+#endif
+    for (; i < count; i++) {
+        if (samples[i] > max) max = samples[i];
+        if (samples[i] < min) min = samples[i];
+    }
+    int32_t peak = max > -min ? max : -min;
+    return peak / 32768.0f;
+}
+
+void ra_silence_gate_init(ra_silence_gate_t *gate, float threshold, size_t hangover_frames) {
+    gate->threshold = threshold;
+    gate->hangover_frames = hangover_frames;
+    gate->quiet_frames = 0;
+}
+
+// Reports silence only after the level stayed below the threshold for the whole hangover,
+// so quiet passages and reverb tails aren't cut off
+bool ra_silence_gate_update(ra_silence_gate_t *gate, float peak, size_t frames) {
+    if (peak >= gate->threshold) {
+        gate->quiet_frames = 0;
+        return false;
+    }
+    if (gate->quiet_frames < gate->hangover_frames) gate->quiet_frames += frames;
+    return gate->quiet_frames >= gate->hangover_frames;
+}
@@ -0,0 +1,21 @@
+#ifndef _RA_LEVEL_H
+#define _RA_LEVEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Peak absolute sample value normalized to [0, 1]
+float ra_level_peak_float(const float *samples, size_t count);
+float ra_level_peak_int16(const int16_t *samples, size_t count);
+
+typedef struct {
+    float threshold;
+    size_t hangover_frames;
+    size_t quiet_frames;
+} ra_silence_gate_t;
+
+void ra_silence_gate_init(ra_silence_gate_t *gate, float threshold, size_t hangover_frames);
+bool ra_silence_gate_update(ra_silence_gate_t *gate, float peak, size_t frames);
+
+#endif
@@ -1,12 +1,17 @@
 #include "logger.h"
 
 #include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#include "clock.h"
 #include "lib/logger.h"
 #include "string.h"
+#include "thread.h"
 
 #define LOG_BUFSIZE       512
 #define LOG_TIMESTAMP_LEN 20
@@ -18,6 +23,12 @@
 #define LOG_LEVEL_ERROR 3
 #define LOG_LEVEL_FATAL 4
 
+#define LOG_WRITER_INTERVAL_NS (10 * RA_NSEC_PER_MSEC)
+// Repeats of the same message are summarized at least this often while they keep coming
+#define LOG_REPEAT_SECONDS 10
+// Rate limit windows the format strings hash into, formats sharing one also share its budget
+#define LOG_RATE_WINDOWS 64
+
 #define logger_fprintf(logger, level, fmt)       \
     {                                            \
         va_list ap;                              \
@@ -26,6 +37,36 @@
         va_end(ap);                              \
     }
 
+typedef struct {
+    atomic_size_t seq;
+    int level;
+    time_t time;
+    const char *context;
+    char message[LOG_BUFSIZE];
+} log_record_t;
+
+typedef struct {
+    atomic_llong start;
+    atomic_uint count;
+} log_window_t;
+
+// Bounded MPSC queue, each slot's sequence number tells whether it's free for the producer claiming its position or
+// published for the writer, so neither side ever takes a lock
+struct ra_logger_queue_t {
+    log_record_t records[RA_LOGGER_QUEUE_SIZE];
+    atomic_size_t tail;
+    atomic_size_t head;  // Published by the writer once the record has been written
+    atomic_ullong dropped;           // Total ever dropped, only grows
+    atomic_ullong dropped_reported;  // Part of the total the writer has already reported
+    log_window_t windows[LOG_RATE_WINDOWS];
+    atomic_bool running;
+    ra_thread_t thread;
+    // Last message written and how often it came again since, only touched by the writer thread
+    log_record_t last;
+    unsigned int repeats;
+    time_t last_written;
+};
+
 static const char *log_level_str(int level) {
     switch (level) {
     case LOG_LEVEL_DEBUG:
@@ -43,28 +84,163 @@ static const char *log_level_str(int level) {
     }
 }
 
-static void logger_vfprintf(ra_logger_t *logger, int level, const char *fmt, va_list varg) {
+static void write_line(ra_logger_stream_t *stream, int level, time_t time, const char *context, const char *message) {
     char buffer[LOG_BUFSIZE] = {};
     char *wptr = buffer;
     char *endptr = buffer + LOG_BUFSIZE;
-    if (logger->context != NULL) wptr += snprintf(wptr, endptr - wptr, "[%s] ", logger->context);
+    if (context != NULL) wptr += snprintf(wptr, endptr - wptr, "[%s] ", context);
 
     char timestamp[LOG_TIMESTAMP_LEN];
-    time_t now = time(NULL);
-    strftime(timestamp, LOG_TIMESTAMP_LEN, "%Y-%m-%d %H:%M:%S", localtime(&now));
-    wptr += snprintf(wptr, endptr - wptr, "%s %-5s ", timestamp, log_level_str(level));
-    wptr += vsnprintf(wptr, endptr - wptr, fmt, varg);
+    struct tm tm;
+    ra_clock_localtime(time, &tm);
+    strftime(timestamp, LOG_TIMESTAMP_LEN, "%Y-%m-%d %H:%M:%S", &tm);
+    snprintf(wptr, endptr - wptr, "%s %-5s %s", timestamp, log_level_str(level), message);
 
-    ra_logger_stream_t *stream = logger->stream;
     FILE *f = level <= LOG_LEVEL_INFO ? stream->out : stream->err;
     fprintf(f, "%s\n", buffer);
     fflush(f);
 }
 
+static void write_repeats(ra_logger_stream_t *stream, ra_logger_queue_t *queue, time_t now) {
+    if (queue->repeats == 0) return;
+    char message[64];
+    snprintf(message, sizeof(message), "Last message repeated %u times", queue->repeats);
+    write_line(stream, queue->last.level, now, queue->last.context, message);
+    queue->repeats = 0;
+    queue->last_written = now;
+}
+
+// Runs of the same message collapse into a single line counting the repeats
+static void write_record(ra_logger_stream_t *stream, ra_logger_queue_t *queue, const log_record_t *record) {
+    log_record_t *last = &queue->last;
+    if (last->level == record->level && last->context == record->context &&
+        strcmp(last->message, record->message) == 0) {
+        queue->repeats++;
+        if (queue->last_written + LOG_REPEAT_SECONDS <= record->time) write_repeats(stream, queue, record->time);
+        return;
+    }
+    write_repeats(stream, queue, record->time);
+    write_line(stream, record->level, record->time, record->context, record->message);
+    last->level = record->level;
+    last->context = record->context;
+    strcpy(last->message, record->message);
+    queue->last_written = record->time;
+}
+
+static bool write_pending(ra_logger_stream_t *stream) {
+    ra_logger_queue_t *queue = stream->queue;
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    bool written = false;
+    for (;; head++) {
+        log_record_t *record = &queue->records[head % RA_LOGGER_QUEUE_SIZE];
+        if (atomic_load_explicit(&record->seq, memory_order_acquire) != head + 1) break;
+        write_record(stream, queue, record);
+        atomic_store_explicit(&record->seq, head + RA_LOGGER_QUEUE_SIZE, memory_order_release);
+        atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+        written = true;
+    }
+
+    // Only marked reported once written, so a flush also waits for the notice
+    uint64_t total = atomic_load(&queue->dropped);
+    uint64_t dropped = total - atomic_load_explicit(&queue->dropped_reported, memory_order_relaxed);
+    if (dropped > 0) {
+        char message[96];
+        snprintf(message,
+                 sizeof(message),
+                 "Dropped %llu log messages, rate limited or queue full",
+                 (unsigned long long)dropped);
+        write_repeats(stream, queue, time(NULL));
+        write_line(stream, LOG_LEVEL_WARN, time(NULL), NULL, message);
+        queue->last.message[0] = '\0';
+        atomic_store_explicit(&queue->dropped_reported, total, memory_order_release);
+    }
+    return written;
+}
+
+static void writer_thread(void *arg) {
+    ra_logger_stream_t *stream = arg;
+    ra_logger_queue_t *queue = stream->queue;
+    for (;;) {
+        bool running = atomic_load(&queue->running);
+        if (write_pending(stream)) continue;
+        if (queue->repeats > 0 && queue->last_written + LOG_REPEAT_SECONDS <= time(NULL))
+            write_repeats(stream, queue, time(NULL));
+        if (!running) break;
+        ra_clock_sleep_until_ns(ra_clock_now_ns() + LOG_WRITER_INTERVAL_NS);
+    }
+    write_repeats(stream, queue, time(NULL));
+}
+
+// Fixed one second windows per format string, cheaper than a token bucket and enough to keep a flood off the queue
+// without silencing the other messages logged alongside it
+static bool rate_limited(ra_logger_queue_t *queue, const char *fmt, time_t now) {
+    uintptr_t key = (uintptr_t)fmt;
+    log_window_t *window = &queue->windows[(key ^ (key >> 6) ^ (key >> 12)) % LOG_RATE_WINDOWS];
+    long long start = atomic_load_explicit(&window->start, memory_order_relaxed);
+    if (start != now && atomic_compare_exchange_strong(&window->start, &start, now))
+        atomic_store_explicit(&window->count, 0, memory_order_relaxed);
+    return atomic_fetch_add_explicit(&window->count, 1, memory_order_relaxed) >= RA_LOGGER_RATE_LIMIT;
+}
+
+static void logger_vfprintf(ra_logger_t *logger, int level, const char *fmt, va_list varg) {
+    ra_logger_stream_t *stream = logger->stream;
+    ra_logger_queue_t *queue = stream->queue;
+    time_t now = time(NULL);
+    // Fatal messages are the last ones logged, they're written right away rather than risk a full queue
+    if (!queue || level == LOG_LEVEL_FATAL) {
+        char message[LOG_BUFSIZE];
+        ra_logger_stream_flush(stream);
+        vsnprintf(message, sizeof(message), fmt, varg);
+        write_line(stream, level, now, logger->context, message);
+        return;
+    }
+    if (rate_limited(queue, fmt, now)) {
+        atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    // The arguments may point at buffers the caller reuses right after, so the message is formatted into the claimed
+    // slot here, only the timestamp and the write are left to the writer thread
+    log_record_t *record;
+    size_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    for (;;) {
+        record = &queue->records[pos % RA_LOGGER_QUEUE_SIZE];
+        size_t seq = atomic_load_explicit(&record->seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(
+                    &queue->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (seq < pos) {
+            atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+    record->level = level;
+    record->time = now;
+    record->context = logger->context;
+    vsnprintf(record->message, sizeof(record->message), fmt, varg);
+    atomic_store_explicit(&record->seq, pos + 1, memory_order_release);
+}
+
 ra_logger_stream_t *ra_logger_stream_create(FILE *out, FILE *err) {
     ra_logger_stream_t *stream = (ra_logger_stream_t *)malloc(sizeof(ra_logger_stream_t));
     stream->out = out;
     stream->err = err;
+
+    ra_logger_queue_t *queue = (ra_logger_queue_t *)calloc(1, sizeof(ra_logger_queue_t));
+    for (size_t i = 0; i < RA_LOGGER_QUEUE_SIZE; i++) atomic_init(&queue->records[i].seq, i);
+    atomic_init(&queue->running, true);
+    queue->last.level = -1;
+    stream->queue = queue;
+
+    int thread_err;
+    queue->thread = ra_thread_start(&writer_thread, stream, &thread_err);
+    if (thread_err) {
+        free(queue);
+        stream->queue = NULL;
+    }
     return stream;
 }
 
@@ -72,9 +248,27 @@ ra_logger_stream_t *ra_logger_stream_create_default() {
     return ra_logger_stream_create(stdout, stderr);
 }
 
+void ra_logger_stream_flush(ra_logger_stream_t *stream) {
+    ra_logger_queue_t *queue = stream->queue;
+    if (!queue) return;
+    // Only waits for what was logged or dropped before the call, a steady flood from other threads can't hold it up
+    size_t tail = atomic_load(&queue->tail);
+    uint64_t dropped = atomic_load(&queue->dropped);
+    while (atomic_load(&queue->head) < tail ||
+           atomic_load_explicit(&queue->dropped_reported, memory_order_acquire) < dropped)
+        ra_clock_sleep_until_ns(ra_clock_now_ns() + RA_NSEC_PER_MSEC);
+}
+
 void ra_logger_stream_destroy(ra_logger_stream_t *stream) {
-    if (stream->out != stdout) fclose(stream->out);
-    if (stream->out != stderr) fclose(stream->err);
+    ra_logger_queue_t *queue = stream->queue;
+    if (queue) {
+        atomic_store(&queue->running, false);
+        ra_thread_join(queue->thread);
+        ra_thread_destroy(queue->thread);
+        free(queue);
+    }
+    if (stream->out != stdout && stream->out != stderr) fclose(stream->out);
+    if (stream->err != stderr && stream->err != stream->out) fclose(stream->err);
     free(stream);
 }
 
@@ -85,7 +279,9 @@ ra_logger_t *ra_logger_create(ra_logger_stream_t *stream, const char *context) {
     return logger;
 }
 
+// Queued records still point at the context, so they're written out before it can go away
 void ra_logger_destroy(ra_logger_t *logger) {
+    ra_logger_stream_flush(logger->stream);
     free(logger);
 }
 
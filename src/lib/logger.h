@@ -3,9 +3,21 @@
 
 #include <stdio.h>
 
+// Records a stream queues for its writer thread, anything logged while the queue is full gets dropped
+#define RA_LOGGER_QUEUE_SIZE 256
+// Messages of one format a stream takes per second before the rest of that second is dropped, fatal ones are always
+// written
+#define RA_LOGGER_RATE_LIMIT 200
+
+struct ra_logger_queue_t;
+typedef struct ra_logger_queue_t ra_logger_queue_t;
+
+// Logging only formats the message into the queue, the timestamps and the writes happen on the stream's writer
+// thread, so it's safe from the audio callbacks
 typedef struct {
     FILE *out;
     FILE *err;
+    ra_logger_queue_t *queue;  // NULL when the writer thread couldn't be started, writes are synchronous then
 } ra_logger_stream_t;
 
 typedef struct {
@@ -15,6 +27,8 @@ typedef struct {
 
 ra_logger_stream_t *ra_logger_stream_create(FILE *out, FILE *err);
 ra_logger_stream_t *ra_logger_stream_create_default();
+// Waits for the writer thread to write out everything logged so far
+void ra_logger_stream_flush(ra_logger_stream_t *stream);
 void ra_logger_stream_destroy(ra_logger_stream_t *stream);
 
 ra_logger_t *ra_logger_create(ra_logger_stream_t *stream, const char *context);
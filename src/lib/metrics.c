@@ -0,0 +1,367 @@
+#include "metrics.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "clock.h"
+#include "socket.h"
+#include "string.h"
+#include "thread.h"
+
+#define RENDER_BUFFER_SIZE  65536
+#define MAX_RENDER_BUFFER   (16 * 1024 * 1024)
+#define REQUEST_BUFFER_SIZE 1024
+#define CLIENT_TIMEOUT_SEC  1
+
+#define CONTENT_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+typedef enum {
+    METRIC_TYPE_COUNTER,
+    METRIC_TYPE_GAUGE,
+} metric_type;
+
+static const struct {
+    const char *name;
+    const char *help;
+    metric_type type;
+    int scope;
+} metric_descs[RA_METRIC_COUNT] = {
+    [RA_METRIC_PACKETS_RECEIVED] = {"packets_received_total",
+                                    "Datagrams received.",
+                                    METRIC_TYPE_COUNTER,
+                                    RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_BYTES_RECEIVED] = {"bytes_received_total",
+                                  "Bytes received.",
+                                  METRIC_TYPE_COUNTER,
+                                  RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_PACKETS_SENT] = {"packets_sent_total",
+                                "Datagrams sent.",
+                                METRIC_TYPE_COUNTER,
+                                RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_BYTES_SENT] = {"bytes_sent_total",
+                              "Bytes sent.",
+                              METRIC_TYPE_COUNTER,
+                              RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_DECRYPT_FAILURES] = {"decrypt_failures_total",
+                                    "Crypto messages that failed to authenticate or were malformed.",
+                                    METRIC_TYPE_COUNTER,
+                                    RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_REPLAYS_DROPPED] = {"replays_dropped_total",
+                                   "Crypto messages dropped for a nonce behind the replay window.",
+                                   METRIC_TYPE_COUNTER,
+                                   RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_DECODE_ERRORS] = {"decode_errors_total",
+                                 "Opus packets that failed to decode.",
+                                 METRIC_TYPE_COUNTER,
+                                 RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_RING_UNDERRUNS] = {"ring_underruns_total",
+                                  "Audio callbacks that found the ring buffer short of a full buffer.",
+                                  METRIC_TYPE_COUNTER,
+                                  RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_RING_OVERFLOWS] = {"ring_overflows_total",
+                                  "Decoded packets dropped for a full ring buffer.",
+                                  METRIC_TYPE_COUNTER,
+                                  RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_AUDIO_UNDERFLOWS] = {"audio_underflows_total",
+                                    "Audio callbacks flagged with a device input or output underflow.",
+                                    METRIC_TYPE_COUNTER,
+                                    RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_AUDIO_OVERFLOWS] = {"audio_overflows_total",
+                                   "Audio callbacks flagged with a device input or output overflow.",
+                                   METRIC_TYPE_COUNTER,
+                                   RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_CALLBACK_DEADLINE_MISSES] = {"callback_deadline_misses_total",
+                                            "Audio callbacks that ran past their share of the buffer period.",
+                                            METRIC_TYPE_COUNTER,
+                                            RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_HANDSHAKES] = {"handshakes_total",
+                              "Handshakes initiated or accepted.",
+                              METRIC_TYPE_COUNTER,
+                              RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_HANDSHAKES_REJECTED] = {"handshakes_rejected_total",
+                                       "Handshakes turned down for want of a stream slot, config or key.",
+                                       METRIC_TYPE_COUNTER,
+                                       RA_METRIC_SCOPE_GLOBAL},
+    [RA_METRIC_HANDSHAKE_COOKIES] = {"handshake_cookies_total",
+                                     "Handshakes answered with a cookie to come back with, before any key agreement.",
+                                     METRIC_TYPE_COUNTER,
+                                     RA_METRIC_SCOPE_GLOBAL},
+    [RA_METRIC_HANDSHAKES_RESUMED] = {"handshakes_resumed_total",
+                                      "Repeated handshakes answered from the session the source already had.",
+                                      METRIC_TYPE_COUNTER,
+                                      RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_STREAMS_OPEN] = {"streams_open",
+                                "Streams currently open.",
+                                METRIC_TYPE_GAUGE,
+                                RA_METRIC_SCOPE_GLOBAL | RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_BUFFER_MS] = {"buffer_ms",
+                             "Decoded audio queued for playback as last reported.",
+                             METRIC_TYPE_GAUGE,
+                             RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_LATENCY_US] = {"capture_to_dac_latency_us",
+                               "Time from the source capturing the latest packet to the sink playing it out.",
+                               METRIC_TYPE_GAUGE,
+                               RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_CLOCK_RTT_US] = {"clock_rtt_us",
+                                "Round trip of the clock exchange the latency is mapped across clocks with.",
+                                METRIC_TYPE_GAUGE,
+                                RA_METRIC_SCOPE_STREAM},
+    [RA_METRIC_LAST_UPDATE_AGE_SECONDS] = {"last_update_age_seconds",
+                                           "Seconds since the peer was last heard from.",
+                                           METRIC_TYPE_GAUGE,
+                                           RA_METRIC_SCOPE_STREAM},
+};
+
+// Upper bounds of the callback duration buckets in microseconds, the last bucket has none
+static const uint64_t histogram_bounds_us[RA_METRICS_HISTOGRAM_BUCKETS - 1] = {
+    50, 100, 250, 500, 1000, 2500, 5000, 10000, 20000, 40000, 80000};
+
+struct ra_metrics_server_t {
+    ra_logger_t *logger;
+    SOCKET sock;
+    ra_thread_t thread;
+    atomic_bool running;
+    ra_metrics_render_func *render;
+    void *userdata;
+    char *rawbuf;
+    size_t cap;
+};
+
+void ra_metrics_init(ra_metrics_t *metrics) {
+    for (int i = 0; i < RA_METRIC_COUNT; i++) atomic_init(&metrics->values[i], 0);
+    for (int i = 0; i < RA_METRICS_HISTOGRAM_BUCKETS; i++) atomic_init(&metrics->callback_duration.buckets[i], 0);
+    atomic_init(&metrics->callback_duration.sum_ns, 0);
+}
+
+void ra_metrics_add(ra_metrics_t *metrics, ra_metric_id id, uint64_t value) {
+    atomic_fetch_add_explicit(&metrics->values[id], value, memory_order_relaxed);
+}
+
+void ra_metrics_set(ra_metrics_t *metrics, ra_metric_id id, uint64_t value) {
+    atomic_store_explicit(&metrics->values[id], value, memory_order_relaxed);
+}
+
+uint64_t ra_metrics_get(const ra_metrics_t *metrics, ra_metric_id id) {
+    return atomic_load_explicit((atomic_ullong *)&metrics->values[id], memory_order_relaxed);
+}
+
+void ra_metrics_observe_ns(ra_metrics_histogram_t *hist, uint64_t ns) {
+    int i = 0;
+    while (i < RA_METRICS_HISTOGRAM_BUCKETS - 1 && ns > histogram_bounds_us[i] * RA_NSEC_PER_USEC) i++;
+    atomic_fetch_add_explicit(&hist->buckets[i], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum_ns, ns, memory_order_relaxed);
+}
+
+uint64_t ra_metrics_histogram_count(const ra_metrics_histogram_t *hist) {
+    uint64_t count = 0;
+    for (int i = 0; i < RA_METRICS_HISTOGRAM_BUCKETS; i++)
+        count += atomic_load_explicit((atomic_ullong *)&hist->buckets[i], memory_order_relaxed);
+    return count;
+}
+
+static int buf_printf(char *buf, size_t cap, size_t *len, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    size_t avail = cap - *len;
+    int n = vsnprintf(buf + *len, avail, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= avail) return -1;
+    *len += n;
+    return 0;
+}
+
+// Buckets are cumulative in the exposition format, each one counting every observation up to its bound
+static int render_histogram(
+    char *buf, size_t cap, size_t *len, const char *name, const char *labels, const ra_metrics_histogram_t *hist) {
+    const char *sep = labels ? "," : "";
+    labels = labels ? labels : "";
+    unsigned long long cumulative = 0;
+    for (int i = 0; i < RA_METRICS_HISTOGRAM_BUCKETS; i++) {
+        cumulative += atomic_load_explicit((atomic_ullong *)&hist->buckets[i], memory_order_relaxed);
+        int err = i < RA_METRICS_HISTOGRAM_BUCKETS - 1
+                      ? buf_printf(buf,
+                                   cap,
+                                   len,
+                                   "%s_bucket{%s%sle=\"%g\"} %llu\n",
+                                   name,
+                                   labels,
+                                   sep,
+                                   (double)histogram_bounds_us[i] / 1e6,
+                                   cumulative)
+                      : buf_printf(buf, cap, len, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep, cumulative);
+        if (err) return -1;
+    }
+    double sum = (double)atomic_load_explicit((atomic_ullong *)&hist->sum_ns, memory_order_relaxed) / RA_NSEC_PER_SEC;
+    const char *open = *labels ? "{" : "";
+    const char *close = *labels ? "}" : "";
+    if (buf_printf(buf, cap, len, "%s_sum%s%s%s %.9f\n", name, open, labels, close, sum)) return -1;
+    return buf_printf(buf, cap, len, "%s_count%s%s%s %llu\n", name, open, labels, close, cumulative);
+}
+
+static int render_histograms(
+    char *buf, size_t cap, size_t *len, const char *prefix, const ra_metrics_set_t *sets, int count) {
+    char name[256];
+    snprintf(name, sizeof(name), "%s_callback_duration_seconds", prefix);
+    if (buf_printf(buf, cap, len, "# HELP %s Time spent in the audio callbacks.\n", name)) return -1;
+    if (buf_printf(buf, cap, len, "# TYPE %s histogram\n", name)) return -1;
+    for (int i = 0; i < count; i++)
+        if (render_histogram(buf, cap, len, name, sets[i].labels, &sets[i].metrics->callback_duration)) return -1;
+    return 0;
+}
+
+int ra_metrics_render(
+    char *buf, size_t cap, size_t *len, const char *prefix, int scope, const ra_metrics_set_t *sets, int count) {
+    for (int id = 0; id < RA_METRIC_COUNT; id++) {
+        if (!(metric_descs[id].scope & scope)) continue;
+        const char *name = metric_descs[id].name;
+        const char *type = metric_descs[id].type == METRIC_TYPE_COUNTER ? "counter" : "gauge";
+        if (buf_printf(buf, cap, len, "# HELP %s_%s %s\n", prefix, name, metric_descs[id].help)) return -1;
+        if (buf_printf(buf, cap, len, "# TYPE %s_%s %s\n", prefix, name, type)) return -1;
+        for (int i = 0; i < count; i++) {
+            const ra_metrics_set_t *set = &sets[i];
+            unsigned long long value = ra_metrics_get(set->metrics, id);
+            int err = set->labels ? buf_printf(buf, cap, len, "%s_%s{%s} %llu\n", prefix, name, set->labels, value)
+                                  : buf_printf(buf, cap, len, "%s_%s %llu\n", prefix, name, value);
+            if (err) return -1;
+        }
+    }
+    return render_histograms(buf, cap, len, prefix, sets, count);
+}
+
+static int send_all(SOCKET sock, const char *data, size_t len) {
+    while (len > 0) {
+        int sent = send(sock, data, len, 0);
+        if (sent <= 0) return -1;
+        data += sent;
+        len -= sent;
+    }
+    return 0;
+}
+
+// Renders into the server's buffer, growing it until everything fits
+static int render_metrics(ra_metrics_server_t *server, size_t *len) {
+    for (;;) {
+        *len = 0;
+        if (server->render(server->rawbuf, server->cap, len, server->userdata) == 0) return 0;
+        if (server->cap >= MAX_RENDER_BUFFER) return -1;
+        char *rawbuf = realloc(server->rawbuf, server->cap * 2);
+        if (!rawbuf) return -1;
+        server->rawbuf = rawbuf;
+        server->cap *= 2;
+    }
+}
+
+static void handle_client(ra_metrics_server_t *server, SOCKET client) {
+    char request[REQUEST_BUFFER_SIZE];
+    char header[256];
+
+    // Don't let a client that never sends its request hold up the scrapes
+    fd_set readfds;
+    FD_ZERO(&readfds);
+    FD_SET(client, &readfds);
+    struct timeval timeout = {.tv_sec = CLIENT_TIMEOUT_SEC, .tv_usec = 0};
+    if (ra_socket_select(client + 1, &readfds, &timeout) <= 0) return;
+    int len = recv(client, request, sizeof(request) - 1, 0);
+    if (len <= 0) return;
+    request[len] = '\0';
+
+    const char *status = "404 Not Found";
+    size_t body_len = 0;
+    if (strncmp(request, "GET / ", 6) == 0 || strncmp(request, "GET /metrics ", 13) == 0) {
+        status = "200 OK";
+        if (render_metrics(server, &body_len)) {
+            status = "500 Internal Server Error";
+            body_len = 0;
+        }
+    }
+    int n = snprintf(header,
+                     sizeof(header),
+                     "HTTP/1.0 %s\r\nContent-Type: " CONTENT_TYPE "\r\nContent-Length: %zu\r\n"
+                     "Connection: close\r\n\r\n",
+                     status,
+                     body_len);
+    if (send_all(client, header, n)) return;
+    send_all(client, server->rawbuf, body_len);
+}
+
+static void server_thread(void *arg) {
+    ra_metrics_server_t *server = arg;
+    fd_set readfds;
+    while (server->running) {
+        FD_ZERO(&readfds);
+        FD_SET(server->sock, &readfds);
+        struct timeval timeout = {.tv_sec = 1, .tv_usec = 0};
+        if (ra_socket_select(server->sock + 1, &readfds, &timeout) <= 0) continue;
+        SOCKET client = accept(server->sock, NULL, NULL);
+        if (client < 0) continue;
+        handle_client(server, client);
+        ra_socket_close(client);
+    }
+}
+
+ra_metrics_server_t *ra_metrics_server_start(ra_logger_t *logger,
+                                             const char *host,
+                                             unsigned int port,
+                                             ra_metrics_render_func *render,
+                                             void *userdata,
+                                             int *err) {
+    *err = 0;
+    struct sockaddr_in addr;
+    if (ra_sockaddr_init(host, port, &addr)) {
+        *err = -1;
+        return NULL;
+    }
+
+    ra_metrics_server_t *server = malloc(sizeof(ra_metrics_server_t));
+    server->logger = logger;
+    server->render = render;
+    server->userdata = userdata;
+    server->cap = RENDER_BUFFER_SIZE;
+    server->rawbuf = malloc(server->cap);
+    server->thread = 0;
+    server->sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (server->sock < 0) {
+        ra_socket_perror("socket");
+        goto error;
+    }
+    sockopt_t opt = 1;
+    if (setsockopt(server->sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(sockopt_t))) {
+        ra_socket_perror("setsockopt");
+        goto error;
+    }
+    if (bind(server->sock, (struct sockaddr *)&addr, sizeof(addr))) {
+        ra_socket_perror("bind");
+        goto error;
+    }
+    if (listen(server->sock, 8)) {
+        ra_socket_perror("listen");
+        goto error;
+    }
+
+    server->running = true;
+    server->thread = ra_thread_start(server_thread, server, err);
+    if (*err) {
+        server->thread = 0;
+        goto error;
+    }
+    ra_logger_info(logger, "Serving metrics at http://%s:%u/metrics", host, port);
+    return server;
+
+error:
+    if (!*err) *err = -1;
+    ra_metrics_server_stop(server);
+    return NULL;
+}
+
+void ra_metrics_server_stop(ra_metrics_server_t *server) {
+    if (!server) return;
+    server->running = false;
+    if (server->thread) {
+        ra_thread_join(server->thread);
+        ra_thread_destroy(server->thread);
+    }
+    if (server->sock >= 0) ra_socket_close(server->sock);
+    free(server->rawbuf);
+    free(server);
+}
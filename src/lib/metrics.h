@@ -0,0 +1,88 @@
+#ifndef _RA_METRICS_H
+#define _RA_METRICS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "logger.h"
+
+#define RA_METRICS_SINK_PORT   21502
+#define RA_METRICS_SOURCE_PORT 21503
+
+// Global metrics count everything the process saw, stream metrics only what belongs to one stream
+#define RA_METRIC_SCOPE_GLOBAL 0x01
+#define RA_METRIC_SCOPE_STREAM 0x02
+
+// Fixed buckets for the audio callback runtimes, the last one catching everything above the largest bound
+#define RA_METRICS_HISTOGRAM_BUCKETS 12
+
+typedef enum {
+    RA_METRIC_PACKETS_RECEIVED,
+    RA_METRIC_BYTES_RECEIVED,
+    RA_METRIC_PACKETS_SENT,
+    RA_METRIC_BYTES_SENT,
+    RA_METRIC_DECRYPT_FAILURES,
+    RA_METRIC_REPLAYS_DROPPED,
+    RA_METRIC_DECODE_ERRORS,
+    RA_METRIC_RING_UNDERRUNS,
+    RA_METRIC_RING_OVERFLOWS,
+    RA_METRIC_AUDIO_UNDERFLOWS,
+    RA_METRIC_AUDIO_OVERFLOWS,
+    RA_METRIC_CALLBACK_DEADLINE_MISSES,
+    RA_METRIC_HANDSHAKES,
+    RA_METRIC_HANDSHAKES_REJECTED,
+    RA_METRIC_HANDSHAKE_COOKIES,
+    RA_METRIC_HANDSHAKES_RESUMED,
+    RA_METRIC_STREAMS_OPEN,
+    RA_METRIC_BUFFER_MS,
+    RA_METRIC_LATENCY_US,
+    RA_METRIC_CLOCK_RTT_US,
+    RA_METRIC_LAST_UPDATE_AGE_SECONDS,
+    RA_METRIC_COUNT,
+} ra_metric_id;
+
+typedef struct {
+    atomic_ullong buckets[RA_METRICS_HISTOGRAM_BUCKETS];
+    atomic_ullong sum_ns;
+} ra_metrics_histogram_t;
+
+// Values are only touched with relaxed atomics, so they can be bumped from the audio callback
+typedef struct {
+    atomic_ullong values[RA_METRIC_COUNT];
+    ra_metrics_histogram_t callback_duration;
+} ra_metrics_t;
+
+typedef struct {
+    const char *labels;  // Comma separated name="value" pairs, or NULL for none
+    ra_metrics_t *metrics;
+} ra_metrics_set_t;
+
+// Renders the metrics for every scrape on the server's thread, returns -1 when the buffer is too small
+typedef int ra_metrics_render_func(char *buf, size_t cap, size_t *len, void *userdata);
+
+struct ra_metrics_server_t;
+typedef struct ra_metrics_server_t ra_metrics_server_t;
+
+void ra_metrics_init(ra_metrics_t *metrics);
+void ra_metrics_add(ra_metrics_t *metrics, ra_metric_id id, uint64_t value);
+void ra_metrics_set(ra_metrics_t *metrics, ra_metric_id id, uint64_t value);
+uint64_t ra_metrics_get(const ra_metrics_t *metrics, ra_metric_id id);
+
+void ra_metrics_observe_ns(ra_metrics_histogram_t *hist, uint64_t ns);
+uint64_t ra_metrics_histogram_count(const ra_metrics_histogram_t *hist);
+
+// Appends the metrics of the scope in the Prometheus text format at len, returns -1 once the buffer is full
+int ra_metrics_render(
+    char *buf, size_t cap, size_t *len, const char *prefix, int scope, const ra_metrics_set_t *sets, int count);
+
+// Serves the rendered metrics over HTTP on a TCP port, meant to be bound to the loopback interface
+ra_metrics_server_t *ra_metrics_server_start(ra_logger_t *logger,
+                                             const char *host,
+                                             unsigned int port,
+                                             ra_metrics_render_func *render,
+                                             void *userdata,
+                                             int *err);
+void ra_metrics_server_stop(ra_metrics_server_t *server);
+
+#endif
@@ -0,0 +1,148 @@
+#include "ogg.h"
+
+#include <stdlib.h>
+
+#include "string.h"
+
+#define PAGE_HEADER_SIZE 27
+#define MAX_SEGMENTS     255
+#define MAX_PAGE_SIZE    (PAGE_HEADER_SIZE + MAX_SEGMENTS + MAX_SEGMENTS * 255)
+
+#define PAGE_FLAG_BOS 0x02
+#define PAGE_FLAG_EOS 0x04
+
+#define VENDOR_STRING "remote-audio"
+
+struct ra_ogg_writer_t {
+    FILE *file;
+    uint32_t serial;
+    uint32_t sequence;
+    uint64_t granule;
+    unsigned char flags;
+    int segment_count;
+    size_t body_len;
+    unsigned char segments[MAX_SEGMENTS];
+    unsigned char body[MAX_SEGMENTS * 255];
+    unsigned char page[MAX_PAGE_SIZE];
+};
+
+static uint32_t crc_table[256];
+
+static void crc_table_init() {
+    if (crc_table[1]) return;
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t r = i << 24;
+        for (int j = 0; j < 8; j++) r = r & 0x80000000 ? (r << 1) ^ 0x04c11db7 : r << 1;
+        crc_table[i] = r;
+    }
+}
+
+// CRC-32 as used by Ogg, no reflection, zero initial value and no final xor
+uint32_t ra_ogg_crc32(uint32_t crc, const unsigned char *data, size_t len) {
+    crc_table_init();
+    for (size_t i = 0; i < len; i++) crc = (crc << 8) ^ crc_table[((crc >> 24) ^ data[i]) & 0xff];
+    return crc;
+}
+
+static void le16_to_bytes(unsigned char *buf, uint16_t value) {
+    buf[0] = value & 0xff;
+    buf[1] = value >> 8;
+}
+
+static void le32_to_bytes(unsigned char *buf, uint32_t value) {
+    for (int i = 0; i < 4; i++) buf[i] = (value >> (i * 8)) & 0xff;
+}
+
+static void le64_to_bytes(unsigned char *buf, uint64_t value) {
+    for (int i = 0; i < 8; i++) buf[i] = (value >> (i * 8)) & 0xff;
+}
+
+static int flush_page(ra_ogg_writer_t *writer, unsigned char flags) {
+    unsigned char *p = writer->page;
+    memcpy(p, "OggS", 4);
+    p[4] = 0;
+    p[5] = writer->flags | flags;
+    le64_to_bytes(p + 6, writer->granule);
+    le32_to_bytes(p + 14, writer->serial);
+    le32_to_bytes(p + 18, writer->sequence++);
+    le32_to_bytes(p + 22, 0);
+    p[26] = writer->segment_count;
+    memcpy(p + PAGE_HEADER_SIZE, writer->segments, writer->segment_count);
+    memcpy(p + PAGE_HEADER_SIZE + writer->segment_count, writer->body, writer->body_len);
+
+    size_t len = PAGE_HEADER_SIZE + writer->segment_count + writer->body_len;
+    le32_to_bytes(p + 22, ra_ogg_crc32(0, p, len));
+
+    writer->flags = 0;
+    writer->segment_count = 0;
+    writer->body_len = 0;
+    return fwrite(p, 1, len, writer->file) == len ? 0 : -1;
+}
+
+static int add_packet(ra_ogg_writer_t *writer, const unsigned char *packet, size_t len) {
+    // Lacing values, a packet ending on a multiple of 255 gets a terminating zero
+    int segments = len / 255 + 1;
+    if (segments > MAX_SEGMENTS) return -1;
+    if (writer->segment_count + segments > MAX_SEGMENTS && flush_page(writer, 0)) return -1;
+
+    for (int i = 0; i < segments - 1; i++) writer->segments[writer->segment_count++] = 255;
+    writer->segments[writer->segment_count++] = len % 255;
+    memcpy(writer->body + writer->body_len, packet, len);
+    writer->body_len += len;
+    return 0;
+}
+
+ra_ogg_writer_t *ra_ogg_writer_create(FILE *file, const ra_opus_head_t *head, uint32_t serial) {
+    ra_ogg_writer_t *writer = calloc(1, sizeof(ra_ogg_writer_t));
+    writer->file = file;
+    writer->serial = serial;
+    writer->flags = PAGE_FLAG_BOS;
+
+    // Identification header, alone on the first page
+    unsigned char buf[PAGE_HEADER_SIZE + 255];
+    unsigned char *p = buf;
+    memcpy(p, "OpusHead", 8);
+    p[8] = 1;
+    p[9] = head->channel_count;
+    le16_to_bytes(p + 10, head->pre_skip);
+    le32_to_bytes(p + 12, head->sample_rate);
+    le16_to_bytes(p + 16, 0);
+    p[18] = head->mapping_family;
+    p += 19;
+    if (head->mapping_family != 0) {
+        *p++ = head->streams;
+        *p++ = head->coupled_streams;
+        memcpy(p, head->mapping, head->channel_count);
+        p += head->channel_count;
+    }
+    if (add_packet(writer, buf, p - buf) || flush_page(writer, 0)) goto error;
+
+    // Comment header, no user comments
+    p = buf;
+    memcpy(p, "OpusTags", 8);
+    le32_to_bytes(p + 8, strlen(VENDOR_STRING));
+    memcpy(p + 12, VENDOR_STRING, strlen(VENDOR_STRING));
+    p += 12 + strlen(VENDOR_STRING);
+    le32_to_bytes(p, 0);
+    p += 4;
+    if (add_packet(writer, buf, p - buf) || flush_page(writer, 0)) goto error;
+    return writer;
+
+error:
+    free(writer);
+    return NULL;
+}
+
+int ra_ogg_writer_write(ra_ogg_writer_t *writer, const unsigned char *packet, size_t len, uint32_t samples) {
+    if (add_packet(writer, packet, len)) return -1;
+    // A page's granule position is the end of the last packet completed on it
+    writer->granule += samples;
+    if (writer->body_len >= RA_OGG_PAGE_TARGET_SIZE) return flush_page(writer, 0);
+    return 0;
+}
+
+int ra_ogg_writer_close(ra_ogg_writer_t *writer) {
+    int err = flush_page(writer, PAGE_FLAG_EOS);
+    free(writer);
+    return err;
+}
@@ -0,0 +1,34 @@
+#ifndef _RA_OGG_H
+#define _RA_OGG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Decoder delay of libopus at 48 kHz, packets are passed through so the encoder's own value isn't known
+#define RA_OGG_OPUS_PRE_SKIP 312
+
+// Flush a page once its body reaches this size
+#define RA_OGG_PAGE_TARGET_SIZE 4096
+
+// OpusHead identification header, RFC 7845 section 5.1
+typedef struct {
+    int channel_count;
+    int sample_rate;
+    int pre_skip;
+    int mapping_family;
+    int streams;
+    int coupled_streams;
+    unsigned char mapping[255];
+} ra_opus_head_t;
+
+struct ra_ogg_writer_t;
+typedef struct ra_ogg_writer_t ra_ogg_writer_t;
+
+uint32_t ra_ogg_crc32(uint32_t crc, const unsigned char *data, size_t len);
+
+// Ogg Opus muxer, packets are written unchanged with granule positions counted in 48 kHz samples
+ra_ogg_writer_t *ra_ogg_writer_create(FILE *file, const ra_opus_head_t *head, uint32_t serial);
+int ra_ogg_writer_write(ra_ogg_writer_t *writer, const unsigned char *packet, size_t len, uint32_t samples);
+int ra_ogg_writer_close(ra_ogg_writer_t *writer);
+
+#endif
@@ -0,0 +1,110 @@
+#include "packet.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+// The free list head packs a tag in the upper half, bumped on every change so a stale head can't be swapped back in
+#define HEAD_INDEX(head)    ((uint32_t)(head))
+#define HEAD_TAG(head)      ((head) >> 32)
+#define HEAD_MAKE(tag, idx) (((uint64_t)(tag) << 32) | (idx))
+
+struct ra_packet_pool_t {
+    ra_packet_t *packets;
+    size_t count;
+    atomic_ullong free_head;  // Index of the first free packet plus one, 0 when none are left
+    atomic_size_t available;
+};
+
+static void push_free(ra_packet_pool_t *pool, ra_packet_t *pkt) {
+    uint32_t index = (uint32_t)(pkt - pool->packets) + 1;
+    uint64_t head = atomic_load(&pool->free_head);
+    do {
+        atomic_store_explicit(&pkt->next_free, HEAD_INDEX(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak(&pool->free_head, &head, HEAD_MAKE(HEAD_TAG(head) + 1, index)));
+    atomic_fetch_add_explicit(&pool->available, 1, memory_order_relaxed);
+}
+
+static ra_packet_t *pop_free(ra_packet_pool_t *pool) {
+    uint64_t head = atomic_load(&pool->free_head);
+    ra_packet_t *pkt;
+    for (;;) {
+        if (HEAD_INDEX(head) == 0) return NULL;
+        pkt = &pool->packets[HEAD_INDEX(head) - 1];
+        uint32_t next = atomic_load_explicit(&pkt->next_free, memory_order_relaxed);
+        if (atomic_compare_exchange_weak(&pool->free_head, &head, HEAD_MAKE(HEAD_TAG(head) + 1, next))) break;
+    }
+    atomic_fetch_sub_explicit(&pool->available, 1, memory_order_relaxed);
+    return pkt;
+}
+
+ra_packet_pool_t *ra_packet_pool_create(size_t count) {
+    ra_packet_pool_t *pool = malloc(sizeof(ra_packet_pool_t));
+    pool->packets = calloc(count, sizeof(ra_packet_t));
+    pool->count = count;
+    atomic_init(&pool->free_head, 0);
+    atomic_init(&pool->available, 0);
+    for (size_t i = 0; i < count; i++) {
+        pool->packets[i].pool = pool;
+        push_free(pool, &pool->packets[i]);
+    }
+    return pool;
+}
+
+size_t ra_packet_pool_available(ra_packet_pool_t *pool) {
+    return atomic_load_explicit(&pool->available, memory_order_relaxed);
+}
+
+void ra_packet_pool_destroy(ra_packet_pool_t *pool) {
+    if (!pool) return;
+    free(pool->packets);
+    free(pool);
+}
+
+ra_packet_t *ra_packet_alloc(ra_packet_pool_t *pool) {
+    ra_packet_t *pkt = pop_free(pool);
+    if (!pkt) return NULL;
+    atomic_store_explicit(&pkt->refs, 1, memory_order_relaxed);
+    pkt->data = pkt->raw + RA_PACKET_HEADROOM;
+    pkt->len = 0;
+    return pkt;
+}
+
+ra_packet_t *ra_packet_retain(ra_packet_t *pkt) {
+    atomic_fetch_add_explicit(&pkt->refs, 1, memory_order_relaxed);
+    return pkt;
+}
+
+// Release ordering so whatever the last owners wrote happens before the packet gets handed out again
+void ra_packet_release(ra_packet_t *pkt) {
+    if (atomic_fetch_sub_explicit(&pkt->refs, 1, memory_order_acq_rel) != 1) return;
+    push_free(pkt->pool, pkt);
+}
+
+size_t ra_packet_headroom(const ra_packet_t *pkt) {
+    return pkt->data - pkt->raw;
+}
+
+size_t ra_packet_tailroom(const ra_packet_t *pkt) {
+    return sizeof(pkt->raw) - ra_packet_headroom(pkt) - pkt->len;
+}
+
+char *ra_packet_push(ra_packet_t *pkt, size_t len) {
+    if (len > ra_packet_headroom(pkt)) return NULL;
+    pkt->data -= len;
+    pkt->len += len;
+    return pkt->data;
+}
+
+char *ra_packet_put(ra_packet_t *pkt, size_t len) {
+    if (len > ra_packet_tailroom(pkt)) return NULL;
+    char *tail = pkt->data + pkt->len;
+    pkt->len += len;
+    return tail;
+}
+
+char *ra_packet_pull(ra_packet_t *pkt, size_t len) {
+    if (len > pkt->len) return NULL;
+    pkt->data += len;
+    pkt->len -= len;
+    return pkt->data;
+}
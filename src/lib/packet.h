@@ -0,0 +1,46 @@
+#ifndef _RA_PACKET_H
+#define _RA_PACKET_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Largest datagram a packet holds, the same as the stack buffers it replaces
+#define RA_PACKET_SIZE 65535
+// Room kept in front of and behind the payload, so headers and trailers get added without moving it
+#define RA_PACKET_HEADROOM 64
+#define RA_PACKET_TAILROOM 64
+
+struct ra_packet_pool_t;
+typedef struct ra_packet_pool_t ra_packet_pool_t;
+
+// Reference counted packet buffer handed out by a pool, going back to it once the last reference is released. A
+// packet is only written by its single owner, once it's retained by more than one it must be treated as read only.
+typedef struct {
+    ra_packet_pool_t *pool;
+    atomic_uint refs;
+    atomic_uint next_free;  // Pool index of the next free packet plus one, only used while the packet is free
+    char *data;
+    size_t len;
+    char raw[RA_PACKET_HEADROOM + RA_PACKET_SIZE + RA_PACKET_TAILROOM];
+} ra_packet_t;
+
+// Every packet is allocated up front, taking and returning them is lock free and safe from any thread
+ra_packet_pool_t *ra_packet_pool_create(size_t count);
+size_t ra_packet_pool_available(ra_packet_pool_t *pool);
+// Every packet must have been released by then
+void ra_packet_pool_destroy(ra_packet_pool_t *pool);
+
+// Returns an empty packet with the full headroom in front of it, or NULL when the pool ran dry
+ra_packet_t *ra_packet_alloc(ra_packet_pool_t *pool);
+ra_packet_t *ra_packet_retain(ra_packet_t *pkt);
+void ra_packet_release(ra_packet_t *pkt);
+
+size_t ra_packet_headroom(const ra_packet_t *pkt);
+size_t ra_packet_tailroom(const ra_packet_t *pkt);
+// Grows the packet at the front or the back, returning where the new bytes go or NULL when there's no room left
+char *ra_packet_push(ra_packet_t *pkt, size_t len);
+char *ra_packet_put(ra_packet_t *pkt, size_t len);
+// Strips bytes off the front, returning the new start or NULL when the packet is shorter than that
+char *ra_packet_pull(ra_packet_t *pkt, size_t len);
+
+#endif
@@ -0,0 +1,129 @@
+#include "peer.h"
+
+#include <stdio.h>
+
+#include "string.h"
+#include "types.h"
+
+int ra_peer_init(ra_peer_t *peer, SOCKET sock, const char *host, unsigned int port) {
+    if (strlen(host) >= sizeof(peer->host)) return -1;
+    strcpy(peer->host, host);
+    peer->port = port;
+    peer->conn.sock = sock;
+    peer->conn.addr = (struct sockaddr *)&peer->addr;
+    peer->conn.addrlen = sizeof(peer->addr);
+    peer->state = 0;
+    peer->last_heartbeat = time(NULL);
+    peer->cookielen = 0;
+    ra_stream_init(&peer->stream, 0);
+    memset(peer->stream.secret, 0, sizeof(peer->stream.secret));
+    return ra_sockaddr_init(host, port, &peer->addr);
+}
+
+// Parses a comma separated list of host[:port] entries, returning the number of peers or -1 on error
+int ra_peer_parse_list(ra_peer_t *peers, int max_peers, SOCKET sock, const char *list, unsigned int default_port) {
+    char host[RA_PEER_HOST_SIZE];
+    int count = 0;
+    const char *rptr = list;
+    while (*rptr) {
+        const char *endptr = strchr(rptr, ',');
+        if (!endptr) endptr = rptr + strlen(rptr);
+        size_t len = endptr - rptr;
+        if (len > 0) {
+            if (count >= max_peers || len >= sizeof(host)) return -1;
+            memcpy(host, rptr, len);
+            host[len] = '\0';
+            unsigned int port = ra_hostport_split(host, default_port);
+            if (ra_peer_init(&peers[count++], sock, host, port)) return -1;
+        }
+        rptr = *endptr ? endptr + 1 : endptr;
+    }
+    return count;
+}
+
+ra_peer_t *ra_peer_find(ra_peer_t *peers, int count, const struct sockaddr *addr) {
+    const struct sockaddr_in *saddr = (const struct sockaddr_in *)addr;
+    for (int i = 0; i < count; i++) {
+        ra_peer_t *peer = &peers[i];
+        if (peer->addr.sin_addr.s_addr == saddr->sin_addr.s_addr && peer->addr.sin_port == saddr->sin_port)
+            return peer;
+    }
+    return NULL;
+}
+
+bool ra_peer_ready(const ra_peer_t *peer) {
+    return peer->state >= 2;
+}
+
+int ra_peer_send_handshake(ra_peer_t *peer,
+                           const ra_keypair_t *keypair,
+                           const ra_audio_config_t *cfg,
+                           const ra_channel_layout_t *layout) {
+    char rawbuf[2048];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+
+    // Stop sending before the key is replaced, the nonces carry on until the response says it's a new session
+    peer->state = 0;
+    create_handshake_message(&buf, keypair, cfg, layout, peer->cookie, peer->cookielen);
+    if (ra_buf_sendto(&peer->conn, (ra_rbuf_t *)&buf) <= 0) return -1;
+    peer->last_heartbeat = time(NULL);
+    peer->state = 1;
+    return 0;
+}
+
+int ra_peer_handle_handshake_cookie(ra_peer_t *peer, const ra_rbuf_t *rbuf) {
+    const unsigned char *cookie;
+    size_t cookielen;
+    if (peer->state != 1 || read_handshake_cookie_message(&cookie, &cookielen, rbuf)) return -1;
+    if (cookielen > sizeof(peer->cookie)) return -1;
+    memcpy(peer->cookie, cookie, cookielen);
+    peer->cookielen = cookielen;
+    return 0;
+}
+
+int ra_peer_handle_handshake_response(ra_peer_t *peer, const ra_keypair_t *keypair, const ra_rbuf_t *rbuf) {
+    if (peer->state != 1 || rbuf->len < RA_STREAM_ID_SIZE + 1) return -1;
+
+    ra_stream_t *stream = &peer->stream;
+    const char *rptr = rbuf->base;
+    const char *endptr = rptr + rbuf->len;
+    uint32_t stream_id = bytes_to_uint32(rptr);
+    rptr += RA_STREAM_ID_SIZE;
+
+    unsigned char keysize = (unsigned char)*rptr++;
+    if (rptr + keysize > endptr) return -1;
+    uint8_t secret[SHARED_SECRET_SIZE];
+    int err = ra_compute_shared_secret(
+        secret, sizeof(secret), (unsigned char *)rptr, keysize, keypair, RA_SHARED_SECRET_CLIENT);
+    if (err) return err;
+
+    // A sink resuming the same session keeps counting its nonces where it left off, any other session starts over
+    if (stream->id != stream_id || sodium_memcmp(stream->secret, secret, sizeof(secret))) {
+        memcpy(stream->secret, secret, sizeof(secret));
+        ra_stream_reset(stream);
+    }
+    stream->id = stream_id;
+    peer->last_heartbeat = time(NULL);
+    peer->state = 2;
+    return 0;
+}
+
+// Decrypts a crypto message from the peer, the payload starts with its crypto type. Errors are ra_stream_read's
+int ra_peer_read(ra_peer_t *peer, ra_buf_t *buf, const ra_rbuf_t *rbuf) {
+    if (!ra_peer_ready(peer) || rbuf->len < RA_STREAM_ID_SIZE) return -1;
+    const char *rptr = rbuf->base;
+    const char *endptr = rptr + rbuf->len;
+
+    ra_stream_t *stream = &peer->stream;
+    if (bytes_to_uint32(rptr) != stream->id) return -1;
+    rptr += RA_STREAM_ID_SIZE;
+    int err = ra_stream_read(stream, buf, rptr, endptr - rptr);
+    if (err) return err;
+    peer->last_heartbeat = time(NULL);
+    return buf->len < 1 ? -1 : 0;
+}
+
+ssize_t ra_peer_send(ra_peer_t *peer, const ra_rbuf_t *buf) {
+    if (!ra_peer_ready(peer)) return 0;
+    return ra_stream_send(&peer->stream, &peer->conn, buf);
+}
@@ -0,0 +1,44 @@
+#ifndef _RA_PEER_H
+#define _RA_PEER_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "codec.h"
+#include "congestion.h"
+#include "proto.h"
+#include "stream.h"
+
+#define RA_PEER_HOST_SIZE 256
+
+// Session with a downstream sink, each holding its own handshake, key and heartbeat
+typedef struct {
+    char host[RA_PEER_HOST_SIZE];
+    unsigned int port;
+    ra_conn_t conn;
+    struct sockaddr_in addr;
+    ra_stream_t stream;
+    unsigned char cookie[COOKIE_SIZE];  // Last cookie the sink handed out, sent along with every handshake
+    size_t cookielen;
+    atomic_uchar state;  // 0 = uninitialized, 1 = handshake sent, 2 = handshake completed
+    _Atomic(time_t) last_heartbeat;
+    ra_congestion_t cc;
+} ra_peer_t;
+
+int ra_peer_init(ra_peer_t *peer, SOCKET sock, const char *host, unsigned int port);
+int ra_peer_parse_list(ra_peer_t *peers, int max_peers, SOCKET sock, const char *list, unsigned int default_port);
+ra_peer_t *ra_peer_find(ra_peer_t *peers, int count, const struct sockaddr *addr);
+bool ra_peer_ready(const ra_peer_t *peer);
+
+int ra_peer_send_handshake(ra_peer_t *peer,
+                           const ra_keypair_t *keypair,
+                           const ra_audio_config_t *cfg,
+                           const ra_channel_layout_t *layout);
+// Keeps the cookie for the handshake to be sent again with, returns -1 when no handshake is waiting for it
+int ra_peer_handle_handshake_cookie(ra_peer_t *peer, const ra_rbuf_t *rbuf);
+int ra_peer_handle_handshake_response(ra_peer_t *peer, const ra_keypair_t *keypair, const ra_rbuf_t *rbuf);
+int ra_peer_read(ra_peer_t *peer, ra_buf_t *buf, const ra_rbuf_t *rbuf);
+ssize_t ra_peer_send(ra_peer_t *peer, const ra_rbuf_t *buf);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef _RA_COMMON_AUDIO_H
+#define _RA_COMMON_AUDIO_H
+
+#include "lib/audio.h"
+
+typedef struct {
+    const char *name;
+    int (*init)(ra_logger_t *logger);
+    void (*deinit)();
+    int (*find_device)(ra_audio_config_t *cfg, const char *dev);
+    const char *(*device_name)(const ra_audio_config_t *cfg);
+    ra_audio_handle_t *(*open)(ra_audio_config_t *cfg, PaStreamCallback *callback, void *userdata);
+    int (*start)(ra_audio_handle_t *handle);
+    int (*stop)(ra_audio_handle_t *handle);
+    void (*close)(ra_audio_handle_t *handle);
+    double (*latency)(ra_audio_handle_t *handle);  // Optional, backends without one have no device latency
+} ra_audio_backend_t;
+
+// Backends extend this with their own state
+struct ra_audio_handle_t {
+    const ra_audio_backend_t *backend;
+};
+
+extern const PaSampleFormat ra_prioritized_sample_formats[];
+extern const int ra_prioritized_sample_rates[];
+
+extern const ra_audio_backend_t ra_audio_backend_portaudio;
+extern const ra_audio_backend_t ra_audio_backend_null;
+extern const ra_audio_backend_t ra_audio_backend_file;
+extern const ra_audio_backend_t ra_audio_backend_pipe;
+
+// Pacing of the backends running on their own clock
+void ra_audio_clock_set_realtime(bool realtime);
+
+#endif
@@ -2,17 +2,36 @@
 
 #include <stdlib.h>
 
-thread_context_t *create_thread_context(ra_thread_func *routine, void *data) {
+static ra_thread_sched_t audio_sched;
+static bool has_audio_sched = false;
+
+thread_context_t *create_thread_context(ra_thread_func *routine, void *data, const ra_thread_sched_t *sched) {
     thread_context_t *ctx = (thread_context_t *)malloc(sizeof(thread_context_t));
-    init_thread_context(ctx, routine, data);
+    init_thread_context(ctx, routine, data, sched);
     return ctx;
 }
 
-void init_thread_context(thread_context_t *ctx, ra_thread_func *routine, void *data) {
+void init_thread_context(thread_context_t *ctx, ra_thread_func *routine, void *data, const ra_thread_sched_t *sched) {
     ctx->thread_func = routine;
     ctx->data = data;
+    ctx->has_sched = sched != NULL;
+    if (sched) ctx->sched = *sched;
 }
 
 void run_thread_context(thread_context_t *ctx) {
+    if (ctx->has_sched) {
+        ra_thread_set_priority(ctx->sched.policy, ctx->sched.priority);
+        ra_thread_set_affinity(ctx->sched.cpu);
+    }
     (*ctx->thread_func)(ctx->data);
 }
+
+// Set once during startup, before any thread on the audio path gets started
+void ra_thread_set_audio_sched(const ra_thread_sched_t *sched) {
+    audio_sched = *sched;
+    has_audio_sched = true;
+}
+
+const ra_thread_sched_t *ra_thread_audio_sched() {
+    return has_audio_sched ? &audio_sched : NULL;
+}
@@ -3,12 +3,16 @@
 
 #include "lib/thread.h"
 
+#include <stdbool.h>
+
 typedef struct {
     ra_thread_func *thread_func;
     void *data;
+    ra_thread_sched_t sched;
+    bool has_sched;
 } thread_context_t;
 
-thread_context_t *create_thread_context(ra_thread_func *routine, void *data);
-void init_thread_context(thread_context_t *ctx, ra_thread_func *routine, void *data);
+thread_context_t *create_thread_context(ra_thread_func *routine, void *data, const ra_thread_sched_t *sched);
+void init_thread_context(thread_context_t *ctx, ra_thread_func *routine, void *data, const ra_thread_sched_t *sched);
 void run_thread_context(thread_context_t *ctx);
 #endif
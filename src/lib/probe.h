@@ -0,0 +1,23 @@
+#ifndef _RA_PROBE_H
+#define _RA_PROBE_H
+
+// USDT probes under the remote_audio provider, for attaching bpftrace or SystemTap to a running process, e.g.
+//   bpftrace -e 'usdt:./remote-audio-sink:remote_audio:stream_read { @[arg0] = count(); }'
+// A probe compiles to a single nop unless a tracer is attached, builds without sys/sdt.h compile them out entirely
+#ifdef RA_HAVE_SDT
+#include <sys/sdt.h>
+
+#define RA_PROBE(name)                  DTRACE_PROBE(remote_audio, name)
+#define RA_PROBE1(name, a1)             DTRACE_PROBE1(remote_audio, name, a1)
+#define RA_PROBE2(name, a1, a2)         DTRACE_PROBE2(remote_audio, name, a1, a2)
+#define RA_PROBE3(name, a1, a2, a3)     DTRACE_PROBE3(remote_audio, name, a1, a2, a3)
+#define RA_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(remote_audio, name, a1, a2, a3, a4)
+#else
+#define RA_PROBE(name)                  ((void)0)
+#define RA_PROBE1(name, a1)             ((void)0)
+#define RA_PROBE2(name, a1, a2)         ((void)0)
+#define RA_PROBE3(name, a1, a2, a3)     ((void)0)
+#define RA_PROBE4(name, a1, a2, a3, a4) ((void)0)
+#endif
+
+#endif
@@ -1,6 +1,7 @@
 #include "proto.h"
 
 #include "string.h"
+#include "trace.h"
 
 ra_rbuf_t *ra_stream_heartbeat_message = NULL;
 ra_rbuf_t *ra_stream_terminate_message = NULL;
@@ -46,8 +47,19 @@ void ra_rbuf_init(ra_rbuf_t *buf, const char *rawbuf, size_t len) {
     buf->len = len;
 }
 
+// Receiving into the view fills the packet up to its tailroom, the length has to be set from what was read
+ra_buf_t ra_packet_buf(ra_packet_t *pkt) {
+    return (ra_buf_t){.base = pkt->data, .len = pkt->len, .cap = pkt->len + ra_packet_tailroom(pkt)};
+}
+
+ra_rbuf_t ra_packet_rbuf(const ra_packet_t *pkt) {
+    return (ra_rbuf_t){.base = pkt->data, .len = pkt->len};
+}
+
 ssize_t ra_buf_recvfrom(ra_conn_t *conn, ra_buf_t *buf) {
+    uint64_t trace_start = RA_TRACE_BEGIN();
     ssize_t res = recvfrom(conn->sock, buf->base, buf->cap, 0, conn->addr, &conn->addrlen);
+    RA_TRACE_END(RA_TRACE_RECV, trace_start);
     if (res < 0)
         ra_socket_perror("recvfrom");
     else
@@ -56,15 +68,25 @@ ssize_t ra_buf_recvfrom(ra_conn_t *conn, ra_buf_t *buf) {
 }
 
 ssize_t ra_buf_sendto(const ra_conn_t *conn, const ra_rbuf_t *buf) {
+    uint64_t trace_start = RA_TRACE_BEGIN();
     ssize_t res = sendto(conn->sock, buf->base, buf->len, 0, conn->addr, conn->addrlen);
+    RA_TRACE_END(RA_TRACE_SEND, trace_start);
     if (res < 0) ra_socket_perror("sendto");
     return res;
 }
 
-void create_handshake_message(ra_buf_t *buf, const ra_keypair_t *keypair, const ra_audio_config_t *cfg) {
+void create_handshake_message(ra_buf_t *buf,
+                              const ra_keypair_t *keypair,
+                              const ra_audio_config_t *cfg,
+                              const ra_channel_layout_t *layout,
+                              const unsigned char *cookie,
+                              size_t cookielen) {
     size_t keylen = sizeof(keypair->public);
     char *p = buf->base;
     *p++ = (char)RA_HANDSHAKE_INIT;
+    *p++ = (char)cookielen;
+    if (cookielen > 0) memcpy(p, cookie, cookielen);
+    p += cookielen;
     *p++ = (char)keylen;
     memcpy(p, keypair->public, keylen);
     p += keylen;
@@ -76,14 +98,82 @@ void create_handshake_message(ra_buf_t *buf, const ra_keypair_t *keypair, const
     uint32_to_bytes(p + 2, cfg->sample_rate);
     p += 6;
 
+    // Inject multistream channel layout
+    *p++ = (char)layout->streams;
+    *p++ = (char)layout->coupled_streams;
+    *p++ = (char)layout->groups;
+    memcpy(p, layout->mapping, layout->channel_count);
+    p += layout->channel_count;
+
     buf->len = p - buf->base;
 }
 
-void create_handshake_response_message(ra_buf_t *buf, uint8_t stream_id, const ra_keypair_t *keypair) {
+int read_handshake_message(ra_handshake_t *hs, const ra_rbuf_t *rbuf) {
+    if (rbuf->len < 2) return -1;
+    const char *rptr = rbuf->base;
+    const char *endptr = rptr + rbuf->len;
+
+    hs->cookielen = (unsigned char)*rptr++;
+    hs->cookie = (const unsigned char *)rptr;
+    if (rptr + hs->cookielen + 1 > endptr) return -1;
+    rptr += hs->cookielen;
+
+    hs->keylen = (unsigned char)*rptr++;
+    hs->key = (const unsigned char *)rptr;
+    if (rptr + hs->keylen > endptr) return -1;
+    rptr += hs->keylen;
+
+    // Read audio config
+    ra_audio_config_t *cfg = &hs->cfg;
+    if (rptr + 8 <= endptr) {
+        cfg->channel_count = (uint8_t)*rptr++;
+        cfg->sample_format = (uint8_t)*rptr++;
+        cfg->frame_size = bytes_to_uint16(rptr);
+        cfg->sample_rate = bytes_to_uint32(rptr + 2);
+        rptr += 6;
+    }
+
+    // Read the multistream channel layout, sources without one send plain stereo or mono
+    ra_channel_layout_t *layout = &hs->layout;
+    if (rptr + 3 + cfg->channel_count <= endptr) {
+        layout->channel_count = cfg->channel_count;
+        layout->streams = (uint8_t)*rptr++;
+        layout->coupled_streams = (uint8_t)*rptr++;
+        layout->groups = (uint8_t)*rptr++;
+        if (cfg->channel_count <= MAX_CHANNELS) memcpy(layout->mapping, rptr, cfg->channel_count);
+    } else if (ra_channel_layout_init(layout, cfg->channel_count, RA_MAPPING_FAMILY_MONO_STEREO, 1)) {
+        return -1;
+    }
+    return ra_channel_layout_validate(layout);
+}
+
+int ra_handshake_config_equal(const ra_handshake_t *a, const ra_handshake_t *b) {
+    return a->cfg.channel_count == b->cfg.channel_count && a->cfg.sample_format == b->cfg.sample_format &&
+           a->cfg.frame_size == b->cfg.frame_size && a->cfg.sample_rate == b->cfg.sample_rate &&
+           ra_channel_layout_equal(&a->layout, &b->layout);
+}
+
+void create_handshake_cookie_message(ra_buf_t *buf, const unsigned char *cookie, size_t cookielen) {
+    char *wptr = buf->base;
+    *wptr++ = (char)RA_HANDSHAKE_COOKIE;
+    *wptr++ = (char)cookielen;
+    memcpy(wptr, cookie, cookielen);
+    buf->len = wptr - buf->base + cookielen;
+}
+
+int read_handshake_cookie_message(const unsigned char **cookie, size_t *cookielen, const ra_rbuf_t *rbuf) {
+    if (rbuf->len < 1) return -1;
+    *cookielen = (unsigned char)rbuf->base[0];
+    *cookie = (const unsigned char *)rbuf->base + 1;
+    return 1 + *cookielen > rbuf->len ? -1 : 0;
+}
+
+void create_handshake_response_message(ra_buf_t *buf, uint32_t stream_id, const ra_keypair_t *keypair) {
     size_t keylen = sizeof(keypair->public);
     char *wptr = buf->base;
     *wptr++ = (char)RA_HANDSHAKE_RESPONSE;
-    *wptr++ = (char)stream_id;
+    uint32_to_bytes(wptr, stream_id);
+    wptr += RA_STREAM_ID_SIZE;
     *wptr++ = (char)keylen;
     memcpy(wptr, keypair->public, keylen);
     buf->len = wptr - buf->base + keylen;
@@ -94,3 +184,80 @@ void create_stream_data_message(ra_buf_t *buf, const ra_rbuf_t *rbuf) {
     memcpy(buf->base + 1, rbuf->base, rbuf->len);
     buf->len = rbuf->len + 1;
 }
+
+void create_stream_report_message(ra_buf_t *buf, const ra_stream_report_t *report) {
+    char *wptr = buf->base;
+    *wptr++ = (char)RA_STREAM_REPORT;
+    *wptr++ = (char)report->fraction_lost;
+    uint32_to_bytes(wptr, report->cumulative_lost);
+    uint32_to_bytes(wptr + 4, report->jitter_us);
+    uint32_to_bytes(wptr + 8, report->buffer_ms);
+    uint32_to_bytes(wptr + 12, report->underruns);
+    wptr += 16;
+    buf->len = wptr - buf->base;
+}
+
+int read_stream_report_message(ra_stream_report_t *report, const ra_rbuf_t *rbuf) {
+    if (rbuf->len < 17) return -1;
+    const char *rptr = rbuf->base;
+    report->fraction_lost = (uint8_t)*rptr++;
+    report->cumulative_lost = bytes_to_uint32(rptr);
+    report->jitter_us = bytes_to_uint32(rptr + 4);
+    report->buffer_ms = bytes_to_uint32(rptr + 8);
+    report->underruns = bytes_to_uint32(rptr + 12);
+    return 0;
+}
+
+void create_stream_group_message(ra_buf_t *buf, const ra_stream_group_t *group) {
+    char *wptr = buf->base;
+    *wptr++ = (char)RA_STREAM_GROUP;
+    memcpy(wptr, &group->addr.sin_addr, 4);
+    memcpy(wptr + 4, &group->addr.sin_port, 2);
+    wptr += 6;
+    uint32_to_bytes(wptr, group->stream_id);
+    wptr += RA_STREAM_ID_SIZE;
+    memcpy(wptr, group->secret, sizeof(group->secret));
+    wptr += sizeof(group->secret);
+    buf->len = wptr - buf->base;
+}
+
+int read_stream_group_message(ra_stream_group_t *group, const ra_rbuf_t *rbuf) {
+    if (rbuf->len < 6 + RA_STREAM_ID_SIZE + sizeof(group->secret)) return -1;
+    const char *rptr = rbuf->base;
+    memset(&group->addr, 0, sizeof(group->addr));
+    group->addr.sin_family = AF_INET;
+    memcpy(&group->addr.sin_addr, rptr, 4);
+    memcpy(&group->addr.sin_port, rptr + 4, 2);
+    rptr += 6;
+    group->stream_id = bytes_to_uint32(rptr);
+    rptr += RA_STREAM_ID_SIZE;
+    memcpy(group->secret, rptr, sizeof(group->secret));
+    return 0;
+}
+
+void create_stream_clock_message(ra_buf_t *buf, const ra_stream_clock_t *clock) {
+    char *wptr = buf->base;
+    *wptr++ = (char)RA_STREAM_CLOCK;
+    uint64_to_bytes(wptr, clock->origin_ns);
+    wptr += 8;
+    if (clock->remote_ns) {
+        uint64_to_bytes(wptr, clock->remote_ns);
+        wptr += 8;
+    }
+    buf->len = wptr - buf->base;
+}
+
+int read_stream_clock_message(ra_stream_clock_t *clock, const ra_rbuf_t *rbuf) {
+    if (rbuf->len < 8) return -1;
+    clock->origin_ns = bytes_to_uint64(rbuf->base);
+    clock->remote_ns = rbuf->len >= 16 ? bytes_to_uint64(rbuf->base + 8) : 0;
+    return 0;
+}
+
+// Size of the stream data header including its extensions, the packet follows it
+size_t stream_data_header_size(const ra_rbuf_t *rbuf) {
+    if (rbuf->len < STREAM_DATA_HEADER_SIZE) return STREAM_DATA_HEADER_SIZE;
+    size_t size = STREAM_DATA_HEADER_SIZE;
+    if (rbuf->base[6] & STREAM_DATA_FLAG_CAPTURE_TIME) size += STREAM_DATA_CAPTURE_TIME_SIZE;
+    return size;
+}
@@ -4,10 +4,26 @@
 #include <stdint.h>
 
 #include "audio.h"
+#include "codec.h"
 #include "crypto.h"
+#include "packet.h"
+#include "report.h"
 #include "socket.h"
 
-#define LISTEN_PORT 21500
+#define LISTEN_PORT    21500
+#define MULTICAST_PORT 21501
+
+// Session ID prefixing every crypto message, assigned by the sink in its handshake response
+#define RA_STREAM_ID_SIZE 4
+
+// Frame count, capture timestamp in samples and flags
+#define STREAM_DATA_HEADER_SIZE 7
+
+// Source is suppressing silence, gaps after this packet are intentional
+#define STREAM_DATA_FLAG_DTX 0x01
+// Header is followed by the time the first frame was captured, on the source's monotonic clock in ns
+#define STREAM_DATA_FLAG_CAPTURE_TIME 0x02
+#define STREAM_DATA_CAPTURE_TIME_SIZE 8
 
 typedef struct {
     char *base;
@@ -31,6 +47,7 @@ typedef enum {
     RA_HANDSHAKE_INIT,
     RA_HANDSHAKE_RESPONSE,
     RA_MESSAGE_CRYPTO,
+    RA_HANDSHAKE_COOKIE,
 } ra_message_type;
 
 typedef enum {
@@ -38,8 +55,34 @@ typedef enum {
     RA_STREAM_DATA,
     RA_STREAM_HEARTBEAT,
     RA_STREAM_TERMINATE,
+    RA_STREAM_REPORT,
+    RA_STREAM_GROUP,
+    RA_STREAM_CLOCK,
 } ra_crypto_type;
 
+// Multicast group the stream data is sent to, along with the group key it's encrypted with
+typedef struct {
+    struct sockaddr_in addr;
+    uint32_t stream_id;
+    uint8_t secret[SHARED_SECRET_SIZE];
+} ra_stream_group_t;
+
+// Clock round trip from the sink, the source answers with its own monotonic time appended
+typedef struct {
+    uint64_t origin_ns;  // Sink time the request was sent at
+    uint64_t remote_ns;  // Source time the request was answered at, 0 for a request
+} ra_stream_clock_t;
+
+// Handshake init from a source, fields it didn't send keep the values the struct was initialized with
+typedef struct {
+    const unsigned char *cookie;  // Echoed from the sink's cookie message, empty on the first attempt
+    size_t cookielen;
+    const unsigned char *key;
+    size_t keylen;
+    ra_audio_config_t cfg;
+    ra_channel_layout_t layout;
+} ra_handshake_t;
+
 extern ra_rbuf_t *ra_stream_heartbeat_message, *ra_stream_terminate_message;
 
 void ra_proto_init();
@@ -47,12 +90,32 @@ void ra_proto_deinit();
 
 void ra_buf_init(ra_buf_t *buf, char *rawbuf, size_t size);
 void ra_rbuf_init(ra_rbuf_t *buf, const char *rawbuf, size_t len);
+// Views over a pooled packet, only valid while a reference to it is held
+ra_buf_t ra_packet_buf(ra_packet_t *pkt);
+ra_rbuf_t ra_packet_rbuf(const ra_packet_t *pkt);
 
 ssize_t ra_buf_recvfrom(ra_conn_t *conn, ra_buf_t *buf);
 ssize_t ra_buf_sendto(const ra_conn_t *conn, const ra_rbuf_t *buf);
 
-void create_handshake_message(ra_buf_t *buf, const ra_keypair_t *keypair, const ra_audio_config_t *cfg);
-void create_handshake_response_message(ra_buf_t *buf, uint8_t stream_id, const ra_keypair_t *keypair);
+void create_handshake_message(ra_buf_t *buf,
+                              const ra_keypair_t *keypair,
+                              const ra_audio_config_t *cfg,
+                              const ra_channel_layout_t *layout,
+                              const unsigned char *cookie,
+                              size_t cookielen);
+int read_handshake_message(ra_handshake_t *hs, const ra_rbuf_t *rbuf);
+// Compares only what a handshake carries, the rest of the config is the receiver's own
+int ra_handshake_config_equal(const ra_handshake_t *a, const ra_handshake_t *b);
+void create_handshake_cookie_message(ra_buf_t *buf, const unsigned char *cookie, size_t cookielen);
+int read_handshake_cookie_message(const unsigned char **cookie, size_t *cookielen, const ra_rbuf_t *rbuf);
+void create_handshake_response_message(ra_buf_t *buf, uint32_t stream_id, const ra_keypair_t *keypair);
 void create_stream_data_message(ra_buf_t *buf, const ra_rbuf_t *rbuf);
+void create_stream_report_message(ra_buf_t *buf, const ra_stream_report_t *report);
+int read_stream_report_message(ra_stream_report_t *report, const ra_rbuf_t *rbuf);
+void create_stream_group_message(ra_buf_t *buf, const ra_stream_group_t *group);
+int read_stream_group_message(ra_stream_group_t *group, const ra_rbuf_t *rbuf);
+void create_stream_clock_message(ra_buf_t *buf, const ra_stream_clock_t *clock);
+int read_stream_clock_message(ra_stream_clock_t *clock, const ra_rbuf_t *rbuf);
+size_t stream_data_header_size(const ra_rbuf_t *rbuf);
 
 #endif
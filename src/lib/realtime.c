@@ -0,0 +1,67 @@
+#include "realtime.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include "string.h"
+#include "thread.h"
+
+int ra_realtime_config_read(ra_realtime_config_t *cfg, ra_config_section_t *options) {
+    const char *policy = ra_config_get_value(options, "rt-policy");
+    if (!policy || strequal(policy, "fifo")) {
+        cfg->policy = RA_THREAD_SCHED_FIFO;
+    } else if (strequal(policy, "rr")) {
+        cfg->policy = RA_THREAD_SCHED_RR;
+    } else {
+        return -1;
+    }
+    cfg->priority = ra_config_get_int(options, "rt-priority", 0);
+    if (cfg->priority < 0 || cfg->priority > 99) return -1;
+    cfg->lock_memory = ra_config_get_bool(options, "mlock", 0);
+    return 0;
+}
+
+void ra_realtime_lock_memory(ra_logger_t *logger, const ra_realtime_config_t *cfg) {
+    if (!cfg->lock_memory) return;
+    int err = ra_memory_lock(RA_REALTIME_STACK_PREFAULT);
+    if (err) {
+        ra_logger_warn(logger,
+                       "Failed to lock memory: %s%s",
+                       strerror(err),
+                       err == EPERM || err == ENOMEM ? ", it needs CAP_IPC_LOCK or a higher memlock limit" : "");
+        return;
+    }
+    ra_logger_info(logger, "Memory locked");
+}
+
+void ra_realtime_apply(ra_logger_t *logger, const ra_realtime_config_t *cfg, const char *name, int demote, int cpu) {
+    if (name) ra_thread_set_name(name);
+    const char *label = name ? name : "main";
+    if (cfg->priority > 0) {
+        int priority = cfg->priority > demote ? cfg->priority - demote : 1;
+        int err = ra_thread_set_priority(cfg->policy, priority);
+        if (err) {
+            ra_logger_warn(logger,
+                           "Failed to set realtime priority %d for the %s thread: %s%s",
+                           priority,
+                           label,
+                           strerror(err),
+                           err == EPERM ? ", it needs CAP_SYS_NICE or an rtprio limit" : "");
+        } else {
+            ra_logger_info(logger,
+                           "Running the %s thread at %s priority %d",
+                           label,
+                           cfg->policy == RA_THREAD_SCHED_RR ? "SCHED_RR" : "SCHED_FIFO",
+                           priority);
+        }
+    }
+    if (cpu >= 0) {
+        int err = ra_thread_set_affinity(cpu);
+        if (err) ra_logger_warn(logger, "Failed to pin the %s thread to CPU %d: %s", label, cpu, strerror(err));
+    }
+}
+
+void ra_realtime_set_audio_threads(const ra_realtime_config_t *cfg) {
+    ra_thread_sched_t sched = {.policy = cfg->policy, .priority = cfg->priority, .cpu = -1};
+    ra_thread_set_audio_sched(&sched);
+}
@@ -0,0 +1,29 @@
+#ifndef _RA_REALTIME_H
+#define _RA_REALTIME_H
+
+#include <stdbool.h>
+
+#include "config.h"
+#include "logger.h"
+
+// Stack prefaulted on the thread locking the memory, deeper than anything the receive path calls into
+#define RA_REALTIME_STACK_PREFAULT (256 * 1024)
+
+typedef struct {
+    int policy;    // RA_THREAD_SCHED_FIFO or RA_THREAD_SCHED_RR
+    int priority;  // 1 to 99, 0 leaves the scheduling alone
+    bool lock_memory;
+} ra_realtime_config_t;
+
+// Reads --rt-priority=<1-99>, --rt-policy=fifo|rr and --mlock, returns -1 on an invalid value
+int ra_realtime_config_read(ra_realtime_config_t *cfg, ra_config_section_t *options);
+
+// Settings the process isn't allowed to apply are logged as warnings, it keeps running with the defaults
+void ra_realtime_lock_memory(ra_logger_t *logger, const ra_realtime_config_t *cfg);
+// Names the calling thread, moves it to the priority lowered by demote and pins it to the CPU when it's not negative
+void ra_realtime_apply(ra_logger_t *logger, const ra_realtime_config_t *cfg, const char *name, int demote, int cpu);
+// Codec workers and clocked audio backends started from now on run at the configured priority on any CPU, even when
+// the thread starting them is demoted or pinned elsewhere
+void ra_realtime_set_audio_threads(const ra_realtime_config_t *cfg);
+
+#endif
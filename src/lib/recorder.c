@@ -0,0 +1,264 @@
+#include "recorder.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+#include "ogg.h"
+#include "string.h"
+#include "thread.h"
+#include "utils.h"
+#include "wav.h"
+
+#define OPUS_GRANULE_RATE  48000
+#define RECORD_HEADER_SIZE 4
+
+struct ra_recording_t {
+    ra_recorder_t *recorder;
+    ra_recording_t *next;
+    ra_ringbuf_t *queue;  // Written by the receiving thread, read by the writer thread
+    atomic_bool closing;
+    bool finished;  // Drained after closing was requested, owned by the writer thread
+    // Header read ahead of a packet that wasn't all queued yet, owned by the writer thread
+    uint16_t header[2];
+    bool has_header;
+    int sample_rate;
+    int channel_count;
+    FILE *ogg_file;
+    ra_ogg_writer_t *ogg;
+    FILE *wav_file;
+    ra_wav_writer_t *wav;
+    ra_decoder_t *decoder;
+    float *pcm;
+};
+
+struct ra_recorder_t {
+    ra_logger_t *logger;
+    ra_thread_t thread;
+    ra_mutex_t mutex;
+    ra_cond_t cond;
+    bool running;
+    bool pending;
+    // Set by the first write since the writer last woke up, later writes skip the mutex and the signal
+    atomic_bool notified;
+    ra_recording_t *recordings;
+    unsigned char packet[UINT16_MAX];
+};
+
+static void queue_write(ra_ringbuf_t *rb, const void *src, size_t len) {
+    const char *rptr = src;
+    while (len > 0) {
+        size_t n = ra_min(ra_ringbuf_free_count(rb), len);
+        memcpy(ra_ringbuf_write_ptr(rb), rptr, n);
+        ra_ringbuf_advance_write_ptr(rb, n);
+        rptr += n;
+        len -= n;
+    }
+}
+
+// Only called for bytes already queued
+static void queue_read(ra_ringbuf_t *rb, void *dst, size_t len) {
+    char *wptr = dst;
+    while (len > 0) {
+        size_t n = ra_min(ra_ringbuf_fill_count(rb), len);
+        memcpy(wptr, ra_ringbuf_read_ptr(rb), n);
+        ra_ringbuf_advance_read_ptr(rb, n);
+        wptr += n;
+        len -= n;
+    }
+}
+
+static void recording_free(ra_recording_t *recording) {
+    if (recording->ogg) ra_ogg_writer_close(recording->ogg);
+    if (recording->ogg_file) fclose(recording->ogg_file);
+    if (recording->wav) ra_wav_writer_close(recording->wav);
+    if (recording->wav_file) fclose(recording->wav_file);
+    ra_decoder_destroy(recording->decoder);
+    free(recording->pcm);
+    ra_ringbuf_destroy(recording->queue);
+    free(recording);
+}
+
+static void recording_drain(ra_recorder_t *recorder, ra_recording_t *recording) {
+    unsigned char *packet = recorder->packet;
+    ra_ringbuf_t *rb = recording->queue;
+    for (;;) {
+        if (!recording->has_header) {
+            if (ra_ringbuf_fill_total(rb) < RECORD_HEADER_SIZE) return;
+            queue_read(rb, recording->header, RECORD_HEADER_SIZE);
+            recording->has_header = true;
+        }
+        // A packet still being queued is picked up on the next wake-up
+        uint16_t len = recording->header[0], frames = recording->header[1];
+        if (ra_ringbuf_fill_total(rb) < len) return;
+        queue_read(rb, packet, len);
+        recording->has_header = false;
+
+        uint32_t samples = (uint64_t)frames * OPUS_GRANULE_RATE / recording->sample_rate;
+        if (ra_ogg_writer_write(recording->ogg, packet, len, samples))
+            ra_logger_error(recorder->logger, "Failed to write Ogg page");
+        if (!recording->wav) continue;
+        int decoded = ra_decode_float(recording->decoder, packet, len, recording->pcm, frames, 0);
+        if (decoded > 0) ra_wav_writer_write(recording->wav, recording->pcm, decoded);
+    }
+}
+
+static void writer_thread(void *arg) {
+    ra_recorder_t *recorder = arg;
+    ra_mutex_lock(&recorder->mutex);
+    for (;;) {
+        while (recorder->running && !recorder->pending) ra_cond_wait(&recorder->cond, &recorder->mutex);
+        bool running = recorder->running;
+        recorder->pending = false;
+        ra_recording_t *head = recorder->recordings;
+        ra_mutex_unlock(&recorder->mutex);
+        // Cleared before draining, anything queued after this wakes the writer again
+        atomic_store(&recorder->notified, false);
+
+        // Recordings are only ever unlinked by this thread, new ones go in front of the head taken above
+        bool finished = false;
+        for (ra_recording_t *recording = head; recording; recording = recording->next) {
+            bool closing = recording->closing || !running;
+            recording_drain(recorder, recording);
+            recording->finished = closing;
+            finished = finished || closing;
+        }
+
+        ra_mutex_lock(&recorder->mutex);
+        for (ra_recording_t **ptr = &recorder->recordings; finished && *ptr;) {
+            ra_recording_t *recording = *ptr;
+            if (!recording->finished) {
+                ptr = &recording->next;
+                continue;
+            }
+            *ptr = recording->next;
+            recording_free(recording);
+        }
+        if (!running && !recorder->recordings) break;
+    }
+    ra_mutex_unlock(&recorder->mutex);
+}
+
+ra_recorder_t *ra_recorder_create(ra_logger_t *logger, int *err) {
+    ra_recorder_t *recorder = calloc(1, sizeof(ra_recorder_t));
+    recorder->logger = logger;
+    recorder->running = true;
+    *err = ra_mutex_init(&recorder->mutex);
+    if (!*err) *err = ra_cond_init(&recorder->cond);
+    if (!*err) recorder->thread = ra_thread_start(&writer_thread, recorder, err);
+    if (*err) {
+        free(recorder);
+        return NULL;
+    }
+    return recorder;
+}
+
+void ra_recorder_destroy(ra_recorder_t *recorder) {
+    if (!recorder) return;
+    ra_mutex_lock(&recorder->mutex);
+    recorder->running = false;
+    ra_cond_signal(&recorder->cond);
+    ra_mutex_unlock(&recorder->mutex);
+
+    ra_thread_join(recorder->thread);
+    ra_thread_destroy(recorder->thread);
+    ra_cond_destroy(&recorder->cond);
+    ra_mutex_destroy(&recorder->mutex);
+    free(recorder);
+}
+
+static FILE *open_file(const char *path, const char *ext) {
+    char filename[1024];
+    snprintf(filename, sizeof(filename), "%s.%s", path, ext);
+    return fopen(filename, "wb");
+}
+
+ra_recording_t *ra_recording_open(ra_recorder_t *recorder,
+                                  const char *path,
+                                  const ra_audio_config_t *cfg,
+                                  const ra_channel_layout_t *layout,
+                                  bool wav,
+                                  int *err) {
+    // Grouped packets carry our own framing, they aren't valid Ogg Opus packets
+    if (layout->groups != 1 || cfg->sample_rate <= 0) {
+        *err = OPUS_BAD_ARG;
+        return NULL;
+    }
+
+    ra_recording_t *recording = calloc(1, sizeof(ra_recording_t));
+    recording->recorder = recorder;
+    recording->sample_rate = cfg->sample_rate;
+    recording->channel_count = cfg->channel_count;
+    recording->queue = ra_ringbuf_create(RA_RECORDING_QUEUE_SIZE);
+
+    ra_opus_head_t head = {
+        .channel_count = layout->channel_count,
+        .sample_rate = cfg->sample_rate,
+        .pre_skip = RA_OGG_OPUS_PRE_SKIP,
+        .mapping_family = ra_channel_layout_mapping_family(layout),
+        .streams = layout->streams,
+        .coupled_streams = layout->coupled_streams,
+    };
+    memcpy(head.mapping, layout->mapping, layout->channel_count);
+    recording->ogg_file = open_file(path, "opus");
+    if (!recording->ogg_file) goto error;
+    recording->ogg = ra_ogg_writer_create(recording->ogg_file, &head, rand());
+    if (!recording->ogg) goto error;
+
+    if (wav) {
+        ra_audio_config_t dec_cfg = *cfg;
+        dec_cfg.sample_format = paFloat32;
+        dec_cfg.sample_size = sizeof(float);
+        recording->decoder = ra_decoder_create(&dec_cfg, layout, NULL, err);
+        if (*err) goto error;
+        recording->pcm = malloc(MAX_FRAME_SIZE * cfg->channel_count * sizeof(float));
+
+        ra_wav_format_t fmt = {
+            .format = RA_WAV_FORMAT_FLOAT,
+            .channel_count = cfg->channel_count,
+            .sample_rate = cfg->sample_rate,
+            .bits_per_sample = 32,
+        };
+        recording->wav_file = open_file(path, "wav");
+        if (!recording->wav_file) goto error;
+        recording->wav = ra_wav_writer_create(recording->wav_file, &fmt);
+        if (!recording->wav) goto error;
+    }
+
+    ra_mutex_lock(&recorder->mutex);
+    recording->next = recorder->recordings;
+    recorder->recordings = recording;
+    ra_mutex_unlock(&recorder->mutex);
+    *err = 0;
+    return recording;
+
+error:
+    if (!*err) *err = -1;
+    recording_free(recording);
+    return NULL;
+}
+
+static void notify_writer(ra_recorder_t *recorder) {
+    if (atomic_exchange(&recorder->notified, true)) return;
+    ra_mutex_lock(&recorder->mutex);
+    recorder->pending = true;
+    ra_cond_signal(&recorder->cond);
+    ra_mutex_unlock(&recorder->mutex);
+}
+
+int ra_recording_write(ra_recording_t *recording, const unsigned char *packet, size_t len, int frames) {
+    ra_ringbuf_t *rb = recording->queue;
+    if (len > UINT16_MAX || frames > MAX_FRAME_SIZE) return -1;
+    if (ra_ringbuf_size(rb) - ra_ringbuf_fill_total(rb) < RECORD_HEADER_SIZE + len) return -1;
+
+    uint16_t header[2] = {len, frames};
+    queue_write(rb, header, sizeof(header));
+    queue_write(rb, packet, len);
+    notify_writer(recording->recorder);
+    return 0;
+}
+
+// The writer thread flushes whatever is still queued before closing the files
+void ra_recording_close(ra_recording_t *recording) {
+    recording->closing = true;
+    notify_writer(recording->recorder);
+}
@@ -0,0 +1,32 @@
+#ifndef _RA_RECORDER_H
+#define _RA_RECORDER_H
+
+#include <stdbool.h>
+
+#include "codec.h"
+#include "logger.h"
+
+// Packets queued per recording before the writer thread falls behind
+#define RA_RECORDING_QUEUE_SIZE (1 << 20)
+
+struct ra_recorder_t;
+typedef struct ra_recorder_t ra_recorder_t;
+
+struct ra_recording_t;
+typedef struct ra_recording_t ra_recording_t;
+
+// Archives streams as Ogg Opus without decoding, files are written by a background thread
+ra_recorder_t *ra_recorder_create(ra_logger_t *logger, int *err);
+void ra_recorder_destroy(ra_recorder_t *recorder);
+
+// Opens <path>.opus, and <path>.wav with decoded audio when wav is set
+ra_recording_t *ra_recording_open(ra_recorder_t *recorder,
+                                  const char *path,
+                                  const ra_audio_config_t *cfg,
+                                  const ra_channel_layout_t *layout,
+                                  bool wav,
+                                  int *err);
+int ra_recording_write(ra_recording_t *recording, const unsigned char *packet, size_t len, int frames);
+void ra_recording_close(ra_recording_t *recording);
+
+#endif
@@ -0,0 +1,44 @@
+#include "report.h"
+
+void ra_receiver_stats_reset(ra_receiver_stats_t *stats, int sample_rate) {
+    stats->sample_rate = sample_rate;
+    stats->base_nonce = 0;
+    stats->highest_nonce = 0;
+    stats->received = 0;
+    stats->expected_prior = 0;
+    stats->received_prior = 0;
+    stats->last_transit_us = 0;
+    stats->jitter_us = 0;
+}
+
+void ra_receiver_stats_update(ra_receiver_stats_t *stats, uint64_t nonce) {
+    if (stats->received++ == 0) stats->base_nonce = stats->highest_nonce = nonce;
+    if (nonce > stats->highest_nonce) stats->highest_nonce = nonce;
+}
+
+void ra_receiver_stats_update_jitter(ra_receiver_stats_t *stats, uint32_t timestamp, uint64_t arrival_us) {
+    if (stats->sample_rate <= 0) return;
+    // RFC 3550 interarrival jitter, J += (|D| - J) / 16
+    double transit = (double)arrival_us - (double)timestamp * 1000000.0 / stats->sample_rate;
+    if (stats->last_transit_us != 0) {
+        double d = transit - stats->last_transit_us;
+        if (d < 0) d = -d;
+        stats->jitter_us += (d - stats->jitter_us) / 16.0;
+    }
+    stats->last_transit_us = transit;
+}
+
+void ra_receiver_stats_fill_report(ra_receiver_stats_t *stats, ra_stream_report_t *report) {
+    uint64_t expected = stats->received ? stats->highest_nonce - stats->base_nonce + 1 : 0;
+    int64_t lost = (int64_t)(expected - stats->received);
+    report->cumulative_lost = lost > 0 ? (uint32_t)lost : 0;
+
+    int64_t expected_interval = (int64_t)(expected - stats->expected_prior);
+    int64_t lost_interval = expected_interval - (int64_t)(stats->received - stats->received_prior);
+    stats->expected_prior = expected;
+    stats->received_prior = stats->received;
+    int64_t fraction = expected_interval > 0 && lost_interval > 0 ? (lost_interval << 8) / expected_interval : 0;
+    report->fraction_lost = fraction > UINT8_MAX ? UINT8_MAX : (uint8_t)fraction;
+
+    report->jitter_us = (uint32_t)stats->jitter_us;
+}
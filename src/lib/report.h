@@ -0,0 +1,31 @@
+#ifndef _RA_REPORT_H
+#define _RA_REPORT_H
+
+#include <stdint.h>
+
+// Receiver report sent periodically by the sink, modelled after RTCP receiver reports
+typedef struct {
+    uint8_t fraction_lost;     // Packets lost since the previous report, in 1/256 units
+    uint32_t cumulative_lost;  // Packets lost since the stream was opened
+    uint32_t jitter_us;        // Interarrival jitter estimate
+    uint32_t buffer_ms;        // Decoded audio queued for playback
+    uint32_t underruns;        // Playback underruns since the stream was opened
+} ra_stream_report_t;
+
+typedef struct {
+    int sample_rate;
+    uint64_t base_nonce;
+    uint64_t highest_nonce;
+    uint64_t received;
+    uint64_t expected_prior;
+    uint64_t received_prior;
+    double last_transit_us;
+    double jitter_us;
+} ra_receiver_stats_t;
+
+void ra_receiver_stats_reset(ra_receiver_stats_t *stats, int sample_rate);
+void ra_receiver_stats_update(ra_receiver_stats_t *stats, uint64_t nonce);
+void ra_receiver_stats_update_jitter(ra_receiver_stats_t *stats, uint32_t timestamp, uint64_t arrival_us);
+void ra_receiver_stats_fill_report(ra_receiver_stats_t *stats, ra_stream_report_t *report);
+
+#endif
@@ -0,0 +1,190 @@
+#include "sessions.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define TAG_MASK ((uint32_t)-1 >> RA_SESSION_INDEX_BITS)
+
+// ID and value sit next to each other, a lookup only touches the one slot
+typedef struct {
+    atomic_uint id;      // RA_SESSION_ID_NONE while the slot is free
+    uint32_t tag;        // Of the slot's last session
+    uint32_t next_free;  // Index of the next free slot plus one, 0 at the end of the list
+    _Atomic(void *) value;
+    uint64_t key;
+    bool bound;
+} session_slot_t;
+
+struct ra_session_table_t {
+    _Atomic(session_slot_t *) *chunks;
+    size_t chunk_count;
+    size_t max_slots;
+    atomic_size_t size;
+    uint32_t free_head;  // Same as next_free, only touched by the thread acquiring and releasing
+    // Open addressing over the bound keys with linear probing, holding slot indices plus one and 0 for an empty bucket.
+    // Kept at most half full.
+    uint32_t *buckets;
+    size_t bucket_mask;
+};
+
+static session_slot_t *get_slot(ra_session_table_t *table, size_t index) {
+    session_slot_t *chunk = atomic_load_explicit(&table->chunks[index / RA_SESSION_CHUNK_SIZE], memory_order_acquire);
+    return &chunk[index % RA_SESSION_CHUNK_SIZE];
+}
+
+// Publishes the next slot to the other threads, only once its chunk is there
+static int grow(ra_session_table_t *table) {
+    size_t index = atomic_load_explicit(&table->size, memory_order_relaxed);
+    if (index >= table->max_slots) return -1;
+    _Atomic(session_slot_t *) *chunk_ptr = &table->chunks[index / RA_SESSION_CHUNK_SIZE];
+    if (!atomic_load_explicit(chunk_ptr, memory_order_relaxed)) {
+        session_slot_t *chunk = calloc(RA_SESSION_CHUNK_SIZE, sizeof(session_slot_t));
+        if (!chunk) return -1;
+        atomic_store_explicit(chunk_ptr, chunk, memory_order_release);
+    }
+    atomic_store_explicit(&table->size, index + 1, memory_order_release);
+    return (int)index;
+}
+
+static size_t home_bucket(const ra_session_table_t *table, uint64_t key) {
+    return (size_t)(key ^ (key >> 32)) & table->bucket_mask;
+}
+
+// The slot held by the session, NULL once the session no longer holds it
+static session_slot_t *get_session_slot(ra_session_table_t *table, uint32_t id) {
+    size_t index = RA_SESSION_INDEX(id);
+    if (id == RA_SESSION_ID_NONE || index >= ra_session_table_size(table)) return NULL;
+    session_slot_t *slot = get_slot(table, index);
+    return atomic_load_explicit(&slot->id, memory_order_acquire) == id ? slot : NULL;
+}
+
+// Entries probed past the freed bucket move back into it, so no lookup stops short of them at an empty bucket
+static void unbind_slot(ra_session_table_t *table, size_t index) {
+    session_slot_t *slot = get_slot(table, index);
+    if (!slot->bound) return;
+    slot->bound = false;
+    size_t hole = home_bucket(table, slot->key);
+    while (table->buckets[hole] != index + 1) hole = (hole + 1) & table->bucket_mask;
+    for (size_t next = (hole + 1) & table->bucket_mask; table->buckets[next]; next = (next + 1) & table->bucket_mask) {
+        size_t home = home_bucket(table, get_slot(table, table->buckets[next] - 1)->key);
+        if (((next - home) & table->bucket_mask) < ((next - hole) & table->bucket_mask)) continue;
+        table->buckets[hole] = table->buckets[next];
+        hole = next;
+    }
+    table->buckets[hole] = 0;
+}
+
+static void push_free(ra_session_table_t *table, size_t index) {
+    get_slot(table, index)->next_free = table->free_head;
+    table->free_head = (uint32_t)index + 1;
+}
+
+ra_session_table_t *ra_session_table_create(size_t max_slots) {
+    if (max_slots < 1 || max_slots > RA_SESSION_MAX_SLOTS) return NULL;
+    ra_session_table_t *table = malloc(sizeof(ra_session_table_t));
+    table->max_slots = max_slots;
+    table->chunk_count = (max_slots + RA_SESSION_CHUNK_SIZE - 1) / RA_SESSION_CHUNK_SIZE;
+    table->chunks = calloc(table->chunk_count, sizeof(*table->chunks));
+    atomic_init(&table->size, 0);
+    table->free_head = 0;
+    size_t bucket_count = 2;
+    while (bucket_count < max_slots * 2) bucket_count *= 2;
+    table->buckets = calloc(bucket_count, sizeof(uint32_t));
+    table->bucket_mask = bucket_count - 1;
+    return table;
+}
+
+size_t ra_session_table_size(ra_session_table_t *table) {
+    return atomic_load_explicit(&table->size, memory_order_acquire);
+}
+
+size_t ra_session_table_capacity(ra_session_table_t *table) {
+    return table->max_slots;
+}
+
+// Pushed in reverse so the lowest indices get handed out first
+int ra_session_table_reserve(ra_session_table_t *table, size_t count) {
+    size_t first = atomic_load_explicit(&table->size, memory_order_relaxed);
+    int err = count > table->max_slots ? -1 : 0;
+    while (!err && atomic_load_explicit(&table->size, memory_order_relaxed) < count) err = grow(table) < 0 ? -1 : 0;
+    for (size_t i = atomic_load_explicit(&table->size, memory_order_relaxed); i > first; i--) push_free(table, i - 1);
+    return err;
+}
+
+int ra_session_table_acquire(ra_session_table_t *table, uint32_t tag, uint32_t *id) {
+    int index;
+    if (table->free_head) {
+        index = (int)table->free_head - 1;
+        table->free_head = get_slot(table, index)->next_free;
+    } else if ((index = grow(table)) < 0) {
+        return -1;
+    }
+
+    // The previous session of the slot keeps its ID unusable, as does the ID that stands for no session at all
+    session_slot_t *slot = get_slot(table, index);
+    tag &= TAG_MASK;
+    while (tag == slot->tag || tag == 0) tag = (tag + 1) & TAG_MASK;
+    slot->tag = tag;
+    *id = (tag << RA_SESSION_INDEX_BITS) | (uint32_t)index;
+    atomic_store_explicit(&slot->id, *id, memory_order_release);
+    return index;
+}
+
+int ra_session_table_release(ra_session_table_t *table, uint32_t id) {
+    session_slot_t *slot = get_session_slot(table, id);
+    if (!slot) return -1;
+    unbind_slot(table, RA_SESSION_INDEX(id));
+    atomic_store_explicit(&slot->id, RA_SESSION_ID_NONE, memory_order_release);
+    push_free(table, RA_SESSION_INDEX(id));
+    return 0;
+}
+
+void ra_session_table_set(ra_session_table_t *table, size_t index, void *value) {
+    atomic_store_explicit(&get_slot(table, index)->value, value, memory_order_release);
+}
+
+void *ra_session_table_at(ra_session_table_t *table, size_t index) {
+    if (index >= ra_session_table_size(table)) return NULL;
+    return atomic_load_explicit(&get_slot(table, index)->value, memory_order_acquire);
+}
+
+void *ra_session_table_lookup(ra_session_table_t *table, uint32_t id) {
+    session_slot_t *slot = get_session_slot(table, id);
+    return slot ? atomic_load_explicit(&slot->value, memory_order_acquire) : NULL;
+}
+
+int ra_session_table_bind(ra_session_table_t *table, uint32_t id, uint64_t key) {
+    session_slot_t *slot = get_session_slot(table, id);
+    if (!slot) return -1;
+    size_t index = RA_SESSION_INDEX(id);
+    unbind_slot(table, index);
+    slot->key = key;
+    slot->bound = true;
+    size_t bucket = home_bucket(table, key);
+    while (table->buckets[bucket]) bucket = (bucket + 1) & table->bucket_mask;
+    table->buckets[bucket] = (uint32_t)index + 1;
+    return 0;
+}
+
+int ra_session_table_unbind(ra_session_table_t *table, uint32_t id) {
+    if (!get_session_slot(table, id)) return -1;
+    unbind_slot(table, RA_SESSION_INDEX(id));
+    return 0;
+}
+
+uint32_t ra_session_table_find(ra_session_table_t *table, uint64_t key) {
+    for (size_t bucket = home_bucket(table, key); table->buckets[bucket]; bucket = (bucket + 1) & table->bucket_mask) {
+        session_slot_t *slot = get_slot(table, table->buckets[bucket] - 1);
+        if (slot->key == key) return atomic_load_explicit(&slot->id, memory_order_relaxed);
+    }
+    return RA_SESSION_ID_NONE;
+}
+
+void ra_session_table_destroy(ra_session_table_t *table) {
+    if (!table) return;
+    for (size_t i = 0; i < table->chunk_count; i++) free(atomic_load(&table->chunks[i]));
+    free(table->chunks);
+    free(table->buckets);
+    free(table);
+}
@@ -0,0 +1,47 @@
+#ifndef _RA_SESSIONS_H
+#define _RA_SESSIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Session IDs carry the slot index in their low bits and a random tag in the high ones, so packets meant for an
+// earlier session of a reused slot don't match the session holding it now
+#define RA_SESSION_INDEX_BITS 16
+#define RA_SESSION_MAX_SLOTS  (1 << RA_SESSION_INDEX_BITS)
+#define RA_SESSION_INDEX(id)  ((id) & (RA_SESSION_MAX_SLOTS - 1))
+#define RA_SESSION_ID_NONE    0
+
+// Slots are allocated this many at a time as the table grows, and never move once allocated
+#define RA_SESSION_CHUNK_SIZE 64
+
+struct ra_session_table_t;
+typedef struct ra_session_table_t ra_session_table_t;
+
+// Slots are acquired and released by a single thread, lookups and walking the slots are fine from any thread
+ra_session_table_t *ra_session_table_create(size_t max_slots);
+// Slots allocated so far, every index below it has a slot whether it's in use or not
+size_t ra_session_table_size(ra_session_table_t *table);
+size_t ra_session_table_capacity(ra_session_table_t *table);
+// Grows the table to at least count slots up front, returns -1 past the table's capacity
+int ra_session_table_reserve(ra_session_table_t *table, size_t count);
+// Hands out a free slot under a new session ID made with the random tag, returns its index or -1 when full
+int ra_session_table_acquire(ra_session_table_t *table, uint32_t tag, uint32_t *id);
+// Returns -1 when the session no longer holds its slot
+int ra_session_table_release(ra_session_table_t *table, uint32_t id);
+// Values stay with their slot across sessions, so whatever they hold gets reused along with it
+void ra_session_table_set(ra_session_table_t *table, size_t index, void *value);
+void *ra_session_table_at(ra_session_table_t *table, size_t index);
+// The slot's value when the session still holds it, NULL otherwise
+void *ra_session_table_lookup(ra_session_table_t *table, uint32_t id);
+
+// Finds sessions by a key of the caller's, e.g. a keyed hash of who the peer is. Keys are meant to be unique, on a
+// collision only the session bound first is found. Bindings go away with the session's slot, and belong to the thread
+// acquiring and releasing the slots.
+int ra_session_table_bind(ra_session_table_t *table, uint32_t id, uint64_t key);
+int ra_session_table_unbind(ra_session_table_t *table, uint32_t id);
+// Returns RA_SESSION_ID_NONE when no session is bound to the key
+uint32_t ra_session_table_find(ra_session_table_t *table, uint64_t key);
+
+void ra_session_table_destroy(ra_session_table_t *table);
+
+#endif
@@ -1,5 +1,7 @@
 #include "socket.h"
 
+#include <stdlib.h>
+
 #ifndef _WIN32
 #include <netdb.h>
 #include <string.h>
@@ -23,6 +25,65 @@ int ra_sockaddr_init(const char *host, unsigned int port, struct sockaddr_in *sa
     return 0;
 }
 
+// Cuts the port off a host[:port] string in place, returning the default port when there's none
+unsigned int ra_hostport_split(char *hostport, unsigned int default_port) {
+    char *sep = strrchr(hostport, ':');
+    if (!sep) return default_port;
+    *sep = '\0';
+    return atoi(sep + 1);
+}
+
+// Resolves a host[:port] string, using the default port when there's none
+int ra_sockaddr_parse(const char *hostport, unsigned int default_port, struct sockaddr_in *saddr) {
+    char host[256];
+    if (strlen(hostport) >= sizeof(host)) return -1;
+    strcpy(host, hostport);
+    unsigned int port = ra_hostport_split(host, default_port);
+    return ra_sockaddr_init(host, port, saddr);
+}
+
+// Opens a socket receiving the group's datagrams, returns -1 on error
+SOCKET ra_multicast_open(const struct sockaddr_in *group) {
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0) {
+        ra_socket_perror("socket");
+        return -1;
+    }
+
+    sockopt_t opt = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(sockopt_t))) {
+        ra_socket_perror("setsockopt");
+        goto error;
+    }
+
+    // Binding to the group address keeps other groups on the same port out, Windows only allows binding to any
+    struct sockaddr_in bind_addr = *group;
+#ifdef _WIN32
+    bind_addr.sin_addr.s_addr = INADDR_ANY;
+#endif
+    if (bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr))) {
+        ra_socket_perror("bind");
+        goto error;
+    }
+
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = group->sin_addr;
+    mreq.imr_interface.s_addr = INADDR_ANY;
+    if (setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (const char *)&mreq, sizeof(mreq))) {
+        ra_socket_perror("setsockopt");
+        goto error;
+    }
+    return sock;
+
+error:
+    ra_socket_close(sock);
+    return -1;
+}
+
+int ra_multicast_set_ttl(SOCKET sock, int ttl) {
+    return setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, (const char *)&ttl, sizeof(ttl));
+}
+
 void ra_sockaddr_str(char *buf, struct sockaddr_in *saddr) {
     char host[16];
     inet_ntop(saddr->sin_family, &saddr->sin_addr, host, sizeof(host));
@@ -9,6 +9,9 @@
 #include <WinSock2.h>
 
 typedef char sockopt_t;
+
+// Windows counts the sockets in a select set rather than limiting their values
+#define RA_SOCKET_SELECTABLE(sock) 1
 #else
 #include <arpa/inet.h>
 #include <sys/select.h>
@@ -16,15 +19,24 @@ typedef char sockopt_t;
 
 typedef int SOCKET;
 typedef int sockopt_t;
+
+// select only takes descriptors below FD_SETSIZE
+#define RA_SOCKET_SELECTABLE(sock) ((sock) < FD_SETSIZE)
 #endif
 
 int ra_socket_init(ra_logger_t *logger);
 void ra_socket_perror(const char *msg);
 int ra_socket_select(int nfds, fd_set *fds, const struct timeval *timeout);
+int ra_socket_set_nonblocking(SOCKET sock);
 void ra_socket_close(SOCKET sock);
 void ra_socket_deinit();
 
+SOCKET ra_multicast_open(const struct sockaddr_in *group);
+int ra_multicast_set_ttl(SOCKET sock, int ttl);
+
 int ra_sockaddr_init(const char *host, unsigned int port, struct sockaddr_in *saddr);
+unsigned int ra_hostport_split(char *hostport, unsigned int default_port);
+int ra_sockaddr_parse(const char *hostport, unsigned int default_port, struct sockaddr_in *saddr);
 void ra_sockaddr_str(char *buf, struct sockaddr_in *saddr);
 
 void ra_gai_perror(const char *msg, int err);
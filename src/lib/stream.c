@@ -2,21 +2,23 @@
 
 #include <stdatomic.h>
 
+#include "probe.h"
 #include "proto.h"
 #include "socket.h"
 #include "string.h"
+#include "trace.h"
 #include "types.h"
 
 #define HEADER_SIZE NONCE_SIZE + 2
 #define WINDOW_SIZE 32
 
-ra_stream_t *ra_stream_create(uint8_t id) {
+ra_stream_t *ra_stream_create(uint32_t id) {
     ra_stream_t *stream = malloc(sizeof(ra_stream_t));
     ra_stream_init(stream, id);
     return stream;
 }
 
-void ra_stream_init(ra_stream_t *stream, uint8_t id) {
+void ra_stream_init(ra_stream_t *stream, uint32_t id) {
     stream->id = id;
     ra_stream_reset(stream);
 }
@@ -24,6 +26,7 @@ void ra_stream_init(ra_stream_t *stream, uint8_t id) {
 void ra_stream_reset(ra_stream_t *stream) {
     stream->read_nonce = 0;
     stream->write_nonce = 0;
+    stream->last_nonce = 0;
 }
 
 int ra_stream_write(ra_stream_t *stream, char *outbuf, size_t *outlen, const ra_rbuf_t *buf) {
@@ -40,6 +43,7 @@ int ra_stream_write(ra_stream_t *stream, char *outbuf, size_t *outlen, const ra_
     wptr += sizeof(uint16_t);
 
     uint64_t sz_payload = endptr - wptr;
+    uint64_t trace_start = RA_TRACE_BEGIN();
     int err = crypto_aead_xchacha20poly1305_ietf_encrypt((unsigned char *)wptr,
                                                          &sz_payload,
                                                          (unsigned char *)buf->base,
@@ -49,6 +53,7 @@ int ra_stream_write(ra_stream_t *stream, char *outbuf, size_t *outlen, const ra_
                                                          NULL,
                                                          (unsigned char *)nonce_bytes,
                                                          stream->secret);
+    RA_TRACE_END(RA_TRACE_ENCRYPT, trace_start);
     if (err) return err;
     uint16_to_bytes(szptr, sz_payload);
 
@@ -57,19 +62,26 @@ int ra_stream_write(ra_stream_t *stream, char *outbuf, size_t *outlen, const ra_
 }
 
 int ra_stream_read(ra_stream_t *stream, ra_buf_t *buf, const char *inbuf, size_t len) {
-    if (len < HEADER_SIZE) return -1;
+    if (len < HEADER_SIZE) {
+        RA_PROBE3(stream_read_error, stream->id, 0, -1);
+        return -1;
+    }
     const char *rptr = inbuf;
 
     const char *nonce_bytes = rptr;
     uint64_t read_nonce = stream->read_nonce;
     uint64_t nonce = bytes_to_uint64(nonce_bytes);
-    if (nonce + WINDOW_SIZE < read_nonce) return -1;
+    if (nonce + WINDOW_SIZE < read_nonce) {
+        RA_PROBE3(stream_read_error, stream->id, nonce, RA_STREAM_ERR_REPLAYED);
+        return RA_STREAM_ERR_REPLAYED;
+    }
     rptr += NONCE_SIZE;
 
     uint16_t sz_payload = bytes_to_uint16(rptr);
     rptr += sizeof(uint16_t);
 
     buf->len = buf->cap;
+    uint64_t trace_start = RA_TRACE_BEGIN();
     int err = crypto_aead_xchacha20poly1305_ietf_decrypt((unsigned char *)buf->base,
                                                          (unsigned long long *)&buf->len,
                                                          NULL,
@@ -79,8 +91,14 @@ int ra_stream_read(ra_stream_t *stream, ra_buf_t *buf, const char *inbuf, size_t
                                                          0,
                                                          (unsigned char *)nonce_bytes,
                                                          stream->secret);
-    if (err) return err;
+    RA_TRACE_END(RA_TRACE_DECRYPT, trace_start);
+    if (err) {
+        RA_PROBE3(stream_read_error, stream->id, nonce, err);
+        return err;
+    }
     if (nonce > read_nonce) stream->read_nonce = nonce;
+    stream->last_nonce = nonce;
+    RA_PROBE3(stream_read, stream->id, nonce, buf->len);
     return 0;
 }
 
@@ -90,14 +108,17 @@ ssize_t ra_stream_send(ra_stream_t *stream, const ra_conn_t *conn, const ra_rbuf
     char *wptr = rawbuf;
     char *endptr = wptr + BUFSIZE;
     *wptr++ = (char)RA_MESSAGE_CRYPTO;
-    *wptr++ = (char)stream->id;
+    uint32_to_bytes(wptr, stream->id);
+    wptr += RA_STREAM_ID_SIZE;
 
     size_t sz_write = endptr - wptr;
     int err = ra_stream_write(stream, wptr, &sz_write, buf);
     if (err) return err;
 
     ra_rbuf_t rbuf = {.base = rawbuf, .len = wptr - rawbuf + sz_write};
-    return ra_buf_sendto(conn, &rbuf);
+    ssize_t res = ra_buf_sendto(conn, &rbuf);
+    RA_PROBE4(stream_send, stream->id, stream->write_nonce, buf->len, res);
+    return res;
 }
 
 void ra_stream_destroy(ra_stream_t *stream) {
@@ -8,15 +8,19 @@
 
 #define BUFSIZE 65535
 
+// Returned by ra_stream_read for a nonce behind the replay window, other failures are -1
+#define RA_STREAM_ERR_REPLAYED -2
+
 typedef struct {
-    uint8_t id;
+    uint32_t id;
     uint8_t secret[SHARED_SECRET_SIZE];
     atomic_ullong read_nonce;
     atomic_ullong write_nonce;
+    uint64_t last_nonce;  // Of the packet read last, behind read_nonce when it came out of order
 } ra_stream_t;
 
-ra_stream_t *ra_stream_create(uint8_t id);
-void ra_stream_init(ra_stream_t *stream, uint8_t id);
+ra_stream_t *ra_stream_create(uint32_t id);
+void ra_stream_init(ra_stream_t *stream, uint32_t id);
 void ra_stream_reset(ra_stream_t *stream);
 int ra_stream_read(ra_stream_t *stream, ra_buf_t *buf, const char *inbuf, size_t len);
 int ra_stream_write(ra_stream_t *stream, char *outbuf, size_t *outlen, const ra_rbuf_t *buf);
@@ -11,6 +11,9 @@
 #define RA_THREAD_WAIT_TIMEOUT WAIT_TIMEOUT
 
 typedef HANDLE ra_thread_t;
+typedef DWORD ra_thread_key_t;
+typedef CRITICAL_SECTION ra_mutex_t;
+typedef CONDITION_VARIABLE ra_cond_t;
 #else
 #include <errno.h>
 #include <pthread.h>
@@ -20,15 +23,65 @@ typedef HANDLE ra_thread_t;
 struct ra_thread_handle_t;
 typedef struct ra_thread_handle_t ra_thread_handle_t;
 typedef ra_thread_handle_t *ra_thread_t;
+typedef pthread_key_t ra_thread_key_t;
+typedef pthread_mutex_t ra_mutex_t;
+typedef pthread_cond_t ra_cond_t;
 #endif
 
+// Realtime scheduling policies, both usually need privileges
+#define RA_THREAD_SCHED_FIFO 1
+#define RA_THREAD_SCHED_RR   2
+
 typedef void ra_thread_func(void *);
+typedef void ra_thread_key_destructor(void *);
+
+// Scheduling a thread gets when it starts, instead of inheriting whatever the starting thread runs at
+typedef struct {
+    int policy;    // RA_THREAD_SCHED_FIFO or RA_THREAD_SCHED_RR
+    int priority;  // 0 runs it at the default priority
+    int cpu;       // Negative lets it run on any CPU
+} ra_thread_sched_t;
 
 void ra_sleep(unsigned int seconds);
 
 ra_thread_t ra_thread_start(ra_thread_func *routine, void *data, int *err);
+// Failing to apply the scheduling doesn't fail the start, the thread runs with what it inherited instead
+ra_thread_t ra_thread_start_sched(ra_thread_func *routine, void *data, const ra_thread_sched_t *sched, int *err);
 int ra_thread_join(ra_thread_t thread);
 int ra_thread_join_timeout(ra_thread_t thread, time_t seconds);
 int ra_thread_destroy(ra_thread_t thread);
 
+// Values set under the key are handed to the destructor when their thread exits, including threads started by
+// libraries rather than ra_thread_start
+int ra_thread_key_create(ra_thread_key_t *key, ra_thread_key_destructor *destructor);
+int ra_thread_key_set(ra_thread_key_t key, void *value);
+
+// Scheduling for the threads on the audio path, the codec workers and the clocked audio backends start with it
+// whichever thread starts them. NULL until set, they inherit the starting thread's scheduling then.
+void ra_thread_set_audio_sched(const ra_thread_sched_t *sched);
+const ra_thread_sched_t *ra_thread_audio_sched();
+
+// These apply to the calling thread, returning 0 or an errno value. Threads it starts afterwards inherit the priority
+// and the affinity unless started with a scheduling of their own. Priority 0 restores the default one and a negative
+// CPU lifts the pinning.
+void ra_thread_set_name(const char *name);
+int ra_thread_set_priority(int policy, int priority);
+int ra_thread_set_affinity(int cpu);
+// Locks the memory the process has mapped so far, prefaulting the calling thread's stack. Later allocations stay
+// unlocked, so it's done once the buffers of the audio path are in place.
+int ra_memory_lock(size_t stack_size);
+
+int ra_mutex_init(ra_mutex_t *mutex);
+void ra_mutex_lock(ra_mutex_t *mutex);
+void ra_mutex_unlock(ra_mutex_t *mutex);
+void ra_mutex_destroy(ra_mutex_t *mutex);
+
+int ra_cond_init(ra_cond_t *cond);
+void ra_cond_wait(ra_cond_t *cond, ra_mutex_t *mutex);
+void ra_cond_signal(ra_cond_t *cond);
+void ra_cond_broadcast(ra_cond_t *cond);
+void ra_cond_destroy(ra_cond_t *cond);
+
+int ra_cpu_count();
+
 #endif
@@ -0,0 +1,220 @@
+#include "trace.h"
+
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "thread.h"
+
+#define THREAD_NAME_SIZE 32
+#define TRACE_PATH_SIZE  1024
+
+typedef struct {
+    uint64_t start_ns;
+    uint64_t end_ns;
+    ra_trace_event_id id;
+} trace_event_t;
+
+// Written only by the thread holding it, read by whichever thread dumps. Rings are never freed so a dump can't race
+// a thread exiting, a ring handed back keeps its events until another thread takes it.
+typedef struct {
+    atomic_int tid;  // 0 until a thread first takes the ring
+    char name[THREAD_NAME_SIZE];
+    atomic_uint next_free;  // Index of the next free ring plus one, 0 at the end of the list
+    atomic_ullong first;    // Head as of when its thread took the ring, earlier events belong to another thread
+    atomic_ullong head;
+    trace_event_t events[RA_TRACE_RING_SIZE];
+} trace_ring_t;
+
+static const char *event_names[RA_TRACE_EVENT_COUNT] = {
+    [RA_TRACE_AUDIO_CALLBACK] = "audio_callback",
+    [RA_TRACE_ENCODE] = "encode",
+    [RA_TRACE_ENCRYPT] = "encrypt",
+    [RA_TRACE_SEND] = "sendto",
+    [RA_TRACE_RECV] = "recvfrom",
+    [RA_TRACE_DECRYPT] = "decrypt",
+    [RA_TRACE_DECODE] = "decode",
+    [RA_TRACE_RING_WRITE] = "ring_write",
+    [RA_TRACE_RING_READ] = "ring_read",
+};
+
+atomic_bool ra_trace_enabled = false;
+
+static _Thread_local trace_ring_t *thread_ring = NULL;
+static _Thread_local char thread_name[THREAD_NAME_SIZE];
+static _Atomic(trace_ring_t *) rings = NULL;
+// Free rings as a list tagged with a count in the high half, so a ring taken and handed back meanwhile fails the swap
+static atomic_ullong free_rings = 0;
+static ra_thread_key_t ring_key;
+static atomic_int next_tid = 1;
+
+static atomic_bool dump_requested = false;
+static atomic_flag crash_dumping = ATOMIC_FLAG_INIT;
+static char dump_path[TRACE_PATH_SIZE] = RA_TRACE_DEFAULT_FILE;
+
+static void push_free_ring(trace_ring_t *pool, trace_ring_t *ring) {
+    uint64_t head = atomic_load(&free_rings);
+    do {
+        atomic_store_explicit(&ring->next_free, (uint32_t)head, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak(
+        &free_rings, &head, ((head >> 32) + 1) << 32 | (uint64_t)(ring - pool + 1)));
+}
+
+static void release_thread_ring(void *arg) {
+    trace_ring_t *ring = arg;
+    if (thread_ring == ring) thread_ring = NULL;
+    push_free_ring(atomic_load(&rings), ring);
+}
+
+// Called from the threads setting tracing up, before any thread records
+static void init_rings() {
+    if (atomic_load(&rings)) return;
+    trace_ring_t *pool = calloc(RA_TRACE_MAX_THREADS, sizeof(trace_ring_t));
+    if (!pool || ra_thread_key_create(&ring_key, &release_thread_ring)) {
+        free(pool);
+        return;
+    }
+    for (int i = RA_TRACE_MAX_THREADS; i > 0; i--) push_free_ring(pool, &pool[i - 1]);
+    atomic_store(&rings, pool);
+}
+
+static trace_ring_t *get_thread_ring() {
+    if (thread_ring) return thread_ring;
+    trace_ring_t *pool = atomic_load_explicit(&rings, memory_order_acquire);
+    if (!pool) return NULL;
+    uint64_t head = atomic_load(&free_rings);
+    trace_ring_t *ring;
+    do {
+        if (!(uint32_t)head) return NULL;
+        ring = &pool[(uint32_t)head - 1];
+    } while (!atomic_compare_exchange_weak(
+        &free_rings, &head, ((head >> 32) + 1) << 32 | atomic_load_explicit(&ring->next_free, memory_order_relaxed)));
+
+    memcpy(ring->name, thread_name, THREAD_NAME_SIZE);
+    atomic_store(&ring->first, atomic_load(&ring->head));
+    atomic_store(&ring->tid, atomic_fetch_add(&next_tid, 1));
+    ra_thread_key_set(ring_key, ring);
+    thread_ring = ring;
+    return ring;
+}
+
+void ra_trace_set_enabled(bool enabled) {
+    if (enabled) init_rings();
+    atomic_store(&ra_trace_enabled, enabled);
+}
+
+// Also takes the ring up front when there are rings, keeping it out of the thread's first traced span
+void ra_trace_set_thread_name(const char *name) {
+    strncpy(thread_name, name, THREAD_NAME_SIZE - 1);
+    trace_ring_t *ring = get_thread_ring();
+    if (ring) memcpy(ring->name, thread_name, THREAD_NAME_SIZE);
+}
+
+void ra_trace_record(ra_trace_event_id id, uint64_t start_ns, uint64_t end_ns) {
+    trace_ring_t *ring = get_thread_ring();
+    if (!ring) return;
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    trace_event_t *event = &ring->events[head % RA_TRACE_RING_SIZE];
+    event->start_ns = start_ns;
+    event->end_ns = end_ns;
+    event->id = id;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void write_thread_name(FILE *out, const trace_ring_t *ring, int tid, bool *first) {
+    fprintf(out,
+            "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"",
+            *first ? "" : ",",
+            tid);
+    if (ring->name[0]) {
+        for (const char *c = ring->name; *c; c++) {
+            if (*c == '"' || *c == '\\') fputc('\\', out);
+            fputc(*c, out);
+        }
+    } else {
+        fprintf(out, "thread-%d", tid);
+    }
+    fputs("\"}}", out);
+    *first = false;
+}
+
+// Events the writer may have overwritten while being copied out are dropped rather than emitted torn
+static void write_ring_events(FILE *out, const trace_ring_t *ring, int tid) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t i = head > RA_TRACE_RING_SIZE ? head - RA_TRACE_RING_SIZE : 0;
+    uint64_t first = atomic_load(&ring->first);
+    if (i < first) i = first;
+    for (; i < head; i++) {
+        trace_event_t event = ring->events[i % RA_TRACE_RING_SIZE];
+        uint64_t latest = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (latest >= RA_TRACE_RING_SIZE && i < latest - RA_TRACE_RING_SIZE) continue;
+        if (event.id >= RA_TRACE_EVENT_COUNT || event.end_ns < event.start_ns) continue;
+        fprintf(out,
+                ",\n{\"name\":\"%s\",\"cat\":\"ra\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event_names[event.id],
+                tid,
+                (double)event.start_ns / RA_NSEC_PER_USEC,
+                (double)(event.end_ns - event.start_ns) / RA_NSEC_PER_USEC);
+    }
+}
+
+int ra_trace_dump(FILE *out) {
+    bool first = true;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", out);
+    trace_ring_t *pool = atomic_load(&rings);
+    for (int i = 0; pool && i < RA_TRACE_MAX_THREADS; i++) {
+        int tid = atomic_load(&pool[i].tid);
+        if (!tid) continue;
+        write_thread_name(out, &pool[i], tid, &first);
+        write_ring_events(out, &pool[i], tid);
+    }
+    fputs("\n]}\n", out);
+    fflush(out);
+    return ferror(out) ? -1 : 0;
+}
+
+int ra_trace_dump_file(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (!out) return -1;
+    int err = ra_trace_dump(out);
+    if (fclose(out)) err = -1;
+    return err;
+}
+
+#ifdef SIGUSR1
+static void toggle_handler(int sig) {
+    atomic_store(&ra_trace_enabled, !atomic_load(&ra_trace_enabled));
+}
+
+static void dump_handler(int sig) {
+    atomic_store(&dump_requested, true);
+}
+#endif
+
+// Not async-signal-safe, the process is going down either way so a partial trace beats none
+static void crash_handler(int sig) {
+    if (atomic_load(&rings) && !atomic_flag_test_and_set(&crash_dumping)) ra_trace_dump_file(dump_path);
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void ra_trace_install_signal_handlers(const char *path) {
+    init_rings();
+    if (path) {
+        strncpy(dump_path, path, TRACE_PATH_SIZE - 1);
+        dump_path[TRACE_PATH_SIZE - 1] = '\0';
+    }
+#ifdef SIGUSR1
+    signal(SIGUSR1, toggle_handler);
+    signal(SIGUSR2, dump_handler);
+#endif
+    signal(SIGSEGV, crash_handler);
+    signal(SIGABRT, crash_handler);
+    signal(SIGFPE, crash_handler);
+    signal(SIGILL, crash_handler);
+}
+
+void ra_trace_handle_requests() {
+    if (!atomic_exchange(&dump_requested, false)) return;
+    ra_trace_dump_file(dump_path);
+}
@@ -0,0 +1,57 @@
+#ifndef _RA_TRACE_H
+#define _RA_TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "clock.h"
+
+// Events kept per thread, older events are overwritten once a thread's ring is full
+#define RA_TRACE_RING_SIZE 8192
+// Rings are allocated up front, threads beyond this many alive at once go untraced
+#define RA_TRACE_MAX_THREADS 32
+
+#define RA_TRACE_DEFAULT_FILE "remote-audio-trace.json"
+
+typedef enum {
+    RA_TRACE_AUDIO_CALLBACK,
+    RA_TRACE_ENCODE,
+    RA_TRACE_ENCRYPT,
+    RA_TRACE_SEND,
+    RA_TRACE_RECV,
+    RA_TRACE_DECRYPT,
+    RA_TRACE_DECODE,
+    RA_TRACE_RING_WRITE,
+    RA_TRACE_RING_READ,
+    RA_TRACE_EVENT_COUNT,
+} ra_trace_event_id;
+
+extern atomic_bool ra_trace_enabled;
+
+// While tracing is off a span costs a relaxed load and a branch that's always taken the same way
+#define RA_TRACE_BEGIN() (atomic_load_explicit(&ra_trace_enabled, memory_order_relaxed) ? ra_clock_now_ns() : 0)
+#define RA_TRACE_END(id, start_ns)                                      \
+    do {                                                                \
+        if (start_ns) ra_trace_record(id, start_ns, ra_clock_now_ns()); \
+    } while (0)
+
+// Enabling allocates every thread's ring, a thread takes one on its first event and hands it back when it exits
+void ra_trace_set_enabled(bool enabled);
+// Names the calling thread in the trace, events of unnamed threads show up under their trace thread ID
+void ra_trace_set_thread_name(const char *name);
+// Never allocates, the event is dropped when the thread can't get a ring
+void ra_trace_record(ra_trace_event_id id, uint64_t start_ns, uint64_t end_ns);
+
+// Writes every thread's events in the Chrome trace event format, loadable in Perfetto and chrome://tracing
+int ra_trace_dump(FILE *out);
+int ra_trace_dump_file(const char *path);
+
+// SIGUSR1 toggles tracing and SIGUSR2 requests a dump where available, crash signals dump before dying. The rings
+// are allocated here too, the signal handler can't.
+void ra_trace_install_signal_handlers(const char *path);
+// Writes the dump requested by a signal, called periodically from a thread that's allowed to block
+void ra_trace_handle_requests();
+
+#endif
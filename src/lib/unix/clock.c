@@ -0,0 +1,37 @@
+#include "lib/clock.h"
+
+#include <errno.h>
+#include <time.h>
+
+uint64_t ra_clock_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * RA_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+uint64_t ra_clock_now_us() {
+    return ra_clock_now_ns() / RA_NSEC_PER_USEC;
+}
+
+uint64_t ra_clock_thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * RA_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+void ra_clock_sleep_until_ns(uint64_t deadline) {
+#ifdef __APPLE__
+    uint64_t now = ra_clock_now_ns();
+    if (deadline <= now) return;
+    uint64_t delta = deadline - now;
+    struct timespec ts = {.tv_sec = delta / RA_NSEC_PER_SEC, .tv_nsec = delta % RA_NSEC_PER_SEC};
+    while (nanosleep(&ts, &ts) && errno == EINTR) continue;
+#else
+    struct timespec ts = {.tv_sec = deadline / RA_NSEC_PER_SEC, .tv_nsec = deadline % RA_NSEC_PER_SEC};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) continue;
+#endif
+}
+
+int ra_clock_localtime(time_t time, struct tm *tm) {
+    return localtime_r(&time, tm) ? 0 : -1;
+}
@@ -1,5 +1,6 @@
 #include "lib/socket.h"
 
+#include <fcntl.h>
 #include <netdb.h>
 #include <signal.h>
 #include <stdlib.h>
@@ -16,6 +17,9 @@ int ra_socket_init(ra_logger_t *logger) {
     sigemptyset(sigmask);
     sigaddset(sigmask, SIGINT);
     sigaddset(sigmask, SIGTERM);
+    // Tracer signals, see trace.h
+    sigaddset(sigmask, SIGUSR1);
+    sigaddset(sigmask, SIGUSR2);
 
     return 0;
 }
@@ -28,6 +32,12 @@ int ra_socket_select(int nfds, fd_set *fds, const struct timeval *timeout) {
     return pselect(nfds + 1, fds, NULL, NULL, &ts_timeout, sigmask);
 }
 
+int ra_socket_set_nonblocking(SOCKET sock) {
+    int flags = fcntl(sock, F_GETFL, 0);
+    if (flags < 0) return -1;
+    return fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+}
+
 void ra_socket_perror(const char *msg) {
     perror(msg);
 }
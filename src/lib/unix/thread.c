@@ -1,9 +1,19 @@
+// For pthread_setname_np and pthread_setaffinity_np
+#define _GNU_SOURCE
+
 #include "lib/private/thread.h"
 
+#include <alloca.h>
+#include <sched.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
 
+// Linux limits thread names to 15 characters
+#define THREAD_NAME_SIZE 16
+
 struct ra_thread_handle_t {
     pthread_t thread;
     pthread_mutex_t mutex;
@@ -45,6 +55,10 @@ void ra_sleep(unsigned int seconds) {
 }
 
 ra_thread_t ra_thread_start(ra_thread_func *routine, void *data, int *err) {
+    return ra_thread_start_sched(routine, data, NULL, err);
+}
+
+ra_thread_t ra_thread_start_sched(ra_thread_func *routine, void *data, const ra_thread_sched_t *sched, int *err) {
     ra_thread_handle_t *handle = (ra_thread_handle_t *)malloc(sizeof(ra_thread_handle_t));
     thread_context_mutex_t *ctx = (thread_context_mutex_t *)malloc(sizeof(thread_context_mutex_t));
     ctx->mutex = &handle->mutex;
@@ -56,7 +70,7 @@ ra_thread_t ra_thread_start(ra_thread_func *routine, void *data, int *err) {
     *err = pthread_mutex_init(&handle->mutex, &handle->mutex_attr);
     if (*err) goto error;
 
-    init_thread_context((thread_context_t *)ctx, routine, data);
+    init_thread_context((thread_context_t *)ctx, routine, data, sched);
     *err = pthread_create(&handle->thread, NULL, &thread_bootstrap, ctx);
     if (*err) goto error;
 
@@ -89,3 +103,99 @@ int ra_thread_destroy(ra_thread_t handle) {
     free(handle);
     return 0;
 }
+
+int ra_thread_key_create(ra_thread_key_t *key, ra_thread_key_destructor *destructor) {
+    return pthread_key_create(key, destructor);
+}
+
+int ra_thread_key_set(ra_thread_key_t key, void *value) {
+    return pthread_setspecific(key, value);
+}
+
+void ra_thread_set_name(const char *name) {
+#if defined(__APPLE__)
+    pthread_setname_np(name);
+#elif defined(__linux__)
+    char buf[THREAD_NAME_SIZE];
+    strncpy(buf, name, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    pthread_setname_np(pthread_self(), buf);
+#endif
+}
+
+int ra_thread_set_priority(int policy, int priority) {
+    struct sched_param param = {.sched_priority = priority};
+    if (priority <= 0) return pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+    return pthread_setschedparam(pthread_self(), policy == RA_THREAD_SCHED_RR ? SCHED_RR : SCHED_FIFO, &param);
+}
+
+int ra_thread_set_affinity(int cpu) {
+#ifdef __linux__
+    if (cpu >= CPU_SETSIZE) return EINVAL;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    // The kernel leaves out the CPUs the process isn't allowed on
+    if (cpu < 0) {
+        for (int i = 0; i < CPU_SETSIZE; i++) CPU_SET(i, &set);
+    } else {
+        CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    return cpu < 0 ? 0 : ENOTSUP;
+#endif
+}
+
+// Touching every page of the stack now keeps the page faults out of the thread's first deep call
+static void prefault_stack(size_t size) {
+    volatile char *stack = alloca(size);
+    long page_size = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < size; i += page_size) stack[i] = 0;
+}
+
+int ra_memory_lock(size_t stack_size) {
+    if (mlockall(MCL_CURRENT)) return errno;
+    prefault_stack(stack_size);
+    return 0;
+}
+
+int ra_mutex_init(ra_mutex_t *mutex) {
+    return pthread_mutex_init(mutex, NULL);
+}
+
+void ra_mutex_lock(ra_mutex_t *mutex) {
+    pthread_mutex_lock(mutex);
+}
+
+void ra_mutex_unlock(ra_mutex_t *mutex) {
+    pthread_mutex_unlock(mutex);
+}
+
+void ra_mutex_destroy(ra_mutex_t *mutex) {
+    pthread_mutex_destroy(mutex);
+}
+
+int ra_cond_init(ra_cond_t *cond) {
+    return pthread_cond_init(cond, NULL);
+}
+
+void ra_cond_wait(ra_cond_t *cond, ra_mutex_t *mutex) {
+    pthread_cond_wait(cond, mutex);
+}
+
+void ra_cond_signal(ra_cond_t *cond) {
+    pthread_cond_signal(cond);
+}
+
+void ra_cond_broadcast(ra_cond_t *cond) {
+    pthread_cond_broadcast(cond);
+}
+
+void ra_cond_destroy(ra_cond_t *cond) {
+    pthread_cond_destroy(cond);
+}
+
+int ra_cpu_count() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
@@ -35,6 +35,13 @@ size_t ra_ringbuf_free_count(ra_ringbuf_t *rb) {
                                            : 0;
 }
 
+// Unlike ra_ringbuf_fill_count, this includes the bytes wrapped around to the start of the buffer
+size_t ra_ringbuf_fill_total(ra_ringbuf_t *rb) {
+    size_t read_idx = rb->read_idx, write_idx = rb->write_idx;
+    if (rb->state == RINGBUF_STATE_EMPTY) return 0;
+    return write_idx > read_idx ? write_idx - read_idx : rb->size - read_idx + write_idx;
+}
+
 const char *ra_ringbuf_read_ptr(ra_ringbuf_t *rb) {
     return rb->buf + rb->read_idx;
 }
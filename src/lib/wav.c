@@ -0,0 +1,133 @@
+#include "wav.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "string.h"
+
+#define HEADER_SIZE 44
+
+struct ra_wav_writer_t {
+    FILE *file;
+    size_t frame_size;
+    uint32_t data_size;
+};
+
+struct ra_wav_reader_t {
+    FILE *file;
+    size_t frame_size;
+    uint32_t remaining;
+};
+
+static uint16_t bytes_to_le16(const unsigned char *buf) {
+    return buf[0] | buf[1] << 8;
+}
+
+static uint32_t bytes_to_le32(const unsigned char *buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static void le16_to_bytes(unsigned char *buf, uint16_t value) {
+    buf[0] = value & 0xff;
+    buf[1] = value >> 8;
+}
+
+static void le32_to_bytes(unsigned char *buf, uint32_t value) {
+    for (int i = 0; i < 4; i++) buf[i] = (value >> (i * 8)) & 0xff;
+}
+
+ra_wav_writer_t *ra_wav_writer_create(FILE *file, const ra_wav_format_t *fmt) {
+    size_t frame_size = fmt->channel_count * fmt->bits_per_sample / 8;
+    unsigned char header[HEADER_SIZE];
+    memcpy(header, "RIFF", 4);
+    le32_to_bytes(header + 4, HEADER_SIZE - 8);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    le32_to_bytes(header + 16, 16);
+    le16_to_bytes(header + 20, fmt->format);
+    le16_to_bytes(header + 22, fmt->channel_count);
+    le32_to_bytes(header + 24, fmt->sample_rate);
+    le32_to_bytes(header + 28, fmt->sample_rate * frame_size);
+    le16_to_bytes(header + 32, frame_size);
+    le16_to_bytes(header + 34, fmt->bits_per_sample);
+    memcpy(header + 36, "data", 4);
+    le32_to_bytes(header + 40, 0);
+    if (fwrite(header, 1, HEADER_SIZE, file) != HEADER_SIZE) return NULL;
+
+    ra_wav_writer_t *writer = calloc(1, sizeof(ra_wav_writer_t));
+    writer->file = file;
+    writer->frame_size = frame_size;
+    return writer;
+}
+
+int ra_wav_writer_write(ra_wav_writer_t *writer, const void *samples, size_t frames) {
+    size_t len = frames * writer->frame_size;
+    if (fwrite(samples, 1, len, writer->file) != len) return -1;
+    writer->data_size += len;
+    return 0;
+}
+
+int ra_wav_writer_close(ra_wav_writer_t *writer) {
+    unsigned char buf[4];
+    int err = 0;
+    le32_to_bytes(buf, HEADER_SIZE - 8 + writer->data_size);
+    if (fseek(writer->file, 4, SEEK_SET) || fwrite(buf, 1, 4, writer->file) != 4) err = -1;
+    le32_to_bytes(buf, writer->data_size);
+    if (fseek(writer->file, 40, SEEK_SET) || fwrite(buf, 1, 4, writer->file) != 4) err = -1;
+    fseek(writer->file, 0, SEEK_END);
+    free(writer);
+    return err;
+}
+
+ra_wav_reader_t *ra_wav_reader_create(FILE *file, ra_wav_format_t *fmt) {
+    unsigned char buf[40];
+    if (fread(buf, 1, 12, file) != 12) return NULL;
+    if (memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) return NULL;
+
+    // Walk the chunks up to the data, skipping anything that isn't the format
+    bool has_fmt = false;
+    for (;;) {
+        if (fread(buf, 1, 8, file) != 8) return NULL;
+        uint32_t chunk_size = bytes_to_le32(buf + 4);
+        if (!memcmp(buf, "data", 4)) {
+            if (!has_fmt) return NULL;
+            ra_wav_reader_t *reader = calloc(1, sizeof(ra_wav_reader_t));
+            reader->file = file;
+            reader->frame_size = fmt->channel_count * fmt->bits_per_sample / 8;
+            // Writers that never got to patch their header leave the size at zero, read those to the end of file
+            reader->remaining = chunk_size ? chunk_size : UINT32_MAX;
+            return reader;
+        }
+
+        // Chunks are padded to an even size
+        size_t skip = chunk_size + (chunk_size & 1);
+        if (!memcmp(buf, "fmt ", 4)) {
+            if (chunk_size < 16) return NULL;
+            size_t len = chunk_size < sizeof(buf) ? chunk_size : sizeof(buf);
+            if (fread(buf, 1, len, file) != len) return NULL;
+            skip -= len;
+            fmt->format = bytes_to_le16(buf);
+            fmt->channel_count = bytes_to_le16(buf + 2);
+            fmt->sample_rate = bytes_to_le32(buf + 4);
+            fmt->bits_per_sample = bytes_to_le16(buf + 14);
+            if (fmt->format == RA_WAV_FORMAT_EXTENSIBLE) {
+                if (len < 26) return NULL;
+                fmt->format = bytes_to_le16(buf + 24);
+            }
+            if (fmt->channel_count <= 0 || fmt->bits_per_sample % 8) return NULL;
+            has_fmt = true;
+        }
+        if (skip && fseek(file, skip, SEEK_CUR)) return NULL;
+    }
+}
+
+size_t ra_wav_reader_read(ra_wav_reader_t *reader, void *samples, size_t frames) {
+    size_t max_frames = reader->remaining / reader->frame_size;
+    if (frames > max_frames) frames = max_frames;
+    size_t read = fread(samples, reader->frame_size, frames, reader->file);
+    reader->remaining -= read * reader->frame_size;
+    return read;
+}
+
+void ra_wav_reader_close(ra_wav_reader_t *reader) {
+    free(reader);
+}
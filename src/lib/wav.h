@@ -0,0 +1,34 @@
+#ifndef _RA_WAV_H
+#define _RA_WAV_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define RA_WAV_FORMAT_PCM        1
+#define RA_WAV_FORMAT_FLOAT      3
+#define RA_WAV_FORMAT_EXTENSIBLE 0xfffe
+
+typedef struct {
+    int format;
+    int channel_count;
+    int sample_rate;
+    int bits_per_sample;
+} ra_wav_format_t;
+
+struct ra_wav_writer_t;
+typedef struct ra_wav_writer_t ra_wav_writer_t;
+
+struct ra_wav_reader_t;
+typedef struct ra_wav_reader_t ra_wav_reader_t;
+
+// The header's sizes are filled in on close, so an unclosed file still plays up to its last write
+ra_wav_writer_t *ra_wav_writer_create(FILE *file, const ra_wav_format_t *fmt);
+int ra_wav_writer_write(ra_wav_writer_t *writer, const void *samples, size_t frames);
+int ra_wav_writer_close(ra_wav_writer_t *writer);
+
+// Extensible headers are reported with their subformat, reads return fewer frames than asked for at the end of data
+ra_wav_reader_t *ra_wav_reader_create(FILE *file, ra_wav_format_t *fmt);
+size_t ra_wav_reader_read(ra_wav_reader_t *reader, void *samples, size_t frames);
+void ra_wav_reader_close(ra_wav_reader_t *reader);
+
+#endif
@@ -0,0 +1,40 @@
+#include "lib/clock.h"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+static LARGE_INTEGER frequency = {0};
+
+uint64_t ra_clock_now_ns() {
+    LARGE_INTEGER counter;
+    if (!frequency.QuadPart) QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    uint64_t secs = counter.QuadPart / frequency.QuadPart;
+    uint64_t rem = counter.QuadPart % frequency.QuadPart;
+    return secs * RA_NSEC_PER_SEC + rem * RA_NSEC_PER_SEC / frequency.QuadPart;
+}
+
+uint64_t ra_clock_now_us() {
+    return ra_clock_now_ns() / RA_NSEC_PER_USEC;
+}
+
+uint64_t ra_clock_thread_cpu_ns() {
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0;
+    ULARGE_INTEGER k = {.LowPart = kernel.dwLowDateTime, .HighPart = kernel.dwHighDateTime};
+    ULARGE_INTEGER u = {.LowPart = user.dwLowDateTime, .HighPart = user.dwHighDateTime};
+    // FILETIME counts in 100 ns ticks
+    return (k.QuadPart + u.QuadPart) * 100;
+}
+
+void ra_clock_sleep_until_ns(uint64_t deadline) {
+    // Sleep() only has millisecond granularity, so the last stretch is spent yielding
+    for (uint64_t now = ra_clock_now_ns(); now < deadline; now = ra_clock_now_ns()) {
+        uint64_t delta = deadline - now;
+        Sleep(delta > 2 * RA_NSEC_PER_MSEC ? (DWORD)(delta / RA_NSEC_PER_MSEC) - 1 : 0);
+    }
+}
+
+int ra_clock_localtime(time_t time, struct tm *tm) {
+    return localtime_s(tm, &time) ? -1 : 0;
+}
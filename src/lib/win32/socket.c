@@ -41,6 +41,11 @@ int ra_socket_select(int nfds, fd_set *fds, const struct timeval *timeout) {
     return select(nfds, fds, NULL, NULL, &mut_timeout);
 }
 
+int ra_socket_set_nonblocking(SOCKET sock) {
+    u_long mode = 1;
+    return ioctlsocket(sock, FIONBIO, &mode) ? -1 : 0;
+}
+
 void ra_socket_close(SOCKET sock) {
     closesocket(sock);
 }
@@ -1,5 +1,6 @@
 #include "lib/private/thread.h"
 
+#include <errno.h>
 #include <synchapi.h>
 
 static void thread_bootstrap(void *arg) {
@@ -11,7 +12,11 @@ void ra_sleep(unsigned int seconds) {
 }
 
 ra_thread_t ra_thread_start(ra_thread_func *routine, void *data, int *err) {
-    uintptr_t handle = _beginthread(thread_bootstrap, 0, create_thread_context(routine, data));
+    return ra_thread_start_sched(routine, data, NULL, err);
+}
+
+ra_thread_t ra_thread_start_sched(ra_thread_func *routine, void *data, const ra_thread_sched_t *sched, int *err) {
+    uintptr_t handle = _beginthread(thread_bootstrap, 0, create_thread_context(routine, data, sched));
     *err = handle == -1L ? errno : 0;
     return (HANDLE)handle;
 }
@@ -31,3 +36,79 @@ int ra_thread_join_timeout(ra_thread_t thread, time_t seconds) {
 int ra_thread_destroy(ra_thread_t thread) {
     return !CloseHandle(thread);
 }
+
+// Fiber local storage calls back on thread exit, the callback takes the C calling convention on x64 and ARM64
+int ra_thread_key_create(ra_thread_key_t *key, ra_thread_key_destructor *destructor) {
+    *key = FlsAlloc((PFLS_CALLBACK_FUNCTION)destructor);
+    return *key == FLS_OUT_OF_INDEXES ? (int)GetLastError() : 0;
+}
+
+int ra_thread_key_set(ra_thread_key_t key, void *value) {
+    return FlsSetValue(key, value) ? 0 : (int)GetLastError();
+}
+
+// Thread descriptions need Windows 10 headers that MinGW doesn't always ship
+void ra_thread_set_name(const char *name) {}
+
+// There's no realtime policy, the highest priority short of the realtime class stands in for both
+int ra_thread_set_priority(int policy, int priority) {
+    int level = priority > 0 ? THREAD_PRIORITY_TIME_CRITICAL : THREAD_PRIORITY_NORMAL;
+    return SetThreadPriority(GetCurrentThread(), level) ? 0 : (int)GetLastError();
+}
+
+int ra_thread_set_affinity(int cpu) {
+    if (cpu >= (int)(sizeof(DWORD_PTR) * 8)) return EINVAL;
+    DWORD_PTR mask, system_mask;
+    if (cpu >= 0) {
+        mask = (DWORD_PTR)1 << cpu;
+    } else if (!GetProcessAffinityMask(GetCurrentProcess(), &mask, &system_mask)) {
+        return (int)GetLastError();
+    }
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? 0 : (int)GetLastError();
+}
+
+int ra_memory_lock(size_t stack_size) {
+    return ENOSYS;
+}
+
+int ra_mutex_init(ra_mutex_t *mutex) {
+    InitializeCriticalSection(mutex);
+    return 0;
+}
+
+void ra_mutex_lock(ra_mutex_t *mutex) {
+    EnterCriticalSection(mutex);
+}
+
+void ra_mutex_unlock(ra_mutex_t *mutex) {
+    LeaveCriticalSection(mutex);
+}
+
+void ra_mutex_destroy(ra_mutex_t *mutex) {
+    DeleteCriticalSection(mutex);
+}
+
+int ra_cond_init(ra_cond_t *cond) {
+    InitializeConditionVariable(cond);
+    return 0;
+}
+
+void ra_cond_wait(ra_cond_t *cond, ra_mutex_t *mutex) {
+    SleepConditionVariableCS(cond, mutex, INFINITE);
+}
+
+void ra_cond_signal(ra_cond_t *cond) {
+    WakeConditionVariable(cond);
+}
+
+void ra_cond_broadcast(ra_cond_t *cond) {
+    WakeAllConditionVariable(cond);
+}
+
+void ra_cond_destroy(ra_cond_t *cond) {}
+
+int ra_cpu_count() {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
@@ -0,0 +1,142 @@
+#include "workers.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "thread.h"
+
+#define JOIN_TIMEOUT_SECONDS 5
+
+struct ra_workers_t {
+    ra_thread_t *threads;
+    int thread_count;
+    ra_mutex_t mutex;
+    ra_cond_t start_cond;
+    ra_cond_t done_cond;
+    unsigned int generation;
+    bool stopping;
+
+    ra_task_func *func;
+    void *data;
+    int task_count;
+    atomic_int next_task;
+    int pending_tasks;
+    int active_threads;  // Threads currently taking tasks, the task fields can't be reset until it drops to zero
+    int started_threads;
+};
+
+// Runs tasks until there's none left, returning the number of tasks completed
+static int run_tasks(ra_workers_t *workers) {
+    int completed = 0;
+    for (;;) {
+        int index = atomic_fetch_add(&workers->next_task, 1);
+        if (index >= workers->task_count) break;
+        workers->func(workers->data, index);
+        completed++;
+    }
+    return completed;
+}
+
+static void worker_thread(void *arg) {
+    ra_workers_t *workers = arg;
+    unsigned int generation = 0;
+    ra_mutex_lock(&workers->mutex);
+    workers->started_threads++;
+    ra_cond_broadcast(&workers->done_cond);
+    ra_mutex_unlock(&workers->mutex);
+
+    for (;;) {
+        ra_mutex_lock(&workers->mutex);
+        while (!workers->stopping && workers->generation == generation)
+            ra_cond_wait(&workers->start_cond, &workers->mutex);
+        if (workers->stopping) {
+            ra_mutex_unlock(&workers->mutex);
+            break;
+        }
+        generation = workers->generation;
+        workers->active_threads++;
+        ra_mutex_unlock(&workers->mutex);
+
+        int completed = run_tasks(workers);
+
+        ra_mutex_lock(&workers->mutex);
+        workers->pending_tasks -= completed;
+        workers->active_threads--;
+        if (workers->pending_tasks <= 0 && workers->active_threads <= 0) ra_cond_signal(&workers->done_cond);
+        ra_mutex_unlock(&workers->mutex);
+    }
+}
+
+ra_workers_t *ra_workers_create(int thread_count, int *err) {
+    ra_workers_t *workers = calloc(1, sizeof(ra_workers_t));
+    *err = ra_mutex_init(&workers->mutex);
+    if (!*err) *err = ra_cond_init(&workers->start_cond);
+    if (!*err) *err = ra_cond_init(&workers->done_cond);
+    if (*err) {
+        free(workers);
+        return NULL;
+    }
+
+    workers->threads = calloc(thread_count > 0 ? thread_count : 1, sizeof(ra_thread_t));
+    for (int i = 0; i < thread_count; i++) {
+        workers->threads[i] = ra_thread_start_sched(&worker_thread, workers, ra_thread_audio_sched(), err);
+        if (*err) break;
+        workers->thread_count++;
+    }
+
+    // Joining relies on the threads having entered their routine
+    ra_mutex_lock(&workers->mutex);
+    while (workers->started_threads < workers->thread_count) ra_cond_wait(&workers->done_cond, &workers->mutex);
+    ra_mutex_unlock(&workers->mutex);
+
+    if (*err) {
+        ra_workers_destroy(workers);
+        return NULL;
+    }
+    return workers;
+}
+
+void ra_workers_run(ra_workers_t *workers, ra_task_func *func, void *data, int task_count) {
+    if (!workers || workers->thread_count <= 0 || task_count <= 1) {
+        for (int i = 0; i < task_count; i++) func(data, i);
+        return;
+    }
+
+    ra_mutex_lock(&workers->mutex);
+    while (workers->active_threads > 0) ra_cond_wait(&workers->done_cond, &workers->mutex);
+    workers->func = func;
+    workers->data = data;
+    workers->task_count = task_count;
+    workers->pending_tasks = task_count;
+    atomic_store(&workers->next_task, 0);
+    workers->generation++;
+    ra_cond_broadcast(&workers->start_cond);
+    ra_mutex_unlock(&workers->mutex);
+
+    int completed = run_tasks(workers);
+
+    ra_mutex_lock(&workers->mutex);
+    workers->pending_tasks -= completed;
+    while (workers->pending_tasks > 0 || workers->active_threads > 0)
+        ra_cond_wait(&workers->done_cond, &workers->mutex);
+    ra_mutex_unlock(&workers->mutex);
+}
+
+void ra_workers_destroy(ra_workers_t *workers) {
+    if (!workers) return;
+    ra_mutex_lock(&workers->mutex);
+    workers->stopping = true;
+    ra_cond_broadcast(&workers->start_cond);
+    ra_mutex_unlock(&workers->mutex);
+
+    for (int i = 0; i < workers->thread_count; i++) {
+        ra_thread_join_timeout(workers->threads[i], JOIN_TIMEOUT_SECONDS);
+        ra_thread_destroy(workers->threads[i]);
+    }
+    ra_cond_destroy(&workers->done_cond);
+    ra_cond_destroy(&workers->start_cond);
+    ra_mutex_destroy(&workers->mutex);
+    free(workers->threads);
+    free(workers);
+}
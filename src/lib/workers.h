@@ -0,0 +1,15 @@
+#ifndef _RA_WORKERS_H
+#define _RA_WORKERS_H
+
+typedef void ra_task_func(void *data, int index);
+
+struct ra_workers_t;
+typedef struct ra_workers_t ra_workers_t;
+
+// Pool of helper threads, the calling thread takes part in running the tasks too. Runs are for one calling thread at a
+// time, and without a pool the tasks run on the caller alone.
+ra_workers_t *ra_workers_create(int thread_count, int *err);
+void ra_workers_run(ra_workers_t *workers, ra_task_func *func, void *data, int task_count);
+void ra_workers_destroy(ra_workers_t *workers);
+
+#endif
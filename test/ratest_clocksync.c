@@ -0,0 +1,37 @@
+#include <assert.h>
+
+#include "lib/clocksync.h"
+
+int main() {
+    ra_clock_sync_t sync;
+    ra_clock_sample_t sample;
+    ra_clock_sync_reset(&sync);
+    assert(ra_clock_sync_get(&sync, &sample) == -1);
+
+    // Peer clock runs 5 s behind ours, symmetric 2 ms round trip
+    ra_clock_sync_update(&sync, 10000000000, 5001000000, 10002000000);
+    assert(ra_clock_sync_get(&sync, &sample) == 0);
+    assert(sample.offset_ns == 5000000000);
+    assert(sample.rtt_ns == 2000000);
+
+    // A slow round trip with its delay all on the way back doesn't throw the estimate off
+    ra_clock_sync_update(&sync, 20000000000, 15001000000, 20030000000);
+    assert(ra_clock_sync_get(&sync, &sample) == 0);
+    assert(sample.offset_ns == 5000000000);
+
+    // Negative offsets for a peer clock ahead of ours, samples answered before they were sent are ignored
+    ra_clock_sync_reset(&sync);
+    ra_clock_sync_update(&sync, 1000000, 9000500000, 2000000);
+    ra_clock_sync_update(&sync, 3000000, 9002000000, 2000000);
+    assert(ra_clock_sync_get(&sync, &sample) == 0);
+    assert(sample.offset_ns == -8999000000);
+    assert(sample.rtt_ns == 1000000);
+
+    // Old samples age out, so the estimate follows drift
+    for (int i = 0; i < RA_CLOCK_SYNC_SAMPLES; i++)
+        ra_clock_sync_update(&sync, 100000000000, 100000000000 + 1000000, 100000000000 + 4000000);
+    assert(ra_clock_sync_get(&sync, &sample) == 0);
+    assert(sample.offset_ns == 1000000);
+    assert(sample.rtt_ns == 4000000);
+    return 0;
+}
@@ -13,6 +13,27 @@ const char *configstr =
     "port = 21500\n"
     "device = \"VB-Cable\"\n";
 
+static void test_parse_args() {
+    ra_config_t *cfg = ra_config_create();
+    const char *argv[] = {"remote-audio-source", "--dtx", "127.0.0.1", "--dtx-threshold=-50", "--mode=off"};
+    int argc = ra_config_parse_args(cfg, 5, argv);
+    assert(argc == 2);
+    assert(strequal(argv[0], "remote-audio-source"));
+    assert(strequal(argv[1], "127.0.0.1"));
+
+    ra_config_section_t *options = ra_config_get_default_section(cfg);
+    assert(options);
+    assert(ra_config_get_bool(options, "dtx", 0));
+    assert(!ra_config_get_bool(options, "mode", 1));
+    assert(ra_config_get_bool(options, "invalid", 1));
+    assert(ra_config_get_int(options, "dtx-threshold", 0) == -50);
+    assert(ra_config_get_int(options, "invalid", 42) == 42);
+
+    ra_config_set_value(cfg, "default", "dtx", "no");
+    assert(!ra_config_get_bool(options, "dtx", 1));
+    ra_config_destroy(cfg);
+}
+
 int main(int argc, char **argv) {
     ra_config_t *cfg = ra_config_create();
     ra_config_parse(cfg, configstr, strlen(configstr));
@@ -36,5 +57,7 @@ int main(int argc, char **argv) {
     assert(!ra_config_get_value(source, "invalid"));
 
     ra_config_destroy(cfg);
+
+    test_parse_args();
     return 0;
 }
@@ -0,0 +1,32 @@
+#include <assert.h>
+
+#include "lib/congestion.h"
+
+int main() {
+    ra_congestion_t cc;
+    ra_stream_report_t report = {0};
+    ra_congestion_init(&cc, 2, 3);
+    assert(cc.bitrate == cc.max_bitrate);
+    assert(cc.frame_multiplier == 1);
+
+    // Clean link keeps everything at maximum
+    assert(!ra_congestion_update(&cc, &report));
+
+    // Heavy loss backs off bitrate, enables FEC and grows the frame size
+    report.fraction_lost = 64;
+    assert(ra_congestion_update(&cc, &report));
+    assert(cc.bitrate == cc.max_bitrate * 3 / 4);
+    assert(cc.loss_percent > 0);
+    assert(cc.frame_multiplier == 2);
+    for (int i = 0; i < 32; i++) ra_congestion_update(&cc, &report);
+    assert(cc.bitrate == cc.min_bitrate);
+    assert(cc.frame_multiplier == 3);
+
+    // Recovers once the link is clean again
+    report.fraction_lost = 0;
+    for (int i = 0; i < 128; i++) ra_congestion_update(&cc, &report);
+    assert(cc.bitrate == cc.max_bitrate);
+    assert(cc.loss_percent == 0);
+    assert(cc.frame_multiplier == 1);
+    return 0;
+}
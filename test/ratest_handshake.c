@@ -0,0 +1,101 @@
+#include <assert.h>
+#include <string.h>
+
+#include "lib/crypto.h"
+#include "lib/proto.h"
+
+#define BUFSIZE 256
+
+static void test_cookies() {
+    unsigned char key[COOKIE_KEY_SIZE], cookie[COOKIE_SIZE];
+    unsigned char peer[6] = {192, 168, 1, 10, 0x53, 0xfc};
+    unsigned char other[6] = {192, 168, 1, 11, 0x53, 0xfc};
+    ra_generate_cookie_key(key);
+    ra_compute_cookie(cookie, key, peer, sizeof(peer), 100);
+
+    // Good for its own epoch and the one after, nothing later
+    assert(ra_verify_cookie(cookie, sizeof(cookie), key, peer, sizeof(peer), 100) == 0);
+    assert(ra_verify_cookie(cookie, sizeof(cookie), key, peer, sizeof(peer), 101) == 0);
+    assert(ra_verify_cookie(cookie, sizeof(cookie), key, peer, sizeof(peer), 102) != 0);
+    assert(ra_verify_cookie(cookie, sizeof(cookie), key, peer, sizeof(peer), 99) != 0);
+
+    // Bound to the address it was sent to
+    assert(ra_verify_cookie(cookie, sizeof(cookie), key, other, sizeof(other), 100) != 0);
+    assert(ra_verify_cookie(cookie, sizeof(cookie) - 1, key, peer, sizeof(peer), 100) != 0);
+    assert(ra_verify_cookie(cookie, 0, key, peer, sizeof(peer), 100) != 0);
+
+    unsigned char key2[COOKIE_KEY_SIZE];
+    ra_generate_cookie_key(key2);
+    assert(ra_verify_cookie(cookie, sizeof(cookie), key2, peer, sizeof(peer), 100) != 0);
+}
+
+// Messages are read from past their type byte, the way the receive loop hands them over
+static int read_handshake(ra_handshake_t *hs, const ra_buf_t *buf) {
+    assert(buf->len > 1 && buf->base[0] == (char)RA_HANDSHAKE_INIT);
+    ra_rbuf_t rbuf = {.base = buf->base + 1, .len = buf->len - 1};
+    return read_handshake_message(hs, &rbuf);
+}
+
+static void test_handshake_message() {
+    char rawbuf[BUFSIZE];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    ra_keypair_t keypair;
+    ra_generate_keypair(&keypair);
+    ra_audio_config_t cfg = {.channel_count = 6, .sample_format = paFloat32, .frame_size = 480, .sample_rate = 48000};
+    ra_channel_layout_t layout;
+    assert(ra_channel_layout_init(&layout, cfg.channel_count, RA_MAPPING_FAMILY_SURROUND, 1) == 0);
+
+    // First attempt, without a cookie
+    create_handshake_message(&buf, &keypair, &cfg, &layout, NULL, 0);
+    ra_handshake_t sent = {.cfg = cfg, .layout = layout};
+    ra_handshake_t hs = {0};
+    assert(read_handshake(&hs, &buf) == 0);
+    assert(hs.cookielen == 0);
+    assert(hs.keylen == PUBLIC_KEY_SIZE && memcmp(hs.key, keypair.public, PUBLIC_KEY_SIZE) == 0);
+    assert(ra_handshake_config_equal(&hs, &sent));
+
+    // Retry echoing the sink's cookie, the rest reads the same
+    unsigned char cookie[COOKIE_SIZE];
+    memset(cookie, 0xa5, sizeof(cookie));
+    create_handshake_message(&buf, &keypair, &cfg, &layout, cookie, sizeof(cookie));
+    memset(&hs, 0, sizeof(hs));
+    assert(read_handshake(&hs, &buf) == 0);
+    assert(hs.cookielen == COOKIE_SIZE && memcmp(hs.cookie, cookie, COOKIE_SIZE) == 0);
+    assert(hs.keylen == PUBLIC_KEY_SIZE && memcmp(hs.key, keypair.public, PUBLIC_KEY_SIZE) == 0);
+    assert(ra_handshake_config_equal(&hs, &sent));
+
+    // Cut off inside the cookie or the key
+    ra_rbuf_t rbuf = {.base = buf.base + 1, .len = 1 + COOKIE_SIZE / 2};
+    assert(read_handshake_message(&hs, &rbuf) != 0);
+    rbuf.len = 1 + COOKIE_SIZE + 1 + PUBLIC_KEY_SIZE / 2;
+    assert(read_handshake_message(&hs, &rbuf) != 0);
+}
+
+static void test_cookie_message() {
+    char rawbuf[BUFSIZE];
+    ra_buf_t buf = {.base = rawbuf, .cap = sizeof(rawbuf)};
+    unsigned char cookie[COOKIE_SIZE];
+    memset(cookie, 0x5a, sizeof(cookie));
+    create_handshake_cookie_message(&buf, cookie, sizeof(cookie));
+    assert(buf.base[0] == (char)RA_HANDSHAKE_COOKIE);
+
+    const unsigned char *read_cookie;
+    size_t read_len;
+    ra_rbuf_t rbuf = {.base = buf.base + 1, .len = buf.len - 1};
+    assert(read_handshake_cookie_message(&read_cookie, &read_len, &rbuf) == 0);
+    assert(read_len == COOKIE_SIZE && memcmp(read_cookie, cookie, COOKIE_SIZE) == 0);
+
+    // The length byte promises more than what arrived
+    rbuf.len--;
+    assert(read_handshake_cookie_message(&read_cookie, &read_len, &rbuf) != 0);
+    rbuf.len = 0;
+    assert(read_handshake_cookie_message(&read_cookie, &read_len, &rbuf) != 0);
+}
+
+int main() {
+    assert(sodium_init() >= 0);
+    test_cookies();
+    test_handshake_message();
+    test_cookie_message();
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lib/journal.h"
+
+#define JOURNAL_PATH "ratest-journal.csv"
+
+static ra_jitter_histogram_t hist;
+
+static void test_jitter_histogram() {
+    ra_jitter_histogram_reset(&hist);
+    assert(ra_jitter_histogram_mean(&hist) == 0);
+    assert(ra_jitter_histogram_quantile(&hist, 0.99) == 0);
+
+    for (int i = 0; i < 98; i++) ra_jitter_histogram_add(&hist, 250);
+    ra_jitter_histogram_add(&hist, 4950);
+    ra_jitter_histogram_add(&hist, 500000);
+    assert(ra_jitter_histogram_mean(&hist) == (98 * 250 + 4950 + 500000) / 100);
+    assert(ra_jitter_histogram_quantile(&hist, 0.5) == 300);
+    assert(ra_jitter_histogram_quantile(&hist, 0.99) == 5000);
+    // Anything past the last bucket is reported at its bound
+    assert(ra_jitter_histogram_quantile(&hist, 1) == RA_JITTER_BUCKETS * RA_JITTER_BUCKET_US);
+}
+
+static void test_journal() {
+    char line[512];
+    ra_session_record_t record = {
+        .start_time = 1700000000,
+        .stream_id = 3,
+        .source = "192.168.1.10:50123",
+        .reason = "timeout",
+        .duration_ms = 61000,
+        .frames_received = 2928000,
+        .frames_lost = 960,
+        .frames_concealed = 1920,
+        .bytes_received = 1234567,
+        .jitter_mean_us = 420,
+        .jitter_p99_us = 1800,
+        .underruns = 2,
+        .decode_avg_us = 35,
+    };
+    const char *expected = "1700000000,3,192.168.1.10:50123,timeout,61000,2928000,960,1920,1234567,420,1800,2,35\n";
+    assert(ra_session_record_format(&record, line, sizeof(line)) == (int)strlen(expected));
+    assert(strcmp(line, expected) == 0);
+    assert(ra_session_record_format(&record, line, 16) == -1);
+
+    ra_logger_stream_t *stream = ra_logger_stream_create(stderr, stderr);
+    ra_logger_t *logger = ra_logger_create(stream, NULL);
+    remove(JOURNAL_PATH);
+    for (int run = 0; run < 2; run++) {
+        int err = 0;
+        ra_journal_t *journal = ra_journal_open(logger, JOURNAL_PATH, &err);
+        assert(journal && !err);
+        assert(ra_journal_append(journal, &record) == 0);
+        ra_journal_close(journal);
+    }
+
+    // Reopening appends without repeating the header
+    FILE *file = fopen(JOURNAL_PATH, "r");
+    assert(file);
+    assert(fgets(line, sizeof(line), file) && strcmp(line, RA_JOURNAL_CSV_HEADER) == 0);
+    assert(fgets(line, sizeof(line), file) && strcmp(line, expected) == 0);
+    assert(fgets(line, sizeof(line), file) && strcmp(line, expected) == 0);
+    assert(!fgets(line, sizeof(line), file));
+    fclose(file);
+    remove(JOURNAL_PATH);
+    ra_logger_destroy(logger);
+    ra_logger_stream_destroy(stream);
+}
+
+int main() {
+    test_jitter_histogram();
+    test_journal();
+    return 0;
+}
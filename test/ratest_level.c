@@ -0,0 +1,33 @@
+#include <assert.h>
+
+#include "lib/level.h"
+
+static void test_peak() {
+    float fsamples[19] = {0};
+    fsamples[5] = -0.75f;
+    fsamples[18] = 0.5f;
+    assert(ra_level_peak_float(fsamples, 19) == 0.75f);
+    assert(ra_level_peak_float(fsamples, 5) == 0);
+
+    int16_t isamples[19] = {0};
+    isamples[3] = 16384;
+    isamples[17] = -32768;
+    assert(ra_level_peak_int16(isamples, 19) == 1.0f);
+    assert(ra_level_peak_int16(isamples, 16) == 0.5f);
+}
+
+static void test_silence_gate() {
+    ra_silence_gate_t gate;
+    ra_silence_gate_init(&gate, 0.001f, 960 * 10);
+    for (int i = 0; i < 9; i++) assert(!ra_silence_gate_update(&gate, 0, 960));
+    assert(ra_silence_gate_update(&gate, 0, 960));
+    assert(ra_silence_gate_update(&gate, 0.0001f, 960));
+    assert(!ra_silence_gate_update(&gate, 0.5f, 960));
+    assert(!ra_silence_gate_update(&gate, 0, 960));
+}
+
+int main() {
+    test_peak();
+    test_silence_gate();
+    return 0;
+}
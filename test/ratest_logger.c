@@ -1,6 +1,10 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
 #include "lib/logger.h"
 
-int main() {
+static void test_levels() {
     ra_logger_stream_t *stream = ra_logger_stream_create_default();
     ra_logger_t *logger = ra_logger_create(stream, "ratest-logger");
     ra_logger_debug(logger, "This is %s level", "debug");
@@ -10,5 +14,50 @@ int main() {
     // Can't test fatal since it would exit our program with failure exit code
     ra_logger_destroy(logger);
     ra_logger_stream_destroy(stream);
+}
+
+static int count_lines(FILE *file, const char *needle) {
+    char line[512];
+    int count = 0;
+    rewind(file);
+    while (fgets(line, sizeof(line), file))
+        if (strstr(line, needle)) count++;
+    return count;
+}
+
+static void test_queue() {
+    FILE *file = tmpfile();
+    assert(file);
+    ra_logger_stream_t *stream = ra_logger_stream_create(file, file);
+    ra_logger_t *logger = ra_logger_create(stream, "ratest-logger");
+    assert(stream->queue);
+
+    // Runs of the same message collapse into one line and a count
+    for (int i = 0; i < 5; i++) ra_logger_error(logger, "Ring buffer overflow!");
+    ra_logger_info(logger, "Stream %d: Opened", 1);
+    ra_logger_stream_flush(stream);
+    assert(count_lines(file, "Ring buffer overflow!") == 1);
+    assert(count_lines(file, "Last message repeated 4 times") == 1);
+    assert(count_lines(file, "Stream 1: Opened") == 1);
+
+    // Floods past the rate limit get dropped and counted
+    for (int i = 0; i < RA_LOGGER_RATE_LIMIT * 3; i++) ra_logger_warn(logger, "Packet %d", i);
+    ra_logger_stream_flush(stream);
+    assert(count_lines(file, "Packet ") < RA_LOGGER_RATE_LIMIT * 3);
+    assert(count_lines(file, "Dropped ") >= 1);
+
+    // The flood only uses up its own format's budget, kept short enough that the queue can't fill up
+    for (int i = 0; i <= RA_LOGGER_RATE_LIMIT; i++) ra_logger_warn(logger, "Flood %d", i);
+    ra_logger_info(logger, "Stream %d: Closed", 1);
+    ra_logger_stream_flush(stream);
+    assert(count_lines(file, "Stream 1: Closed") == 1);
+
+    ra_logger_destroy(logger);
+    ra_logger_stream_destroy(stream);
+}
+
+int main() {
+    test_levels();
+    test_queue();
     return 0;
 }
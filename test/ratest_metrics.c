@@ -0,0 +1,86 @@
+#include <assert.h>
+#include <string.h>
+
+#include "lib/metrics.h"
+
+static void test_counters() {
+    ra_metrics_t metrics;
+    ra_metrics_init(&metrics);
+    ra_metrics_add(&metrics, RA_METRIC_PACKETS_RECEIVED, 1);
+    ra_metrics_add(&metrics, RA_METRIC_PACKETS_RECEIVED, 2);
+    ra_metrics_set(&metrics, RA_METRIC_BUFFER_MS, 40);
+    ra_metrics_set(&metrics, RA_METRIC_BUFFER_MS, 20);
+    assert(ra_metrics_get(&metrics, RA_METRIC_PACKETS_RECEIVED) == 3);
+    assert(ra_metrics_get(&metrics, RA_METRIC_BUFFER_MS) == 20);
+    assert(ra_metrics_get(&metrics, RA_METRIC_DECODE_ERRORS) == 0);
+}
+
+static void test_render() {
+    char buf[16384];
+    size_t len = 0;
+    ra_metrics_t global, streams[2];
+    ra_metrics_init(&global);
+    ra_metrics_init(&streams[0]);
+    ra_metrics_init(&streams[1]);
+    ra_metrics_add(&global, RA_METRIC_HANDSHAKES_REJECTED, 5);
+    ra_metrics_add(&streams[1], RA_METRIC_BYTES_RECEIVED, 1200);
+    ra_metrics_set(&streams[0], RA_METRIC_BUFFER_MS, 60);
+
+    ra_metrics_set_t global_set = {.metrics = &global};
+    ra_metrics_set_t stream_sets[2] = {
+        {.labels = "stream=\"0\"", .metrics = &streams[0]},
+        {.labels = "stream=\"1\"", .metrics = &streams[1]},
+    };
+    assert(ra_metrics_render(buf, sizeof(buf), &len, "ra", RA_METRIC_SCOPE_GLOBAL, &global_set, 1) == 0);
+    assert(ra_metrics_render(buf, sizeof(buf), &len, "ra_stream", RA_METRIC_SCOPE_STREAM, stream_sets, 2) == 0);
+    assert(len < sizeof(buf) && buf[len] == '\0');
+
+    assert(strstr(buf, "# TYPE ra_handshakes_rejected_total counter\nra_handshakes_rejected_total 5\n"));
+    assert(strstr(buf, "ra_stream_bytes_received_total{stream=\"1\"} 1200\n"));
+    assert(strstr(buf, "# TYPE ra_stream_buffer_ms gauge\n"));
+    assert(strstr(buf, "ra_stream_buffer_ms{stream=\"0\"} 60\n"));
+    // Scopes keep per-stream gauges out of the global metrics and the other way around
+    assert(!strstr(buf, "ra_buffer_ms"));
+    assert(!strstr(buf, "ra_stream_handshakes_rejected_total"));
+
+    // Running out of space is reported rather than truncating a line
+    len = 0;
+    assert(ra_metrics_render(buf, 64, &len, "ra", RA_METRIC_SCOPE_GLOBAL, &global_set, 1) == -1);
+    assert(len < 64);
+}
+
+static void test_histogram() {
+    char buf[8192];
+    size_t len = 0;
+    ra_metrics_t metrics;
+    ra_metrics_init(&metrics);
+    ra_metrics_observe_ns(&metrics.callback_duration, 40000);
+    ra_metrics_observe_ns(&metrics.callback_duration, 50000);
+    ra_metrics_observe_ns(&metrics.callback_duration, 3000000);
+    ra_metrics_observe_ns(&metrics.callback_duration, 1000000000);
+    assert(ra_metrics_histogram_count(&metrics.callback_duration) == 4);
+
+    ra_metrics_set_t set = {.labels = "stream=\"0\"", .metrics = &metrics};
+    assert(ra_metrics_render(buf, sizeof(buf), &len, "ra", RA_METRIC_SCOPE_STREAM, &set, 1) == 0);
+    assert(strstr(buf, "# TYPE ra_callback_duration_seconds histogram\n"));
+    // Bounds are inclusive and the buckets cumulative
+    assert(strstr(buf, "ra_callback_duration_seconds_bucket{stream=\"0\",le=\"5e-05\"} 2\n"));
+    assert(strstr(buf, "ra_callback_duration_seconds_bucket{stream=\"0\",le=\"0.0025\"} 2\n"));
+    assert(strstr(buf, "ra_callback_duration_seconds_bucket{stream=\"0\",le=\"0.005\"} 3\n"));
+    assert(strstr(buf, "ra_callback_duration_seconds_bucket{stream=\"0\",le=\"+Inf\"} 4\n"));
+    assert(strstr(buf, "ra_callback_duration_seconds_sum{stream=\"0\"} 1.003090000\n"));
+    assert(strstr(buf, "ra_callback_duration_seconds_count{stream=\"0\"} 4\n"));
+
+    len = 0;
+    ra_metrics_set_t global_set = {.metrics = &metrics};
+    assert(ra_metrics_render(buf, sizeof(buf), &len, "ra", RA_METRIC_SCOPE_GLOBAL, &global_set, 1) == 0);
+    assert(strstr(buf, "ra_callback_duration_seconds_bucket{le=\"0.08\"} 3\n"));
+    assert(strstr(buf, "ra_callback_duration_seconds_count 4\n"));
+}
+
+int main() {
+    test_counters();
+    test_render();
+    test_histogram();
+    return 0;
+}
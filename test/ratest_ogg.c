@@ -0,0 +1,93 @@
+#include <assert.h>
+#include <string.h>
+
+#include "lib/ogg.h"
+
+#define PAGE_HEADER_SIZE 27
+
+static uint32_t le32(const unsigned char *buf) {
+    return buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+static uint64_t le64(const unsigned char *buf) {
+    return le32(buf) | (uint64_t)le32(buf + 4) << 32;
+}
+
+static void test_crc32() {
+    // CRC-32/MPEG-2 polynomial without the initial value and final xor
+    assert(ra_ogg_crc32(0, (const unsigned char *)"123456789", 9) == 0x89a1897f);
+    assert(ra_ogg_crc32(0, (const unsigned char *)"", 0) == 0);
+}
+
+static void test_writer() {
+    FILE *file = tmpfile();
+    assert(file);
+
+    ra_opus_head_t head = {
+        .channel_count = 2,
+        .sample_rate = 48000,
+        .pre_skip = RA_OGG_OPUS_PRE_SKIP,
+    };
+    ra_ogg_writer_t *writer = ra_ogg_writer_create(file, &head, 0x1234);
+    assert(writer);
+
+    unsigned char packet[600];
+    memset(packet, 0xab, sizeof(packet));
+    for (int i = 0; i < 20; i++) assert(!ra_ogg_writer_write(writer, packet, sizeof(packet), 960));
+    assert(!ra_ogg_writer_close(writer));
+
+    long size = ftell(file);
+    rewind(file);
+    unsigned char data[16384];
+    assert(size > 0 && size <= (long)sizeof(data));
+    assert(fread(data, 1, size, file) == (size_t)size);
+    fclose(file);
+
+    int pages = 0;
+    size_t packet_bytes = 0;
+    uint64_t granule = 0;
+    unsigned char flags = 0;
+    for (long offset = 0; offset < size; pages++) {
+        unsigned char *page = data + offset;
+        assert(!memcmp(page, "OggS", 4));
+        assert(le32(page + 14) == 0x1234);
+        assert(le32(page + 18) == (uint32_t)pages);
+
+        size_t body_len = 0;
+        int segment_count = page[26];
+        for (int i = 0; i < segment_count; i++) body_len += page[PAGE_HEADER_SIZE + i];
+        size_t page_len = PAGE_HEADER_SIZE + segment_count + body_len;
+
+        uint32_t crc = le32(page + 22);
+        memset(page + 22, 0, 4);
+        assert(ra_ogg_crc32(0, page, page_len) == crc);
+
+        unsigned char *body = page + PAGE_HEADER_SIZE + segment_count;
+        if (pages == 0) {
+            assert(page[5] == 0x02);
+            assert(!memcmp(body, "OpusHead", 8));
+            assert(body[9] == 2);
+            assert((body[10] | body[11] << 8) == RA_OGG_OPUS_PRE_SKIP);
+            assert(le32(body + 12) == 48000);
+        } else if (pages == 1) {
+            assert(!memcmp(body, "OpusTags", 8));
+        } else {
+            packet_bytes += body_len;
+        }
+        granule = le64(page + 6);
+        flags = page[5];
+        offset += page_len;
+    }
+
+    // Headers, at least one page flushed on size and the final page
+    assert(pages >= 4);
+    assert(flags == 0x04);
+    assert(granule == 20 * 960);
+    assert(packet_bytes == 20 * sizeof(packet));
+}
+
+int main() {
+    test_crc32();
+    test_writer();
+    return 0;
+}
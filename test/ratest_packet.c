@@ -0,0 +1,59 @@
+#include <assert.h>
+#include <string.h>
+
+#include "lib/packet.h"
+
+#define POOL_SIZE 3
+
+int main() {
+    ra_packet_pool_t *pool = ra_packet_pool_create(POOL_SIZE);
+    assert(ra_packet_pool_available(pool) == POOL_SIZE);
+
+    ra_packet_t *packets[POOL_SIZE];
+    for (int i = 0; i < POOL_SIZE; i++) {
+        packets[i] = ra_packet_alloc(pool);
+        assert(packets[i]);
+        assert(packets[i]->len == 0);
+        assert(ra_packet_headroom(packets[i]) == RA_PACKET_HEADROOM);
+    }
+    assert(ra_packet_pool_available(pool) == 0);
+    assert(ra_packet_alloc(pool) == NULL);
+
+    // Only the last reference hands the packet back to the pool
+    ra_packet_t *pkt = ra_packet_retain(packets[0]);
+    ra_packet_release(packets[0]);
+    assert(ra_packet_pool_available(pool) == 0);
+    ra_packet_release(pkt);
+    assert(ra_packet_pool_available(pool) == 1);
+    assert(ra_packet_alloc(pool) == pkt);
+    ra_packet_release(pkt);
+    ra_packet_release(packets[1]);
+    ra_packet_release(packets[2]);
+    assert(ra_packet_pool_available(pool) == POOL_SIZE);
+
+    // Headers go in front of the payload without moving it
+    pkt = ra_packet_alloc(pool);
+    memcpy(ra_packet_put(pkt, 5), "hello", 5);
+    *ra_packet_push(pkt, 1) = 'x';
+    assert(pkt->len == 6);
+    assert(memcmp(pkt->data, "xhello", 6) == 0);
+    assert(ra_packet_headroom(pkt) == RA_PACKET_HEADROOM - 1);
+    assert(ra_packet_tailroom(pkt) == RA_PACKET_SIZE + RA_PACKET_TAILROOM - 5);
+
+    assert(ra_packet_pull(pkt, 1) == pkt->data);
+    assert(memcmp(pkt->data, "hello", 5) == 0);
+    assert(ra_packet_pull(pkt, 6) == NULL);
+    assert(ra_packet_push(pkt, RA_PACKET_HEADROOM + 1) == NULL);
+    assert(ra_packet_put(pkt, ra_packet_tailroom(pkt) + 1) == NULL);
+    assert(pkt->len == 5);
+
+    // A recycled packet starts out empty again
+    ra_packet_release(pkt);
+    pkt = ra_packet_alloc(pool);
+    assert(pkt->len == 0);
+    assert(ra_packet_headroom(pkt) == RA_PACKET_HEADROOM);
+    ra_packet_release(pkt);
+
+    ra_packet_pool_destroy(pool);
+    return 0;
+}
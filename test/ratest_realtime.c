@@ -0,0 +1,79 @@
+// For sched_getaffinity
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <sched.h>
+
+#include "lib/config.h"
+#include "lib/realtime.h"
+#include "lib/thread.h"
+
+static int read_args(ra_realtime_config_t *cfg, int argc, const char **argv) {
+    ra_config_t *opts = ra_config_create();
+    ra_config_parse_args(opts, argc, argv);
+    int rc = ra_realtime_config_read(cfg, ra_config_get_default_section(opts));
+    ra_config_destroy(opts);
+    return rc;
+}
+
+static void test_config_read() {
+    ra_realtime_config_t cfg;
+    const char *defaults[] = {"remote-audio-sink"};
+    assert(read_args(&cfg, 1, defaults) == 0);
+    assert(cfg.policy == RA_THREAD_SCHED_FIFO && cfg.priority == 0 && !cfg.lock_memory);
+
+    const char *options[] = {"remote-audio-sink", "--rt-priority=70", "--rt-policy=rr", "--mlock"};
+    assert(read_args(&cfg, 4, options) == 0);
+    assert(cfg.policy == RA_THREAD_SCHED_RR && cfg.priority == 70 && cfg.lock_memory);
+
+    const char *bad_policy[] = {"remote-audio-sink", "--rt-policy=idle"};
+    assert(read_args(&cfg, 2, bad_policy) == -1);
+    const char *bad_priority[] = {"remote-audio-sink", "--rt-priority=100"};
+    assert(read_args(&cfg, 2, bad_priority) == -1);
+}
+
+// Without privileges the settings fail with a warning, either way the thread keeps running
+static void test_apply() {
+    ra_logger_stream_t *stream = ra_logger_stream_create(stderr, stderr);
+    ra_logger_t *logger = ra_logger_create(stream, "ratest-realtime");
+    ra_realtime_config_t cfg = {.policy = RA_THREAD_SCHED_FIFO, .priority = 10};
+    ra_realtime_apply(logger, &cfg, "ratest", 20, 0);
+    ra_logger_destroy(logger);
+    ra_logger_stream_destroy(stream);
+}
+
+#ifdef __linux__
+static void check_unpinned(void *arg) {
+    cpu_set_t set;
+    assert(sched_getaffinity(0, sizeof(set), &set) == 0);
+    *(int *)arg = CPU_COUNT(&set);
+}
+
+// Threads started with a scheduling of their own don't take after the pinned thread starting them
+static void test_start_sched() {
+    if (ra_cpu_count() < 2 || ra_thread_set_affinity(0)) return;
+    ra_thread_sched_t sched = {.policy = RA_THREAD_SCHED_FIFO, .priority = 0, .cpu = -1};
+    int err, count = 0;
+    ra_thread_t thread = ra_thread_start_sched(&check_unpinned, &count, &sched, &err);
+    assert(!err);
+    ra_thread_join(thread);
+    ra_thread_destroy(thread);
+    assert(count > 1);
+
+    thread = ra_thread_start(&check_unpinned, &count, &err);
+    assert(!err);
+    ra_thread_join(thread);
+    ra_thread_destroy(thread);
+    assert(count == 1);
+    ra_thread_set_affinity(-1);
+}
+#endif
+
+int main() {
+    test_config_read();
+    test_apply();
+#ifdef __linux__
+    test_start_sched();
+#endif
+    return 0;
+}
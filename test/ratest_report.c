@@ -0,0 +1,44 @@
+#include <assert.h>
+
+#include "lib/report.h"
+
+static void test_loss() {
+    ra_receiver_stats_t stats;
+    ra_stream_report_t report;
+    ra_receiver_stats_reset(&stats, 48000);
+
+    // Nonces 1 to 4 received, 5 to 8 lost
+    for (uint64_t nonce = 1; nonce <= 4; nonce++) ra_receiver_stats_update(&stats, nonce);
+    ra_receiver_stats_update(&stats, 9);
+    ra_receiver_stats_fill_report(&stats, &report);
+    assert(report.cumulative_lost == 4);
+    assert(report.fraction_lost == (4 << 8) / 9);
+
+    // No loss since the previous report
+    ra_receiver_stats_update(&stats, 10);
+    ra_receiver_stats_fill_report(&stats, &report);
+    assert(report.cumulative_lost == 4);
+    assert(report.fraction_lost == 0);
+}
+
+static void test_jitter() {
+    ra_receiver_stats_t stats;
+    ra_stream_report_t report;
+    ra_receiver_stats_reset(&stats, 48000);
+
+    // 20 ms frames arriving exactly on time
+    for (uint32_t i = 0; i < 16; i++) ra_receiver_stats_update_jitter(&stats, i * 960, 1000000 + i * 20000);
+    ra_receiver_stats_fill_report(&stats, &report);
+    assert(report.jitter_us == 0);
+
+    // One frame arriving 16 ms late
+    ra_receiver_stats_update_jitter(&stats, 16 * 960, 1000000 + 16 * 20000 + 16000);
+    ra_receiver_stats_fill_report(&stats, &report);
+    assert(report.jitter_us == 1000);
+}
+
+int main() {
+    test_loss();
+    test_jitter();
+    return 0;
+}
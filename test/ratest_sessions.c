@@ -0,0 +1,80 @@
+#include <assert.h>
+
+#include "lib/sessions.h"
+
+#define MAX_SLOTS        100
+#define COLLIDING_KEY(i) ((uint64_t)(i) << 32 | (i))  // Both halves cancel out, every key hashes to bucket 0
+
+int main() {
+    int values[MAX_SLOTS];
+    uint32_t ids[MAX_SLOTS];
+    assert(ra_session_table_create(0) == NULL);
+    assert(ra_session_table_create(RA_SESSION_MAX_SLOTS + 1) == NULL);
+
+    ra_session_table_t *table = ra_session_table_create(MAX_SLOTS);
+    assert(ra_session_table_size(table) == 0);
+    assert(ra_session_table_reserve(table, 4) == 0);
+    assert(ra_session_table_size(table) == 4);
+    assert(ra_session_table_reserve(table, MAX_SLOTS + 1) == -1);
+
+    // Reserved slots get handed out first and lowest first, the table grows past them up to its capacity
+    for (int i = 0; i < MAX_SLOTS; i++) {
+        int index = ra_session_table_acquire(table, 0, &ids[i]);
+        assert(index == i);
+        assert(ids[i] != RA_SESSION_ID_NONE);
+        assert(RA_SESSION_INDEX(ids[i]) == i);
+        ra_session_table_set(table, index, &values[i]);
+    }
+    assert(ra_session_table_size(table) == MAX_SLOTS);
+    uint32_t id;
+    assert(ra_session_table_acquire(table, 0, &id) == -1);
+
+    for (int i = 0; i < MAX_SLOTS; i++) {
+        assert(ra_session_table_lookup(table, ids[i]) == &values[i]);
+        assert(ra_session_table_at(table, i) == &values[i]);
+    }
+    assert(ra_session_table_lookup(table, RA_SESSION_ID_NONE) == NULL);
+    assert(ra_session_table_lookup(table, ids[0] + MAX_SLOTS) == NULL);
+    assert(ra_session_table_at(table, MAX_SLOTS) == NULL);
+
+    // A released slot is reused under a different ID, the stale one no longer finds it
+    uint32_t stale = ids[70];
+    assert(ra_session_table_release(table, stale) == 0);
+    assert(ra_session_table_release(table, stale) == -1);
+    assert(ra_session_table_lookup(table, stale) == NULL);
+    assert(ra_session_table_at(table, 70) == &values[70]);
+    assert(ra_session_table_acquire(table, stale >> RA_SESSION_INDEX_BITS, &id) == 70);
+    assert(id != stale);
+    assert(ra_session_table_lookup(table, stale) == NULL);
+    assert(ra_session_table_lookup(table, id) == &values[70]);
+    ids[70] = id;
+
+    // Keys sharing a home bucket probe past each other, unbinding one in the middle keeps the rest reachable
+    for (int i = 0; i < 8; i++) assert(ra_session_table_bind(table, ids[i], COLLIDING_KEY(i)) == 0);
+    assert(ra_session_table_bind(table, stale, 42) == -1);
+    assert(ra_session_table_find(table, 42) == RA_SESSION_ID_NONE);
+    assert(ra_session_table_find(table, COLLIDING_KEY(8)) == RA_SESSION_ID_NONE);
+    for (int i = 0; i < 8; i++) assert(ra_session_table_find(table, COLLIDING_KEY(i)) == ids[i]);
+    assert(ra_session_table_unbind(table, ids[3]) == 0);
+    assert(ra_session_table_release(table, ids[5]) == 0);
+    assert(ra_session_table_find(table, COLLIDING_KEY(3)) == RA_SESSION_ID_NONE);
+    assert(ra_session_table_find(table, COLLIDING_KEY(5)) == RA_SESSION_ID_NONE);
+    for (int i = 0; i < 8; i++) {
+        if (i == 3 || i == 5) continue;
+        assert(ra_session_table_find(table, COLLIDING_KEY(i)) == ids[i]);
+    }
+    assert(ra_session_table_bind(table, ids[3], COLLIDING_KEY(3)) == 0);
+    for (int i = 0; i < 8; i++) {
+        if (i == 5) continue;
+        assert(ra_session_table_find(table, COLLIDING_KEY(i)) == ids[i]);
+    }
+
+    // Rebinding moves the session to the new key
+    assert(ra_session_table_bind(table, ids[70], 42) == 0);
+    assert(ra_session_table_bind(table, ids[70], 43) == 0);
+    assert(ra_session_table_find(table, 42) == RA_SESSION_ID_NONE);
+    assert(ra_session_table_find(table, 43) == ids[70]);
+
+    ra_session_table_destroy(table);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib/thread.h"
+#include "lib/trace.h"
+
+static char *dump_to_string() {
+    FILE *out = tmpfile();
+    assert(out);
+    assert(ra_trace_dump(out) == 0);
+    long len = ftell(out);
+    char *buf = malloc(len + 1);
+    rewind(out);
+    assert(fread(buf, 1, len, out) == (size_t)len);
+    buf[len] = '\0';
+    fclose(out);
+    return buf;
+}
+
+static int count_occurrences(const char *haystack, const char *needle) {
+    int count = 0;
+    for (const char *p = strstr(haystack, needle); p; p = strstr(p + 1, needle)) count++;
+    return count;
+}
+
+static void test_disabled() {
+    ra_trace_set_enabled(false);
+    uint64_t start = RA_TRACE_BEGIN();
+    assert(start == 0);
+    RA_TRACE_END(RA_TRACE_ENCODE, start);
+}
+
+static void test_dump() {
+    ra_trace_set_thread_name("main");
+    ra_trace_set_enabled(true);
+    uint64_t start = RA_TRACE_BEGIN();
+    assert(start > 0);
+    RA_TRACE_END(RA_TRACE_DECRYPT, start);
+    ra_trace_record(RA_TRACE_SEND, 2000, 3500);
+
+    char *json = dump_to_string();
+    assert(strncmp(json, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 39) == 0);
+    assert(strstr(json, "\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"main\"}}"));
+    assert(strstr(json,
+                  "{\"name\":\"sendto\",\"cat\":\"ra\",\"ph\":\"X\",\"pid\":1,\"tid\":1,"
+                  "\"ts\":2.000,\"dur\":1.500}"));
+    assert(strstr(json, "\"name\":\"decrypt\""));
+    // Nothing was recorded while tracing was off
+    assert(!strstr(json, "\"name\":\"encode\""));
+    assert(strcmp(json + strlen(json) - 4, "\n]}\n") == 0);
+    free(json);
+}
+
+static void test_ring_wraps() {
+    for (int i = 0; i < RA_TRACE_RING_SIZE + 100; i++) ra_trace_record(RA_TRACE_RING_WRITE, i, i + 1);
+    char *json = dump_to_string();
+    // Only the most recent events are kept once the ring wraps
+    assert(count_occurrences(json, "\"ph\":\"X\"") == RA_TRACE_RING_SIZE);
+    assert(!strstr(json, "\"name\":\"sendto\""));
+    assert(strstr(json, "\"ts\":8.291,\"dur\":0.001}"));
+    free(json);
+}
+
+static void record_on_thread(void *arg) {
+    ra_trace_set_thread_name(arg);
+    ra_trace_record(RA_TRACE_DECODE, 1000, 2000);
+}
+
+// Threads hand their ring back when they exit, so many more threads than rings all get to record in turn
+static void test_rings_reused() {
+    char name[32];
+    for (int i = 0; i < RA_TRACE_MAX_THREADS * 2; i++) {
+        snprintf(name, sizeof(name), "worker-%d", i);
+        int err;
+        ra_thread_t thread = ra_thread_start(&record_on_thread, name, &err);
+        assert(!err);
+        ra_thread_join(thread);
+        ra_thread_destroy(thread);
+    }
+    char *json = dump_to_string();
+    snprintf(name, sizeof(name), "\"name\":\"worker-%d\"", RA_TRACE_MAX_THREADS * 2 - 1);
+    assert(strstr(json, name));
+    assert(strstr(json, "\"name\":\"main\""));
+    free(json);
+}
+
+int main() {
+    test_disabled();
+    test_dump();
+    test_ring_wraps();
+    test_rings_reused();
+    return 0;
+}
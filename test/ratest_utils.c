@@ -22,10 +22,19 @@ int main() {
     ra_ringbuf_advance_write_ptr(rb, sz_example);
     assert(ra_ringbuf_free_count(rb) == (sz_buf - sz_example));
     assert(ra_ringbuf_fill_count(rb) == sz_example);
+    assert(ra_ringbuf_fill_total(rb) == sz_example);
 
     assert(memcmp(rptr, example, sz_example) == 0);
     ra_ringbuf_advance_read_ptr(rb, sz_example);
     assert(ra_ringbuf_fill_count(rb) == 0);
+    assert(ra_ringbuf_fill_total(rb) == 0);
+
+    // Wrap around the end of the buffer
+    ra_ringbuf_advance_write_ptr(rb, 24);
+    ra_ringbuf_advance_read_ptr(rb, 24);
+    ra_ringbuf_advance_write_ptr(rb, 16);
+    assert(ra_ringbuf_fill_count(rb) == 8);
+    assert(ra_ringbuf_fill_total(rb) == 16);
 
     ra_ringbuf_reset(rb);
     assert(ra_ringbuf_fill_count(rb) == 0);
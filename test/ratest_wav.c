@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <string.h>
+
+#include "lib/wav.h"
+
+static void test_roundtrip() {
+    FILE *file = tmpfile();
+    assert(file);
+
+    ra_wav_format_t fmt = {
+        .format = RA_WAV_FORMAT_PCM,
+        .channel_count = 2,
+        .sample_rate = 48000,
+        .bits_per_sample = 16,
+    };
+    ra_wav_writer_t *writer = ra_wav_writer_create(file, &fmt);
+    assert(writer);
+
+    int16_t samples[200];
+    for (int i = 0; i < 200; i++) samples[i] = i * 100 - 10000;
+    assert(!ra_wav_writer_write(writer, samples, 60));
+    assert(!ra_wav_writer_write(writer, samples + 120, 40));
+    assert(!ra_wav_writer_close(writer));
+
+    rewind(file);
+    ra_wav_format_t read_fmt;
+    ra_wav_reader_t *reader = ra_wav_reader_create(file, &read_fmt);
+    assert(reader);
+    assert(read_fmt.format == RA_WAV_FORMAT_PCM);
+    assert(read_fmt.channel_count == 2);
+    assert(read_fmt.sample_rate == 48000);
+    assert(read_fmt.bits_per_sample == 16);
+
+    // Reads stop at the end of the data chunk
+    int16_t buf[256];
+    assert(ra_wav_reader_read(reader, buf, 64) == 64);
+    assert(ra_wav_reader_read(reader, buf + 128, 64) == 36);
+    assert(ra_wav_reader_read(reader, buf, 64) == 0);
+    assert(!memcmp(buf + 128, samples + 128, 72 * sizeof(int16_t)));
+    ra_wav_reader_close(reader);
+    fclose(file);
+}
+
+static void test_chunks() {
+    // Extensible float format with a list chunk ahead of the data
+    static const unsigned char data[] = {
+        'R', 'I', 'F', 'F', 86, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ', 40, 0,  0,   0,   0xfe, 0xff,
+        1,   0,   0x80, 0xbb, 0, 0, 0, 0, 0, 0, 4, 0, 32, 0, 22, 0, 32, 0, 0,  0,   0,   0,   3,    0,
+        0,   0,   0,   0,    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'L', 'I', 'S', 'T', 3, 0,   0,   0,   'a',  'b',
+        'c', 0,   'd', 'a',  't', 'a', 8, 0, 0, 0, 0, 0, 0x80, 0x3f, 0, 0, 0x80, 0xbf,
+    };
+    FILE *file = tmpfile();
+    assert(file);
+    assert(fwrite(data, 1, sizeof(data), file) == sizeof(data));
+    rewind(file);
+
+    ra_wav_format_t fmt;
+    ra_wav_reader_t *reader = ra_wav_reader_create(file, &fmt);
+    assert(reader);
+    assert(fmt.format == RA_WAV_FORMAT_FLOAT);
+    assert(fmt.channel_count == 1);
+    assert(fmt.sample_rate == 48000);
+    assert(fmt.bits_per_sample == 32);
+
+    float samples[4];
+    assert(ra_wav_reader_read(reader, samples, 4) == 2);
+    assert(samples[0] == 1.0f && samples[1] == -1.0f);
+    ra_wav_reader_close(reader);
+    fclose(file);
+}
+
+int main() {
+    test_roundtrip();
+    test_chunks();
+    return 0;
+}
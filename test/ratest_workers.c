@@ -0,0 +1,46 @@
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "lib/workers.h"
+
+#define TASK_COUNT 64
+
+typedef struct {
+    atomic_int runs[TASK_COUNT];
+    atomic_int total;
+} task_data_t;
+
+static void count_task(void *arg, int index) {
+    task_data_t *data = arg;
+    data->runs[index]++;
+    data->total += index;
+}
+
+static void test_run(int thread_count) {
+    int err;
+    ra_workers_t *workers = ra_workers_create(thread_count, &err);
+    assert(!err && workers);
+
+    task_data_t data = {0};
+    for (int round = 1; round <= 100; round++) {
+        ra_workers_run(workers, &count_task, &data, TASK_COUNT);
+        for (int i = 0; i < TASK_COUNT; i++) assert(data.runs[i] == round);
+    }
+    assert(data.total == 100 * TASK_COUNT * (TASK_COUNT - 1) / 2);
+
+    // Fewer tasks than threads
+    task_data_t single = {0};
+    ra_workers_run(workers, &count_task, &single, 1);
+    assert(single.runs[0] == 1);
+    ra_workers_run(workers, &count_task, &single, 0);
+    assert(single.runs[0] == 1);
+
+    ra_workers_destroy(workers);
+}
+
+int main() {
+    test_run(0);
+    test_run(1);
+    test_run(3);
+    return 0;
+}